@@ -74,6 +74,10 @@ void AppSettings::load()
     m_mp4boxPath = loadToolPath(settings, "paths/mp4box", "mp4box.exe");
     m_nugenAmbPath = settings.value("paths/nugenAmb", "").toString();
     m_deleteTempFiles = settings.value("general/deleteTempFiles", true).toBool();
+    m_directSourceTracks = settings.value("general/directSourceTracks", true).toBool();
+    m_bitrateCalibration = settings.value("general/bitrateCalibration", true).toBool();
+    m_subsetFonts = settings.value("general/subsetFonts", false).toBool();
+    m_applyAudioOffset = settings.value("general/applyAudioOffset", false).toBool();
     m_userFileAction = static_cast<UserFileAction>(
         settings.value("general/userFileAction", static_cast<int>(UserFileAction::UseOriginalPath)).toInt());
     m_projectDirectory = settings.value("general/projectDirectory", "").toString();
@@ -138,6 +142,10 @@ void AppSettings::save()
     settings.setValue("paths/nugenAmb", m_nugenAmbPath);
     settings.setValue("general/setupCompleted", m_setupCompleted);
     settings.setValue("general/deleteTempFiles", m_deleteTempFiles);
+    settings.setValue("general/directSourceTracks", m_directSourceTracks);
+    settings.setValue("general/bitrateCalibration", m_bitrateCalibration);
+    settings.setValue("general/subsetFonts", m_subsetFonts);
+    settings.setValue("general/applyAudioOffset", m_applyAudioOffset);
     settings.setValue("general/userFileAction", static_cast<int>(m_userFileAction));
     settings.setValue("general/projectDirectory", m_projectDirectory);
 
@@ -378,6 +386,38 @@ void AppSettings::setDeleteTempFiles(bool enabled)
 {
     m_deleteTempFiles = enabled;
 }
+bool AppSettings::directSourceTracks() const
+{
+    return m_directSourceTracks;
+}
+void AppSettings::setDirectSourceTracks(bool enabled)
+{
+    m_directSourceTracks = enabled;
+}
+bool AppSettings::bitrateCalibration() const
+{
+    return m_bitrateCalibration;
+}
+void AppSettings::setBitrateCalibration(bool enabled)
+{
+    m_bitrateCalibration = enabled;
+}
+bool AppSettings::subsetFonts() const
+{
+    return m_subsetFonts;
+}
+void AppSettings::setSubsetFonts(bool enabled)
+{
+    m_subsetFonts = enabled;
+}
+bool AppSettings::applyAudioOffset() const
+{
+    return m_applyAudioOffset;
+}
+void AppSettings::setApplyAudioOffset(bool enabled)
+{
+    m_applyAudioOffset = enabled;
+}
 UserFileAction AppSettings::userFileAction() const
 {
     return m_userFileAction;
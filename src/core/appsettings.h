@@ -86,6 +86,14 @@ public:
     void setMp4boxPath(const QString& path);
     bool deleteTempFiles() const;
     void setDeleteTempFiles(bool enabled);
+    bool directSourceTracks() const;
+    void setDirectSourceTracks(bool enabled);
+    bool bitrateCalibration() const;
+    void setBitrateCalibration(bool enabled);
+    bool subsetFonts() const;
+    void setSubsetFonts(bool enabled);
+    bool applyAudioOffset() const;
+    void setApplyAudioOffset(bool enabled);
     UserFileAction userFileAction() const;
     void setUserFileAction(UserFileAction action);
     QString projectDirectory() const;
@@ -122,6 +130,10 @@ private:
     QString m_nugenAmbPath;
     QString m_mp4boxPath;
     bool m_deleteTempFiles;
+    bool m_directSourceTracks = true;
+    bool m_bitrateCalibration = true;
+    bool m_subsetFonts = false;
+    bool m_applyAudioOffset = false;
     UserFileAction m_userFileAction;
     QString m_projectDirectory;
     QList<TbStyleInfo> m_tbStyles;
@@ -0,0 +1,263 @@
+#include "filestager.h"
+
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+
+#if defined(Q_OS_WIN)
+#include <windows.h>
+#include <winioctl.h>
+#elif defined(Q_OS_LINUX)
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#elif defined(Q_OS_MACOS)
+#include <sys/clonefile.h>
+#include <unistd.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace
+{
+#if defined(Q_OS_WIN)
+// Block cloning (ReFS, Dev Drive). Объявления есть не во всех версиях SDK.
+#ifndef FILE_SUPPORTS_BLOCK_REFCOUNTING
+#define FILE_SUPPORTS_BLOCK_REFCOUNTING 0x08000000
+#endif
+#ifndef FSCTL_DUPLICATE_EXTENTS_TO_FILE
+#define FSCTL_DUPLICATE_EXTENTS_TO_FILE CTL_CODE(FILE_DEVICE_FILE_SYSTEM, 209, METHOD_BUFFERED, FILE_WRITE_DATA)
+#endif
+struct DuplicateExtentsData
+{
+    HANDLE fileHandle;
+    LARGE_INTEGER sourceFileOffset;
+    LARGE_INTEGER targetFileOffset;
+    LARGE_INTEGER byteCount;
+};
+
+qint64 clusterSizeForPath(const QString& path)
+{
+    wchar_t volume[MAX_PATH] = {};
+    const std::wstring native = QDir::toNativeSeparators(QFileInfo(path).absoluteFilePath()).toStdWString();
+    if (GetVolumePathNameW(native.c_str(), volume, MAX_PATH) == 0)
+    {
+        return 0;
+    }
+    DWORD sectorsPerCluster = 0;
+    DWORD bytesPerSector = 0;
+    DWORD freeClusters = 0;
+    DWORD totalClusters = 0;
+    if (GetDiskFreeSpaceW(volume, &sectorsPerCluster, &bytesPerSector, &freeClusters, &totalClusters) == 0)
+    {
+        return 0;
+    }
+    return static_cast<qint64>(sectorsPerCluster) * bytesPerSector;
+}
+
+bool tryReflink(const QString& sourcePath, const QString& destPath)
+{
+    const std::wstring src = QDir::toNativeSeparators(sourcePath).toStdWString();
+    const std::wstring dst = QDir::toNativeSeparators(destPath).toStdWString();
+
+    HANDLE source = CreateFileW(src.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, 0, nullptr);
+    if (source == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    DWORD fsFlags = 0;
+    LARGE_INTEGER size = {};
+    BY_HANDLE_FILE_INFORMATION info = {};
+    const qint64 cluster = clusterSizeForPath(sourcePath);
+    if (GetVolumeInformationByHandleW(source, nullptr, 0, nullptr, nullptr, &fsFlags, nullptr, 0) == 0 ||
+        (fsFlags & FILE_SUPPORTS_BLOCK_REFCOUNTING) == 0 || GetFileSizeEx(source, &size) == 0 ||
+        GetFileInformationByHandle(source, &info) == 0 || cluster <= 0)
+    {
+        CloseHandle(source);
+        return false;
+    }
+
+    HANDLE dest = CreateFileW(dst.c_str(), GENERIC_READ | GENERIC_WRITE | DELETE, 0, nullptr, CREATE_NEW, 0, nullptr);
+    if (dest == INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(source);
+        return false;
+    }
+
+    DWORD returned = 0;
+    bool ok = true;
+    if ((info.dwFileAttributes & FILE_ATTRIBUTE_SPARSE_FILE) != 0)
+    {
+        ok = DeviceIoControl(dest, FSCTL_SET_SPARSE, nullptr, 0, nullptr, 0, &returned, nullptr) != 0;
+    }
+
+    FILE_END_OF_FILE_INFO eof = {};
+    eof.EndOfFile = size;
+    ok = ok && SetFileInformationByHandle(dest, FileEndOfFileInfo, &eof, sizeof(eof)) != 0;
+
+    // Смещения и длина должны быть кратны кластеру; последний блок можно округлить вверх за конец файла.
+    // ByteCount одного вызова FSCTL должен быть меньше 4 ГиБ, поэтому клонируем кусками по 2^31 байт (2 ГиБ).
+    const qint64 maxChunk = (Q_INT64_C(1) << 31) / cluster * cluster;
+    for (qint64 offset = 0; ok && offset < size.QuadPart; offset += maxChunk)
+    {
+        const qint64 remaining = size.QuadPart - offset;
+        const qint64 rounded = (remaining + cluster - 1) / cluster * cluster;
+        DuplicateExtentsData data = {};
+        data.fileHandle = source;
+        data.sourceFileOffset.QuadPart = offset;
+        data.targetFileOffset.QuadPart = offset;
+        data.byteCount.QuadPart = qMin(rounded, maxChunk);
+        ok = DeviceIoControl(dest, FSCTL_DUPLICATE_EXTENTS_TO_FILE, &data, sizeof(data), nullptr, 0, &returned,
+                             nullptr) != 0;
+    }
+
+    if (!ok)
+    {
+        FILE_DISPOSITION_INFO disposition = {};
+        disposition.DeleteFile = TRUE;
+        SetFileInformationByHandle(dest, FileDispositionInfo, &disposition, sizeof(disposition));
+    }
+    CloseHandle(dest);
+    CloseHandle(source);
+    return ok;
+}
+
+bool tryHardlink(const QString& sourcePath, const QString& destPath)
+{
+    const std::wstring src = QDir::toNativeSeparators(sourcePath).toStdWString();
+    const std::wstring dst = QDir::toNativeSeparators(destPath).toStdWString();
+    return CreateHardLinkW(dst.c_str(), src.c_str(), nullptr) != 0;
+}
+#else
+bool tryReflink(const QString& sourcePath, const QString& destPath)
+{
+#if defined(Q_OS_LINUX)
+    const QByteArray src = QFile::encodeName(sourcePath);
+    const QByteArray dst = QFile::encodeName(destPath);
+    const int in = ::open(src.constData(), O_RDONLY | O_CLOEXEC);
+    if (in < 0)
+    {
+        return false;
+    }
+    const int out = ::open(dst.constData(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (out < 0)
+    {
+        ::close(in);
+        return false;
+    }
+    const bool ok = ::ioctl(out, FICLONE, in) == 0;
+    ::close(out);
+    ::close(in);
+    if (!ok)
+    {
+        ::unlink(dst.constData());
+    }
+    return ok;
+#elif defined(Q_OS_MACOS)
+    return ::clonefile(QFile::encodeName(sourcePath).constData(), QFile::encodeName(destPath).constData(), 0) == 0;
+#else
+    Q_UNUSED(sourcePath);
+    Q_UNUSED(destPath);
+    return false;
+#endif
+}
+
+bool tryHardlink(const QString& sourcePath, const QString& destPath)
+{
+    return ::link(QFile::encodeName(sourcePath).constData(), QFile::encodeName(destPath).constData()) == 0;
+}
+#endif
+} // namespace
+
+StageResult FileStager::stageFile(const QString& sourcePath, const QString& destPath, StageMode mode)
+{
+    StageResult result;
+    QElapsedTimer timer;
+    timer.start();
+
+    const QFileInfo sourceInfo(sourcePath);
+    if (!sourceInfo.exists())
+    {
+        result.errorString = QStringLiteral("исходный файл не найден");
+        return result;
+    }
+    result.bytes = sourceInfo.size();
+
+    const QString src = sourceInfo.absoluteFilePath();
+    const QString dst = QFileInfo(destPath).absoluteFilePath();
+    if (QFile::exists(dst))
+    {
+        QFile::remove(dst);
+    }
+
+    auto finish = [&](StageStrategy strategy)
+    {
+        result.ok = true;
+        result.strategy = strategy;
+        result.elapsedMs = timer.elapsed();
+        return result;
+    };
+
+    if (mode == StageMode::Move && QFile::rename(src, dst))
+    {
+        return finish(StageStrategy::Rename);
+    }
+
+    if (tryReflink(src, dst))
+    {
+        if (mode == StageMode::Move)
+        {
+            QFile::remove(src);
+        }
+        return finish(StageStrategy::Reflink);
+    }
+
+    if (mode == StageMode::ReadOnlyCopy && tryHardlink(src, dst))
+    {
+        return finish(StageStrategy::Hardlink);
+    }
+
+    QFile sourceFile(src);
+    if (sourceFile.copy(dst))
+    {
+        if (mode == StageMode::Move)
+        {
+            QFile::remove(src);
+        }
+        return finish(StageStrategy::Copy);
+    }
+
+    result.errorString = sourceFile.errorString();
+    result.elapsedMs = timer.elapsed();
+    return result;
+}
+
+QString FileStager::strategyName(StageStrategy strategy)
+{
+    switch (strategy)
+    {
+    case StageStrategy::Rename:
+        return QStringLiteral("rename");
+    case StageStrategy::Reflink:
+        return QStringLiteral("reflink");
+    case StageStrategy::Hardlink:
+        return QStringLiteral("hardlink");
+    case StageStrategy::Copy:
+        return QStringLiteral("copy");
+    case StageStrategy::None:
+        break;
+    }
+    return QStringLiteral("none");
+}
+
+QString FileStager::describe(const StageResult& result)
+{
+    const double mib = static_cast<double>(result.bytes) / (1024.0 * 1024.0);
+    return QStringLiteral("%1, %2 МиБ за %3 мс")
+        .arg(strategyName(result.strategy))
+        .arg(mib, 0, 'f', 1)
+        .arg(result.elapsedMs);
+}
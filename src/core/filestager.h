@@ -0,0 +1,45 @@
+#ifndef FILESTAGER_H
+#define FILESTAGER_H
+
+#include <QString>
+
+/// Способ, которым файл оказался по новому пути.
+enum class StageStrategy
+{
+    None,
+    Rename,   // перемещение в пределах одной ФС
+    Reflink,  // copy-on-write клон (FICLONE на btrfs/xfs, block cloning на ReFS, clonefile на APFS)
+    Hardlink, // жёсткая ссылка, только для файлов, которые дальше не изменяются
+    Copy      // обычное побайтовое копирование
+};
+
+enum class StageMode
+{
+    Move,        // исходник больше не нужен по старому пути
+    Copy,        // нужна независимая копия
+    ReadOnlyCopy // копия, которую никто не будет изменять: допустима жёсткая ссылка
+};
+
+struct StageResult
+{
+    bool ok = false;
+    StageStrategy strategy = StageStrategy::None;
+    qint64 bytes = 0;
+    qint64 elapsedMs = 0;
+    QString errorString;
+};
+
+namespace FileStager
+{
+/// Place \a sourcePath at \a destPath trying the cheapest strategy first:
+/// rename (Move only) -> reflink -> hardlink (ReadOnlyCopy only) -> buffered copy.
+/// An existing file at \a destPath is replaced.
+StageResult stageFile(const QString& sourcePath, const QString& destPath, StageMode mode);
+
+QString strategyName(StageStrategy strategy);
+
+/// Human-readable summary for the log, e.g. "reflink, 2150.4 МиБ за 3 мс".
+QString describe(const StageResult& result);
+} // namespace FileStager
+
+#endif // FILESTAGER_H
@@ -1,7 +1,14 @@
 #include "processmanager.h"
 
+#include <utility>
+
+#include <QFile>
 #include <QFileInfo>
 
+#ifdef Q_OS_WIN
+#include <windows.h>
+#endif
+
 ProcessManager::ProcessManager(QObject* parent) : QObject{parent}
 {
 }
@@ -9,8 +16,76 @@ ProcessManager::ProcessManager(QObject* parent) : QObject{parent}
 ProcessManager::~ProcessManager()
 {
     killProcess();
+#ifdef Q_OS_WIN
+    for (void* handle : std::as_const(m_ioCounterHandles))
+    {
+        CloseHandle(static_cast<HANDLE>(handle));
+    }
+#endif
+    m_ioCounterHandles.clear();
+}
+
+// Открываем дескриптор сразу после старта: он удерживает объект процесса,
+// поэтому счётчики ввода-вывода остаются доступны и после его завершения.
+static void* openIoCounterHandle(const QProcess* process)
+{
+#ifdef Q_OS_WIN
+    const qint64 pid = process->processId();
+    if (pid <= 0)
+    {
+        return nullptr;
+    }
+    return OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, static_cast<DWORD>(pid));
+#else
+    Q_UNUSED(process);
+    return nullptr;
+#endif
 }
 
+static qint64 takeBytesReadAndClose(void* handle)
+{
+    if (handle == nullptr)
+    {
+        return -1;
+    }
+#ifdef Q_OS_WIN
+    IO_COUNTERS counters = {};
+    const bool ok = GetProcessIoCounters(static_cast<HANDLE>(handle), &counters) != 0;
+    CloseHandle(static_cast<HANDLE>(handle));
+    return ok ? static_cast<qint64>(counters.ReadTransferCount) : -1;
+#else
+    return -1;
+#endif
+}
+
+#ifdef Q_OS_LINUX
+// rchar из /proc/<pid>/io — все прочитанные байты, включая попавшие в кэш, как ReadTransferCount в Windows.
+// Файл исчезает, как только QProcess заберёт код завершения, поэтому читать его можно только до этого.
+static qint64 readProcIoBytesRead(qint64 pid)
+{
+    if (pid <= 0)
+    {
+        return -1;
+    }
+    QFile file(QString("/proc/%1/io").arg(pid));
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        return -1;
+    }
+    const QList<QByteArray> lines = file.readAll().split('\n');
+    for (const QByteArray& line : lines)
+    {
+        if (line.startsWith("rchar:"))
+        {
+            bool ok = false;
+            const qint64 bytesRead = line.mid(6).trimmed().toLongLong(&ok);
+            return ok ? bytesRead : -1;
+        }
+    }
+    return -1;
+}
+#endif
+
 static QString formatCommand(const QString& program, const QStringList& arguments)
 {
     QStringList escapedArgs;
@@ -31,6 +106,7 @@ static QString formatCommand(const QString& program, const QStringList& argument
 void ProcessManager::startProcess(const QString& program, const QStringList& arguments)
 {
     m_wasKilled = false;
+    m_lastProcessBytesRead = -1;
     emit processOutput(QString("Запуск (асинхронный): %1").arg(formatCommand(program, arguments)));
 
     QProcess* newProcess = new QProcess(this);
@@ -38,6 +114,10 @@ void ProcessManager::startProcess(const QString& program, const QStringList& arg
     {
         newProcess->setWorkingDirectory(m_workingDir);
     }
+    if (!m_environment.isEmpty())
+    {
+        newProcess->setProcessEnvironment(m_environment);
+    }
     m_activeProcesses.append(newProcess);
 
     connect(newProcess, &QProcess::readyReadStandardOutput, this, &ProcessManager::onReadyReadStandardOutput);
@@ -51,10 +131,41 @@ void ProcessManager::startProcess(const QString& program, const QStringList& arg
                 emit processError("Не удалось запустить процесс: " + p->errorString());
             });
 
+    connect(newProcess, &QProcess::started, this,
+            [this, newProcess]()
+            {
+                if (void* handle = openIoCounterHandle(newProcess))
+                {
+                    m_ioCounterHandles.insert(newProcess, handle);
+                }
+            });
+
+#ifdef Q_OS_LINUX
+    // Дескриптор, который удержал бы счётчики после завершения, в Linux взять неоткуда: снимаем их при каждом
+    // выводе процесса и при закрытии его stdout, пока процесс ещё не убран. Последний снимок — итог.
+    const auto sampleBytesRead = [this, newProcess]()
+    {
+        const qint64 bytesRead = readProcIoBytesRead(newProcess->processId());
+        if (bytesRead >= 0)
+        {
+            m_bytesReadSamples.insert(newProcess, bytesRead);
+        }
+    };
+    connect(newProcess, &QProcess::readyReadStandardOutput, this, sampleBytesRead);
+    connect(newProcess, &QProcess::readyReadStandardError, this, sampleBytesRead);
+    connect(newProcess, &QProcess::readChannelFinished, this, sampleBytesRead);
+#endif
+
     // Когда процесс завершается, отправляем сигнал и удаляем его из нашего списка
     connect(newProcess, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished), this,
             [this, newProcess](int exitCode, QProcess::ExitStatus exitStatus)
             {
+                m_lastProcessBytesRead = takeBytesReadAndClose(m_ioCounterHandles.take(newProcess));
+                if (m_lastProcessBytesRead < 0)
+                {
+                    m_lastProcessBytesRead = m_bytesReadSamples.value(newProcess, -1);
+                }
+                m_bytesReadSamples.remove(newProcess);
                 flushProcessBuffers(newProcess);
                 emit processOutput(QString("Процесс (асинхронный) завершен с кодом %1.").arg(exitCode));
                 emit processFinished(exitCode, exitStatus);
@@ -66,6 +177,7 @@ void ProcessManager::startProcess(const QString& program, const QStringList& arg
 
     newProcess->start(program, arguments);
     m_workingDir.clear();
+    m_environment = QProcessEnvironment();
 }
 
 bool ProcessManager::executeAndWait(const QString& program, const QStringList& arguments, QByteArray& output,
@@ -78,6 +190,10 @@ bool ProcessManager::executeAndWait(const QString& program, const QStringList& a
     {
         syncProcess.setWorkingDirectory(m_workingDir);
     }
+    if (!m_environment.isEmpty())
+    {
+        syncProcess.setProcessEnvironment(m_environment);
+    }
     syncProcess.start(program, arguments);
 
     if (!syncProcess.waitForFinished(timeoutMs))
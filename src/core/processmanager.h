@@ -5,6 +5,7 @@
 #include <QList>
 #include <QObject>
 #include <QProcess>
+#include <QProcessEnvironment>
 
 class ProcessManager : public QObject
 {
@@ -19,10 +20,23 @@ public:
                         int timeoutMs = 30000);
     void killProcess();
     bool wasKilled() const;
+    /**
+     * Байты, прочитанные последним завершившимся асинхронным процессом (по счётчикам ОС), или -1.
+     * В Windows — точный итог, в Linux — последний снимок /proc/<pid>/io до завершения, в других ОС всегда -1.
+     */
+    qint64 lastProcessBytesRead() const
+    {
+        return m_lastProcessBytesRead;
+    }
     void setWorkingDirectory(const QString& dir)
     {
         m_workingDir = dir;
     }
+    /// Окружение следующего процесса, как и рабочая папка; пустое — окружение приложения.
+    void setProcessEnvironment(const QProcessEnvironment& environment)
+    {
+        m_environment = environment;
+    }
 
 signals:
     void processOutput(const QString& output);
@@ -42,8 +56,14 @@ private:
     QList<QProcess*> m_activeProcesses;
     bool m_wasKilled = false;
     QString m_workingDir;
+    QProcessEnvironment m_environment;
     QHash<QProcess*, QString> m_stdoutBuffers;
     QHash<QProcess*, QString> m_stderrBuffers;
+    // Дескрипторы процессов для чтения счётчиков ввода-вывода после завершения
+    QHash<QProcess*, void*> m_ioCounterHandles;
+    // Linux: последние снятые при работе процесса значения rchar
+    QHash<QProcess*, qint64> m_bytesReadSamples;
+    qint64 m_lastProcessBytesRead = -1;
 };
 
 #endif // PROCESSMANAGER_H
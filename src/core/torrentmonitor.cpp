@@ -0,0 +1,199 @@
+#include "torrentmonitor.h"
+
+#include <QCoreApplication>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QTimer>
+#include <QUrlQuery>
+
+namespace
+{
+constexpr qint64 kInfiniteEta = 8640000; // так qBittorrent обозначает «никогда»
+constexpr int kEtaFraction = 10;         // опрос не реже, чем 10 раз за оставшееся время
+} // namespace
+
+TorrentMonitor::TorrentMonitor(QObject* parent)
+    : QObject(parent), m_netManager(new QNetworkAccessManager(this)), m_pollTimer(new QTimer(this))
+{
+    m_pollTimer->setSingleShot(true);
+    connect(m_pollTimer, &QTimer::timeout, this, &TorrentMonitor::poll);
+}
+
+TorrentMonitor* TorrentMonitor::shared()
+{
+    // Создаётся в потоке первой серии и сразу переносится в поток приложения: потоки серий завершаются
+    static TorrentMonitor* monitor = []()
+    {
+        auto* instance = new TorrentMonitor;
+        instance->moveToThread(QCoreApplication::instance()->thread());
+        return instance;
+    }();
+    return monitor;
+}
+
+void TorrentMonitor::watch(const QString& webUiUrl, const QList<QNetworkCookie>& cookies, const QString& hash)
+{
+    const QString key = hash.toLower();
+    QMetaObject::invokeMethod(
+        this,
+        [this, webUiUrl, cookies, key]()
+        {
+            if (webUiUrl != m_webUiUrl)
+            {
+                m_webUiUrl = webUiUrl;
+                m_torrents.clear();
+                m_forceFullUpdate = true;
+            }
+            m_cookies = cookies;
+            // Поля нового торрента могли прийти в прошлых ответах, пока его ещё не отслеживали;
+            // полный ответ, который уже в пути, разбирается после этого и торрент не пропустит
+            if (!m_watched.contains(key) && !(m_requestInFlight && m_requestIsFull))
+            {
+                m_forceFullUpdate = true;
+            }
+            m_watched.insert(key);
+            m_pollTimer->stop();
+            poll();
+        },
+        Qt::QueuedConnection);
+}
+
+void TorrentMonitor::unwatch(const QString& hash)
+{
+    const QString key = hash.toLower();
+    QMetaObject::invokeMethod(
+        this,
+        [this, key]()
+        {
+            m_watched.remove(key);
+            m_torrents.remove(key);
+            if (m_watched.isEmpty())
+            {
+                m_pollTimer->stop();
+            }
+        },
+        Qt::QueuedConnection);
+}
+
+int TorrentMonitor::pollIntervalMs(const QList<TorrentState>& states)
+{
+    qint64 intervalMs = kMaxIntervalMs;
+    for (const TorrentState& state : states)
+    {
+        if (state.isFinished() || state.downloadSpeed <= 0)
+        {
+            continue;
+        }
+        if (state.etaS >= 0 && state.etaS < kInfiniteEta)
+        {
+            intervalMs = qMin(intervalMs, state.etaS * 1000 / kEtaFraction);
+        }
+        // Прогресс показывается с точностью до процента: опрашивать чаще, чем он меняется, незачем
+        if (state.sizeBytes > 0)
+        {
+            intervalMs = qMin(intervalMs, state.sizeBytes * 10 / state.downloadSpeed);
+        }
+    }
+    return int(qBound<qint64>(kMinIntervalMs, intervalMs, kMaxIntervalMs));
+}
+
+TorrentState TorrentMonitor::stateFromJson(const QString& hash, const QJsonObject& torrent)
+{
+    TorrentState state;
+    state.hash = hash;
+    state.state = torrent["state"].toString();
+    state.savePath = torrent["save_path"].toString();
+    state.progress = torrent["progress"].toDouble();
+    state.downloadSpeed = torrent["dlspeed"].toInteger();
+    state.etaS = torrent.contains("eta") ? torrent["eta"].toInteger() : -1;
+    state.sizeBytes = torrent["size"].toInteger();
+    return state;
+}
+
+void TorrentMonitor::poll()
+{
+    if (m_watched.isEmpty() || m_requestInFlight)
+    {
+        return;
+    }
+    QUrl url(m_webUiUrl + "/api/v2/sync/maindata");
+    QUrlQuery query;
+    m_requestIsFull = m_forceFullUpdate || m_rid == 0;
+    query.addQueryItem("rid", QString::number(m_requestIsFull ? 0 : m_rid));
+    url.setQuery(query);
+    m_forceFullUpdate = false;
+
+    QNetworkRequest request(url);
+    request.setHeader(QNetworkRequest::CookieHeader, QVariant::fromValue(m_cookies));
+    m_requestInFlight = true;
+    QNetworkReply* reply = m_netManager->get(request);
+    connect(reply, &QNetworkReply::finished, this, [this, reply]() { onMainDataReceived(reply); });
+}
+
+void TorrentMonitor::onMainDataReceived(QNetworkReply* reply)
+{
+    reply->deleteLater();
+    m_requestInFlight = false;
+    const QJsonObject root =
+        reply->error() == QNetworkReply::NoError ? QJsonDocument::fromJson(reply->readAll()).object() : QJsonObject();
+    if (root.isEmpty())
+    {
+        // Сеть или клиент недоступны: повтор не спеша, и следующий ответ — целиком
+        m_forceFullUpdate = true;
+        if (!m_watched.isEmpty())
+        {
+            m_pollTimer->start(kMaxIntervalMs);
+        }
+        return;
+    }
+
+    m_rid = root["rid"].toInteger();
+    if (root["full_update"].toBool())
+    {
+        m_torrents.clear();
+    }
+    const QJsonObject torrents = root["torrents"].toObject();
+    for (auto it = torrents.constBegin(); it != torrents.constEnd(); ++it)
+    {
+        const QString hash = it.key().toLower();
+        if (!m_watched.contains(hash))
+        {
+            continue;
+        }
+        // В дельте только изменившиеся поля, остальные берутся из прошлых ответов
+        QJsonObject& cached = m_torrents[hash];
+        const QJsonObject changes = it.value().toObject();
+        for (auto field = changes.constBegin(); field != changes.constEnd(); ++field)
+        {
+            cached.insert(field.key(), field.value());
+        }
+    }
+    for (const QJsonValue& removed : root["torrents_removed"].toArray())
+    {
+        m_torrents.remove(removed.toString().toLower());
+    }
+
+    // Рассылаем всех отслеживаемых: у подписчика, начавшего следить сейчас, прогресс может не меняться
+    for (auto it = m_torrents.constBegin(); it != m_torrents.constEnd(); ++it)
+    {
+        emit torrentUpdated(stateFromJson(it.key(), it.value()));
+    }
+    scheduleNextPoll();
+}
+
+void TorrentMonitor::scheduleNextPoll()
+{
+    if (m_watched.isEmpty())
+    {
+        return;
+    }
+    QList<TorrentState> states;
+    for (auto it = m_torrents.constBegin(); it != m_torrents.constEnd(); ++it)
+    {
+        states.append(stateFromJson(it.key(), it.value()));
+    }
+    // Торрент добавили к отслеживаемым, пока шёл запрос: полный ответ нужен сразу
+    m_pollTimer->start(m_forceFullUpdate ? 0 : pollIntervalMs(states));
+}
@@ -0,0 +1,93 @@
+#ifndef TORRENTMONITOR_H
+#define TORRENTMONITOR_H
+
+#include <QHash>
+#include <QJsonObject>
+#include <QList>
+#include <QMetaType>
+#include <QNetworkCookie>
+#include <QObject>
+#include <QSet>
+#include <QString>
+
+class QNetworkAccessManager;
+class QNetworkReply;
+class QTimer;
+
+/// Состояние отслеживаемого торрента по данным qBittorrent.
+struct TorrentState
+{
+    QString hash; // в нижнем регистре, как в ответах qBittorrent
+    QString state;
+    QString savePath;
+    double progress = 0.0;
+    qint64 downloadSpeed = 0; // байт/с
+    qint64 etaS = -1;         // -1 — неизвестно (у qBittorrent 8640000 — «бесконечно»)
+    qint64 sizeBytes = 0;
+
+    bool isFinished() const
+    {
+        return progress >= 1.0;
+    }
+};
+Q_DECLARE_METATYPE(TorrentState)
+
+/**
+ * @brief Общий для всех серий опрос qBittorrent через /api/v2/sync/maindata.
+ *
+ * Вместо отдельного запроса torrents/info на каждую серию раз в 500 мс — один запрос на всех: клиент
+ * присылает по rid только изменившиеся поля, монитор сливает их в кэш отслеживаемых торрентов и рассылает
+ * torrentUpdated(). Интервал опроса подстраивается под скорость и ETA: почти скачанный торрент опрашивается
+ * часто, стоящий — раз в kMaxIntervalMs.
+ *
+ * Монитор живёт в потоке приложения; watch() и unwatch() можно вызывать из потоков WorkflowManager.
+ */
+class TorrentMonitor : public QObject
+{
+    Q_OBJECT
+
+public:
+    static constexpr int kMinIntervalMs = 500;
+    static constexpr int kMaxIntervalMs = 5000;
+
+    explicit TorrentMonitor(QObject* parent = nullptr);
+
+    /// Монитор приложения, общий для всех WorkflowManager.
+    static TorrentMonitor* shared();
+
+    /**
+     * @brief Отслеживать \a hash; первый опрос — сразу.
+     * @param webUiUrl адрес Web UI вместе с портом, например "http://127.0.0.1:8080"
+     */
+    void watch(const QString& webUiUrl, const QList<QNetworkCookie>& cookies, const QString& hash);
+    void unwatch(const QString& hash);
+
+    /// Интервал до следующего опроса: ETA / 10 или время на 1% размера, в пределах [kMinIntervalMs, kMaxIntervalMs].
+    static int pollIntervalMs(const QList<TorrentState>& states);
+
+    /// Состояние из полей объекта торрента qBittorrent.
+    static TorrentState stateFromJson(const QString& hash, const QJsonObject& torrent);
+
+public slots:
+    void poll();
+
+signals:
+    void torrentUpdated(const TorrentState& state);
+
+private:
+    void onMainDataReceived(QNetworkReply* reply);
+    void scheduleNextPoll();
+
+    QNetworkAccessManager* m_netManager = nullptr;
+    QTimer* m_pollTimer = nullptr;
+    QString m_webUiUrl;
+    QList<QNetworkCookie> m_cookies;
+    QSet<QString> m_watched;
+    QHash<QString, QJsonObject> m_torrents; // накопленные поля отслеживаемых торрентов
+    qint64 m_rid = 0;
+    bool m_forceFullUpdate = true; // следующий запрос с rid=0
+    bool m_requestInFlight = false;
+    bool m_requestIsFull = false; // запрос в пути отправлен с rid=0
+};
+
+#endif // TORRENTMONITOR_H
@@ -1,12 +1,21 @@
 ﻿#include "workflowmanager.h"
 
 #include "assprocessor.h"
+#include "audiooffset.h"
+#include "bitratecalibrator.h"
 #include "chapterhelper.h"
+#include "chunkedflac.h"
+#include "filestager.h"
 #include "fontfinder.h"
+#include "fontstore.h"
+#include "fontsubsetter.h"
+#include "loudnessmeter.h"
 #include "mainwindow.h"
 #include "manualrenderer.h"
+#include "mkvattachments.h"
 #include "processmanager.h"
 #include "trackselectordialog.h"
+#include "wavfile.h"
 
 #include <QDir>
 #include <QEventLoop>
@@ -14,6 +23,7 @@
 #include <QFileInfo>
 #include <QFontDatabase>
 #include <QFontInfo>
+#include <QFutureWatcher>
 #include <QHash>
 #include <QHttpMultiPart>
 #include <QJsonArray>
@@ -22,10 +32,16 @@
 #include <QMessageBox>
 #include <QProcess>
 #include <QRegularExpression>
+#include <QSaveFile>
 #include <QSet>
 #include <QTextStream>
+#include <QThread>
 #include <QUrlQuery>
 #include <QXmlStreamReader>
+#include <QtConcurrent/QtConcurrentRun>
+
+#include <algorithm>
+#include <utility>
 
 #include <windows.h> // Для API шрифтов
 
@@ -147,6 +163,22 @@ double probeTsVideoEndTime(ProcessManager* processManager, const QString& ffprob
     return durOk ? duration : -1.0;
 }
 
+// Первый видеопоток файла из ffprobe (codec_name, profile, pix_fmt); пустой объект, если ffprobe не ответил
+QJsonObject probeVideoStream(ProcessManager* processManager, const QString& ffprobePath, const QString& path)
+{
+    QByteArray output;
+    if (ffprobePath.isEmpty() || !QFileInfo::exists(ffprobePath) ||
+        !processManager->executeAndWait(ffprobePath,
+                                        {"-v", "quiet", "-select_streams", "v:0", "-show_entries",
+                                         "stream=codec_name,profile,pix_fmt", "-print_format", "json", path},
+                                        output))
+    {
+        return {};
+    }
+    const QJsonArray streams = QJsonDocument::fromJson(output).object()["streams"].toArray();
+    return streams.isEmpty() ? QJsonObject() : streams.first().toObject();
+}
+
 QJsonObject probeTsVideoStats(ProcessManager* processManager, const QString& ffprobePath, const QString& tsPath)
 {
     QJsonObject stats{
@@ -373,6 +405,25 @@ QString probeLastFrameMd5FromTailWindow(ProcessManager* processManager, const QS
     return "";
 }
 
+/// Если \a future ещё считается, вызвать \a next после его завершения и вернуть true.
+template <typename T, typename Next>
+bool deferUntilFinished(QObject* context, const QFuture<T>& future, Next next)
+{
+    if (!future.isValid() || future.isFinished())
+    {
+        return false;
+    }
+    auto* watcher = new QFutureWatcher<T>(context);
+    QObject::connect(watcher, &QFutureWatcher<T>::finished, context,
+                     [watcher, next]()
+                     {
+                         watcher->deleteLater();
+                         next();
+                     });
+    watcher->setFuture(future);
+    return true;
+}
+
 void enforceAacFromWavForPresetArgs(QStringList& args, const QString& wavPath)
 {
     if (args.isEmpty() || wavPath.isEmpty())
@@ -496,7 +547,6 @@ WorkflowManager::WorkflowManager(ReleaseTemplate t, const QString& episodeNumber
     connect(m_fontFinder, &FontFinder::logMessage, this, &WorkflowManager::logMessage);
     connect(m_fontFinder, &FontFinder::finished, this, &WorkflowManager::onFontFinderFinished);
     connect(m_assProcessor, &AssProcessor::logMessage, this, &WorkflowManager::logMessage);
-    connect(m_progressTimer, &QTimer::timeout, this, &WorkflowManager::onPollingTimerTimeout);
     connect(m_processManager, &ProcessManager::processOutput, this, &WorkflowManager::onProcessStdOut);
     connect(m_processManager, &ProcessManager::processStdErr, this, &WorkflowManager::onProcessStdErr);
     connect(m_processManager, &ProcessManager::processFinished, this, &WorkflowManager::onProcessFinished);
@@ -504,6 +554,11 @@ WorkflowManager::WorkflowManager(ReleaseTemplate t, const QString& episodeNumber
 
 WorkflowManager::~WorkflowManager()
 {
+    if (m_currentStep == Step::Polling)
+    {
+        TorrentMonitor::shared()->unwatch(m_torrentHash);
+    }
+    *m_chunkedFlacCancelled = true;
     delete m_paths;
 }
 
@@ -560,7 +615,7 @@ void WorkflowManager::startWithManualFile(const QString& filePath)
     m_paths = new PathManager(baseDownloadPath, useOriginal);
     emit logMessage("Структура папок создана в: " + m_paths->basePath, LogCategory::APP);
 
-    QString newPath = handleUserFile(filePath, m_paths->sourcesPath);
+    QString newPath = handleUserFile(filePath, m_paths->sourcesPath, QString(), true);
     if (newPath.isEmpty())
     {
         emit logMessage("Критическая ошибка: не удалось переместить указанный видеофайл.", LogCategory::APP,
@@ -1081,55 +1136,31 @@ void WorkflowManager::startPolling()
     m_currentStep = Step::Polling;
     emit logMessage("Начинаем отслеживание прогресса скачивания...", LogCategory::APP);
     emit progressUpdated(0, "Скачивание торрента");
-    m_progressTimer->disconnect();
-    connect(m_progressTimer, &QTimer::timeout, this, &WorkflowManager::onPollingTimerTimeout);
-    onPollingTimerTimeout();
-    m_progressTimer->start(500);
-}
-
-void WorkflowManager::onPollingTimerTimeout()
-{
-    QUrl url(QString("%1:%2/api/v2/torrents/info").arg(m_webUiHost).arg(m_webUiPort));
-    QUrlQuery query;
-    query.addQueryItem("filter", "all");
-    query.addQueryItem("hashes", m_torrentHash);
-    url.setQuery(query);
-
-    QNetworkRequest request(url);
-    request.setHeader(QNetworkRequest::CookieHeader, QVariant::fromValue(m_cookies));
-
-    QNetworkReply* reply = m_netManager->get(request);
-    connect(reply, &QNetworkReply::finished, this, [this, reply]() { onTorrentProgressReceived(reply); });
+    // Один опрос sync/maindata на все серии вместо torrents/info раз в 500 мс на каждую
+    TorrentMonitor* monitor = TorrentMonitor::shared();
+    connect(monitor, &TorrentMonitor::torrentUpdated, this, &WorkflowManager::onTorrentUpdated, Qt::UniqueConnection);
+    monitor->watch(QString("%1:%2").arg(m_webUiHost).arg(m_webUiPort), m_cookies, m_torrentHash);
 }
 
-void WorkflowManager::onTorrentProgressReceived(QNetworkReply* reply)
+void WorkflowManager::onTorrentUpdated(const TorrentState& state)
 {
-    if (reply->error() != QNetworkReply::NoError)
+    if (m_currentStep != Step::Polling || state.hash.compare(m_torrentHash, Qt::CaseInsensitive) != 0)
     {
-        reply->deleteLater();
         return;
     }
 
-    QJsonArray torrents = QJsonDocument::fromJson(reply->readAll()).array();
-    if (torrents.isEmpty())
-    {
-        reply->deleteLater();
-        return;
-    }
-
-    QJsonObject torrent = torrents[0].toObject();
-    double progress = torrent["progress"].toDouble();
-    int percentage = static_cast<int>(progress * 100);
+    emit progressUpdated(static_cast<int>(state.progress * 100));
 
-    emit progressUpdated(percentage);
-
-    if (progress >= 1.0)
+    if (state.isFinished())
     {
-        m_progressTimer->stop();
+        // Обновления, уже стоящие в очереди потока, после этого игнорируются
+        m_currentStep = Step::Idle;
+        TorrentMonitor::shared()->unwatch(m_torrentHash);
+        disconnect(TorrentMonitor::shared(), &TorrentMonitor::torrentUpdated, this,
+                   &WorkflowManager::onTorrentUpdated);
         emit logMessage("Скачивание завершено (100%).", LogCategory::APP);
         getTorrentFiles();
     }
-    reply->deleteLater();
 }
 
 void WorkflowManager::getTorrentFiles()
@@ -1188,6 +1219,11 @@ void WorkflowManager::getMkvInfo()
     prepareUserFiles();
 
     m_sourceFormat = SourceFormat::MKV;
+    m_directSourceTracks = false;
+    m_demuxSourceSize = 0;
+    m_embeddedChaptersChecked = false;
+    m_embeddedChaptersPath.clear();
+    m_sourceFontAttachments.clear();
     emit logMessage("Шаг 2: Получение информации о файле MKV...", LogCategory::APP);
 
     m_currentStep = Step::GettingMkvInfo;
@@ -1272,6 +1308,8 @@ void WorkflowManager::getMkvInfo()
                 m_videoTrack.id = track["id"].toInt();
                 m_videoTrack.codecId = codecId;
                 m_videoTrack.extension = getExtensionForCodec(codecId);
+                m_videoTrack.bitrateKbps =
+                    RenderHelper::mkvTrackBitrateKbps(props, static_cast<double>(m_sourceDurationS));
             }
             else if (track["type"].toString() == "audio" && languageMatch)
             {
@@ -1316,19 +1354,13 @@ void WorkflowManager::getMkvInfo()
         }
 
         loadChaptersForWorkflow();
+        startFingerprintScan();
 
         if (m_template.chaptersEnabled && m_chapterMarkers.isEmpty() && !m_skipChaptersForWorkflow)
         {
             m_chapterContinueKind = ChapterContinueKind::AfterMkvProbe;
             m_pendingMkvInfoRoot = root;
-            m_wasUserInputRequested = true;
-            m_lastStepBeforeRequest = Step::GettingMkvInfo;
-            UserInputRequest req;
-            req.chaptersRequired = true;
-            req.chaptersReason =
-                QStringLiteral("Для релиза ожидаются главы, но в контейнере не найдено и на главной странице не "
-                               "указан файл XML. Укажите путь к файлу глав или выберите сборку без глав.");
-            emit userInputRequired(req);
+            requestMissingChapters();
             return;
         }
 
@@ -1355,17 +1387,10 @@ QString WorkflowManager::parseChaptersWithMkvExtract()
 {
     emit logMessage("Запуск mkvextract для извлечения глав...", LogCategory::APP);
 
-    // Мы не знаем, какой формат получим, поэтому используем .txt
-    QString chaptersFilePath = QDir(m_paths->sourcesPath).filePath("chapters_temp.txt");
-
-    QStringList args;
-    args << m_mkvFilePath << "chapters" << chaptersFilePath;
-
-    QByteArray dummyOutput;
-    if (!m_processManager->executeAndWait(m_mkvextractPath, args, dummyOutput))
+    const QString chaptersFilePath = embeddedChaptersFile();
+    if (chaptersFilePath.isEmpty())
     {
         emit logMessage("Ошибка при извлечении глав с помощью mkvextract.", LogCategory::APP, LogLevel::Error);
-        QFile::remove(chaptersFilePath);
         return QString();
     }
 
@@ -1373,7 +1398,6 @@ QString WorkflowManager::parseChaptersWithMkvExtract()
     if (!chaptersFile.open(QIODevice::ReadOnly | QIODevice::Text))
     {
         emit logMessage("Не удалось открыть временный файл с главами.", LogCategory::APP);
-        QFile::remove(chaptersFilePath);
         return QString();
     }
 
@@ -1456,14 +1480,13 @@ QString WorkflowManager::parseChaptersWithMkvExtract()
     }
 
     chaptersFile.close();
-    QFile::remove(chaptersFilePath);
 
     return foundTime;
 }
 
 void WorkflowManager::extractTracks()
 {
-    emit logMessage("Шаг 4: Извлечение дорожек (ffmpeg)...", LogCategory::APP);
+    emit logMessage("Шаг 4: Извлечение дорожек за один проход (mkvextract)...", LogCategory::APP);
     m_currentStep = Step::ExtractingTracks;
 
     if (m_videoTrack.id == -1)
@@ -1474,41 +1497,103 @@ void WorkflowManager::extractTracks()
         return;
     }
 
-    QStringList args;
-    args << "-y" << "-i" << m_mkvFilePath;
-
-    QString videoOutPath = m_paths->extractedVideo(m_videoTrack.extension);
-    args << "-map" << QString("0:%1").arg(m_videoTrack.id) << "-c:v" << "copy" << "-map_chapters" << "-1"
-         << videoOutPath;
+    // Без промежуточного извлечения видео и оригинальное аудио берутся mkvmerge прямо из исходника по ID.
+    m_directSourceTracks = AppSettings::instance().directSourceTracks();
 
-    if (m_originalAudioTrack.id != -1)
+    // Один вызов mkvextract читает исходник последовательно один раз вместо ffmpeg-демукса по дорожкам.
+    // Шрифты-вложения извлекаются позже (extractReferencedFonts()), когда известно, какие нужны субтитрам.
+    QStringList trackSpecs;
+    if (m_directSourceTracks)
     {
-        QString audioExtension = (m_sourceFormat == SourceFormat::MP4) ? "m4a" : "mka";
-        QString audioOutPath = m_paths->extractedAudio(audioExtension);
-        args << "-map" << QString("0:%1").arg(m_originalAudioTrack.id) << "-c:a" << "copy" << "-map_chapters" << "-1"
-             << audioOutPath;
+        emit logMessage("Видео и оригинальное аудио не извлекаются: сборка возьмёт их напрямую из исходного MKV.",
+                        LogCategory::APP);
+    }
+    else
+    {
+        trackSpecs << QString("%1:%2").arg(m_videoTrack.id).arg(m_paths->extractedVideo(m_videoTrack.extension));
+        if (m_originalAudioTrack.id != -1)
+        {
+            trackSpecs << QString("%1:%2").arg(m_originalAudioTrack.id).arg(originalAudioSourcePath());
+        }
     }
 
-    if (m_sourceFormat == SourceFormat::MKV && m_template.sourceHasSubtitles && m_overrideSubsPath.isEmpty() &&
-        m_subtitleTrack.id != -1)
+    if (m_template.sourceHasSubtitles && m_overrideSubsPath.isEmpty() && m_subtitleTrack.id != -1)
     {
-        QString subsOutPath = m_paths->extractedSubs(m_subtitleTrack.extension);
-        args << "-map" << QString("0:%1").arg(m_subtitleTrack.id) << "-c:s" << "copy" << "-map_chapters" << "-1"
-             << subsOutPath;
+        trackSpecs << QString("%1:%2").arg(m_subtitleTrack.id).arg(m_paths->extractedSubs(m_subtitleTrack.extension));
     }
     else if (!m_overrideSubsPath.isEmpty())
     {
         emit logMessage("Пропускаем извлечение встроенных субтитров, так как указаны внешние файлы.", LogCategory::APP);
     }
-    else if (m_sourceFormat == SourceFormat::MP4 && m_template.sourceHasSubtitles)
+
+    if (trackSpecs.isEmpty())
     {
-        emit logMessage(
-            "Предупреждение: MP4 файл не содержит субтитров формата ASS. Укажите субтитры через 'Свои субтитры'.",
-            LogCategory::APP, LogLevel::Warning);
+        emit logMessage("Извлекать из исходника нечего. Пропускаем шаг.", LogCategory::APP);
+        QMetaObject::invokeMethod(this, "onProcessFinished", Qt::QueuedConnection, Q_ARG(int, 0),
+                                  Q_ARG(QProcess::ExitStatus, QProcess::NormalExit));
+        return;
     }
 
-    emit progressUpdated(-1, "Извлечение дорожек (ffmpeg)");
-    m_processManager->startProcess(m_ffmpegPath, args);
+    QStringList args;
+    args << m_mkvFilePath << "tracks" << trackSpecs;
+
+    m_demuxSourceSize = QFileInfo(m_mkvFilePath).size();
+    emit progressUpdated(-1, "Извлечение дорожек (mkvextract)");
+    m_processManager->startProcess(m_mkvextractPath, args);
+}
+
+void WorkflowManager::logDemuxBytesRead()
+{
+    if (m_sourceFormat != SourceFormat::MKV)
+    {
+        return;
+    }
+    const qint64 bytesRead = m_processManager->lastProcessBytesRead();
+    if (m_demuxSourceSize <= 0)
+    {
+        return;
+    }
+    const double mib = 1024.0 * 1024.0;
+    if (bytesRead < 0)
+    {
+        emit logMessage(QString("Демукс: один проход по источнику (%1 МиБ), счётчик чтения недоступен "
+                                "(он есть только в Windows и Linux).")
+                            .arg(m_demuxSourceSize / mib, 0, 'f', 1),
+                        LogCategory::APP);
+        return;
+    }
+    const double ratio = m_demuxSourceSize > 0 ? static_cast<double>(bytesRead) / m_demuxSourceSize : 0.0;
+    emit logMessage(QString("Демукс: прочитано %1 МиБ при размере источника %2 МиБ (%3x).")
+                        .arg(bytesRead / mib, 0, 'f', 1)
+                        .arg(m_demuxSourceSize / mib, 0, 'f', 1)
+                        .arg(ratio, 0, 'f', 2),
+                    LogCategory::APP);
+}
+
+QString WorkflowManager::originalAudioSourcePath() const
+{
+    if (m_sourceFormat == SourceFormat::MP4)
+    {
+        return m_paths->extractedAudio("m4a");
+    }
+    // mkvextract пишет дорожку в её «родном» формате (ADTS, FLAC, Ogg...), поэтому расширение берётся из кодека.
+    return m_paths->extractedAudio(m_originalAudioTrack.extension.isEmpty() ? "mka" : m_originalAudioTrack.extension);
+}
+
+QString WorkflowManager::embeddedChaptersFile()
+{
+    if (!m_embeddedChaptersChecked)
+    {
+        // Главы лежат в заголовке сегмента: mkvextract читает только его, а результат
+        // используется и для поиска главы эндинга, и для глав финального MKV.
+        m_embeddedChaptersChecked = true;
+        const QString embPath = QDir(m_paths->sourcesPath).filePath(QStringLiteral("chapters_embedded.xml"));
+        if (ChapterHelper::extractEmbeddedChaptersToFile(m_mkvextractPath, m_mkvFilePath, embPath, m_processManager))
+        {
+            m_embeddedChaptersPath = embPath;
+        }
+    }
+    return m_embeddedChaptersPath;
 }
 
 void WorkflowManager::cancelOperation()
@@ -1521,11 +1606,32 @@ void WorkflowManager::cancelOperation()
     }
     switch (m_currentStep)
     {
+    case Step::ConvertingAudio:
+        // Куски кодируют процессы в пуле потоков: их убивает сама задача, результат будет отброшен
+        if (m_chunkedFlacFuture.isValid() && !m_chunkedFlacFuture.isFinished())
+        {
+            *m_chunkedFlacCancelled = true;
+            emit logMessage("Операция успешно отменена пользователем.", LogCategory::APP);
+            emit workflowAborted();
+        }
+        break;
+
+    case Step::CalibratingBitrate:
+        if (m_bitrateCalibrator != nullptr)
+        {
+            m_bitrateCalibrator->cancel();
+            m_bitrateCalibrator = nullptr;
+        }
+        emit logMessage("Операция успешно отменена пользователем.", LogCategory::APP);
+        emit workflowAborted();
+        break;
+
     case Step::Polling:
     case Step::AddingTorrent:
         // Если мы скачиваем торрент, просто останавливаем таймеры и завершаем работу.
         // Мы не можем "отменить" скачивание в qBittorrent, но мы можем прекратить его отслеживать.
         emit logMessage("Отслеживание торрента прервано пользователем.", LogCategory::APP);
+        TorrentMonitor::shared()->unwatch(m_torrentHash);
         if ((m_progressTimer != nullptr) && m_progressTimer->isActive())
         {
             m_progressTimer->stop();
@@ -1584,7 +1690,7 @@ void WorkflowManager::onProcessFinished(int exitCode, QProcess::ExitStatus exitS
     {
     case Step::ExtractingAttachments:
     {
-        emit logMessage("Извлечение вложений завершено.", LogCategory::APP);
+        emit logMessage("Поиск вложений завершен.", LogCategory::APP);
         if (m_sourceFormat == SourceFormat::MP4)
         {
             extractTracksMp4();
@@ -1595,9 +1701,27 @@ void WorkflowManager::onProcessFinished(int exitCode, QProcess::ExitStatus exitS
         }
         break;
     }
+    case Step::ExtractingFonts:
+    {
+        emit logMessage("Извлечение шрифтов завершено.", LogCategory::APP);
+        // Извлечённые файлы переезжают в хранилище, в проекте остаются ссылки
+        QHash<QString, StoredFont> stored;
+        for (const QString& path : std::as_const(m_tempFontPaths))
+        {
+            const StoredFont adopted = FontStore::adoptFile(path);
+            if (adopted.ok)
+            {
+                stored.insert(QFileInfo(path).fileName(), adopted);
+            }
+        }
+        reportStoredFonts(stored);
+        findFontsInProcessedSubs();
+        break;
+    }
     case Step::ExtractingTracks:
     {
         emit logMessage("Извлечение дорожек завершено.", LogCategory::APP);
+        logDemuxBytesRead();
         // --- Шаг 4.5: Автозамены и пауза для ручной правки ---
         QString extractedSubsPath = m_paths->extractedSubs("ass");
         if (QFileInfo::exists(extractedSubsPath))
@@ -1679,20 +1803,14 @@ void WorkflowManager::onProcessFinished(int exitCode, QProcess::ExitStatus exitS
         if (m_audioConversionNeedsSecondPass)
         {
             m_audioConversionNeedsSecondPass = false;
-            m_audioConversionCurrentOutputPath = m_finalAudioMp4Path;
-            emit logMessage("Конвертация аудио для MKV завершена. Запуск отдельной конвертации для MP4...",
+            m_audioConversionCurrentOutputPath = m_finalAudioPath;
+            emit logMessage("Кодирование AAC завершено. Перепаковка того же битстрима в MKA (без перекодирования)...",
                             LogCategory::APP);
 
+            // Второй проход — только ремукс m4a -> mka. Битстрим один и тот же для MKV и MP4,
+            // повторное кодирование WAV не нужно.
             QStringList args;
-            args << "-y" << "-i" << m_mainRuAudioPath;
-            if (AppSettings::instance().hasAacAtCodec())
-            {
-                args << "-c:a" << "aac_at" << "-b:a" << "256k";
-            }
-            else
-            {
-                args << "-c:a" << "aac" << "-b:a" << "256k";
-            }
+            args << "-y" << "-i" << m_finalAudioMp4Path << "-map" << "0:a:0" << "-c:a" << "copy";
             args << "-progress" << QDir::toNativeSeparators(m_ffmpegProgressFile) << m_audioConversionCurrentOutputPath;
 
             m_progressTimer->disconnect();
@@ -1715,7 +1833,7 @@ void WorkflowManager::onProcessFinished(int exitCode, QProcess::ExitStatus exitS
         {
             emit logMessage("Удаление временных файлов...", LogCategory::APP);
             QString videoPath = m_paths->extractedVideo(m_videoTrack.extension);
-            QString audioPath = m_paths->extractedAudio(m_sourceFormat == SourceFormat::MP4 ? "m4a" : "mka");
+            QString audioPath = originalAudioSourcePath();
             bool videoRemoved = QFile::remove(videoPath);
             bool audioRemoved = QFile::remove(audioPath);
             if (videoRemoved)
@@ -1758,6 +1876,11 @@ void WorkflowManager::onProcessFinished(int exitCode, QProcess::ExitStatus exitS
         else
         {
             emit logMessage("Рендер MP4 успешно завершен (один проход).", LogCategory::APP);
+            if (m_renderTimer.isValid())
+            {
+                RenderHelper::recordRenderSpeed(m_renderPreset.name, static_cast<double>(m_sourceDurationS),
+                                                m_renderTimer.elapsed());
+            }
             RenderHelper* helper = new RenderHelper(m_renderPreset, m_tempVideoMp4Path, m_processManager, this);
             connect(helper, &RenderHelper::logMessage, this, &WorkflowManager::logMessage);
             connect(helper, &RenderHelper::finished, this, &WorkflowManager::onBitrateCheckFinished);
@@ -1777,6 +1900,11 @@ void WorkflowManager::onProcessFinished(int exitCode, QProcess::ExitStatus exitS
         }
 
         emit logMessage("Второй проход и рендер MP4 успешно завершены.", LogCategory::APP);
+        if (m_renderTimer.isValid())
+        {
+            RenderHelper::recordRenderSpeed(m_renderPreset.name, static_cast<double>(m_sourceDurationS),
+                                            m_renderTimer.elapsed());
+        }
         RenderHelper* helper = new RenderHelper(m_renderPreset, m_tempVideoMp4Path, m_processManager, this);
         connect(helper, &RenderHelper::logMessage, this, &WorkflowManager::logMessage);
         connect(helper, &RenderHelper::finished, this, &WorkflowManager::onBitrateCheckFinished);
@@ -1784,6 +1912,30 @@ void WorkflowManager::onProcessFinished(int exitCode, QProcess::ExitStatus exitS
         helper->startCheck();
         break;
     }
+    case Step::CopyingMp4Video:
+    {
+        if (exitCode != 0)
+        {
+            emit logMessage("Копирование видео в MP4 не удалось, выполняется обычный рендер.", LogCategory::APP,
+                            LogLevel::Warning);
+            m_renderAudioArgs.clear();
+            if (!startBitrateCalibration())
+            {
+                m_currentStep = Step::RenderingMp4Pass1;
+                runRenderPass(m_currentStep);
+            }
+            break;
+        }
+
+        emit logMessage(RenderHelper::describeFastPathSavings(m_renderPreset.name,
+                                                              static_cast<double>(m_sourceDurationS),
+                                                              m_renderTimer.elapsed()),
+                        LogCategory::APP);
+        m_renderTimer.invalidate();
+        m_mp4VideoReady = true;
+        startMp4MuxPipeline();
+        break;
+    }
     case Step::RenderingMp4Audio:
     {
         emit logMessage("MP4 mux: аудиопроход завершен.", LogCategory::APP);
@@ -1861,12 +2013,28 @@ void WorkflowManager::audioPreparation()
     emit progressUpdated(-1, "Подготовка данных");
 
     UserInputRequest request;
+    // Оборванная загрузка: файл просим заново, пока не началась долгая обработка
+    const QString audioError = WavFile::integrityError(WavFile::readHeader(m_mainRuAudioPath));
+    if (!audioError.isEmpty())
+    {
+        emit logMessage(QString("Аудиофайл %1 повреждён: %2.").arg(QFileInfo(m_mainRuAudioPath).fileName(), audioError),
+                        LogCategory::APP, LogLevel::Error);
+        m_mainRuAudioPath.clear();
+    }
+    const QString srtMasterWavError = WavFile::integrityError(WavFile::readHeader(m_wavForSrtMasterPath));
+    if (!srtMasterWavError.isEmpty())
+    {
+        emit logMessage(QString("WAV для мастер-копии %1 повреждён: %2.")
+                            .arg(QFileInfo(m_wavForSrtMasterPath).fileName(), srtMasterWavError),
+                        LogCategory::APP, LogLevel::Error);
+        m_wavForSrtMasterPath.clear();
+    }
     if (m_mainRuAudioPath.isEmpty())
     {
         request.audioFileRequired = true;
     }
 
-    bool mainAudioIsWav = m_mainRuAudioPath.endsWith(".wav", Qt::CaseInsensitive);
+    bool mainAudioIsWav = WavFile::isWav(m_mainRuAudioPath);
     if (m_template.createSrtMaster && !mainAudioIsWav && m_wavForSrtMasterPath.isEmpty())
     {
         request.audioFileRequired = true;
@@ -1884,6 +2052,15 @@ void WorkflowManager::audioPreparation()
         timeForTb = m_parsedEndingTime;
         emit logMessage("Используется время для ТБ: " + timeForTb, LogCategory::APP);
     }
+    else if (m_fingerprintFuture.isValid() && m_fingerprintIndex.endingSegment() >= 0)
+    {
+        if (deferUntilFinished(this, m_fingerprintFuture, [this]() { audioPreparation(); }))
+        {
+            emit logMessage("Время эндинга не найдено в главах, поиск по отпечатку звука...", LogCategory::APP);
+            return;
+        }
+        timeForTb = endingTimeFromFingerprints();
+    }
 
     if (timeForTb.isEmpty())
     {
@@ -1929,6 +2106,10 @@ void WorkflowManager::audioPreparation()
         return;
     }
 
+    // Время эндинга известно: если индекс сериала его ещё не знает, он учится по этой серии в фоне
+    startFingerprintScan();
+    learnFingerprints();
+
     if (!m_isNormalizationEnabled || m_wasNormalizationPerformed)
     {
         processSubtitles();
@@ -1938,6 +2119,11 @@ void WorkflowManager::audioPreparation()
     QString nugenPath = AppSettings::instance().nugenAmbPath();
     if (nugenPath.isEmpty())
     {
+        if (mainAudioIsWav)
+        {
+            emit logMessage("NUGEN AMB не указан: громкость будет выровнена по измерению перед конвертацией аудио.",
+                            LogCategory::APP);
+        }
         processSubtitles();
         return;
     }
@@ -1986,14 +2172,18 @@ void WorkflowManager::audioPreparation()
         QFile::remove(tempInputPath);
     }
 
-    if (!QFile::copy(targetWavPath, tempInputPath))
+    // AMBCmd пишет результат в отдельный *_corrected.wav, вход только читается — жёсткая ссылка допустима.
+    const StageResult staged = FileStager::stageFile(targetWavPath, tempInputPath, StageMode::ReadOnlyCopy);
+    if (!staged.ok)
     {
         emit logMessage("ОШИБКА: Не удалось скопировать временный аудиофайл.", LogCategory::APP, LogLevel::Error);
         emit workflowAborted();
         return;
     }
 
-    emit logMessage("Аудиофайл переименован в temp_audio_for_nugen.wav для безопасной обработки.", LogCategory::APP);
+    emit logMessage(QString("Аудиофайл подготовлен как temp_audio_for_nugen.wav для безопасной обработки (%1).")
+                        .arg(FileStager::describe(staged)),
+                    LogCategory::APP);
 
     QTimer::singleShot(3000, this,
                        [this, ambCmdPath, tempInputPath]()
@@ -2004,8 +2194,183 @@ void WorkflowManager::audioPreparation()
                        });
 }
 
+void WorkflowManager::extractReferencedFonts()
+{
+    m_currentStep = Step::ExtractingFonts;
+    const QList<MkvAttachment> candidates = std::exchange(m_sourceFontAttachments, {});
+
+    // Шрифты нужны тем же файлам, что пойдут в MKV и в хардсаб
+    QSet<AssStyleInfo> styles;
+    for (const QString& path : {m_paths->processedFullSubs(), m_paths->processedSignsSubs()})
+    {
+        if (QFileInfo::exists(path))
+        {
+            styles.unite(m_fontFinder->parseAssFile(path));
+        }
+    }
+
+    // Сопоставляем вложения из mkvmerge -J с разобранными из контейнера по номеру вложения
+    QString readError;
+    const QList<MkvAttachment> parsed = MkvAttachments::read(m_mkvFilePath, &readError);
+    QList<MkvAttachment> located = candidates;
+    QList<MkvAttachment> toExtract = candidates;
+    if (MkvAttachments::locate(located, parsed))
+    {
+        toExtract = MkvAttachments::selectReferencedFonts(m_mkvFilePath, located, styles);
+    }
+    else
+    {
+        emit logMessage(QString("Не удалось прочитать вложения прямо из MKV (%1), извлекаются все шрифты.")
+                            .arg(readError.isEmpty() ? QStringLiteral("вложение не найдено") : readError),
+                        LogCategory::APP, LogLevel::Warning);
+    }
+
+    if (toExtract.size() < candidates.size())
+    {
+        QStringList skippedNames;
+        qint64 skippedBytes = 0;
+        for (const MkvAttachment& font : candidates)
+        {
+            if (std::none_of(toExtract.cbegin(), toExtract.cend(),
+                             [&font](const MkvAttachment& selected) { return selected.id == font.id; }))
+            {
+                skippedNames.append(font.fileName);
+                skippedBytes += font.dataSize;
+            }
+        }
+        emit logMessage(QString("Субтитрам нужны %1 из %2 вложенных шрифтов. Не извлекаются (%3 КиБ): %4")
+                            .arg(toExtract.size())
+                            .arg(candidates.size())
+                            .arg(skippedBytes / 1024)
+                            .arg(skippedNames.join(", ")),
+                        LogCategory::APP);
+    }
+
+    if (toExtract.isEmpty())
+    {
+        findFontsInProcessedSubs();
+        return;
+    }
+
+    QDir attachmentsDir(m_paths->attachedFontsDir());
+    if (!attachmentsDir.exists())
+        attachmentsDir.mkpath(".");
+
+    // Шрифты с известным положением в MKV попадают в общее хранилище прямо из исходника, без mkvextract;
+    // шрифт, который там уже есть (та же серия сезона или другой сериал), заново не записывается
+    QHash<QString, StoredFont> stored;
+    QList<MkvAttachment> pending;
+    QFile source(m_mkvFilePath);
+    const bool sourceOpened = source.open(QIODevice::ReadOnly);
+    for (const MkvAttachment& font : toExtract)
+    {
+        uchar* mapped = sourceOpened && font.dataOffset >= 0 && font.dataSize > 0
+                            ? source.map(font.dataOffset, font.dataSize)
+                            : nullptr;
+        if (mapped == nullptr)
+        {
+            pending.append(font);
+            continue;
+        }
+        const StoredFont placed =
+            FontStore::placeData(mapped, font.dataSize, attachmentsDir.filePath(font.fileName));
+        source.unmap(mapped);
+        if (placed.ok)
+        {
+            stored.insert(font.fileName, placed);
+        }
+        else
+        {
+            emit logMessage(QString("Хранилище шрифтов: %1 — %2, шрифт будет извлечён в проект.")
+                                .arg(font.fileName, placed.errorString),
+                            LogCategory::APP, LogLevel::Warning);
+            pending.append(font);
+        }
+    }
+    source.close();
+    reportStoredFonts(stored);
+
+    if (pending.isEmpty())
+    {
+        findFontsInProcessedSubs();
+        return;
+    }
+
+    m_tempFontPaths.clear();
+    QStringList args;
+    args << m_mkvFilePath << "attachments";
+    for (const MkvAttachment& font : pending)
+    {
+        // Старый файл может быть жёсткой ссылкой на хранилище: mkvextract перезаписал бы общую копию
+        const QString outputPath = attachmentsDir.filePath(font.fileName);
+        QFile::remove(outputPath);
+        args << QString("%1:%2").arg(font.id).arg(outputPath);
+        m_tempFontPaths.append(outputPath);
+    }
+
+    emit logMessage("Извлечение вложенных шрифтов (mkvextract)...", LogCategory::APP);
+    emit progressUpdated(-1, "Извлечение шрифтов");
+    m_processManager->startProcess(m_mkvextractPath, args);
+}
+
+void WorkflowManager::reportStoredFonts(const QHash<QString, StoredFont>& storedByFileName)
+{
+    if (storedByFileName.isEmpty())
+    {
+        return;
+    }
+
+    int reused = 0;
+    qint64 reusedBytes = 0;
+    QHash<QString, QString> hashes;
+    QStringList storePaths;
+    QStringList strategies;
+    for (auto it = storedByFileName.cbegin(); it != storedByFileName.cend(); ++it)
+    {
+        hashes.insert(it.key(), it->hash);
+        storePaths.append(it->storePath);
+        if (it->reused)
+        {
+            ++reused;
+            reusedBytes += it->link.bytes;
+        }
+        const QString strategy = FileStager::strategyName(it->link.strategy);
+        if (!strategies.contains(strategy))
+        {
+            strategies.append(strategy);
+        }
+    }
+    // По манифесту индекс шрифтов узнаёт уже разобранные файлы и не читает их таблицы повторно
+    if (!FontStore::writeManifest(m_paths->attachedFontsDir(), hashes))
+    {
+        emit logMessage("Не удалось записать манифест хэшей шрифтов.", LogCategory::APP, LogLevel::Warning);
+    }
+    const int prunedFonts = FontStore::pruneStore(storePaths);
+    if (prunedFonts > 0)
+    {
+        emit logMessage(QString("Хранилище шрифтов: удалено %1 файлов, не нужных ни одному эпизоду дольше %2 дней.")
+                            .arg(prunedFonts)
+                            .arg(FontStore::kStoreMaxUnusedDays),
+                        LogCategory::APP);
+    }
+    emit logMessage(QString("Шрифты размещены из общего хранилища (%1): %2 файлов, уже были в хранилище %3 "
+                            "(не записано повторно %4 КиБ).")
+                        .arg(strategies.join(", "))
+                        .arg(storedByFileName.size())
+                        .arg(reused)
+                        .arg(reusedBytes / 1024),
+                    LogCategory::APP);
+}
+
 void WorkflowManager::findFontsInProcessedSubs()
 {
+    if (!m_sourceFontAttachments.isEmpty())
+    {
+        // Вернёмся сюда из onProcessFinished(), когда mkvextract извлечёт нужные шрифты
+        extractReferencedFonts();
+        return;
+    }
+
     m_currentStep = Step::FindingFonts;
     emit logMessage("Шаг 7: Поиск шрифтов в обработанных субтитрах...", LogCategory::APP);
     emit progressUpdated(-1, "Поиск шрифтов");
@@ -2035,8 +2400,179 @@ void WorkflowManager::findFontsInProcessedSubs()
     }
 }
 
+void WorkflowManager::startAudioAnalysis()
+{
+    // Анализируем итоговый WAV (после NUGEN, если он был) параллельно с субтитрами и шрифтами
+    if (m_analyzedAudioPath == m_mainRuAudioPath || !WavFile::isWav(m_mainRuAudioPath))
+    {
+        return;
+    }
+    m_analyzedAudioPath = m_mainRuAudioPath;
+    const QString path = m_mainRuAudioPath;
+    m_loudnessFuture = QtConcurrent::run([path]() { return LoudnessMeter::analyzeFile(path); });
+
+    // Оригинал берём из извлечённой дорожки, а в режиме без извлечения — прямо из исходника
+    QString originalPath = originalAudioSourcePath();
+    QString streamSpecifier = "a:0";
+    if (!QFileInfo::exists(originalPath))
+    {
+        if (m_originalAudioTrack.id == -1)
+        {
+            return;
+        }
+        originalPath = m_mkvFilePath;
+        streamSpecifier = QString::number(m_originalAudioTrack.id);
+    }
+    const QString ffmpegPath = m_ffmpegPath;
+    m_audioOffsetFuture = QtConcurrent::run(
+        [ffmpegPath, originalPath, streamSpecifier, path]()
+        { return AudioOffset::detect(ffmpegPath, originalPath, streamSpecifier, path); });
+}
+
+double WorkflowManager::decideLoudnessGain()
+{
+    if (!m_loudnessFuture.isValid() || m_analyzedAudioPath != m_mainRuAudioPath)
+    {
+        return 0.0;
+    }
+    const LoudnessResult loudness = m_loudnessFuture.result();
+    if (!loudness.ok)
+    {
+        emit logMessage("Не удалось измерить громкость аудио: " + loudness.errorString, LogCategory::APP,
+                        LogLevel::Warning);
+        return 0.0;
+    }
+    emit logMessage(QString("Громкость: %1 LUFS, LRA %2 LU, true peak %3 dBTP, клиппинг %4 отсч. (%5 мс)")
+                        .arg(loudness.integratedLufs, 0, 'f', 1)
+                        .arg(loudness.loudnessRangeLu, 0, 'f', 1)
+                        .arg(loudness.truePeakDbtp, 0, 'f', 1)
+                        .arg(loudness.clippedSamples)
+                        .arg(loudness.elapsedMs),
+                    LogCategory::APP);
+
+    const double gainDb = LoudnessMeter::recommendedGainDb(loudness);
+    // Без NUGEN нормализация сводится к усилению при конвертации; после NUGEN только предупреждаем
+    if (m_isNormalizationEnabled && !m_wasNormalizationPerformed && qAbs(gainDb) >= 0.1)
+    {
+        emit logMessage(QString("Нормализация: усиление %1 дБ (цель %2 LUFS, true peak не выше %3 dBTP).")
+                            .arg(gainDb, 0, 'f', 1)
+                            .arg(LoudnessMeter::kTargetLufs, 0, 'f', 0)
+                            .arg(LoudnessMeter::kMaxTruePeakDbtp, 0, 'f', 0),
+                        LogCategory::APP);
+        return gainDb;
+    }
+
+    if (qAbs(loudness.integratedLufs - LoudnessMeter::kTargetLufs) > 1.0)
+    {
+        emit logMessage(QString("Громкость отличается от %1 LUFS больше чем на 1 LU.").arg(LoudnessMeter::kTargetLufs),
+                        LogCategory::APP, LogLevel::Warning);
+    }
+    if (loudness.truePeakDbtp > LoudnessMeter::kMaxTruePeakDbtp)
+    {
+        emit logMessage(QString("True peak выше %1 dBTP: после кодирования в AAC возможны искажения.")
+                            .arg(LoudnessMeter::kMaxTruePeakDbtp),
+                        LogCategory::APP, LogLevel::Warning);
+    }
+    if (loudness.clippedSamples > 0)
+    {
+        emit logMessage(QString("В аудио %1 отсчётов на полной шкале: вероятен клиппинг в сведении.")
+                            .arg(loudness.clippedSamples),
+                        LogCategory::APP, LogLevel::Warning);
+    }
+    return 0.0;
+}
+
+int WorkflowManager::decideAudioOffset()
+{
+    if (!m_audioOffsetFuture.isValid() || m_analyzedAudioPath != m_mainRuAudioPath)
+    {
+        return 0;
+    }
+    const AudioOffsetResult offset = m_audioOffsetFuture.result();
+    if (!offset.ok)
+    {
+        emit logMessage("Не удалось сравнить дубляж с оригиналом: " + offset.errorString, LogCategory::APP,
+                        LogLevel::Warning);
+        return 0;
+    }
+    QStringList perWindow;
+    for (const AudioOffsetWindow& window : offset.windows)
+    {
+        perWindow << QString("%1 мс на %2 с").arg(window.offsetMs).arg(qRound(window.startS));
+    }
+    emit logMessage(QString("Сдвиг дубляжа относительно оригинала: %1 мс, уверенность %2 (%3; %4 мс)")
+                        .arg(offset.offsetMs)
+                        .arg(offset.confidence, 0, 'f', 2)
+                        .arg(perWindow.join(", "))
+                        .arg(offset.elapsedMs),
+                    LogCategory::APP);
+
+    if (!offset.reliable)
+    {
+        emit logMessage("Сдвиг не подтвердился в большинстве окон, дорожка остаётся как есть.", LogCategory::APP);
+        return 0;
+    }
+    // Расхождение меньше кадра на слух не заметно
+    constexpr int kMinCorrectionMs = 20;
+    if (qAbs(offset.offsetMs) < kMinCorrectionMs)
+    {
+        return 0;
+    }
+    if (!AppSettings::instance().applyAudioOffset())
+    {
+        emit logMessage(QString("Дубляж %1 оригинала на %2 мс. Проверьте сведение или включите компенсацию сдвига "
+                                "в настройках.")
+                            .arg(offset.offsetMs > 0 ? "отстаёт от" : "опережает")
+                            .arg(qAbs(offset.offsetMs)),
+                        LogCategory::APP, LogLevel::Warning);
+        return 0;
+    }
+    emit logMessage(QString("Сдвиг дубляжа %1 мс будет скомпенсирован.").arg(offset.offsetMs), LogCategory::APP);
+    return offset.offsetMs;
+}
+
+QStringList WorkflowManager::ruAudioFilterArgs() const
+{
+    QStringList filters;
+    if (m_audioOffsetMs > 0)
+    {
+        filters << QString("atrim=start=%1,asetpts=PTS-STARTPTS").arg(m_audioOffsetMs / 1000.0, 0, 'f', 3);
+    }
+    else if (m_audioOffsetMs < 0)
+    {
+        filters << QString("adelay=%1:all=1").arg(-m_audioOffsetMs);
+    }
+    if (m_loudnessGainDb != 0.0)
+    {
+        filters << QString("volume=%1dB").arg(m_loudnessGainDb, 0, 'f', 2);
+    }
+    if (filters.isEmpty())
+    {
+        return {};
+    }
+    return {"-af", filters.join(",")};
+}
+
+QStringList WorkflowManager::ruAudioSyncArgs(const QString& russianAudioPath) const
+{
+    // Перекодированная дорожка уже сдвинута фильтром; файл пользователя сдвигает mkvmerge
+    if (m_audioOffsetMs == 0 || russianAudioPath != m_mainRuAudioPath)
+    {
+        return {};
+    }
+    return {"--sync", QString("0:%1").arg(-m_audioOffsetMs)};
+}
+
 void WorkflowManager::convertAudioIfNeeded()
 {
+    const auto resume = [this]() { convertAudioIfNeeded(); };
+    if (deferUntilFinished(this, m_loudnessFuture, resume) || deferUntilFinished(this, m_audioOffsetFuture, resume))
+    {
+        emit logMessage("Ожидание завершения анализа аудио...", LogCategory::APP);
+        emit progressUpdated(-1, "Анализ аудио");
+        return;
+    }
+
     emit logMessage("Шаг 8: Проверка и конвертация аудио...", LogCategory::APP);
 
     if (m_mainRuAudioPath.isEmpty())
@@ -2059,6 +2595,9 @@ void WorkflowManager::convertAudioIfNeeded()
         return path.endsWith("." + targetFormat, Qt::CaseInsensitive);
     };
 
+    m_loudnessGainDb = decideLoudnessGain();
+    m_audioOffsetMs = decideAudioOffset();
+
     if (!isAac && alreadyInTargetFormat(m_mainRuAudioPath))
     {
         emit logMessage("Аудиофайл уже в целевом формате. Конвертация не требуется.", LogCategory::APP);
@@ -2071,20 +2610,35 @@ void WorkflowManager::convertAudioIfNeeded()
     }
 
     m_currentStep = Step::ConvertingAudio;
-    // Для AAC кодируем отдельно в два контейнера:
+    // Для AAC кодируем один раз в m4a (MP4 сохраняет Edit List с задержкой энкодера),
+    // затем тот же битстрим перепаковывается в mka для mkvmerge:
+    // - m4a для MP4Box и concat-рендера (финальный MP4)
     // - mka для mkvmerge (финальный MKV)
-    // - m4a для MP4Box (финальный MP4)
     const QString outputExtension = isAac ? "mka" : targetFormat;
     m_finalAudioPath = m_paths->convertedRuAudio(outputExtension);
     m_finalAudioMp4Path = isAac ? m_paths->convertedRuAudio("m4a") : QString();
     m_audioConversionNeedsSecondPass = isAac;
-    m_audioConversionCurrentOutputPath = m_finalAudioPath;
+    m_audioConversionCurrentOutputPath = isAac ? m_finalAudioMp4Path : m_finalAudioPath;
     emit logMessage(QString("Запуск конвертации в %1...").arg(targetFormat.toUpper()), LogCategory::APP);
 
+    if (targetFormat == "flac" && startChunkedFlacEncode())
+    {
+        return;
+    }
+    startAudioConversion();
+}
+
+void WorkflowManager::startAudioConversion()
+{
+    const QString targetFormat = m_template.targetAudioFormat;
+    const bool isAac = (targetFormat == "aac");
     m_ffmpegProgressFile = QDir(m_paths->sourcesPath).filePath("ffmpeg_progress.log");
+    // Длительность дорожки из заголовка WAV; у сжатых форматов — длительность исходника из mkvmerge -J
+    const WavInfo wav = WavFile::readHeader(m_mainRuAudioPath);
+    m_audioConversionDurationUs = wav.ok ? wav.durationUs() : static_cast<qint64>(m_sourceDurationS * 1000000);
 
     QStringList args;
-    args << "-y" << "-i" << m_mainRuAudioPath;
+    args << "-y" << "-i" << m_mainRuAudioPath << ruAudioFilterArgs();
 
     if (isAac)
     {
@@ -2119,6 +2673,67 @@ void WorkflowManager::convertAudioIfNeeded()
     m_processManager->startProcess(m_ffmpegPath, args);
 }
 
+bool WorkflowManager::startChunkedFlacEncode()
+{
+    // Границы кусков считаются в отсчётах по заголовку WAV; другие форматы кодирует один процесс
+    if (m_chunkedFlacFailed)
+    {
+        return false;
+    }
+    const WavInfo wav = WavFile::readHeader(m_mainRuAudioPath);
+    const int chunks = ChunkedFlac::chunkCount(wav, QThread::idealThreadCount());
+    if (chunks < 2)
+    {
+        return false;
+    }
+    emit logMessage(QString("Параллельное кодирование FLAC: %1 кусков по ~%2 с.")
+                        .arg(chunks)
+                        .arg(qRound(wav.durationS() / chunks)),
+                    LogCategory::APP);
+    emit progressUpdated(-1, "Кодирование FLAC");
+
+    const QString ffmpegPath = m_ffmpegPath;
+    const QString wavPath = m_mainRuAudioPath;
+    const QString outputPath = m_finalAudioPath;
+    const int offsetMs = m_audioOffsetMs;
+    const double gainDb = m_loudnessGainDb;
+    m_chunkedFlacCancelled = std::make_shared<std::atomic_bool>(false);
+    m_chunkedFlacFuture = QtConcurrent::run(
+        [ffmpegPath, wavPath, chunks, offsetMs, gainDb, outputPath, cancelled = m_chunkedFlacCancelled]()
+        { return ChunkedFlac::encode(ffmpegPath, wavPath, chunks, offsetMs, gainDb, outputPath, cancelled.get()); });
+    deferUntilFinished(this, m_chunkedFlacFuture, [this]() { finishChunkedFlacEncode(); });
+    return true;
+}
+
+void WorkflowManager::finishChunkedFlacEncode()
+{
+    if (*m_chunkedFlacCancelled)
+    {
+        QFile::remove(m_finalAudioPath);
+        return;
+    }
+    const ChunkedFlacResult result = m_chunkedFlacFuture.result();
+    if (!result.ok)
+    {
+        emit logMessage(QString("Параллельное кодирование FLAC не удалось (%1), кодирование одним процессом...")
+                            .arg(result.errorString),
+                        LogCategory::APP, LogLevel::Warning);
+        m_chunkedFlacFailed = true;
+        startAudioConversion();
+        return;
+    }
+    emit logMessage(QString("FLAC закодирован за %1 с: %2 кусков, %3 точек перемотки%4.")
+                        .arg(result.elapsedMs / 1000.0, 0, 'f', 1)
+                        .arg(result.chunks)
+                        .arg(result.seekPoints)
+                        .arg(result.hasMd5 ? "" : ", без MD5"),
+                    LogCategory::APP);
+    emit logMessage("Конвертация аудио успешно завершена.", LogCategory::APP);
+    emit progressUpdated(100);
+    m_audioConversionCurrentOutputPath.clear();
+    assembleMkv(m_finalAudioPath);
+}
+
 void WorkflowManager::onAudioConversionProgress()
 {
     QFile progressFile(m_ffmpegProgressFile);
@@ -2128,12 +2743,9 @@ void WorkflowManager::onAudioConversionProgress()
     }
 
     QTextStream in(&progressFile);
-    qint64 totalDurationUs = 0;
+    const qint64 totalDurationUs = m_audioConversionDurationUs;
     qint64 currentTimeUs = 0;
 
-    // Узнаем общую длительность из mkvmerge -J
-    totalDurationUs = m_sourceDurationS * 1000000;
-
     while (!in.atEnd())
     {
         QString line = in.readLine();
@@ -2157,7 +2769,7 @@ void WorkflowManager::assembleMkv(const QString& russianAudioPath)
     m_currentStep = Step::AssemblingMkv;
 
     QString videoPath = m_paths->extractedVideo(m_videoTrack.extension);
-    QString originalAudioPath = m_paths->extractedAudio(m_sourceFormat == SourceFormat::MP4 ? "m4a" : "mka");
+    QString originalAudioPath = originalAudioSourcePath();
     QString fullSubsPath = m_paths->processedFullSubs();
     QString signsPath = m_paths->processedSignsSubs();
 
@@ -2191,13 +2803,6 @@ void WorkflowManager::assembleMkv(const QString& russianAudioPath)
 
     emit logMessage("Все необходимые файлы на месте. Начинаем сборку mkvmerge...", LogCategory::APP);
 
-    QStringList fontPaths;
-    for (const FoundFontInfo& fontInfo : m_fontResult.foundFonts)
-    {
-        fontPaths.append(fontInfo.path);
-    }
-    fontPaths.removeDuplicates();
-
     if (!m_fontResult.notFoundFontNames.isEmpty())
     {
         emit logMessage("ПРЕДУПРЕЖДЕНИЕ: Не все шрифты были предоставлены. Субтитры могут отображаться некорректно.",
@@ -2214,9 +2819,11 @@ void WorkflowManager::assembleMkv(const QString& russianAudioPath)
     QStringList args;
     args << "-o" << m_finalMkvPath;
 
-    for (const QString& path : fontPaths)
+    const QList<SubsetAttachment> fonts = subsetFontsForMkv(fullSubsPath, signsPath);
+    for (const SubsetAttachment& font : fonts)
     {
-        args << "--attachment-name" << QFileInfo(path).fileName();
+        const QString& path = font.path;
+        args << "--attachment-name" << font.attachmentName;
         QString mimeType = "application/octet-stream";
         if (path.endsWith(".ttf", Qt::CaseInsensitive))
         {
@@ -2245,27 +2852,78 @@ void WorkflowManager::assembleMkv(const QString& russianAudioPath)
     QString animStudio = m_template.animationStudio;
     QString subAuthor = m_template.subAuthor;
 
-    // Дорожка видео
-    args << "--language" << "0:" + m_template.originalLanguage << "--track-name"
-         << QString("0:Видеоряд [%1]").arg(animStudio) << videoPath;
+    if (m_directSourceTracks)
+    {
+        // Видео и оригинал — из исходного MKV по ID дорожек (файл 0), русское аудио — файл 1.
+        // Порядок дорожек в результате тот же, что и при сборке из извлечённых файлов.
+        const QString vid = QString::number(m_videoTrack.id);
+        const bool hasOriginal = m_originalAudioTrack.id != -1;
+        const QString aid = QString::number(m_originalAudioTrack.id);
+        if (!hasOriginal && m_template.useOriginalAudio)
+        {
+            emit logMessage("Критическая ошибка: Отсутствует оригинальная аудиодорожка, проверьте язык оригинального "
+                            "аудио в шаблоне. Сборка остановлена.",
+                            LogCategory::APP, LogLevel::Error);
+            emit workflowAborted();
+            return;
+        }
+
+        args << "--video-tracks" << vid;
+        if (hasOriginal)
+        {
+            args << "--audio-tracks" << aid;
+        }
+        else
+        {
+            args << "--no-audio";
+        }
+        args << "--no-subtitles" << "--no-attachments" << "--no-chapters" << "--no-global-tags";
+        args << "--language" << vid + ":" + m_template.originalLanguage << "--track-name"
+             << QString("%1:Видеоряд [%2]").arg(vid, animStudio);
+        if (hasOriginal)
+        {
+            args << "--default-track-flag" << aid + ":no" << "--language" << aid + ":" + m_template.originalLanguage
+                 << "--track-name" << QString("%1:Оригинал [%2]").arg(aid, animStudio);
+        }
+        args << m_mkvFilePath;
 
-    // Дорожка русского аудио (с флагом по умолчанию)
-    args << "--default-track-flag" << "0:yes" << "--language" << "0:rus" << "--track-name" << "0:Русский [Дубляжная]"
-         << russianAudioPath;
+        args << "--default-track-flag" << "0:yes" << "--language" << "0:rus" << "--track-name"
+             << "0:Русский [Дубляжная]" << ruAudioSyncArgs(russianAudioPath) << russianAudioPath;
 
-    // Дорожка оригинального аудио
-    if (QFileInfo::exists(originalAudioPath))
+        QString trackOrder = QString("0:%1,1:0").arg(vid);
+        if (hasOriginal)
+        {
+            trackOrder += QString(",0:%1").arg(aid);
+        }
+        args << "--track-order" << trackOrder;
+    }
+    else
     {
-        args << "--default-track-flag" << "0:no" << "--language" << "0:" + m_template.originalLanguage << "--track-name"
-             << QString("0:Оригинал [%1]").arg(animStudio) << originalAudioPath;
+        // Дорожка видео
+        args << "--language" << "0:" + m_template.originalLanguage << "--track-name"
+             << QString("0:Видеоряд [%1]").arg(animStudio) << videoPath;
+
+        // Дорожка русского аудио (с флагом по умолчанию)
+        args << "--default-track-flag" << "0:yes" << "--language" << "0:rus" << "--track-name"
+             << "0:Русский [Дубляжная]" << ruAudioSyncArgs(russianAudioPath) << russianAudioPath;
     }
-    else if (m_template.useOriginalAudio)
+
+    // Дорожка оригинального аудио (в режиме без извлечения уже добавлена вместе с видео)
+    if (!m_directSourceTracks)
     {
-        emit logMessage("Критическая ошибка: Отсутствует оригинальная аудиодорожка, проверьте язык оригинального аудио "
-                        "в шаблоне. Сборка остановлена.",
-                        LogCategory::APP, LogLevel::Error);
-        emit workflowAborted();
-        return;
+        if (QFileInfo::exists(originalAudioPath))
+        {
+            args << "--default-track-flag" << "0:no" << "--language" << "0:" + m_template.originalLanguage
+                 << "--track-name" << QString("0:Оригинал [%1]").arg(animStudio) << originalAudioPath;
+        }
+        else if (m_template.useOriginalAudio)
+        {
+            emit logMessage("Критическая ошибка: Отсутствует оригинальная аудиодорожка, проверьте язык оригинального "
+                            "аудио в шаблоне. Сборка остановлена.",
+                            LogCategory::APP, LogLevel::Error);
+            emit workflowAborted();
+            return;
+        }
     }
 
     QString subTrackAuthorName = m_template.isCustomTranslation ? "Дубляжная" : subAuthor;
@@ -2276,48 +2934,275 @@ void WorkflowManager::assembleMkv(const QString& russianAudioPath)
         args << "--forced-display-flag" << "0:yes" << "--default-track-flag" << "0:yes" << "--language" << "0:rus"
              << "--track-name" << QString("0:Надписи [%1]").arg(subTrackAuthorName) << signsPath;
     }
-    if (QFileInfo::exists(fullSubsPath))
+    if (QFileInfo::exists(fullSubsPath))
+    {
+        args << "--default-track-flag" << "0:no" << "--forced-display-flag" << "0:no" << "--language" << "0:rus"
+             << "--track-name" << QString("0:Субтитры [%1]").arg(subTrackAuthorName) << fullSubsPath;
+    }
+
+    emit progressUpdated(-1, "Сборка MKV");
+    m_processManager->startProcess(m_mkvmergePath, args);
+}
+
+QList<SubsetAttachment> WorkflowManager::subsetFontsForMkv(QString& fullSubsPath, QString& signsPath)
+{
+    QList<SubsetAttachment> wholeFonts;
+    QSet<QString> seen;
+    for (const FoundFontInfo& fontInfo : std::as_const(m_fontResult.foundFonts))
+    {
+        if (!seen.contains(fontInfo.path))
+        {
+            seen.insert(fontInfo.path);
+            wholeFonts.append({fontInfo.path, QFileInfo(fontInfo.path).fileName(), false});
+        }
+    }
+    if (!AppSettings::instance().subsetFonts() || wholeFonts.isEmpty())
+    {
+        return wholeFonts;
+    }
+
+    // Символы считаются по обоим файлам, которые пойдут в MKV: поиск шрифтов смотрел только один из них
+    QElapsedTimer timer;
+    timer.start();
+    GlyphUsage usage;
+    for (const QString& path : {fullSubsPath, signsPath})
+    {
+        if (QFileInfo::exists(path))
+        {
+            const GlyphUsage fileUsage = m_fontFinder->parseAssFileGlyphs(path);
+            for (auto it = fileUsage.cbegin(); it != fileUsage.cend(); ++it)
+            {
+                usage[it.key()].unite(it.value());
+            }
+        }
+    }
+
+    const SubsetPlan plan = FontSubsetter::planSubsets(m_fontResult, usage);
+    // Подмножества этой серии уже отмечены как использованные, удаляются только давно не нужные
+    const int prunedSubsets = FontSubsetter::pruneCache();
+    if (prunedSubsets > 0)
+    {
+        emit logMessage(QString("Кэш подмножеств шрифтов: удалено %1 файлов, не нужных дольше %2 дней.")
+                            .arg(prunedSubsets)
+                            .arg(FontSubsetter::kCacheMaxUnusedDays),
+                        LogCategory::APP);
+    }
+    for (const QString& skipped : plan.skipped)
+    {
+        emit logMessage("Шрифт вложен целиком: " + skipped, LogCategory::APP);
+    }
+    if (plan.renames.isEmpty())
+    {
+        return wholeFonts;
+    }
+
+    const QString mkvFullSubs = m_paths->mkvFullSubs();
+    const QString mkvSignsSubs = m_paths->mkvSignsSubs();
+    const bool hasFullSubs = QFileInfo::exists(fullSubsPath);
+    const bool hasSignsSubs = QFileInfo::exists(signsPath);
+    if ((hasFullSubs && !FontSubsetter::renameFontsInAss(fullSubsPath, mkvFullSubs, plan.renames)) ||
+        (hasSignsSubs && !FontSubsetter::renameFontsInAss(signsPath, mkvSignsSubs, plan.renames)))
+    {
+        emit logMessage("Не удалось переименовать шрифты в субтитрах для MKV, шрифты будут вложены целиком.",
+                        LogCategory::APP, LogLevel::Warning);
+        return wholeFonts;
+    }
+    if (hasFullSubs)
+    {
+        fullSubsPath = mkvFullSubs;
+    }
+    if (hasSignsSubs)
+    {
+        signsPath = mkvSignsSubs;
+    }
+
+    const int subsetCount =
+        static_cast<int>(std::count_if(plan.attachments.cbegin(), plan.attachments.cend(),
+                                       [](const SubsetAttachment& attachment) { return attachment.subset; }));
+    emit logMessage(QString("Шрифты урезаны до используемых символов: %1 из %2 файлов, %3 -> %4 КиБ "
+                            "(сэкономлено %5 КиБ, из кэша: %6, %7 мс)")
+                        .arg(subsetCount)
+                        .arg(plan.attachments.size())
+                        .arg(plan.originalBytes / 1024)
+                        .arg(plan.subsetBytes / 1024)
+                        .arg((plan.originalBytes - plan.subsetBytes) / 1024)
+                        .arg(plan.fromCache)
+                        .arg(timer.elapsed()),
+                    LogCategory::APP, LogLevel::Success);
+    return plan.attachments;
+}
+
+void WorkflowManager::renderMp4()
+{
+    emit logMessage("Шаг 10: Рендер финального MP4 файла...", LogCategory::APP);
+    emit progressUpdated(-1, "Рендер MP4");
+    m_renderPreset = AppSettings::instance().findRenderPreset(m_template.renderPresetName);
+    if (m_renderPreset.name.isEmpty())
+    {
+        emit logMessage("Критическая ошибка: пресет рендера '" + m_template.renderPresetName +
+                            "' не найден. Процесс остановлен.",
+                        LogCategory::APP, LogLevel::Error);
+        emit workflowAborted();
+        return;
+    }
+
+    m_outputMp4Path = m_finalMkvPath;
+    m_outputMp4Path.replace(".mkv", ".mp4");
+    m_tempVideoMp4Path = QDir(QFileInfo(m_outputMp4Path).absolutePath())
+                             .filePath(QFileInfo(m_outputMp4Path).completeBaseName() + "_temp_video.mp4");
+    m_tempAudioForMp4Path = QDir(QFileInfo(m_outputMp4Path).absolutePath())
+                                .filePath(QFileInfo(m_outputMp4Path).completeBaseName() + "_temp_audio.m4a");
+    m_tempMp4ChaptersTxtPath = QDir(QFileInfo(m_outputMp4Path).absolutePath())
+                                   .filePath(QFileInfo(m_outputMp4Path).completeBaseName() + "_auto_chapters.txt");
+
+    QFile::remove(m_tempVideoMp4Path);
+    QFile::remove(m_tempAudioForMp4Path);
+    QFile::remove(m_tempMp4ChaptersTxtPath);
+    m_useExternalAudioForMp4Mux = false;
+    m_mp4ChaptersEmbeddedInMux = false;
+    m_mp4VideoReady = false;
+    m_mp4AudioReady = false;
+    m_renderAudioArgs.clear();
+
+    m_signsHaveVisibleEvents = true;
+    if (QFileInfo::exists(m_paths->processedSignsSubs()))
+    {
+        // У фильтра subtitles нет поддержки timeline (enable=), а split/select перед overlay заставил бы
+        // framesync копить кадры на всём промежутке без надписей. Поэтому интервалы используются,
+        // чтобы вовсе не подключать libass, если рисовать нечего.
+        const QList<TbSegment> intervals = AssProcessor::detectActiveIntervalsFromFile(m_paths->processedSignsSubs());
+        m_signsHaveVisibleEvents = !intervals.isEmpty();
+        if (!m_signsHaveVisibleEvents)
+        {
+            emit logMessage("В файле надписей нет видимых событий — рендер без фильтра subtitles.", LogCategory::APP);
+        }
+        else
+        {
+            double coveredS = 0.0;
+            for (const TbSegment& interval : intervals)
+            {
+                coveredS += interval.endSeconds - interval.startSeconds;
+            }
+            const double percent = m_sourceDurationS > 0 ? coveredS * 100.0 / static_cast<double>(m_sourceDurationS)
+                                                         : 0.0;
+            emit logMessage(QString("Надписи на экране: %1 интервалов, %2 с (%3% хронометража).")
+                                .arg(intervals.size())
+                                .arg(coveredS, 0, 'f', 1)
+                                .arg(percent, 0, 'f', 1),
+                            LogCategory::APP);
+        }
+    }
+
+    if (tryMp4FastPath() || startBitrateCalibration())
+    {
+        return;
+    }
+
+    m_currentStep = Step::RenderingMp4Pass1;
+    runRenderPass(m_currentStep);
+}
+
+bool WorkflowManager::tryMp4FastPath()
+{
+    const QString codec = m_videoTrack.codecId.isEmpty() ? m_videoTrack.extension : m_videoTrack.codecId;
+    if (useHardsubForRender() || !RenderHelper::isMp4CompatibleVideoCodec(codec))
+    {
+        return false;
+    }
+    if (!RenderHelper::sourceBitrateFitsTarget(m_videoTrack.bitrateKbps, m_renderPreset.targetBitrateKbps))
+    {
+        if (m_videoTrack.bitrateKbps <= 0)
+        {
+            emit logMessage(QString("Надписей нет, но битрейт исходника неизвестен, а в пресете задан целевой "
+                                    "(%1 kbps) — видео будет перекодировано.")
+                                .arg(m_renderPreset.targetBitrateKbps),
+                            LogCategory::APP);
+        }
+        else
+        {
+            emit logMessage(QString("Надписей нет, но битрейт исходника (%1 kbps) выше целевого (%2 kbps) — "
+                                    "видео будет перекодировано.")
+                                .arg(m_videoTrack.bitrateKbps)
+                                .arg(m_renderPreset.targetBitrateKbps),
+                            LogCategory::APP);
+        }
+        return false;
+    }
+
+    // Копия заменяет рендер, только если пресет выдал бы то же самое: без своих фильтров, тем же кодеком и профилем
+    const QString finalPassTemplate =
+        m_renderPreset.isTwoPass() ? m_renderPreset.commandPass2 : m_renderPreset.commandPass1;
+    const QString sourceMkv = QFileInfo(m_finalMkvPath).absoluteFilePath();
+    const QString mismatch = RenderHelper::mp4FastPathMismatch(
+        finalPassTemplate, probeVideoStream(m_processManager, AppSettings::instance().ffprobePath(), sourceMkv));
+    if (!mismatch.isEmpty())
+    {
+        emit logMessage(QString("Надписей нет, но видео нельзя скопировать: %1 — видео будет перекодировано.")
+                            .arg(mismatch),
+                        LogCategory::APP);
+        return false;
+    }
+
+    // Аудиопроход берём из пресета как обычно, видео — копией потока
+    QStringList videoArgs;
+    QStringList audioArgs;
+    if (!prepareSplitRenderArgs(finalPassTemplate, m_tempVideoMp4Path, videoArgs, audioArgs))
+    {
+        return false;
+    }
+    m_renderAudioArgs = audioArgs;
+
+    QStringList args{"-y", "-hide_banner", "-i", sourceMkv};
+    args << "-map" << "0:v:0" << "-c:v" << "copy" << "-an" << "-sn" << "-dn" << "-map_chapters" << "-1";
+    if (codec.contains("hevc", Qt::CaseInsensitive) || codec.contains("h265", Qt::CaseInsensitive))
+    {
+        args << "-tag:v" << "hvc1";
+    }
+    args << m_tempVideoMp4Path;
+
+    emit logMessage("Надписей для вшивания нет, кодек совместим с MP4 — видео копируется без перекодирования.",
+                    LogCategory::APP);
+    emit progressUpdated(-1, "MP4: копирование видео");
+    m_currentStep = Step::CopyingMp4Video;
+    m_renderTimer.start();
+    m_processManager->startProcess(m_ffmpegPath, args);
+    return true;
+}
+
+bool WorkflowManager::startBitrateCalibration()
+{
+    const double durationS = static_cast<double>(m_sourceDurationS);
+    if (!AppSettings::instance().bitrateCalibration() || !BitrateCalibrator::isApplicable(m_renderPreset, durationS))
+    {
+        return false;
+    }
+
+    QStringList videoArgs;
+    QStringList audioArgs;
+    if (!prepareSplitRenderArgs(m_renderPreset.commandPass1, m_tempVideoMp4Path, videoArgs, audioArgs))
     {
-        args << "--default-track-flag" << "0:no" << "--forced-display-flag" << "0:no" << "--language" << "0:rus"
-             << "--track-name" << QString("0:Субтитры [%1]").arg(subTrackAuthorName) << fullSubsPath;
+        return false;
     }
+    const QString workingDir = QFileInfo(m_paths->processedSignsSubs()).absolutePath();
 
-    emit progressUpdated(-1, "Сборка MKV");
-    m_processManager->startProcess(m_mkvmergePath, args);
+    m_currentStep = Step::CalibratingBitrate;
+    emit progressUpdated(-1, "Калибровка битрейта");
+    m_bitrateCalibrator = new BitrateCalibrator(m_renderPreset, videoArgs, workingDir, durationS, this);
+    m_bitrateCalibrator->setProcessEnvironment(renderProcessEnvironment());
+    connect(m_bitrateCalibrator, &BitrateCalibrator::logMessage, this, &WorkflowManager::logMessage);
+    connect(m_bitrateCalibrator, &BitrateCalibrator::finished, this, &WorkflowManager::onBitrateCalibrationFinished);
+    m_bitrateCalibrator->start();
+    return true;
 }
 
-void WorkflowManager::renderMp4()
+void WorkflowManager::onBitrateCalibrationFinished(const RenderPreset& preset, bool adjusted)
 {
-    emit logMessage("Шаг 10: Рендер финального MP4 файла...", LogCategory::APP);
-    emit progressUpdated(-1, "Рендер MP4");
-    m_renderPreset = AppSettings::instance().findRenderPreset(m_template.renderPresetName);
-    if (m_renderPreset.name.isEmpty())
+    m_bitrateCalibrator = nullptr;
+    if (adjusted)
     {
-        emit logMessage("Критическая ошибка: пресет рендера '" + m_template.renderPresetName +
-                            "' не найден. Процесс остановлен.",
-                        LogCategory::APP, LogLevel::Error);
-        emit workflowAborted();
-        return;
+        m_renderPreset = preset;
     }
-
-    m_outputMp4Path = m_finalMkvPath;
-    m_outputMp4Path.replace(".mkv", ".mp4");
-    m_tempVideoMp4Path = QDir(QFileInfo(m_outputMp4Path).absolutePath())
-                             .filePath(QFileInfo(m_outputMp4Path).completeBaseName() + "_temp_video.mp4");
-    m_tempAudioForMp4Path = QDir(QFileInfo(m_outputMp4Path).absolutePath())
-                                .filePath(QFileInfo(m_outputMp4Path).completeBaseName() + "_temp_audio.m4a");
-    m_tempMp4ChaptersTxtPath = QDir(QFileInfo(m_outputMp4Path).absolutePath())
-                                   .filePath(QFileInfo(m_outputMp4Path).completeBaseName() + "_auto_chapters.txt");
-
-    QFile::remove(m_tempVideoMp4Path);
-    QFile::remove(m_tempAudioForMp4Path);
-    QFile::remove(m_tempMp4ChaptersTxtPath);
-    m_useExternalAudioForMp4Mux = false;
-    m_mp4ChaptersEmbeddedInMux = false;
-    m_mp4VideoReady = false;
-    m_mp4AudioReady = false;
-    m_renderAudioArgs.clear();
-
+    emit progressUpdated(-1, "Рендер MP4");
     m_currentStep = Step::RenderingMp4Pass1;
     runRenderPass(m_currentStep);
 }
@@ -2328,6 +3213,10 @@ void WorkflowManager::runRenderPass(Step pass)
         (pass == Step::RenderingMp4Pass1) ? m_renderPreset.commandPass1 : m_renderPreset.commandPass2;
     QStringList videoArgs;
     QStringList audioArgs;
+    if (pass == Step::RenderingMp4Pass1)
+    {
+        m_renderTimer.start();
+    }
     if (!prepareSplitRenderArgs(commandTemplate, m_tempVideoMp4Path, videoArgs, audioArgs))
     {
         emit logMessage("Ошибка: не удалось подготовить команду для рендера.", LogCategory::APP, LogLevel::Error);
@@ -2342,9 +3231,163 @@ void WorkflowManager::runRenderPass(Step pass)
         m_renderAudioArgs = audioArgs;
     }
 
+    // Статистика первого прохода хранится в Sources под ключом (исходник, субтитры, пресет без битрейта),
+    // чтобы перерендер с другим битрейтом мог начать сразу со второго прохода.
+    if (m_renderPreset.isTwoPass())
+    {
+        const QString statsName = pass1StatsFileName(m_renderPreset);
+        if (RenderHelper::applyPassStatsFile(videoArgs, statsName))
+        {
+            m_processManager->setWorkingDirectory(m_paths->sourcesPath);
+            if (pass == Step::RenderingMp4Pass1)
+            {
+                RenderHelper::removePass1Stats(m_paths->sourcesPath, statsName);
+            }
+        }
+    }
+
     m_processManager->startProcess(m_ffmpegPath, videoArgs);
 }
 
+bool WorkflowManager::useHardsubForRender() const
+{
+    return m_signsHaveVisibleEvents && QFileInfo::exists(m_paths->processedSignsSubs());
+}
+
+QString WorkflowManager::pass1StatsFileName(const RenderPreset& preset) const
+{
+    QStringList inputs{m_finalMkvPath};
+    const bool useHardsub = useHardsubForRender();
+    if (useHardsub)
+    {
+        inputs << m_paths->processedSignsSubs();
+    }
+    return RenderHelper::pass1StatsFileName(inputs, useHardsub ? "hardsub" : "nosub", preset.commandPass1);
+}
+
+void WorkflowManager::stageRenderFonts()
+{
+    m_renderFontsStaged = true;
+    m_renderFontsIsolated = false;
+
+    // Каталог собирается заново на каждый прогон: в нём не должно остаться шрифтов прошлой серии
+    const QString dirPath = m_paths->renderFontsDir();
+    QDir(dirPath).removeRecursively();
+    QFile::remove(m_paths->renderFontconfigFile());
+    if (m_fontResult.foundFonts.isEmpty())
+    {
+        return;
+    }
+    QDir().mkpath(dirPath);
+
+    QSet<QString> stagedPaths;
+    QSet<QString> usedNames;
+    QStringList strategies;
+    qint64 bytes = 0;
+    int failed = 0;
+    for (const FoundFontInfo& font : std::as_const(m_fontResult.foundFonts))
+    {
+        const QString sourcePath = QFileInfo(font.path).absoluteFilePath();
+        if (stagedPaths.contains(sourcePath))
+        {
+            continue;
+        }
+        stagedPaths.insert(sourcePath);
+
+        // Одноимённые файлы из attached_fonts и системного каталога не должны затирать друг друга
+        QString name = QFileInfo(sourcePath).fileName();
+        if (usedNames.contains(name.toLower()))
+        {
+            name = QString("%1_%2").arg(stagedPaths.size()).arg(name);
+        }
+        usedNames.insert(name.toLower());
+
+        const StageResult staged =
+            FileStager::stageFile(sourcePath, QDir(dirPath).filePath(name), StageMode::ReadOnlyCopy);
+        if (!staged.ok)
+        {
+            ++failed;
+            emit logMessage(QString("Шрифт для рендера не подготовлен: %1 (%2)").arg(sourcePath, staged.errorString),
+                            LogCategory::APP, LogLevel::Warning);
+            continue;
+        }
+        bytes += staged.bytes;
+        const QString strategy = FileStager::strategyName(staged.strategy);
+        if (!strategies.contains(strategy))
+        {
+            strategies.append(strategy);
+        }
+    }
+    emit logMessage(QString("Шрифты для рендера: %1 файлов (%2 КиБ, %3) в %4.")
+                        .arg(stagedPaths.size() - failed)
+                        .arg(bytes / 1024)
+                        .arg(strategies.join(", "))
+                        .arg(QDir::toNativeSeparators(dirPath)),
+                    LogCategory::APP);
+
+    // Системные шрифты отключаем, только если libass точно не понадобится ничего кроме render_fonts:
+    // иначе ненайденный шрифт или недостающие символы ушли бы в квадраты вместо системной замены
+    QString keepSystemReason;
+    if (failed > 0)
+    {
+        keepSystemReason = "не все шрифты удалось подготовить";
+    }
+    else if (!m_fontResult.notFoundFontNames.isEmpty())
+    {
+        keepSystemReason = "часть шрифтов не найдена";
+    }
+    else if (!m_fontResult.missingGlyphs.isEmpty())
+    {
+        keepSystemReason = "в шрифтах не хватает символов";
+    }
+    if (!keepSystemReason.isEmpty())
+    {
+        emit logMessage("Системные шрифты остаются доступны фильтру subtitles: " + keepSystemReason + ".",
+                        LogCategory::APP);
+        return;
+    }
+
+    // Пустая конфигурация fontconfig: libass берёт шрифты только из fontsdir и не сканирует систему
+    QSaveFile config(m_paths->renderFontconfigFile());
+    if (config.open(QIODevice::WriteOnly) &&
+        config.write("<?xml version=\"1.0\"?>\n<!DOCTYPE fontconfig SYSTEM \"urn:fontconfig:fonts.dtd\">\n"
+                     "<fontconfig>\n</fontconfig>\n") > 0 &&
+        config.commit())
+    {
+        m_renderFontsIsolated = true;
+        emit logMessage("Системные шрифты для фильтра subtitles отключены (FONTCONFIG_FILE).", LogCategory::APP);
+    }
+}
+
+QString WorkflowManager::subtitlesFontsDirOption(bool relativeToSources)
+{
+    if (!m_renderFontsStaged)
+    {
+        stageRenderFonts();
+    }
+    const QString dirPath = m_paths->renderFontsDir();
+    if (!QFileInfo(dirPath).isDir())
+    {
+        return QString();
+    }
+    // Относительно рабочей папки (Sources) путь не содержит двоеточия диска, и его не нужно экранировать
+    const QString path = relativeToSources ? QFileInfo(dirPath).fileName() : escapePathForFfmpegFilter(dirPath);
+    return QString(":fontsdir='%1'").arg(path);
+}
+
+QProcessEnvironment WorkflowManager::renderProcessEnvironment() const
+{
+    if (!m_renderFontsIsolated)
+    {
+        return QProcessEnvironment();
+    }
+    // Сборки ffmpeg с libass на fontconfig без этого при каждом запуске перебирают все системные шрифты;
+    // провайдер DirectWrite переменную игнорирует, там fontsdir просто идёт первым
+    QProcessEnvironment environment = QProcessEnvironment::systemEnvironment();
+    environment.insert("FONTCONFIG_FILE", QDir::toNativeSeparators(m_paths->renderFontconfigFile()));
+    return environment;
+}
+
 bool WorkflowManager::prepareSplitRenderArgs(const QString& commandTemplate, const QString& outputVideoPath,
                                              QStringList& outVideoArgs, QStringList& outAudioArgs)
 {
@@ -2355,13 +3398,15 @@ bool WorkflowManager::prepareSplitRenderArgs(const QString& commandTemplate, con
     processedTemplate.replace("%INPUT%", inputMkv);
     processedTemplate.replace("%OUTPUT%", outputMp4);
 
-    const bool useHardsub = QFileInfo::exists(m_paths->processedSignsSubs());
+    const bool useHardsub = useHardsubForRender();
     if (useHardsub)
     {
         QFileInfo subsInfo(m_paths->processedSignsSubs());
+        const QString fontsDirOption = subtitlesFontsDirOption(true);
         m_processManager->setWorkingDirectory(subsInfo.absolutePath());
+        m_processManager->setProcessEnvironment(renderProcessEnvironment());
         const QString escapedFileName = subsInfo.fileName().replace("'", "\\'");
-        processedTemplate.replace("%SIGNS%", QString("filename='%1'").arg(escapedFileName));
+        processedTemplate.replace("%SIGNS%", QString("filename='%1'").arg(escapedFileName) + fontsDirOption);
     }
     else
     {
@@ -2555,13 +3600,15 @@ QStringList WorkflowManager::prepareCommandArguments(const QString& commandTempl
     processedTemplate.replace("%INPUT%", inputMkv);
     processedTemplate.replace("%OUTPUT%", outputMp4);
 
-    bool useHardsub = QFileInfo::exists(m_paths->processedSignsSubs());
+    bool useHardsub = useHardsubForRender();
     if (useHardsub)
     {
         QFileInfo subsInfo(m_paths->processedSignsSubs());
+        const QString fontsDirOption = subtitlesFontsDirOption(true);
         m_processManager->setWorkingDirectory(subsInfo.absolutePath());
+        m_processManager->setProcessEnvironment(renderProcessEnvironment());
         QString escapedFileName = subsInfo.fileName().replace("'", "\\'");
-        processedTemplate.replace("%SIGNS%", QString("filename='%1'").arg(escapedFileName));
+        processedTemplate.replace("%SIGNS%", QString("filename='%1'").arg(escapedFileName) + fontsDirOption);
     }
     else
     {
@@ -2589,10 +3636,16 @@ QStringList WorkflowManager::prepareCommandArguments(const QString& commandTempl
     // Preset commands may contain "-c:a copy" (or "-c copy"), which breaks AAC
     // priming metadata when remuxing to MP4. For AAC target we force encoding
     // from the original WAV directly in the final MP4 pass.
-    if (m_template.targetAudioFormat == QLatin1String("aac") &&
-        m_mainRuAudioPath.endsWith(QLatin1String(".wav"), Qt::CaseInsensitive))
+    if (m_template.targetAudioFormat == QLatin1String("aac") && WavFile::isWav(m_mainRuAudioPath))
     {
         enforceAacFromWavForPresetArgs(args, QFileInfo(m_mainRuAudioPath).absoluteFilePath());
+        // Audio is re-encoded from the WAV here, so it gets the same gain and offset as the MKV track.
+        const qsizetype outIdx = args.size() - 1;
+        const QStringList filterArgs = args.contains(QStringLiteral("-an")) ? QStringList() : ruAudioFilterArgs();
+        for (qsizetype i = filterArgs.size() - 1; i >= 0 && outIdx >= 0; --i)
+        {
+            args.insert(outIdx, filterArgs.at(i));
+        }
     }
     return args;
 }
@@ -2986,8 +4039,9 @@ void WorkflowManager::concatRenderSegment2()
         // otherwise cut into the first subtitle fade window.
         const double subtitleTimelineStart = qMin(m_concatKfBeforeTbStart + overlapUsed, m_concatTbStartSeconds);
         vfParts << QString("setpts=PTS+%1/TB").arg(QString::number(subtitleTimelineStart, 'f', 3));
-        vfParts << QString("subtitles=%1").arg(signsPath);
+        vfParts << QString("subtitles=%1").arg(signsPath) + subtitlesFontsDirOption(false);
         vfParts << "setpts=PTS-STARTPTS";
+        m_processManager->setProcessEnvironment(renderProcessEnvironment());
     }
     if (!vfParts.isEmpty())
     {
@@ -3142,14 +4196,17 @@ void WorkflowManager::concatJoinSegments()
     listFile.close();
 
     // Concat demuxer provides concatenated video from segments (input 0).
-    // Audio source depends on codec: for AAC we encode from the original WAV
-    // (m_mainRuAudioPath) directly into the MP4 so that ffmpeg creates a
-    // correct Edit List (edts) with the encoder delay.  Copying AAC from
-    // the MKV resets media_time to 0 and introduces ~44 ms lip-sync drift.
+    // Audio source depends on codec: for AAC we stream-copy the already encoded
+    // m4a (m_finalAudioMp4Path) — MP4 -> MP4 keeps the Edit List (edts) with the
+    // encoder delay.  Copying AAC from the MKV resets media_time to 0 and
+    // introduces ~44 ms lip-sync drift.  If the m4a is missing we fall back to
+    // encoding from the original WAV (m_mainRuAudioPath).
     // For non-AAC codecs (FLAC, etc.) we stream-copy from the assembled MKV
     // because there is no encoder delay to preserve.
     const bool audioIsAac = m_template.targetAudioFormat == "aac";
-    const QString audioInputPath = audioIsAac ? m_mainRuAudioPath : m_finalMkvPath;
+    const bool reuseAacBitstream = audioIsAac && hasEncodedAacForMp4();
+    const QString audioInputPath =
+        audioIsAac ? (reuseAacBitstream ? m_finalAudioMp4Path : m_mainRuAudioPath) : m_finalMkvPath;
 
     QStringList args;
     args << "-y"
@@ -3159,9 +4216,9 @@ void WorkflowManager::concatJoinSegments()
          << "-map" << "1:a:0"
          << "-c:v" << "copy";
 
-    if (audioIsAac)
+    if (audioIsAac && !reuseAacBitstream)
     {
-        args << "-c:a" << "aac_at" << "-b:a" << "256k";
+        args << ruAudioFilterArgs() << "-c:a" << aacEncoderName() << "-b:a" << "256k";
     }
     else
     {
@@ -3221,8 +4278,8 @@ void WorkflowManager::concatRemux()
     emit progressUpdated(-1, "Concat: финальный MP4");
 
     // Convert the CFR MKV (from mkvmerge) to MP4 with faststart for streaming.
-    // For AAC audio we re-encode from the original WAV to create a correct
-    // Edit List (edts) — stream-copying AAC from MKV resets media_time to 0.
+    // For AAC audio we take the m4a encoded once in convertAudioIfNeeded() so the
+    // Edit List (edts) survives — stream-copying AAC from MKV resets media_time to 0.
     QString tempMkvPath = QDir(m_paths->resultPath).filePath("concat_cfr.mkv");
     const bool audioIsAac = m_template.targetAudioFormat == "aac";
 
@@ -3230,11 +4287,16 @@ void WorkflowManager::concatRemux()
     args << "-y"
          << "-i" << tempMkvPath;
 
-    if (audioIsAac)
+    if (audioIsAac && hasEncodedAacForMp4())
+    {
+        args << "-i" << m_finalAudioMp4Path << "-map" << "0:v:0" << "-map" << "1:a:0"
+             << "-c" << "copy";
+    }
+    else if (audioIsAac)
     {
         args << "-i" << m_mainRuAudioPath << "-map" << "0:v:0" << "-map" << "1:a:0"
-             << "-c:v" << "copy"
-             << "-c:a" << "aac_at" << "-b:a" << "256k";
+             << "-c:v" << "copy" << ruAudioFilterArgs()
+             << "-c:a" << aacEncoderName() << "-b:a" << "256k";
     }
     else
     {
@@ -3246,6 +4308,16 @@ void WorkflowManager::concatRemux()
     m_processManager->startProcess(m_ffmpegPath, args);
 }
 
+bool WorkflowManager::hasEncodedAacForMp4() const
+{
+    return !m_finalAudioMp4Path.isEmpty() && QFileInfo::exists(m_finalAudioMp4Path);
+}
+
+QString WorkflowManager::aacEncoderName() const
+{
+    return AppSettings::instance().hasAacAtCodec() ? QStringLiteral("aac_at") : QStringLiteral("aac");
+}
+
 void WorkflowManager::concatCleanup()
 {
     emit logMessage("Concat рендер: очистка временных файлов...", LogCategory::APP);
@@ -3261,57 +4333,29 @@ void WorkflowManager::concatCleanup()
 
 void WorkflowManager::extractAttachments(const QJsonArray& attachments)
 {
-    emit logMessage("Шаг 3: Извлечение вложенных шрифтов...", LogCategory::APP);
+    emit logMessage("Шаг 3: Поиск вложенных шрифтов...", LogCategory::APP);
     m_currentStep = Step::ExtractingAttachments;
 
     m_tempFontPaths.clear();
+    m_sourceFontAttachments = MkvAttachments::fontsFromIdentification(attachments);
 
-    QDir attachmentsDir(m_paths->attachedFontsDir());
-    if (!attachmentsDir.exists())
-        attachmentsDir.mkpath(".");
-
-    QStringList args;
-    args << m_mkvFilePath << "attachments";
     QStringList logFontNames;
-
-    bool foundAnyFonts = false;
-    for (const QJsonValue& val : attachments)
+    for (const MkvAttachment& font : std::as_const(m_sourceFontAttachments))
     {
-        QJsonObject att = val.toObject();
-        QString contentType = att["content_type"].toString();
-        // Ищем шрифты по MIME-типу
-        if (contentType.contains("font", Qt::CaseInsensitive) ||
-            contentType.contains("octet-stream", Qt::CaseInsensitive))
-        {
-            QString id = QString::number(att["id"].toInt());
-            QString fileName = att["file_name"].toString();
-            // Проверяем расширение, чтобы не извлекать картинки и прочее
-            if (fileName.toLower().endsWith(".ttf") || fileName.toLower().endsWith(".otf") ||
-                fileName.toLower().endsWith(".ttc"))
-            {
-                QString outputPath = attachmentsDir.filePath(fileName);
-                args << QString("%1:%2").arg(id, outputPath);
-
-                m_tempFontPaths.append(outputPath);
-                logFontNames.append(fileName);
-                foundAnyFonts = true;
-            }
-        }
+        logFontNames.append(font.fileName);
     }
 
-    if (foundAnyFonts)
+    if (!m_sourceFontAttachments.isEmpty())
     {
-        emit logMessage("Найдены шрифты для извлечения: " + logFontNames.join(", "), LogCategory::APP);
-        emit progressUpdated(-1, "Извлечение вложений");
-        m_processManager->startProcess(m_mkvextractPath, args);
+        // Сами файлы извлекаются после обработки субтитров, и только те, что им нужны
+        emit logMessage("Найдены вложенные шрифты: " + logFontNames.join(", "), LogCategory::APP);
     }
     else
     {
         emit logMessage("Шрифтов среди вложений не найдено. Пропускаем шаг.", LogCategory::APP);
-        m_currentStep = Step::ExtractingAttachments;
-        QMetaObject::invokeMethod(this, "onProcessFinished", Qt::QueuedConnection, Q_ARG(int, 0),
-                                  Q_ARG(QProcess::ExitStatus, QProcess::NormalExit));
     }
+    QMetaObject::invokeMethod(this, "onProcessFinished", Qt::QueuedConnection, Q_ARG(int, 0),
+                              Q_ARG(QProcess::ExitStatus, QProcess::NormalExit));
 }
 
 void WorkflowManager::onProcessStdOut(const QString& output)
@@ -3332,6 +4376,7 @@ void WorkflowManager::onProcessStdOut(const QString& output)
             category = (m_sourceFormat == SourceFormat::MP4) ? LogCategory::FFMPEG : LogCategory::MKVTOOLNIX;
             break;
 
+        case Step::ExtractingFonts:
         case Step::ConcatExtract:
             category = LogCategory::MKVTOOLNIX;
             break;
@@ -3339,6 +4384,7 @@ void WorkflowManager::onProcessStdOut(const QString& output)
         case Step::ConvertingAudio:
         case Step::RenderingMp4Pass1:
         case Step::RenderingMp4Pass2:
+        case Step::CopyingMp4Video:
         case Step::RenderingMp4Audio:
         case Step::ConcatCutSegment1:
         case Step::ConcatRenderSegment2:
@@ -3358,8 +4404,8 @@ void WorkflowManager::onProcessStdOut(const QString& output)
     }
 
     if (m_currentStep == Step::ConcatExtract || m_currentStep == Step::ExtractingTracks ||
-        m_currentStep == Step::ExtractingAttachments || m_currentStep == Step::AssemblingMkv ||
-        m_currentStep == Step::AssemblingSrtMaster)
+        m_currentStep == Step::ExtractingAttachments || m_currentStep == Step::ExtractingFonts ||
+        m_currentStep == Step::AssemblingMkv || m_currentStep == Step::AssemblingSrtMaster)
     {
         QRegularExpression re("Progress: (\\d+)%");
         auto it = re.globalMatch(output);
@@ -3390,6 +4436,7 @@ void WorkflowManager::onProcessStdErr(const QString& output)
             category = (m_sourceFormat == SourceFormat::MP4) ? LogCategory::FFMPEG : LogCategory::MKVTOOLNIX;
             break;
 
+        case Step::ExtractingFonts:
         case Step::ConcatExtract:
             category = LogCategory::MKVTOOLNIX;
             break;
@@ -3397,6 +4444,7 @@ void WorkflowManager::onProcessStdErr(const QString& output)
         case Step::ConvertingAudio:
         case Step::RenderingMp4Pass1:
         case Step::RenderingMp4Pass2:
+        case Step::CopyingMp4Video:
         case Step::RenderingMp4Audio:
         case Step::ConcatCutSegment1:
         case Step::ConcatRenderSegment2:
@@ -3466,11 +4514,19 @@ void WorkflowManager::convertToSrtAndAssembleMaster()
         m_paths->masterMkv(QString("[DUB x TVOЁ] %1 - %2.mkv").arg(m_template.seriesTitle, m_episodeNumberForSearch));
     args << "-o" << outputMkvPath;
 
-    QString videoPath = m_paths->extractedVideo(m_videoTrack.extension);
-    args << videoPath;
+    if (m_directSourceTracks)
+    {
+        args << "--video-tracks" << QString::number(m_videoTrack.id) << "--no-audio" << "--no-subtitles"
+             << "--no-attachments" << "--no-chapters" << "--no-global-tags" << m_mkvFilePath;
+    }
+    else
+    {
+        QString videoPath = m_paths->extractedVideo(m_videoTrack.extension);
+        args << videoPath;
+    }
 
     QString wavPath = m_wavForSrtMasterPath.isEmpty() ? m_mainRuAudioPath : m_wavForSrtMasterPath;
-    args << "--language" << "0:rus" << wavPath;
+    args << "--language" << "0:rus" << ruAudioSyncArgs(wavPath) << wavPath;
     args << "--language" << "0:rus" << m_paths->masterSrt();
 
     emit progressUpdated(0, "Сборка SRT-копии");
@@ -3583,6 +4639,9 @@ void WorkflowManager::getMp4Info()
 
     emit logMessage("Шаг 2: Получение информации о файле MP4 (ffprobe)...", LogCategory::APP);
     m_currentStep = Step::GettingMkvInfo;
+    m_directSourceTracks = false;
+    m_demuxSourceSize = 0;
+    m_sourceFontAttachments.clear();
 
     QString ffprobePath = AppSettings::instance().ffprobePath();
 
@@ -3701,18 +4760,12 @@ void WorkflowManager::getMp4Info()
     }
 
     loadChaptersForWorkflow();
+    startFingerprintScan();
 
     if (m_template.chaptersEnabled && m_chapterMarkers.isEmpty() && !m_skipChaptersForWorkflow)
     {
         m_chapterContinueKind = ChapterContinueKind::AfterMp4Probe;
-        m_wasUserInputRequested = true;
-        m_lastStepBeforeRequest = Step::GettingMkvInfo;
-        UserInputRequest req;
-        req.chaptersRequired = true;
-        req.chaptersReason =
-            QStringLiteral("Для релиза ожидаются главы, но в контейнере не найдено и на главной странице не "
-                           "указан файл XML. Укажите путь к файлу глав или выберите сборку без глав.");
-        emit userInputRequired(req);
+        requestMissingChapters();
         return;
     }
 
@@ -3808,7 +4861,7 @@ void WorkflowManager::resumeWithUserInput(const UserInputResponse& response)
     if (!response.audioPath.isEmpty())
     {
         emit logMessage("Пользователь предоставил аудиофайл. Обработка...", LogCategory::APP);
-        QString newAudioPath = handleUserFile(response.audioPath, m_paths->sourcesPath);
+        QString newAudioPath = handleUserFile(response.audioPath, m_paths->sourcesPath, QString(), true);
         if (!newAudioPath.isEmpty())
         {
             if (m_mainRuAudioPath.isEmpty())
@@ -3823,7 +4876,7 @@ void WorkflowManager::resumeWithUserInput(const UserInputResponse& response)
         }
     }
     else if (m_lastStepBeforeRequest == Step::AudioPreparation && m_template.createSrtMaster &&
-             !m_mainRuAudioPath.endsWith(".wav"))
+             !WavFile::isWav(m_mainRuAudioPath))
     {
         emit logMessage("WAV для мастер-копии не предоставлен. Сборка мастер-копии отменена.", LogCategory::APP);
         m_template.createSrtMaster = false;
@@ -3841,6 +4894,7 @@ void WorkflowManager::resumeWithUserInput(const UserInputResponse& response)
             m_fontResult.foundFonts.append({it.value(), it.key()});
             m_fontResult.notFoundFontNames.removeOne(it.key());
         }
+        m_renderFontsStaged = false;
     }
 
     if (m_lastStepBeforeRequest == Step::AudioPreparation)
@@ -3906,18 +4960,12 @@ void WorkflowManager::resumeWithSelectedAudioTrack(int trackId)
                     LogCategory::APP);
 
     loadChaptersForWorkflow();
+    startFingerprintScan();
 
     if (m_template.chaptersEnabled && m_chapterMarkers.isEmpty() && !m_skipChaptersForWorkflow)
     {
         m_chapterContinueKind = ChapterContinueKind::AfterAudioTrack;
-        m_wasUserInputRequested = true;
-        m_lastStepBeforeRequest = Step::GettingMkvInfo;
-        UserInputRequest req;
-        req.chaptersRequired = true;
-        req.chaptersReason =
-            QStringLiteral("Для релиза ожидаются главы, но в контейнере не найдено и на главной странице не "
-                           "указан файл XML. Укажите путь к файлу глав или выберите сборку без глав.");
-        emit userInputRequired(req);
+        requestMissingChapters();
         return;
     }
 
@@ -3952,6 +5000,7 @@ void WorkflowManager::processSubtitles()
 {
     emit logMessage("Шаг 6: Обработка субтитров...", LogCategory::APP);
     m_currentStep = Step::ProcessingSubs;
+    startAudioAnalysis();
 
     QString subsToAnalyze;
     if ((m_template.signStyles.isEmpty() || m_template.forceSignStyleRequest) && !m_wereStylesRequested)
@@ -4121,11 +5170,21 @@ void WorkflowManager::onFontFinderFinished(const FontFinderResult& result)
     }
 
     emit logMessage("Поиск шрифтов завершен.", LogCategory::APP);
+    if (!result.missingGlyphs.isEmpty())
+    {
+        emit logMessage(QString("Внимание: в %1 шрифтах нет части символов из субтитров (список выше). В MKV и в "
+                                "рендере MP4 эти символы будут показаны другим шрифтом или квадратами — "
+                                "проверьте шрифты до рендера.")
+                            .arg(result.missingGlyphs.size()),
+                        LogCategory::APP, LogLevel::Warning);
+    }
     m_fontResult = result;
+    m_renderFontsStaged = false;
     convertToSrtAndAssembleMaster();
 }
 
-QString WorkflowManager::handleUserFile(const QString& sourcePath, const QString& destDir, const QString& newName)
+QString WorkflowManager::handleUserFile(const QString& sourcePath, const QString& destDir, const QString& newName,
+                                        bool readOnly)
 {
     if (sourcePath.isEmpty() || !QFileInfo::exists(sourcePath))
     {
@@ -4148,32 +5207,19 @@ QString WorkflowManager::handleUserFile(const QString& sourcePath, const QString
         return sourceInfo.absoluteFilePath();
     }
 
-    if (destInfo.exists())
-    {
-        QFile::remove(destInfo.absoluteFilePath());
-    }
-
-    bool success = false;
-    if (action == UserFileAction::Move)
+    // Move: rename, а на другой диск — reflink/копия с удалением исходника.
+    // Copy: reflink, для неизменяемых файлов (видео, аудио) — жёсткая ссылка, затем обычная копия.
+    StageMode mode = StageMode::Move;
+    if (action == UserFileAction::Copy)
     {
-        success = QFile::rename(sourceInfo.absoluteFilePath(), destInfo.absoluteFilePath());
-        if (success)
-        {
-            return destInfo.absoluteFilePath();
-        }
-        // Если rename не удался (например, разные диски), пробуем скопировать
+        mode = readOnly ? StageMode::ReadOnlyCopy : StageMode::Copy;
     }
+    const StageResult staged = FileStager::stageFile(sourceInfo.absoluteFilePath(), destInfo.absoluteFilePath(), mode);
 
-    // Действие Copy или фоллбэк для Move
-    success = QFile::copy(sourceInfo.absoluteFilePath(), destInfo.absoluteFilePath());
-
-    if (success)
+    if (staged.ok)
     {
-        if (action == UserFileAction::Move)
-        {
-            // Если это был фоллбэк для Move, удаляем исходник
-            QFile::remove(sourceInfo.absoluteFilePath());
-        }
+        emit logMessage(QString("Файл %1 размещён в проекте (%2).").arg(finalName, FileStager::describe(staged)),
+                        LogCategory::APP);
         return destInfo.absoluteFilePath();
     }
 
@@ -4230,8 +5276,8 @@ void WorkflowManager::loadChaptersForWorkflow()
 
     if (m_sourceFormat == SourceFormat::MKV && QFileInfo::exists(m_mkvFilePath))
     {
-        const QString embPath = QDir(m_paths->sourcesPath).filePath(QStringLiteral("chapters_embedded.xml"));
-        if (ChapterHelper::extractEmbeddedChaptersToFile(m_mkvextractPath, m_mkvFilePath, embPath, m_processManager))
+        const QString embPath = embeddedChaptersFile();
+        if (!embPath.isEmpty())
         {
             m_chapterMarkers = ChapterHelper::loadChaptersFromFile(embPath);
             if (!m_chapterMarkers.isEmpty())
@@ -4279,6 +5325,202 @@ void WorkflowManager::loadChaptersForWorkflow()
     }
 }
 
+void WorkflowManager::requestMissingChapters()
+{
+    if (m_fingerprintFuture.isValid() && !m_fingerprintIndex.chapters.isEmpty())
+    {
+        if (deferUntilFinished(this, m_fingerprintFuture, [this]() { requestMissingChapters(); }))
+        {
+            emit logMessage(QStringLiteral("Глав нет, поиск опенинга и эндинга по отпечаткам звука..."),
+                            LogCategory::APP);
+            emit progressUpdated(-1, "Поиск глав по звуку");
+            return;
+        }
+        if (chaptersFromFingerprints())
+        {
+            continueWorkflowAfterChaptersResolved();
+            return;
+        }
+    }
+
+    m_wasUserInputRequested = true;
+    m_lastStepBeforeRequest = Step::GettingMkvInfo;
+    UserInputRequest req;
+    req.chaptersRequired = true;
+    req.chaptersReason =
+        QStringLiteral("Для релиза ожидаются главы, но в контейнере не найдено и на главной странице не "
+                       "указан файл XML. Укажите путь к файлу глав или выберите сборку без глав.");
+    emit userInputRequired(req);
+}
+
+void WorkflowManager::startFingerprintScan()
+{
+    if (m_fingerprintFuture.isValid() || m_template.seriesTitle.isEmpty() || m_originalAudioTrack.id == -1 ||
+        !QFileInfo::exists(m_ffmpegPath))
+    {
+        return;
+    }
+    if (m_fingerprintIndexPath.isEmpty())
+    {
+        m_fingerprintIndexPath = AudioFingerprint::indexPath(m_template.seriesTitle);
+        m_fingerprintIndex = AudioFingerprint::loadIndex(m_fingerprintIndexPath);
+    }
+
+    // Проход по звуку нужен, только если по нему есть что найти или чему научиться
+    const bool findEnding =
+        !m_template.useManualTime && m_parsedEndingTime.isEmpty() && m_fingerprintIndex.endingSegment() >= 0;
+    const bool findChapters = m_template.chaptersEnabled && !m_skipChaptersForWorkflow && m_chapterMarkers.isEmpty() &&
+                              !m_fingerprintIndex.chapters.isEmpty();
+    if (!findEnding && !findChapters && !canLearnFingerprints())
+    {
+        return;
+    }
+
+    // До извлечения дорожек звук читается прямо из исходника
+    QString path = originalAudioSourcePath();
+    QString streamSpecifier = "a:0";
+    if (!QFileInfo::exists(path))
+    {
+        path = m_mkvFilePath;
+        streamSpecifier = QString::number(m_originalAudioTrack.id);
+    }
+    const QString ffmpegPath = m_ffmpegPath;
+    m_fingerprintFuture = QtConcurrent::run([ffmpegPath, path, streamSpecifier]()
+                                            { return AudioFingerprint::scan(ffmpegPath, path, streamSpecifier); });
+}
+
+bool WorkflowManager::canLearnFingerprints() const
+{
+    // Учится только то, чего в индексе ещё нет: иначе каждая серия стоила бы лишнего прохода по звуку
+    const bool learnEnding = !m_template.useManualTime && !m_endingTimeFromFingerprint &&
+                             !m_parsedEndingTime.isEmpty() && m_fingerprintIndex.endingSegment() < 0;
+    if (learnEnding || !m_fingerprintIndex.chapters.isEmpty())
+    {
+        return learnEnding;
+    }
+    return std::any_of(m_chapterMarkers.cbegin(), m_chapterMarkers.cend(),
+                       [this](const ChapterMarker& chapter)
+                       {
+                           return AudioFingerprint::isOpeningChapter(chapter.title) ||
+                                  AudioFingerprint::isEndingChapter(chapter.title, m_template.endingChapterName);
+                       });
+}
+
+const QList<FingerprintMatch>& WorkflowManager::fingerprintMatches()
+{
+    if (m_fingerprintMatched)
+    {
+        return m_fingerprintMatches;
+    }
+    m_fingerprintMatched = true;
+    const FingerprintScan scan = m_fingerprintFuture.result();
+    if (!scan.ok)
+    {
+        emit logMessage("Не удалось посчитать отпечатки звука: " + scan.errorString, LogCategory::APP,
+                        LogLevel::Warning);
+        return m_fingerprintMatches;
+    }
+    QElapsedTimer timer;
+    timer.start();
+    m_fingerprintMatches = AudioFingerprint::match(m_fingerprintIndex, scan.hashes);
+    emit logMessage(QString("Отпечатки звука: проход по %1 мин аудио за %2 мс, поиск за %3 мс, найдено %4 из %5.")
+                        .arg(scan.durationS() / 60.0, 0, 'f', 1)
+                        .arg(scan.elapsedMs)
+                        .arg(timer.elapsed())
+                        .arg(m_fingerprintMatches.size())
+                        .arg(m_fingerprintIndex.segments.size()),
+                    LogCategory::APP);
+    return m_fingerprintMatches;
+}
+
+QString WorkflowManager::endingTimeFromFingerprints()
+{
+    const int ending = m_fingerprintIndex.endingSegment();
+    for (const FingerprintMatch& match : fingerprintMatches())
+    {
+        if (match.segment != ending)
+        {
+            continue;
+        }
+        m_parsedEndingTime = QTime::fromMSecsSinceStartOfDay(qRound(match.startS * 1000.0)).toString("H:mm:ss.zzz");
+        m_endingTimeFromFingerprint = true;
+        emit logMessage(QString("Эндинг найден по отпечатку звука: %1 (совпадение %2%).")
+                            .arg(m_parsedEndingTime)
+                            .arg(qRound(match.score * 100)),
+                        LogCategory::APP);
+        return m_parsedEndingTime;
+    }
+    emit logMessage("Эндинг по отпечатку звука не найден.", LogCategory::APP, LogLevel::Warning);
+    return {};
+}
+
+bool WorkflowManager::chaptersFromFingerprints()
+{
+    const QList<ChapterMarker> chapters = AudioFingerprint::buildChapters(
+        m_fingerprintIndex, fingerprintMatches(), m_fingerprintFuture.result().durationS());
+    if (chapters.isEmpty())
+    {
+        emit logMessage(QStringLiteral("Главы по отпечаткам звука восстановить не удалось."), LogCategory::APP,
+                        LogLevel::Warning);
+        return false;
+    }
+    const QString muxCopy = QDir(m_paths->sourcesPath).filePath(QStringLiteral("chapters_mux.xml"));
+    if (!ChapterHelper::writeMatroskaChapterXml(chapters, muxCopy))
+    {
+        return false;
+    }
+    m_chapterMarkers = chapters;
+    m_chaptersMuxPathForMkv = muxCopy;
+    emit logMessage(QStringLiteral("Главы: восстановлены по отпечаткам звука (%1 шт.).").arg(chapters.size()),
+                    LogCategory::APP);
+    return true;
+}
+
+void WorkflowManager::learnFingerprints()
+{
+    if (!m_fingerprintFuture.isValid() || !canLearnFingerprints() ||
+        deferUntilFinished(this, m_fingerprintFuture, [this]() { learnFingerprints(); }))
+    {
+        return;
+    }
+    const FingerprintScan scan = m_fingerprintFuture.result();
+    if (!scan.ok)
+    {
+        emit logMessage("Не удалось посчитать отпечатки звука: " + scan.errorString, LogCategory::APP,
+                        LogLevel::Warning);
+        return;
+    }
+
+    bool learned = false;
+    if (!m_chapterMarkers.isEmpty() && m_fingerprintIndex.chapters.isEmpty())
+    {
+        learned = AudioFingerprint::learnChapters(m_fingerprintIndex, scan.hashes, m_chapterMarkers,
+                                                  m_template.endingChapterName);
+    }
+    const QTime endingTime = QTime::fromString(m_parsedEndingTime, "H:mm:ss.zzz");
+    if (!m_template.useManualTime && !m_endingTimeFromFingerprint && endingTime.isValid() &&
+        m_fingerprintIndex.endingSegment() < 0)
+    {
+        AudioFingerprint::learnEnding(m_fingerprintIndex, scan.hashes, endingTime.msecsSinceStartOfDay() / 1000.0);
+        learned = learned || m_fingerprintIndex.endingSegment() >= 0;
+    }
+    if (!learned)
+    {
+        return;
+    }
+    if (AudioFingerprint::saveIndex(m_fingerprintIndex, m_fingerprintIndexPath))
+    {
+        emit logMessage("Отпечатки опенинга и эндинга этой серии сохранены: в следующих сериях время ТБ и главы "
+                        "найдутся по звуку.",
+                        LogCategory::APP);
+    }
+    else
+    {
+        emit logMessage("Не удалось сохранить отпечатки звука: " + m_fingerprintIndexPath, LogCategory::APP,
+                        LogLevel::Warning);
+    }
+}
+
 void WorkflowManager::continueWorkflowAfterChaptersResolved()
 {
     switch (m_chapterContinueKind)
@@ -4395,7 +5637,7 @@ void WorkflowManager::prepareUserFiles()
 
     // 1. Русская аудиодорожка
     QString oldAudioPath = m_mainWindow->getAudioPath();
-    QString newAudioPath = handleUserFile(oldAudioPath, m_paths->sourcesPath);
+    QString newAudioPath = handleUserFile(oldAudioPath, m_paths->sourcesPath, QString(), true);
 
     if (newAudioPath != oldAudioPath && !newAudioPath.isEmpty())
     {
@@ -4445,6 +5687,16 @@ void WorkflowManager::onBitrateCheckFinished(RerenderDecision decision, const Re
         emit logMessage("Получено решение о перерендере.", LogCategory::APP);
         m_renderPreset = newPreset;
         m_currentStep = Step::RenderingMp4Pass1;
+        if (m_renderPreset.isTwoPass() &&
+            RenderHelper::hasPass1Stats(m_paths->sourcesPath, pass1StatsFileName(m_renderPreset)))
+        {
+            emit logMessage("Статистика первого прохода для этого исходника и фильтров уже есть, "
+                            "перерендер начинается сразу со второго прохода.",
+                            LogCategory::APP);
+            m_currentStep = Step::RenderingMp4Pass2;
+            emit progressUpdated(50, "Рендер MP4 (проход 2/2)");
+            m_renderTimer.invalidate(); // скорость только второго прохода исказила бы статистику пресета
+        }
         runRenderPass(m_currentStep);
     }
     else
@@ -3,30 +3,45 @@
 
 #include "appsettings.h"
 #include "assprocessor.h"
+#include "audiofingerprint.h"
+#include "audiooffset.h"
 #include "chapterhelper.h"
+#include "chunkedflac.h"
 #include "fontfinder.h"
+#include "fontstore.h"
+#include "loudnessmeter.h"
+#include "mkvattachments.h"
 #include "postgenerator.h"
 #include "processmanager.h"
 #include "releasetemplate.h"
 #include "renderhelper.h"
 #include "rerenderdialog.h"
+#include "torrentmonitor.h"
 #include "torrentselectordialog.h"
 #include "trackselectordialog.h"
 
 #include <QDir>
+#include <QElapsedTimer>
 #include <QFileInfo>
+#include <QFuture>
 #include <QJsonObject>
 #include <QNetworkAccessManager>
 #include <QNetworkCookie>
 #include <QNetworkReply>
 #include <QObject>
+#include <QProcessEnvironment>
 #include <QSettings>
 #include <QTimer>
 #include <QXmlStreamReader>
 
+#include <atomic>
+#include <memory>
+
 class AssProcessor;
+class BitrateCalibrator;
 class MainWindow;
 class ProcessManager;
+struct SubsetAttachment;
 
 enum class SourceFormat
 {
@@ -144,6 +159,24 @@ struct PathManager
     {
         return QDir(sourcesPath).filePath("subtitles_processed_signs.ass");
     }
+    // Копии для MKV с именами урезанных шрифтов; рендер MP4 берёт обработанные файлы
+    QString mkvFullSubs() const
+    {
+        return QDir(sourcesPath).filePath("subtitles_mkv_full.ass");
+    }
+    QString mkvSignsSubs() const
+    {
+        return QDir(sourcesPath).filePath("subtitles_mkv_signs.ass");
+    }
+    // Найденные FontFinder шрифты для fontsdir фильтра subtitles, собираются заново на каждый прогон
+    QString renderFontsDir() const
+    {
+        return QDir(sourcesPath).filePath("render_fonts");
+    }
+    QString renderFontconfigFile() const
+    {
+        return QDir(sourcesPath).filePath("render_fonts.conf");
+    }
     QString masterSrt() const
     {
         return QDir(sourcesPath).filePath("master_subtitles.srt");
@@ -212,8 +245,7 @@ private slots:
     void onTorrentDeleted(QNetworkReply* reply);
     void onTorrentListReceived(QNetworkReply* reply);
     void onTorrentListForHashCheckReceived(QNetworkReply* reply);
-    void onPollingTimerTimeout();
-    void onTorrentProgressReceived(QNetworkReply* reply);
+    void onTorrentUpdated(const TorrentState& state);
     void onTorrentFilesReceived(QNetworkReply* reply);
     void onFontFinderFinished(const FontFinderResult& result);
     void onProcessFinished(int exitCode, QProcess::ExitStatus exitStatus);
@@ -234,13 +266,16 @@ private:
         ExtractingTracks,
         AudioPreparation,
         ProcessingSubs,
+        ExtractingFonts,
         FindingFonts,
         ConvertingToSrt,
         AssemblingSrtMaster,
         ConvertingAudio,
         AssemblingMkv,
+        CalibratingBitrate,
         RenderingMp4Pass1,
         RenderingMp4Pass2,
+        CopyingMp4Video,
         RenderingMp4Audio,
         MuxingMp4,
         ConcatFindKeyframe,
@@ -283,12 +318,32 @@ private:
     void extractTracks();
     void extractTracksMp4();
     void extractAttachments(const QJsonArray& attachments);
+    void logDemuxBytesRead();
+    QString originalAudioSourcePath() const;
+    QString embeddedChaptersFile();
     void audioPreparation();
+    void startAudioAnalysis();
+    double decideLoudnessGain();
+    int decideAudioOffset();
+    QStringList ruAudioFilterArgs() const;
+    QStringList ruAudioSyncArgs(const QString& russianAudioPath) const;
     void convertAudioIfNeeded();
+    void startAudioConversion();
+    bool startChunkedFlacEncode();
+    void finishChunkedFlacEncode();
     void convertToSrtAndAssembleMaster();
     void assembleMkv(const QString& m_finalAudioPath);
+    QList<SubsetAttachment> subsetFontsForMkv(QString& fullSubsPath, QString& signsPath);
     void renderMp4();
     void runRenderPass(Step pass);
+    bool startBitrateCalibration();
+    bool tryMp4FastPath();
+    void onBitrateCalibrationFinished(const RenderPreset& preset, bool adjusted);
+    QString pass1StatsFileName(const RenderPreset& preset) const;
+    bool useHardsubForRender() const;
+    void stageRenderFonts();
+    QString subtitlesFontsDirOption(bool relativeToSources);
+    QProcessEnvironment renderProcessEnvironment() const;
     bool prepareSplitRenderArgs(const QString& commandTemplate, const QString& outputVideoPath,
                                 QStringList& outVideoArgs, QStringList& outAudioArgs);
     bool runMp4MuxWithMp4Box();
@@ -302,9 +357,21 @@ private:
     void concatExtractH264();
     void concatRemux();
     void concatCleanup();
+    bool hasEncodedAacForMp4() const;
+    QString aacEncoderName() const;
     static QString concatEncoderForCodec(const QString& codecExtension);
     void prepareUserFiles();
     void loadChaptersForWorkflow();
+    /// Восстановить главы по отпечаткам звука, а если не вышло — спросить у пользователя.
+    void requestMissingChapters();
+    /// Запустить проход по оригинальной дорожке, если по отпечаткам сериала есть что найти или выучить.
+    void startFingerprintScan();
+    bool canLearnFingerprints() const;
+    const QList<FingerprintMatch>& fingerprintMatches();
+    QString endingTimeFromFingerprints();
+    bool chaptersFromFingerprints();
+    /// Запомнить эндинг и главы этой серии в индексе сериала, когда проход закончится.
+    void learnFingerprints();
     void warnIfExpectedChaptersMissing();
     void continueWorkflowAfterChaptersResolved();
 
@@ -323,12 +390,15 @@ private:
     void processSubtitles();
     void runAssProcessing();
     void findFontsInProcessedSubs();
+    void extractReferencedFonts();
+    void reportStoredFonts(const QHash<QString, StoredFont>& storedByFileName);
 
     QStringList prepareCommandArguments(const QString& commandTemplate);
     QString getExtensionForCodec(const QString& codecId);
     QString getExtensionForFfprobeCodec(const QString& codecName);
     static SourceFormat detectSourceFormat(const QString& filePath);
-    QString handleUserFile(const QString& sourcePath, const QString& destDir, const QString& newName = "");
+    QString handleUserFile(const QString& sourcePath, const QString& destDir, const QString& newName = "",
+                           bool readOnly = false);
     QString getInfohashFromMagnet(const QString& magnetLink) const;
 
     MainWindow* m_mainWindow; // Указатель на главный класс UI
@@ -360,6 +430,14 @@ private:
 
     QString m_chaptersMuxPathForMkv;
     QList<ChapterMarker> m_chapterMarkers;
+    QString m_embeddedChaptersPath;
+    bool m_embeddedChaptersChecked = false;
+
+    // Шрифты-вложения источника; извлекаются после обработки субтитров, только нужные им
+    QList<MkvAttachment> m_sourceFontAttachments;
+    qint64 m_demuxSourceSize = 0;
+    // Видео и оригинальное аудио не извлекаются в Sources/, mkvmerge берёт их из m_mkvFilePath по ID
+    bool m_directSourceTracks = false;
 
     SourceFormat m_sourceFormat = SourceFormat::Unknown;
 
@@ -375,14 +453,34 @@ private:
     bool m_isNormalizationEnabled = false;
     bool m_didLaunchNugen = false;
     bool m_wasNormalizationPerformed = false;
+    QFuture<LoudnessResult> m_loudnessFuture;
+    QFuture<AudioOffsetResult> m_audioOffsetFuture;
+    QString m_analyzedAudioPath;   // файл, по которому запущены измерение громкости и поиск сдвига
+    double m_loudnessGainDb = 0.0; // усиление при кодировании русской дорожки из WAV
+    int m_audioOffsetMs = 0;       // компенсируемый сдвиг дубляжа, > 0 — дубляж запаздывает
+    QFuture<FingerprintScan> m_fingerprintFuture;
+    QString m_fingerprintIndexPath;
+    FingerprintIndex m_fingerprintIndex;
+    QList<FingerprintMatch> m_fingerprintMatches;
+    bool m_fingerprintMatched = false;
+    bool m_endingTimeFromFingerprint = false; // время ТБ найдено по отпечатку, учить по нему нечего
+    QFuture<ChunkedFlacResult> m_chunkedFlacFuture;
+    bool m_chunkedFlacFailed = false;    // кодировать одним процессом ffmpeg
+    // Взводится при отмене: процессы ffmpeg кусков убиваются, результат отбрасывается. Общий с задачей пула,
+    // потому что та может пережить WorkflowManager
+    std::shared_ptr<std::atomic_bool> m_chunkedFlacCancelled = std::make_shared<std::atomic_bool>(false);
     bool m_isSrtMasterDecoupled = false;
     bool m_useExternalAudioForMp4Mux = false;
     bool m_mp4ChaptersEmbeddedInMux = false;
     bool m_mp4VideoReady = false;
     bool m_mp4AudioReady = false;
     QStringList m_renderAudioArgs;
+    BitrateCalibrator* m_bitrateCalibrator = nullptr;
+    bool m_signsHaveVisibleEvents = true;
+    QElapsedTimer m_renderTimer;
     bool m_audioConversionNeedsSecondPass = false;
     QString m_audioConversionCurrentOutputPath;
+    qint64 m_audioConversionDurationUs = 0; // для процента по out_time_us из -progress
 
     struct TrackInfo
     {
@@ -397,6 +495,8 @@ private:
 
     FontFinder* m_fontFinder;
     FontFinderResult m_fontResult;
+    bool m_renderFontsStaged = false;   // render_fonts собран по текущему m_fontResult
+    bool m_renderFontsIsolated = false; // ffmpeg запускается с пустым fontconfig: все шрифты есть в render_fonts
 
     TrackInfo m_videoTrack;
     TrackInfo m_originalAudioTrack;
@@ -0,0 +1,473 @@
+#include "assdocument.h"
+
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QStringDecoder>
+
+#include <climits>
+
+namespace
+{
+constexpr int kMaxCachedDocuments = 8;
+
+bool isSpace(char c)
+{
+    return c == ' ' || c == '\t';
+}
+
+AssSpan trimSpan(const char* data, AssSpan span)
+{
+    while (span.length > 0 && isSpace(data[span.offset]))
+    {
+        ++span.offset;
+        --span.length;
+    }
+    while (span.length > 0 && isSpace(data[span.offset + span.length - 1]))
+    {
+        --span.length;
+    }
+    return span;
+}
+
+bool equalsIgnoreCase(QByteArrayView a, QByteArrayView b)
+{
+    return a.compare(b, Qt::CaseInsensitive) == 0;
+}
+
+// Делит тело строки по запятым на expectedCount полей; последнее поле забирает остаток вместе с запятыми
+template <qsizetype N>
+void splitFields(const char* data, AssSpan body, int expectedCount, QVarLengthArray<AssSpan, N>& out)
+{
+    out.clear();
+    qsizetype fieldStart = body.offset;
+    const qsizetype end = body.offset + body.length;
+    for (qsizetype i = body.offset; i < end && out.size() + 1 < expectedCount; ++i)
+    {
+        if (data[i] == ',')
+        {
+            out.append({fieldStart, i - fieldStart});
+            fieldStart = i + 1;
+        }
+    }
+    out.append({fieldStart, end - fieldStart});
+}
+
+struct CacheEntry
+{
+    qint64 size = -1;
+    QDateTime modified;
+    std::shared_ptr<const AssDocument> document;
+};
+
+QMutex& cacheMutex()
+{
+    static QMutex mutex;
+    return mutex;
+}
+
+QHash<QString, CacheEntry>& cache()
+{
+    static QHash<QString, CacheEntry> entries;
+    return entries;
+}
+
+QStringList& cacheOrder()
+{
+    static QStringList order;
+    return order;
+}
+} // namespace
+
+AssDocument AssDocument::fromData(const QByteArray& data)
+{
+    AssDocument doc;
+    if (data.startsWith("\xEF\xBB\xBF"))
+    {
+        doc.m_data = data.mid(3);
+    }
+    else if (data.startsWith("\xFF\xFE") || data.startsWith("\xFE\xFF"))
+    {
+        QStringDecoder decoder(data.startsWith("\xFF\xFE") ? QStringDecoder::Utf16LE : QStringDecoder::Utf16BE);
+        const QString text = decoder(QByteArrayView(data).mid(2));
+        doc.m_data = text.toUtf8();
+    }
+    else
+    {
+        doc.m_data = data;
+    }
+    doc.m_valid = true;
+    doc.parse();
+    return doc;
+}
+
+AssDocument AssDocument::fromFile(const QString& path, QString* errorString)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        if (errorString)
+        {
+            *errorString = file.errorString();
+        }
+        return {};
+    }
+    return fromData(file.readAll());
+}
+
+std::shared_ptr<const AssDocument> AssDocument::load(const QString& path)
+{
+    const QFileInfo info(path);
+    if (!info.exists())
+    {
+        return nullptr;
+    }
+    const QString key = info.absoluteFilePath();
+    const qint64 size = info.size();
+    const QDateTime modified = info.lastModified();
+
+    {
+        QMutexLocker locker(&cacheMutex());
+        const auto it = cache().constFind(key);
+        if (it != cache().constEnd() && it->size == size && it->modified == modified)
+        {
+            return it->document;
+        }
+    }
+
+    // Разбор вне блокировки: два потока могут разобрать один файл одновременно, результат одинаков
+    AssDocument parsed = fromFile(key);
+    if (!parsed.isValid())
+    {
+        return nullptr;
+    }
+    auto document = std::make_shared<const AssDocument>(std::move(parsed));
+
+    QMutexLocker locker(&cacheMutex());
+    cache().insert(key, {size, modified, document});
+    cacheOrder().removeAll(key);
+    cacheOrder().append(key);
+    while (cacheOrder().size() > kMaxCachedDocuments)
+    {
+        cache().remove(cacheOrder().takeFirst());
+    }
+    return document;
+}
+
+void AssDocument::invalidate(const QString& path)
+{
+    const QString key = QFileInfo(path).absoluteFilePath();
+    QMutexLocker locker(&cacheMutex());
+    cache().remove(key);
+    cacheOrder().removeAll(key);
+}
+
+void AssDocument::parse()
+{
+    const char* data = m_data.constData();
+    const qsizetype size = m_data.size();
+
+    qsizetype pos = 0;
+    while (pos < size)
+    {
+        qsizetype end = m_data.indexOf('\n', pos);
+        const qsizetype next = (end < 0) ? size : end + 1;
+        if (end < 0)
+        {
+            end = size;
+        }
+        if (end > pos && data[end - 1] == '\r')
+        {
+            --end;
+        }
+
+        Line line;
+        line.raw = {pos, end - pos};
+        line.section = m_sections.size() - 1;
+        const AssSpan trimmed = trimSpan(data, line.raw);
+
+        if (trimmed.length >= 2 && data[trimmed.offset] == '[' && data[trimmed.offset + trimmed.length - 1] == ']')
+        {
+            if (!m_sections.isEmpty())
+            {
+                m_sections.last().endLine = m_lines.size();
+            }
+            Section section;
+            section.name = QString::fromUtf8(data + trimmed.offset + 1, trimmed.length - 2).trimmed();
+            section.headerLine = m_lines.size();
+            m_sections.append(section);
+            line.kind = LineKind::SectionHeader;
+            line.section = m_sections.size() - 1;
+        }
+        else if (trimmed.length > 0 && data[trimmed.offset] != ';')
+        {
+            const qsizetype colon = QByteArrayView(data + trimmed.offset, trimmed.length).indexOf(':');
+            if (colon > 0)
+            {
+                const QByteArrayView key = QByteArrayView(data + trimmed.offset, colon).trimmed();
+                const qsizetype bodyStart = trimmed.offset + colon + 1;
+                AssSpan body = {bodyStart, line.raw.offset + line.raw.length - bodyStart};
+                while (body.length > 0 && isSpace(data[body.offset]))
+                {
+                    ++body.offset;
+                    --body.length;
+                }
+                line.body = body;
+
+                const QString sectionName = m_sections.isEmpty() ? QString() : m_sections.last().name;
+                const bool inStyles = sectionName.startsWith(QLatin1String("V4"), Qt::CaseInsensitive);
+                const bool inEvents = sectionName.compare(QLatin1String("Events"), Qt::CaseInsensitive) == 0;
+
+                if (equalsIgnoreCase(key, "Format"))
+                {
+                    line.kind = LineKind::Format;
+                    if (inStyles || inEvents)
+                    {
+                        applyFormat(line, inEvents);
+                    }
+                }
+                else if (inStyles && equalsIgnoreCase(key, "Style"))
+                {
+                    line.kind = LineKind::Style;
+                    Style style;
+                    style.line = m_lines.size();
+                    splitFields(data, body, m_styleFieldCount, style.fields);
+                    m_styles.append(style);
+                }
+                else if (inEvents && (equalsIgnoreCase(key, "Dialogue") || equalsIgnoreCase(key, "Comment")))
+                {
+                    const bool comment = equalsIgnoreCase(key, "Comment");
+                    line.kind = comment ? LineKind::Comment : LineKind::Dialogue;
+                    Event event;
+                    event.line = m_lines.size();
+                    event.comment = comment;
+                    splitFields(data, body, m_eventFieldCount, event.fields);
+                    m_events.append(event);
+                }
+            }
+        }
+
+        m_lines.append(line);
+        pos = next;
+    }
+
+    if (!m_sections.isEmpty())
+    {
+        m_sections.last().endLine = m_lines.size();
+    }
+}
+
+void AssDocument::applyFormat(const Line& line, bool events)
+{
+    QVarLengthArray<AssSpan, 24> names;
+    splitFields(m_data.constData(), line.body, INT_MAX, names);
+
+    auto indexOf = [&](std::initializer_list<const char*> aliases) -> int
+    {
+        for (int i = 0; i < names.size(); ++i)
+        {
+            const QByteArrayView name = view(names[i]).trimmed();
+            for (const char* alias : aliases)
+            {
+                if (equalsIgnoreCase(name, alias))
+                {
+                    return i;
+                }
+            }
+        }
+        return -1;
+    };
+
+    if (events)
+    {
+        m_eventFieldCount = names.size();
+        m_eventFieldIndex[static_cast<int>(EventField::Layer)] = indexOf({"Layer", "Marked"});
+        m_eventFieldIndex[static_cast<int>(EventField::Start)] = indexOf({"Start"});
+        m_eventFieldIndex[static_cast<int>(EventField::End)] = indexOf({"End"});
+        m_eventFieldIndex[static_cast<int>(EventField::Style)] = indexOf({"Style"});
+        m_eventFieldIndex[static_cast<int>(EventField::Name)] = indexOf({"Name", "Actor"});
+        m_eventFieldIndex[static_cast<int>(EventField::MarginL)] = indexOf({"MarginL"});
+        m_eventFieldIndex[static_cast<int>(EventField::MarginR)] = indexOf({"MarginR"});
+        m_eventFieldIndex[static_cast<int>(EventField::MarginV)] = indexOf({"MarginV"});
+        m_eventFieldIndex[static_cast<int>(EventField::Effect)] = indexOf({"Effect"});
+        m_eventFieldIndex[static_cast<int>(EventField::Text)] = indexOf({"Text"});
+    }
+    else
+    {
+        m_styleFieldCount = names.size();
+        m_styleFieldIndex[static_cast<int>(StyleField::Name)] = indexOf({"Name"});
+        m_styleFieldIndex[static_cast<int>(StyleField::Fontname)] = indexOf({"Fontname"});
+        m_styleFieldIndex[static_cast<int>(StyleField::Bold)] = indexOf({"Bold"});
+        m_styleFieldIndex[static_cast<int>(StyleField::Italic)] = indexOf({"Italic"});
+        m_styleFieldIndex[static_cast<int>(StyleField::Alignment)] = indexOf({"Alignment"});
+    }
+}
+
+int AssDocument::sectionIndex(const QString& name) const
+{
+    for (int i = 0; i < m_sections.size(); ++i)
+    {
+        if (m_sections.at(i).name.compare(name, Qt::CaseInsensitive) == 0)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int AssDocument::formatLine(int section) const
+{
+    if (section < 0 || section >= m_sections.size())
+    {
+        return -1;
+    }
+    const Section& s = m_sections.at(section);
+    for (int i = s.headerLine + 1; i < s.endLine; ++i)
+    {
+        if (m_lines.at(i).kind == LineKind::Format)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+QString AssDocument::scriptInfoValue(const QString& key) const
+{
+    const int section = sectionIndex(QStringLiteral("Script Info"));
+    if (section < 0)
+    {
+        return {};
+    }
+    const QByteArray keyBytes = key.toUtf8();
+    const Section& s = m_sections.at(section);
+    for (int i = s.headerLine + 1; i < s.endLine; ++i)
+    {
+        const Line& line = m_lines.at(i);
+        const QByteArrayView raw = view(line.raw).trimmed();
+        if (raw.size() > keyBytes.size() && raw.startsWith(keyBytes) && raw.at(keyBytes.size()) == ':')
+        {
+            return QString::fromUtf8(raw.mid(keyBytes.size() + 1).trimmed());
+        }
+    }
+    return {};
+}
+
+QByteArrayView AssDocument::eventFieldView(int eventIndex, EventField field) const
+{
+    const Event& event = m_events.at(eventIndex);
+    const int index = m_eventFieldIndex[static_cast<int>(field)];
+    if (index < 0 || index >= event.fields.size())
+    {
+        return {};
+    }
+    const QByteArrayView value = view(event.fields.at(index));
+    return field == EventField::Text ? value : value.trimmed();
+}
+
+QString AssDocument::eventField(int eventIndex, EventField field) const
+{
+    return QString::fromUtf8(eventFieldView(eventIndex, field));
+}
+
+QString AssDocument::styleField(int styleIndex, StyleField field) const
+{
+    const Style& style = m_styles.at(styleIndex);
+    const int index = m_styleFieldIndex[static_cast<int>(field)];
+    if (index < 0 || index >= style.fields.size())
+    {
+        return {};
+    }
+    return QString::fromUtf8(view(style.fields.at(index)).trimmed());
+}
+
+void AssDocument::setEventText(int eventIndex, const QString& text)
+{
+    setEventTextUtf8(eventIndex, text.toUtf8());
+}
+
+void AssDocument::setEventTextUtf8(int eventIndex, QByteArrayView text)
+{
+    const Event& event = m_events.at(eventIndex);
+    const int index = m_eventFieldIndex[static_cast<int>(EventField::Text)];
+    if (index < 0 || index >= event.fields.size())
+    {
+        return;
+    }
+    const AssSpan raw = m_lines.at(event.line).raw;
+    const AssSpan textSpan = event.fields.at(index);
+    QByteArray line = m_data.mid(raw.offset, textSpan.offset - raw.offset);
+    line += text;
+    m_lineOverrides.insert(event.line, line);
+}
+
+void AssDocument::setStyleField(int styleIndex, StyleField field, const QString& value)
+{
+    const Style& style = m_styles.at(styleIndex);
+    const int index = m_styleFieldIndex[static_cast<int>(field)];
+    if (index < 0 || index >= style.fields.size())
+    {
+        return;
+    }
+    // Поля стиля не содержат запятых, так что строку с прошлыми правками можно резать заново
+    const Line& line = m_lines.at(style.line);
+    QByteArray bytes = lineBytes(style.line);
+    const qsizetype bodyStart = line.body.offset - line.raw.offset;
+    QList<QByteArray> fields = bytes.mid(bodyStart).split(',');
+    if (index >= fields.size())
+    {
+        return;
+    }
+    fields[index] = value.toUtf8();
+    bytes.truncate(bodyStart);
+    bytes += fields.join(',');
+    m_lineOverrides.insert(style.line, bytes);
+}
+
+QByteArray AssDocument::lineBytes(int line) const
+{
+    const auto it = m_lineOverrides.constFind(line);
+    if (it != m_lineOverrides.constEnd())
+    {
+        return *it;
+    }
+    return view(m_lines.at(line).raw).toByteArray();
+}
+
+bool AssDocument::save(const QString& path) const
+{
+    QList<QByteArray> lines;
+    lines.reserve(m_lines.size());
+    for (int i = 0; i < m_lines.size(); ++i)
+    {
+        lines.append(lineBytes(i));
+    }
+    return writeLines(path, lines);
+}
+
+bool AssDocument::writeLines(const QString& path, const QList<QByteArray>& lines)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        return false;
+    }
+    QByteArray out("\xEF\xBB\xBF");
+    qsizetype total = out.size();
+    for (const QByteArray& line : lines)
+    {
+        total += line.size() + 1;
+    }
+    out.reserve(total);
+    for (const QByteArray& line : lines)
+    {
+        out += line;
+        out += '\n';
+    }
+    const bool ok = file.write(out) == out.size();
+    file.close();
+    invalidate(path);
+    return ok;
+}
@@ -0,0 +1,197 @@
+#ifndef ASSDOCUMENT_H
+#define ASSDOCUMENT_H
+
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <QVarLengthArray>
+
+#include <memory>
+
+/// Участок общего UTF-8 буфера документа.
+struct AssSpan
+{
+    qsizetype offset = 0;
+    qsizetype length = 0;
+};
+
+/**
+ * @brief Разобранный ASS-файл: один UTF-8 буфер + индексы строк, секций, стилей и событий.
+ *
+ * Файл читается и режется на строки/поля один раз; поля хранятся как смещения в буфере,
+ * поэтому обход 50k событий не создаёт временных QStringList. Правки событий хранятся отдельно
+ * и применяются при сериализации (lineBytes()/save()), исходный буфер не меняется.
+ */
+class AssDocument
+{
+public:
+    enum class LineKind
+    {
+        Other,
+        SectionHeader,
+        Format,
+        Style,
+        Dialogue,
+        Comment
+    };
+
+    enum class EventField
+    {
+        Layer,
+        Start,
+        End,
+        Style,
+        Name,
+        MarginL,
+        MarginR,
+        MarginV,
+        Effect,
+        Text,
+        Count
+    };
+
+    enum class StyleField
+    {
+        Name,
+        Fontname,
+        Bold,
+        Italic,
+        Alignment,
+        Count
+    };
+
+    struct Line
+    {
+        LineKind kind = LineKind::Other;
+        int section = -1;
+        AssSpan raw;  // строка целиком, без \r\n
+        AssSpan body; // значение после "Key:" без ведущих пробелов
+    };
+
+    struct Section
+    {
+        QString name; // без скобок, например "V4+ Styles"
+        int headerLine = -1;
+        int endLine = -1; // первая строка после секции
+    };
+
+    struct Event
+    {
+        int line = -1;
+        bool comment = false;
+        QVarLengthArray<AssSpan, 10> fields; // в порядке Format секции [Events]; последнее поле — до конца строки
+    };
+
+    struct Style
+    {
+        int line = -1;
+        QVarLengthArray<AssSpan, 23> fields;
+    };
+
+    AssDocument() = default;
+
+    /// Разбор из памяти. UTF-8 (с BOM или без); UTF-16 с BOM перекодируется в UTF-8.
+    static AssDocument fromData(const QByteArray& data);
+    static AssDocument fromFile(const QString& path, QString* errorString = nullptr);
+
+    /// Общий кэш разобранных файлов (ключ — путь + размер + mtime): разные этапы одного прогона
+    /// получают один и тот же разбор. nullptr, если файл не открылся.
+    static std::shared_ptr<const AssDocument> load(const QString& path);
+    static void invalidate(const QString& path);
+
+    bool isValid() const
+    {
+        return m_valid;
+    }
+
+    const QByteArray& buffer() const
+    {
+        return m_data;
+    }
+    QByteArrayView view(AssSpan span) const
+    {
+        return QByteArrayView(m_data.constData() + span.offset, span.length);
+    }
+    QString string(AssSpan span) const
+    {
+        return QString::fromUtf8(view(span));
+    }
+
+    const QList<Line>& lines() const
+    {
+        return m_lines;
+    }
+    const QList<Section>& sections() const
+    {
+        return m_sections;
+    }
+    const QList<Style>& styles() const
+    {
+        return m_styles;
+    }
+    const QList<Event>& events() const
+    {
+        return m_events;
+    }
+
+    /// Индекс секции по имени без скобок (без учёта регистра), -1 если нет.
+    int sectionIndex(const QString& name) const;
+    /// Строка Format: секции или -1.
+    int formatLine(int section) const;
+    /// Значение ключа из [Script Info], например "PlayResX".
+    QString scriptInfoValue(const QString& key) const;
+
+    /// Поле события (без крайних пробелов, кроме Text); пустой view, если поля нет в Format.
+    QByteArrayView eventFieldView(int eventIndex, EventField field) const;
+    /// Все поля из Format на месте (в строке не меньше запятых, чем нужно).
+    bool isEventComplete(int eventIndex) const
+    {
+        return m_events.at(eventIndex).fields.size() == m_eventFieldCount;
+    }
+    QString eventField(int eventIndex, EventField field) const;
+    QString styleField(int styleIndex, StyleField field) const;
+
+    /// Правка текста события; сериализуется вместо исходной строки.
+    void setEventText(int eventIndex, const QString& text);
+    void setEventTextUtf8(int eventIndex, QByteArrayView text);
+    /// Правка поля стиля; правки разных полей одного стиля накапливаются.
+    void setStyleField(int styleIndex, StyleField field, const QString& value);
+    bool isLineModified(int line) const
+    {
+        return m_lineOverrides.contains(line);
+    }
+
+    /// Строка с учётом правок (UTF-8, без перевода строки).
+    QByteArray lineBytes(int line) const;
+    QString lineText(int line) const
+    {
+        return QString::fromUtf8(lineBytes(line));
+    }
+
+    /// Весь документ с учётом правок.
+    bool save(const QString& path) const;
+
+    /// Единый сериализатор ASS: UTF-8 с BOM, строки через "\n".
+    static bool writeLines(const QString& path, const QList<QByteArray>& lines);
+
+private:
+    void parse();
+    void applyFormat(const Line& line, bool events);
+
+    QByteArray m_data;
+    bool m_valid = false;
+    QList<Line> m_lines;
+    QList<Section> m_sections;
+    QList<Style> m_styles;
+    QList<Event> m_events;
+    int m_eventFieldIndex[static_cast<int>(EventField::Count)] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+    int m_eventFieldCount = 10;
+    int m_styleFieldIndex[static_cast<int>(StyleField::Count)] = {0, 1, 7, 8, 18};
+    int m_styleFieldCount = 23;
+    QHash<int, QByteArray> m_lineOverrides;
+};
+
+#endif // ASSDOCUMENT_H
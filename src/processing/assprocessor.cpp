@@ -1,14 +1,15 @@
 ﻿#include "assprocessor.h"
 
 #include "appsettings.h"
+#include "assdocument.h"
+#include "asstexttokenizer.h"
+#include "asstime.h"
+#include "substitutionmatcher.h"
 
 #include <QDate>
 #include <QFile>
 #include <QFileInfo>
 #include <QMap>
-#include <QRegularExpression>
-#include <QTextStream>
-#include <QTime>
 #include <algorithm>
 
 static QMap<QChar, double> createCharWidthsMap()
@@ -189,19 +190,58 @@ static double getVisualLength(const QString& text)
 
 static bool writeAssFile(const QString& path, const QStringList& lines)
 {
-    QFile file(path);
-    if (!file.open(QIODevice::WriteOnly))
+    QList<QByteArray> bytes;
+    bytes.reserve(lines.size());
+    for (const QString& line : lines)
     {
-        return false;
+        bytes.append(line.toUtf8());
     }
-    QTextStream out(&file);
-    out.setEncoding(QStringConverter::Utf8);
-    out.setGenerateByteOrderMark(true);
+    return AssDocument::writeLines(path, bytes);
+}
+
+static void appendLines(QList<QByteArray>& out, const QStringList& lines)
+{
     for (const QString& line : lines)
     {
-        out << line << "\n";
+        out.append(line.toUtf8());
+    }
+}
+
+static bool isSignEvent(const AssDocument& doc, int eventIndex, const QStringList& signStyles,
+                        Qt::CaseSensitivity cs = Qt::CaseInsensitive)
+{
+    return signStyles.contains(doc.eventField(eventIndex, AssDocument::EventField::Style), cs) ||
+           signStyles.contains(doc.eventField(eventIndex, AssDocument::EventField::Name), cs);
+}
+
+// Строки документа до Format: секции [Events] включительно (или до самого заголовка, если Format нет),
+// со стилем ТБ сразу после Format: секции стилей. Возвращает false, если [Events] не найдена.
+static bool collectHeaderLines(const AssDocument& doc, const QString& tbStyleLine, QList<QByteArray>& headers,
+                               int& firstEventLine, bool* tbStyleInserted = nullptr)
+{
+    const int eventsSection = doc.sectionIndex(QStringLiteral("Events"));
+    if (eventsSection < 0)
+    {
+        return false;
+    }
+    const int eventsFormat = doc.formatLine(eventsSection);
+    const int headerEnd = eventsFormat >= 0 ? eventsFormat : doc.sections().at(eventsSection).headerLine;
+    const int stylesFormat = doc.formatLine(doc.sectionIndex(QStringLiteral("V4+ Styles")));
+
+    headers.reserve(headerEnd + 2);
+    for (int i = 0; i <= headerEnd; ++i)
+    {
+        headers.append(doc.lineBytes(i));
+        if (i == stylesFormat)
+        {
+            headers.append(tbStyleLine.toUtf8());
+        }
+    }
+    if (tbStyleInserted)
+    {
+        *tbStyleInserted = stylesFormat >= 0 && stylesFormat <= headerEnd;
     }
-    file.close();
+    firstEventLine = headerEnd + 1;
     return true;
 }
 
@@ -214,28 +254,14 @@ bool AssProcessor::processExistingFile(const QString& inputPath, const QString&
 {
     emit logMessage("Начало обработки файла субтитров: " + inputPath, LogCategory::APP);
 
-    QFile inputFile(inputPath);
-    if (!inputFile.open(QIODevice::ReadOnly))
+    const std::shared_ptr<const AssDocument> doc = AssDocument::load(inputPath);
+    if (!doc)
     {
         emit logMessage("Ошибка: не удалось открыть для чтения файл " + inputPath, LogCategory::APP, LogLevel::Error);
         return false;
     }
 
-    QTextStream in(&inputFile);
-    in.setEncoding(QStringConverter::Utf8);
-    int playResX = 0;
-    QStringList originalLines;
-    while (!in.atEnd())
-    {
-        QString line = in.readLine();
-        originalLines << line;
-        if (line.startsWith("PlayResX:"))
-        {
-            playResX = line.split(':').last().trimmed().toInt();
-        }
-    }
-    inputFile.close();
-
+    const int playResX = doc->scriptInfoValue("PlayResX").toInt();
     if (playResX == 0)
     {
         emit logMessage("Предупреждение: не удалось определить PlayResX. Будет использован стиль по умолчанию.",
@@ -246,73 +272,44 @@ bool AssProcessor::processExistingFile(const QString& inputPath, const QString&
         emit logMessage(QString("Определено разрешение субтитров: %1px по ширине.").arg(playResX), LogCategory::APP);
     }
 
-    int eventsIndex = -1;
-    for (int i = 0; i < originalLines.size(); ++i)
-    {
-        if (originalLines[i].trimmed() == "[Events]")
-        {
-            eventsIndex = i;
-            break;
-        }
-    }
-    if (eventsIndex == -1)
+    QList<QByteArray> headers;
+    int firstEventLine = 0;
+    const QString tbStyle =
+        "Style: ТБ,Arial,20,&H00FFFFFF,&H000000FF,&H00000000,&H00000000,0,0,0,0,100,100,0,0,1,2,2,2,10,10,10,1";
+    if (!collectHeaderLines(*doc, tbStyle, headers, firstEventLine))
     {
         emit logMessage("Критическая ошибка: секция [Events] не найдена в файле субтитров.", LogCategory::APP,
                         LogLevel::Error);
         return false;
     }
-    // +2 чтобы захватить и [Events] и строку Format:
-    QStringList headers = originalLines.mid(0, eventsIndex + 2);
-    QStringList events = originalLines.mid(eventsIndex + 2);
-
-    QStringList tbLines = generateTb(t, startTime, playResX);
 
-    int styleFormatIndex = -1;
-    for (int i = 0; i < headers.size(); ++i)
-    {
-        if (headers[i].trimmed().startsWith("Format:", Qt::CaseInsensitive) &&
-            headers[i - 1].trimmed() == "[V4+ Styles]")
-        {
-            styleFormatIndex = i;
-            break;
-        }
-    }
-    if (styleFormatIndex != -1)
-    {
-        headers.insert(
-            styleFormatIndex + 1,
-            "Style: ТБ,Arial,20,&H00FFFFFF,&H000000FF,&H00000000,&H00000000,0,0,0,0,100,100,0,0,1,2,2,2,10,10,10,1");
-    }
+    const QStringList tbLines = generateTb(t, startTime, playResX);
 
-    QStringList fullSubsEvents, signsOnlyEvents;
-    for (const QString& line : events)
+    QList<QByteArray> fullSubs = headers;
+    QList<QByteArray> signsOnly = headers;
+    for (int i = 0; i < doc->events().size(); ++i)
     {
-        if (!line.startsWith("Dialogue:"))
+        const AssDocument::Event& event = doc->events().at(i);
+        if (event.comment || event.line < firstEventLine || !doc->isEventComplete(i))
             continue;
-        QStringList parts = line.split(',');
-        if (parts.size() < 10)
-            continue;
-        QString style = parts[3].trimmed();
-        QString actor = parts[4].trimmed();
-        if (t.signStyles.contains(style, Qt::CaseInsensitive) || t.signStyles.contains(actor, Qt::CaseInsensitive))
-        {
-            fullSubsEvents.append(line);
-            signsOnlyEvents.append(line);
-        }
-        else
+        const QByteArray line = doc->lineBytes(event.line);
+        fullSubs.append(line);
+        if (isSignEvent(*doc, i, t.signStyles))
         {
-            fullSubsEvents.append(line);
+            signsOnly.append(line);
         }
     }
+    appendLines(fullSubs, tbLines);
+    appendLines(signsOnly, tbLines);
 
-    if (!writeAssFile(outputPathBase + "_full.ass", headers + fullSubsEvents + tbLines))
+    if (!AssDocument::writeLines(outputPathBase + "_full.ass", fullSubs))
     {
         emit logMessage("Ошибка записи в файл: " + outputPathBase + "_full.ass", LogCategory::APP, LogLevel::Error);
         return false;
     }
     emit logMessage("Создан файл с полными субтитрами: " + outputPathBase + "_full.ass", LogCategory::APP);
 
-    if (!writeAssFile(outputPathBase + "_signs.ass", headers + signsOnlyEvents + tbLines))
+    if (!AssDocument::writeLines(outputPathBase + "_signs.ass", signsOnly))
     {
         emit logMessage("Ошибка записи в файл: " + outputPathBase + "_signs.ass", LogCategory::APP, LogLevel::Error);
         return false;
@@ -450,121 +447,107 @@ QString AssProcessor::balanceCastLine(const QStringList& actors, bool shouldSort
 
 TbSegment AssProcessor::detectTbSegmentFromFile(const QString& assPath)
 {
-    auto parseAssTimeToSeconds = [](const QString& raw, double& secondsOut) -> bool
+    TbSegment segment;
+    const std::shared_ptr<const AssDocument> doc = AssDocument::load(assPath);
+    if (!doc)
     {
-        // ASS timestamps are usually h:mm:ss.cc (centiseconds), but sometimes come as h:mm:ss.zzz.
-        const QString value = raw.trimmed();
-        const QStringList hms = value.split(':');
-        if (hms.size() != 3)
-        {
-            return false;
-        }
+        return segment;
+    }
 
-        bool okH = false;
-        bool okM = false;
-        int hours = hms[0].toInt(&okH);
-        int minutes = hms[1].toInt(&okM);
-        if (!okH || !okM)
+    for (int i = 0; i < doc->events().size(); ++i)
+    {
+        if (doc->events().at(i).comment)
         {
-            return false;
+            continue;
         }
 
-        const QStringList secParts = hms[2].split('.');
-        if (secParts.isEmpty())
+        const AssTime start = AssTime::parse(doc->eventFieldView(i, AssDocument::EventField::Start));
+        const AssTime end = AssTime::parse(doc->eventFieldView(i, AssDocument::EventField::End));
+        if (!start.isValid() || !end.isValid())
         {
-            return false;
+            continue;
         }
+        const double startS = start.seconds();
+        const double endS = end.seconds();
 
-        bool okS = false;
-        int wholeSeconds = secParts[0].toInt(&okS);
-        if (!okS)
+        if (!segment.isValid())
         {
-            return false;
+            segment.startSeconds = startS;
+            segment.endSeconds = endS;
         }
-
-        double fractional = 0.0;
-        if (secParts.size() > 1)
+        else
         {
-            QString fraction = secParts[1].left(3);
-            while (fraction.size() < 3)
+            if (startS < segment.startSeconds)
             {
-                fraction.append('0');
+                segment.startSeconds = startS;
             }
-            bool okMs = false;
-            int ms = fraction.toInt(&okMs);
-            if (!okMs)
+            if (endS > segment.endSeconds)
             {
-                return false;
+                segment.endSeconds = endS;
             }
-            fractional = static_cast<double>(ms) / 1000.0;
         }
+    }
 
-        secondsOut = static_cast<double>(hours) * 3600.0 + static_cast<double>(minutes) * 60.0 +
-                     static_cast<double>(wholeSeconds) + fractional;
-        return true;
-    };
+    return segment;
+}
 
-    TbSegment segment;
-    QFile file(assPath);
-    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+QList<TbSegment> AssProcessor::detectActiveIntervalsFromFile(const QString& assPath, double mergeGapS)
+{
+    // libass рисует событие только в [Start, End): \fad/\fade/\move/\t не выводят его за End,
+    // поэтому хвосты затуханий уже внутри границ события. Запас в кадр с каждой стороны — на округление pts.
+    constexpr double kPaddingS = 0.05;
+
+    QList<TbSegment> spans;
+    const std::shared_ptr<const AssDocument> doc = AssDocument::load(assPath);
+    if (!doc)
     {
-        return segment;
+        return spans;
     }
 
-    QTextStream in(&file);
-    in.setEncoding(QStringConverter::Utf8);
-
-    bool inEvents = false;
-    while (!in.atEnd())
+    for (int i = 0; i < doc->events().size(); ++i)
     {
-        const QString line = in.readLine();
-        if (line.trimmed().compare("[Events]", Qt::CaseInsensitive) == 0)
-        {
-            inEvents = true;
-            continue;
-        }
-        if (!inEvents)
-        {
-            continue;
-        }
-        if (!line.startsWith("Dialogue:", Qt::CaseInsensitive))
+        if (doc->events().at(i).comment)
         {
             continue;
         }
 
-        QString rest = line.mid(QStringLiteral("Dialogue:").length());
-        QStringList parts = rest.split(',');
-        if (parts.size() < 3)
+        const AssTime start = AssTime::parse(doc->eventFieldView(i, AssDocument::EventField::Start));
+        const AssTime end = AssTime::parse(doc->eventFieldView(i, AssDocument::EventField::End));
+        if (!start.isValid() || !end.isValid() || !(start < end))
         {
             continue;
         }
+        const double startS = start.seconds();
+        const double endS = end.seconds();
 
-        double startS = 0.0;
-        double endS = 0.0;
-        if (!parseAssTimeToSeconds(parts[1], startS) || !parseAssTimeToSeconds(parts[2], endS))
+        // Строки из одних тегов и переносов ничего не рисуют; векторные рисунки (\p1) остаются текстом
+        if (!AssTextTokenizer::hasVisibleText(doc->eventField(i, AssDocument::EventField::Text)))
         {
             continue;
         }
 
-        if (!segment.isValid())
+        TbSegment span;
+        span.startSeconds = qMax(0.0, startS - kPaddingS);
+        span.endSeconds = endS + kPaddingS;
+        spans.append(span);
+    }
+
+    std::sort(spans.begin(), spans.end(),
+              [](const TbSegment& a, const TbSegment& b) { return a.startSeconds < b.startSeconds; });
+
+    QList<TbSegment> merged;
+    for (const TbSegment& span : std::as_const(spans))
+    {
+        if (!merged.isEmpty() && span.startSeconds <= merged.last().endSeconds + mergeGapS)
         {
-            segment.startSeconds = startS;
-            segment.endSeconds = endS;
+            merged.last().endSeconds = qMax(merged.last().endSeconds, span.endSeconds);
         }
         else
         {
-            if (startS < segment.startSeconds)
-            {
-                segment.startSeconds = startS;
-            }
-            if (endS > segment.endSeconds)
-            {
-                segment.endSeconds = endS;
-            }
+            merged.append(span);
         }
     }
-
-    return segment;
+    return merged;
 }
 
 QStringList AssProcessor::generateTb(const ReleaseTemplate& t, const QString& startTime, int detectedResX)
@@ -583,7 +566,7 @@ QStringList AssProcessor::generateTb(const ReleaseTemplate& t, const QString& st
         return tbLines;
     }
 
-    QTime currentTime = QTime::fromString(startTime, "H:mm:ss.zzz");
+    AssTime currentTime = AssTime::parse(startTime.toLatin1());
 
     if (!currentTime.isValid())
     {
@@ -636,11 +619,9 @@ QStringList AssProcessor::generateTb(const ReleaseTemplate& t, const QString& st
 
     auto generateDialogueLine = [&](const QString& text)
     {
-        QTime endTime = currentTime.addSecs(3);
-        QString startTimeStr =
-            currentTime.toString("H:mm:ss") + "." + QString::number(currentTime.msec() / 10).rightJustified(2, '0');
-        QString endTimeStr =
-            endTime.toString("H:mm:ss") + "." + QString::number(endTime.msec() / 10).rightJustified(2, '0');
+        const AssTime endTime(currentTime.ms + 3000);
+        const QString startTimeStr = QString::fromLatin1(currentTime.toAss());
+        const QString endTimeStr = QString::fromLatin1(endTime.toAss());
         currentTime = endTime;
 
         return QString("Dialogue: 0,%1,%2,ТБ,НАДПИСЬ,%3,%4,%5,,%6%7")
@@ -774,50 +755,28 @@ bool AssProcessor::addTbToFile(const QString& inputPath, const QString& outputPa
 {
     emit logMessage("Обработка файла, содержащего только надписи: " + inputPath, LogCategory::APP);
 
-    QFile inputFile(inputPath);
-    if (!inputFile.open(QIODevice::ReadOnly))
+    const std::shared_ptr<const AssDocument> doc = AssDocument::load(inputPath);
+    if (!doc)
     {
         emit logMessage("Ошибка: не удалось открыть для чтения файл " + inputPath, LogCategory::APP, LogLevel::Error);
         return false;
     }
-    QTextStream in(&inputFile);
-    in.setEncoding(QStringConverter::Utf8);
-    QStringList originalLines = in.readAll().split('\n');
-    inputFile.close();
-    int eventsIndex = -1;
-    for (int i = 0; i < originalLines.size(); ++i)
-    {
-        if (originalLines[i].trimmed() == "[Events]")
-        {
-            eventsIndex = i;
-            break;
-        }
-    }
-    if (eventsIndex == -1)
-    {
-        return false;
-    }
 
-    QStringList headers = originalLines.mid(0, eventsIndex + 2);
-    QStringList events = originalLines.mid(eventsIndex + 2);
-    QStringList tbLines = generateTb(t, startTime, 0);
-    int styleFormatIndex = -1;
-    for (int i = 0; i < headers.size(); ++i)
+    QList<QByteArray> lines;
+    int firstEventLine = 0;
+    const QString tbStyle =
+        "Style: ТБ,Tahoma,20,&H00FFFFFF,&H000000FF,&H00000000,&H00000000,-1,0,0,0,100,100,0,0,1,2,2,2,10,10,10,1";
+    if (!collectHeaderLines(*doc, tbStyle, lines, firstEventLine))
     {
-        if (headers[i].trimmed().startsWith("Format:", Qt::CaseInsensitive) &&
-            headers[i - 1].trimmed() == "[V4+ Styles]")
-        {
-            styleFormatIndex = i;
-            break;
-        }
+        return false;
     }
-    if (styleFormatIndex != -1)
+    for (int i = firstEventLine; i < doc->lines().size(); ++i)
     {
-        headers.insert(
-            styleFormatIndex + 1,
-            "Style: ТБ,Tahoma,20,&H00FFFFFF,&H000000FF,&H00000000,&H00000000,-1,0,0,0,100,100,0,0,1,2,2,2,10,10,10,1");
+        lines.append(doc->lineBytes(i));
     }
-    if (!writeAssFile(outputPath, headers + events + tbLines))
+    appendLines(lines, generateTb(t, startTime, 0));
+
+    if (!AssDocument::writeLines(outputPath, lines))
     {
         emit logMessage("Ошибка записи в файл: " + outputPath, LogCategory::APP, LogLevel::Error);
         return false;
@@ -835,68 +794,13 @@ bool AssProcessor::processFromTwoSources(const QString& subsInputPath, const QSt
                         .arg(QFileInfo(signsInputPath).fileName()),
                     LogCategory::APP);
 
-    // 1. Читаем файл с диалогами для заголовков и разрешения
-    QFile subsFile(subsInputPath);
-    if (!subsFile.open(QIODevice::ReadOnly))
-        return false;
-    QTextStream inDialogues(&subsFile);
-    inDialogues.setEncoding(QStringConverter::Utf8);
-
-    int playResX = 0;
-    int playResXSigns = 0;
-    QStringList headers;
-    QStringList fullSubsEvents;
-    bool inEvents = false;
-
-    while (!inDialogues.atEnd())
-    {
-        QString line = inDialogues.readLine();
-        if (line.startsWith("PlayResX:"))
-            playResX = line.split(':').last().trimmed().toInt();
-        if (line.trimmed() == "[Events]")
-            inEvents = true;
-
-        if (!inEvents || !line.startsWith("Dialogue:"))
-        {
-            headers << line;
-        }
-        else
-        {
-            // Берем только строки, которые НЕ являются надписями
-            QStringList parts = line.split(',');
-            if (parts.size() < 5)
-                continue;
-            if (!t.signStyles.contains(parts[3].trimmed()) && !t.signStyles.contains(parts[4].trimmed()))
-            {
-                fullSubsEvents.append(line);
-            }
-        }
-    }
-    subsFile.close();
-
-    // 2. Читаем файл с надписями
-    QFile signsFile(signsInputPath);
-    if (!signsFile.open(QIODevice::ReadOnly))
+    const std::shared_ptr<const AssDocument> subsDoc = AssDocument::load(subsInputPath);
+    const std::shared_ptr<const AssDocument> signsDoc = AssDocument::load(signsInputPath);
+    if (!subsDoc || !signsDoc)
         return false;
-    QTextStream inSigns(&signsFile);
-    inSigns.setEncoding(QStringConverter::Utf8);
-    QStringList signsOnlyEvents;
-    inEvents = false;
-    while (!inSigns.atEnd())
-    {
-        QString line = inSigns.readLine();
-        if (line.startsWith("PlayResX:"))
-            playResXSigns = line.split(':').last().trimmed().toInt();
-        if (line.trimmed() == "[Events]")
-            inEvents = true;
-        if (inEvents && line.startsWith("Dialogue:"))
-        {
-            fullSubsEvents.append(line);
-            signsOnlyEvents.append(line);
-        }
-    }
-    signsFile.close();
 
+    const int playResX = subsDoc->scriptInfoValue("PlayResX").toInt();
+    const int playResXSigns = signsDoc->scriptInfoValue("PlayResX").toInt();
     if (playResX != playResXSigns)
         emit logMessage(QString("PlayResX из субтитров и надписей не совпадают, отображение надписей может быть "
                                 "некорректным: Субтитры %1 px, надписи %2 px ")
@@ -904,41 +808,52 @@ bool AssProcessor::processFromTwoSources(const QString& subsInputPath, const QSt
                             .arg(playResXSigns),
                         LogCategory::APP);
 
-    // 3. Генерируем ТБ и вставляем стиль
-    QStringList tbLines = generateTb(t, startTime, playResX);
-    int styleFormatIndex = -1;
-    // Ищем строку "Format: " в секции "[V4+ Styles]"
-    for (int i = 0; i < headers.size(); ++i)
+    // 1. Заголовки — всё из файла диалогов, кроме самих Dialogue; стиль ТБ — сразу после Format: секции стилей
+    const int stylesFormat = subsDoc->formatLine(subsDoc->sectionIndex(QStringLiteral("V4+ Styles")));
+    if (stylesFormat < 0)
+    {
+        emit logMessage("Предупреждение: не удалось найти секцию [V4+ Styles] для добавления стиля ТБ.",
+                        LogCategory::APP, LogLevel::Warning);
+    }
+    QList<QByteArray> headers;
+    for (int i = 0; i < subsDoc->lines().size(); ++i)
     {
-        if (headers[i].trimmed().startsWith("Format:", Qt::CaseInsensitive))
+        if (subsDoc->lines().at(i).kind == AssDocument::LineKind::Dialogue)
+            continue;
+        headers.append(subsDoc->lineBytes(i));
+        if (i == stylesFormat)
         {
-            // Убеждаемся, что предыдущая строка - это заголовок секции
-            if (i > 0 && headers[i - 1].trimmed() == "[V4+ Styles]")
-            {
-                styleFormatIndex = i;
-                break;
-            }
+            headers.append(QStringLiteral("Style: ТБ,Tahoma,20,&H00FFFFFF,&H000000FF,&H00000000,&H00000000,-1,0,0,0,"
+                                          "100,100,0,0,1,2,2,2,10,10,10,1")
+                               .toUtf8());
         }
     }
 
-    // Если нашли, куда вставлять, то вставляем
-    if (styleFormatIndex != -1)
+    // 2. Диалоги без надписей + все события файла надписей
+    QList<QByteArray> fullSubs = headers;
+    QList<QByteArray> signsOnly = headers;
+    for (int i = 0; i < subsDoc->events().size(); ++i)
     {
-        headers.insert(
-            styleFormatIndex + 1,
-            "Style: ТБ,Tahoma,20,&H00FFFFFF,&H000000FF,&H00000000,&H00000000,-1,0,0,0,100,100,0,0,1,2,2,2,10,10,10,1");
+        if (!subsDoc->events().at(i).comment && !isSignEvent(*subsDoc, i, t.signStyles, Qt::CaseSensitive))
+        {
+            fullSubs.append(subsDoc->lineBytes(subsDoc->events().at(i).line));
+        }
     }
-    else
+    for (int i = 0; i < signsDoc->events().size(); ++i)
     {
-        // Если по какой-то причине секция стилей не найдена, это может быть проблемой,
-        // но мы можем попробовать добавить ее целиком. Однако лучше просто выдать предупреждение.
-        emit logMessage("Предупреждение: не удалось найти секцию [V4+ Styles] для добавления стиля ТБ.",
-                        LogCategory::APP, LogLevel::Warning);
+        if (signsDoc->events().at(i).comment)
+            continue;
+        const QByteArray line = signsDoc->lineBytes(signsDoc->events().at(i).line);
+        fullSubs.append(line);
+        signsOnly.append(line);
     }
 
-    // 4. Записываем файлы
-    writeAssFile(outputPathBase + "_full.ass", headers + fullSubsEvents + tbLines);
-    writeAssFile(outputPathBase + "_signs.ass", headers + signsOnlyEvents + tbLines);
+    // 3. ТБ и запись
+    const QStringList tbLines = generateTb(t, startTime, playResX);
+    appendLines(fullSubs, tbLines);
+    appendLines(signsOnly, tbLines);
+    AssDocument::writeLines(outputPathBase + "_full.ass", fullSubs);
+    AssDocument::writeLines(outputPathBase + "_signs.ass", signsOnly);
 
     return true;
 }
@@ -946,55 +861,50 @@ bool AssProcessor::processFromTwoSources(const QString& subsInputPath, const QSt
 QString AssProcessor::convertAssTagsToSrt(const QString& assText)
 {
     QString result;
-    QString text = assText;
+    result.reserve(assText.size());
 
-    // Regex для поиска всех блоков с тегами
-    QRegularExpression tagBlockRegex(R"(\{[^\}]+\})");
-
-    qsizetype lastPos = 0;
-    auto it = tagBlockRegex.globalMatch(text);
-
-    while (it.hasNext())
+    AssTextTokenizer tokenizer(assText);
+    AssTextToken token;
+    while (tokenizer.next(token))
     {
-        auto match = it.next();
-        // Добавляем обычный текст, который был перед тегом
-        result.append(text.mid(lastPos, match.capturedStart() - lastPos));
-        lastPos = match.capturedEnd();
-
-        // Обрабатываем содержимое блока тегов
-        QString blockContent = match.captured(0);
-        blockContent = blockContent.mid(1, blockContent.length() - 2); // убираем {}
-
-        // Блок может содержать несколько тегов, например {\i1\b1\fs30}
-        QStringList tags = blockContent.split('\\', Qt::SkipEmptyParts);
-
-        for (const QString& tag : tags)
+        switch (token.kind)
+        {
+        case AssTextToken::Kind::Text:
+            result.append(token.text);
+            break;
+        case AssTextToken::Kind::LineBreak:
+            // Тег \N заменяется на стандартный перенос строки
+            result.append(u'\n');
+            break;
+        case AssTextToken::Kind::Tag:
         {
-            if (tag == "i1")
+            const QStringView tag = token.text;
+            if (tag == u"i1")
                 result.append("<i>");
-            else if (tag == "i0")
+            else if (tag == u"i0")
                 result.append("</i>");
-            else if (tag == "b1")
+            else if (tag == u"b1")
                 result.append("<b>");
-            else if (tag == "b0")
+            else if (tag == u"b0")
                 result.append("</b>");
-            else if (tag == "u1")
+            else if (tag == u"u1")
                 result.append("<u>");
-            else if (tag == "u0")
+            else if (tag == u"u0")
                 result.append("</u>");
-            else if (tag.startsWith("an") && tag.length() == 3 && tag[2].isDigit() && tag[2] != '0' && tag[2] != '2')
+            else if (tag.startsWith(u"an") && tag.size() == 3 && tag.at(2).isDigit() && tag.at(2) != u'0' &&
+                     tag.at(2) != u'2')
             {
                 // Восстанавливаем оригинальный тег для SRT
-                result.append("{\\" + tag + "}");
+                result.append(u"{\\").append(tag).append(u'}');
             }
             // Все остальные теги (fs, fn, c, fad, и т.д.) просто игнорируются
+            break;
+        }
+        case AssTextToken::Kind::BlockStart:
+        case AssTextToken::Kind::BlockEnd:
+            break;
         }
     }
-    // Добавляем оставшийся текст после последнего тега
-    result.append(text.mid(lastPos));
-
-    // Тег \N обрабатывается отдельно и заменяется на стандартный перенос строки
-    result.replace(QRegularExpression(R"(\\[Nn])"), "\n");
 
     return result;
 }
@@ -1004,133 +914,63 @@ bool AssProcessor::convertToSrt(const QString& inputAssPath, const QString& outp
 {
     emit logMessage("Конвертация в SRT: " + QFileInfo(inputAssPath).fileName(), LogCategory::APP);
 
-    QFile inputFile(inputAssPath);
-    if (!inputFile.open(QIODevice::ReadOnly))
+    const std::shared_ptr<const AssDocument> doc = AssDocument::load(inputAssPath);
+    if (!doc)
         return false;
 
-    QFile outputFile(outputSrtPath);
-    if (!outputFile.open(QIODevice::WriteOnly))
-        return false;
-
-    QTextStream in(&inputFile);
-    in.setEncoding(QStringConverter::Utf8);
-    QTextStream out(&outputFile);
-    out.setEncoding(QStringConverter::Utf8);
-    out.setGenerateByteOrderMark(true);
-
     QMap<QString, QPair<QString, QString>> styleInfo; // Карта "Имя стиля" -> "SRT тег, тег \an"
-    bool inStylesSection = false;
-
-    while (!in.atEnd())
+    for (int i = 0; i < doc->styles().size(); ++i)
     {
-        QString line = in.readLine();
-        if (line.trimmed() == "[V4+ Styles]")
-        {
-            inStylesSection = true;
+        // Формат v4+ имеет 23 поля, но Alignment - 19-е
+        const QString alignmentField = doc->styleField(i, AssDocument::StyleField::Alignment);
+        if (alignmentField.isEmpty())
             continue;
-        }
-        if (inStylesSection && (line.trimmed().isEmpty() || line.startsWith("[")))
-        {
-            break;
-        }
 
-        if (inStylesSection && line.startsWith("Style:"))
+        // Теги форматирования (жирный, курсив)
+        bool isItalic = (doc->styleField(i, AssDocument::StyleField::Italic) == "-1");
+        bool isBold = (doc->styleField(i, AssDocument::StyleField::Bold) == "-1");
+        QString formatTags;
+        if (isBold)
+            formatTags += "<b>";
+        if (isItalic)
+            formatTags += "<i>";
+
+        // Тег выравнивания
+        int alignment = alignmentField.toInt();
+        QString alignmentTag;
+        if (alignment != 0 && alignment != 2)
         {
-            // Используем split с KeepEmptyParts, чтобы не сдвигались индексы
-            QStringList parts = line.split(',', Qt::KeepEmptyParts);
-            // Формат v4+ имеет 23 поля, но Alignment - 19-е (индекс 18)
-            if (parts.size() < 19)
-                continue;
-
-            QString styleName = parts[0].split(':').last().trimmed();
-
-            // Теги форматирования (жирный, курсив)
-            bool isItalic = (parts[8].trimmed() == "-1");
-            bool isBold = (parts[7].trimmed() == "-1");
-            QString formatTags;
-            if (isBold)
-                formatTags += "<b>";
-            if (isItalic)
-                formatTags += "<i>";
-
-            // Тег выравнивания
-            int alignment = parts[18].trimmed().toInt();
-            QString alignmentTag;
-            if (alignment != 0 && alignment != 2)
-            {
-                // Стандартные значения для SRT: 7, 8, 9, 4, 5, 6, 1, 2, 3
-                alignmentTag = QString("{\\an%1}").arg(alignment);
-            }
-            styleInfo[styleName] = {formatTags, alignmentTag};
+            // Стандартные значения для SRT: 7, 8, 9, 4, 5, 6, 1, 2, 3
+            alignmentTag = QString("{\\an%1}").arg(alignment);
         }
+        styleInfo[doc->styleField(i, AssDocument::StyleField::Name)] = {formatTags, alignmentTag};
     }
 
-    in.seek(0);
-    bool inEvents = false;
     int lineCounter = 1;
+    QByteArray out("\xEF\xBB\xBF");
+    out.reserve(doc->buffer().size());
 
-    while (!in.atEnd())
+    for (int i = 0; i < doc->events().size(); ++i)
     {
-        QString line = in.readLine();
-        if (line.trimmed() == "[Events]")
-        {
-            inEvents = true;
-            continue;
-        }
-        if (!inEvents || !line.startsWith("Dialogue:"))
-            continue;
-
-        QStringList parts = line.split(',');
-        if (parts.size() < 10)
+        if (doc->events().at(i).comment || !doc->isEventComplete(i))
             continue;
 
         // Пропускаем надписи и ТБ
-        QString style = parts[3].trimmed();
-        QString actor = parts[4].trimmed();
+        QString style = doc->eventField(i, AssDocument::EventField::Style);
+        QString actor = doc->eventField(i, AssDocument::EventField::Name);
         if (signStyles.contains(style, Qt::CaseInsensitive) || signStyles.contains(actor, Qt::CaseInsensitive) ||
             actor == "НАДПИСЬ")
         {
             continue;
         }
 
-        // Форматируем время для SRT
-        // ASS: H:MM:SS.cs -> SRT: HH:MM:SS,ms
-        QString startTimeStr = parts[1].trimmed();
-        QStringList st_parts = startTimeStr.split(':');
-        QString srtStartTime = "00:00:00,000";
-        if (st_parts.size() == 3)
-        {
-            int st_h = st_parts[0].toInt();
-            int st_m = st_parts[1].toInt();
-            QStringList st_sec_cs = st_parts[2].split('.');
-            if (st_sec_cs.size() == 2)
-            {
-                int st_s = st_sec_cs[0].toInt();
-                int st_ms = st_sec_cs[1].toInt() * 10; // cs -> ms
-                srtStartTime = QString::asprintf("%02d:%02d:%02d,%03d", st_h, st_m, st_s, st_ms);
-            }
-        }
-
-        // --- Обработка EndTime ---
-        QString endTimeStr = parts[2].trimmed();
-        QStringList et_parts = endTimeStr.split(':');
-        QString srtEndTime = "00:00:00,000";
-        if (et_parts.size() == 3)
-        {
-            int et_h = et_parts[0].toInt();
-            int et_m = et_parts[1].toInt();
-            QStringList et_sec_cs = et_parts[2].split('.');
-            if (et_sec_cs.size() == 2)
-            {
-                int et_s = et_sec_cs[0].toInt();
-                int et_ms = et_sec_cs[1].toInt() * 10; // cs -> ms
-                srtEndTime = QString::asprintf("%02d:%02d:%02d,%03d", et_h, et_m, et_s, et_ms);
-            }
-        }
+        // ASS: H:MM:SS.cs -> SRT: HH:MM:SS,ms; нечитаемое время — 00:00:00,000, как и раньше
+        const AssTime start = AssTime::parse(doc->eventFieldView(i, AssDocument::EventField::Start));
+        const AssTime end = AssTime::parse(doc->eventFieldView(i, AssDocument::EventField::End));
+        char timeBuffer[AssTime::kMaxFormattedLength];
 
         // Собираем текст и конвертируем теги
-        QString text = parts.mid(9).join(',');
-        text = convertAssTagsToSrt(text);
+        QString text = convertAssTagsToSrt(doc->eventField(i, AssDocument::EventField::Text));
 
         QString finalLine = text;
 
@@ -1151,13 +991,23 @@ bool AssProcessor::convertToSrt(const QString& inputAssPath, const QString& outp
         }
 
         // Записываем блок в SRT
-        out << lineCounter << "\n";
-        out << srtStartTime << " --> " << srtEndTime << "\n";
-        out << finalLine.trimmed() << "\n\n";
+        out += QByteArray::number(lineCounter);
+        out += '\n';
+        out.append(timeBuffer, (start.isValid() ? start : AssTime(0)).writeSrt(timeBuffer));
+        out += " --> ";
+        out.append(timeBuffer, (end.isValid() ? end : AssTime(0)).writeSrt(timeBuffer));
+        out += '\n';
+        out += finalLine.trimmed().toUtf8();
+        out += "\n\n";
 
         lineCounter++;
     }
 
+    QFile outputFile(outputSrtPath);
+    if (!outputFile.open(QIODevice::WriteOnly) || outputFile.write(out) != out.size())
+        return false;
+    outputFile.close();
+
     emit logMessage("Файл SRT успешно создан: " + QFileInfo(outputSrtPath).fileName(), LogCategory::APP);
     return true;
 }
@@ -1171,56 +1021,53 @@ bool AssProcessor::applySubstitutions(const QString& filePath, const QMap<QStrin
 
     emit logMessage("Применение автоматических замен в файле: " + QFileInfo(filePath).fileName(), LogCategory::APP);
 
-    QFile file(filePath);
-    if (!file.open(QIODevice::ReadOnly))
+    const std::shared_ptr<const AssDocument> source = AssDocument::load(filePath);
+    if (!source)
     {
         emit logMessage("Ошибка: не удалось открыть файл для замен: " + filePath, LogCategory::APP, LogLevel::Error);
         return false;
     }
 
-    QTextStream in(&file);
-    in.setEncoding(QStringConverter::Utf8);
-    QStringList lines = in.readAll().split('\n');
-    file.close();
+    const SubstitutionMatcher matcher(substitutions);
+    QList<int> hitsPerKey(matcher.keyCount(), 0);
 
-    int substitutionsCount = 0;
-    for (QString& line : lines)
+    // Копия разделяет буфер с кэшем; правки хранятся отдельно от него
+    AssDocument doc = *source;
+    int changedLines = 0;
+    QByteArray replaced;
+    for (int i = 0; i < doc.events().size(); ++i)
     {
-        if (line.startsWith("Dialogue:"))
+        if (doc.events().at(i).comment || !doc.isEventComplete(i))
+            continue;
+
+        if (matcher.apply(doc.eventFieldView(i, AssDocument::EventField::Text), replaced, &hitsPerKey))
         {
-            QStringList parts = line.split(',');
-            if (parts.size() >= 10)
-            {
-                QString textPart = parts.mid(9).join(',');
-                QString originalText = textPart;
-
-                for (auto it = substitutions.constBegin(); it != substitutions.constEnd(); ++it)
-                {
-                    textPart.replace(it.key(), it.value());
-                }
-
-                if (textPart != originalText)
-                {
-                    substitutionsCount++;
-                    // Собираем строку обратно
-                    QStringList newLineParts = parts.mid(0, 9);
-                    newLineParts.append(textPart);
-                    line = newLineParts.join(',');
-                }
-            }
+            changedLines++;
+            doc.setEventTextUtf8(i, replaced);
         }
     }
 
-    if (substitutionsCount > 0)
-    {
-        emit logMessage(QString("Выполнено %1 замен.").arg(substitutionsCount), LogCategory::APP);
-        return writeAssFile(filePath, lines);
-    }
-    else
+    if (changedLines == 0)
     {
         emit logMessage("Замены не потребовались.", LogCategory::APP);
         return true;
     }
+
+    QList<int> order;
+    for (int k = 0; k < hitsPerKey.size(); ++k)
+    {
+        if (hitsPerKey.at(k) > 0)
+            order.append(k);
+    }
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return hitsPerKey.at(a) > hitsPerKey.at(b); });
+    QStringList perKey;
+    for (int k : std::as_const(order))
+    {
+        perKey << QString("«%1» ×%2").arg(matcher.key(k)).arg(hitsPerKey.at(k));
+    }
+    emit logMessage(QString("Выполнено замен в %1 строках: %2.").arg(changedLines).arg(perKey.join(", ")),
+                    LogCategory::APP);
+    return doc.save(filePath);
 }
 
 int AssProcessor::calculateTbLineCount(const ReleaseTemplate& t)
@@ -27,6 +27,9 @@ public:
     bool applySubstitutions(const QString& filePath, const QMap<QString, QString>& substitutions);
     static int calculateTbLineCount(const ReleaseTemplate& t);
     static TbSegment detectTbSegmentFromFile(const QString& assPath);
+    /// Отрезки времени, где на экране есть хотя бы одно видимое событие (слитые, если ближе \a mergeGapS).
+    /// Пустой список — рисовать нечего.
+    static QList<TbSegment> detectActiveIntervalsFromFile(const QString& assPath, double mergeGapS = 0.5);
 
 signals:
     void logMessage(const QString&, LogCategory, LogLevel = LogLevel::Info);
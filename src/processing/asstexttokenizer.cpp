@@ -0,0 +1,99 @@
+#include "asstexttokenizer.h"
+
+namespace
+{
+bool isLineBreakAt(QStringView text, qsizetype pos)
+{
+    return text.at(pos) == u'\\' && pos + 1 < text.size() && (text.at(pos + 1) == u'N' || text.at(pos + 1) == u'n');
+}
+} // namespace
+
+bool AssTextTokenizer::next(AssTextToken& token)
+{
+    const qsizetype size = m_text.size();
+
+    while (m_blockEnd >= 0)
+    {
+        if (m_pos >= m_blockEnd)
+        {
+            token = {AssTextToken::Kind::BlockEnd, m_text.mid(m_blockEnd, 1), m_blockEnd};
+            m_pos = m_blockEnd + 1;
+            m_blockEnd = -1;
+            return true;
+        }
+
+        // До первого '\' в блоке — комментарий, между тегами — значение предыдущего тега
+        qsizetype start = m_pos;
+        while (start < m_blockEnd && m_text.at(start) != u'\\')
+        {
+            ++start;
+        }
+        if (start >= m_blockEnd)
+        {
+            m_pos = m_blockEnd;
+            continue;
+        }
+        ++start;
+        qsizetype end = start;
+        while (end < m_blockEnd && m_text.at(end) != u'\\')
+        {
+            ++end;
+        }
+        m_pos = end;
+        if (end > start)
+        {
+            token = {AssTextToken::Kind::Tag, m_text.mid(start, end - start), start};
+            return true;
+        }
+    }
+
+    if (m_pos >= size)
+    {
+        return false;
+    }
+
+    if (m_text.at(m_pos) == u'{')
+    {
+        const qsizetype close = m_text.indexOf(u'}', m_pos + 1);
+        if (close >= 0)
+        {
+            token = {AssTextToken::Kind::BlockStart, m_text.mid(m_pos, 1), m_pos};
+            m_blockEnd = close;
+            ++m_pos;
+            return true;
+        }
+        // Непарная '{' — до конца строки обычный текст
+        token = {AssTextToken::Kind::Text, m_text.mid(m_pos), m_pos};
+        m_pos = size;
+        return true;
+    }
+
+    if (isLineBreakAt(m_text, m_pos))
+    {
+        token = {AssTextToken::Kind::LineBreak, m_text.mid(m_pos, 2), m_pos};
+        m_pos += 2;
+        return true;
+    }
+
+    const qsizetype start = m_pos;
+    while (m_pos < size && m_text.at(m_pos) != u'{' && !isLineBreakAt(m_text, m_pos))
+    {
+        ++m_pos;
+    }
+    token = {AssTextToken::Kind::Text, m_text.mid(start, m_pos - start), start};
+    return true;
+}
+
+bool AssTextTokenizer::hasVisibleText(QStringView text)
+{
+    AssTextTokenizer tokenizer(text);
+    AssTextToken token;
+    while (tokenizer.next(token))
+    {
+        if (token.kind == AssTextToken::Kind::Text && !token.text.trimmed().isEmpty())
+        {
+            return true;
+        }
+    }
+    return false;
+}
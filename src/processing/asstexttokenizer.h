@@ -0,0 +1,49 @@
+#ifndef ASSTEXTTOKENIZER_H
+#define ASSTEXTTOKENIZER_H
+
+#include <QStringView>
+
+/// Токен поля Text события ASS. Все участки указывают в исходную строку.
+struct AssTextToken
+{
+    enum class Kind
+    {
+        Text,       // обычный текст между блоками тегов
+        LineBreak,  // \N или \n вне блока
+        BlockStart, // '{'
+        Tag,        // содержимое от '\' до следующего '\' или '}', например "fnArial", "b1", "pos(10,20"
+        BlockEnd    // '}'
+    };
+
+    Kind kind = Kind::Text;
+    QStringView text;
+    qsizetype position = 0; // смещение начала токена в исходной строке
+};
+
+/**
+ * @brief Однопроходный токенизатор override-тегов ASS без регулярных выражений и выделений памяти.
+ *
+ * Блоком тегов считается '{' с парной '}' (непарная '{' остаётся текстом). Внутри блока текст до первого
+ * '\' — комментарий и пропускается, пустые теги ("\\") тоже. Имя и значение тега не разделяются:
+ * у ASS нет разделителя (\fnArial, \b700, \1c&H...), поэтому потребитель сам сверяет префикс.
+ */
+class AssTextTokenizer
+{
+public:
+    explicit AssTextTokenizer(QStringView text) : m_text(text)
+    {
+    }
+
+    /// Следующий токен; false, когда строка закончилась.
+    bool next(AssTextToken& token);
+
+    /// Есть ли в строке что-то видимое, кроме блоков тегов, \N/\n и пробелов.
+    static bool hasVisibleText(QStringView text);
+
+private:
+    QStringView m_text;
+    qsizetype m_pos = 0;
+    qsizetype m_blockEnd = -1; // позиция '}' текущего блока, -1 — вне блока
+};
+
+#endif // ASSTEXTTOKENIZER_H
@@ -0,0 +1,130 @@
+#include "asstime.h"
+
+namespace
+{
+bool isDigit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+// Читает от 1 до maxDigits цифр; false, если цифр нет
+bool readNumber(const char*& p, const char* end, int maxDigits, qint64& value)
+{
+    value = 0;
+    int digits = 0;
+    while (p < end && isDigit(*p) && digits < maxDigits)
+    {
+        value = value * 10 + (*p - '0');
+        ++p;
+        ++digits;
+    }
+    return digits > 0;
+}
+
+char* writeDigits(char* out, qint64 value, int width)
+{
+    for (int i = width - 1; i >= 0; --i)
+    {
+        out[i] = static_cast<char>('0' + value % 10);
+        value /= 10;
+    }
+    return out + width;
+}
+
+char* writeHours(char* out, qint64 hours, int minWidth)
+{
+    int width = 1;
+    for (qint64 v = hours; v >= 10; v /= 10)
+    {
+        ++width;
+    }
+    return writeDigits(out, hours, qMax(width, minWidth));
+}
+} // namespace
+
+AssTime AssTime::parse(QByteArrayView text)
+{
+    const char* p = text.data();
+    const char* end = p + text.size();
+    while (p < end && (*p == ' ' || *p == '\t'))
+    {
+        ++p;
+    }
+    while (end > p && (end[-1] == ' ' || end[-1] == '\t'))
+    {
+        --end;
+    }
+
+    qint64 hours = 0;
+    qint64 minutes = 0;
+    qint64 seconds = 0;
+    if (!readNumber(p, end, 6, hours) || p == end || *p++ != ':' || !readNumber(p, end, 2, minutes) || p == end ||
+        *p++ != ':' || !readNumber(p, end, 2, seconds))
+    {
+        return {};
+    }
+
+    qint64 fraction = 0;
+    if (p < end && *p == '.')
+    {
+        ++p;
+        int digits = 0;
+        while (p < end && isDigit(*p))
+        {
+            if (digits < 3)
+            {
+                fraction = fraction * 10 + (*p - '0');
+                ++digits;
+            }
+            ++p;
+        }
+        for (; digits < 3; ++digits)
+        {
+            fraction *= 10;
+        }
+    }
+    if (p != end)
+    {
+        return {};
+    }
+
+    return AssTime(((hours * 60 + minutes) * 60 + seconds) * 1000 + fraction);
+}
+
+int AssTime::writeAss(char* out) const
+{
+    const qint64 value = qMax<qint64>(0, ms);
+    char* p = writeHours(out, value / 3600000, 1);
+    *p++ = ':';
+    p = writeDigits(p, value / 60000 % 60, 2);
+    *p++ = ':';
+    p = writeDigits(p, value / 1000 % 60, 2);
+    *p++ = '.';
+    p = writeDigits(p, value % 1000 / 10, 2);
+    return static_cast<int>(p - out);
+}
+
+int AssTime::writeSrt(char* out) const
+{
+    const qint64 value = qMax<qint64>(0, ms);
+    char* p = writeHours(out, value / 3600000, 2);
+    *p++ = ':';
+    p = writeDigits(p, value / 60000 % 60, 2);
+    *p++ = ':';
+    p = writeDigits(p, value / 1000 % 60, 2);
+    *p++ = ',';
+    p = writeDigits(p, value % 1000, 3);
+    return static_cast<int>(p - out);
+}
+
+QByteArray AssTime::toAss() const
+{
+    char buffer[kMaxFormattedLength];
+    return QByteArray(buffer, writeAss(buffer));
+}
+
+QByteArray AssTime::toSrt() const
+{
+    char buffer[kMaxFormattedLength];
+    return QByteArray(buffer, writeSrt(buffer));
+}
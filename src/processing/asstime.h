@@ -0,0 +1,60 @@
+#ifndef ASSTIME_H
+#define ASSTIME_H
+
+#include <QByteArray>
+#include <QByteArrayView>
+
+/**
+ * @brief Метка времени ASS в миллисекундах (целое число, без QTime и double).
+ *
+ * ASS пишет H:MM:SS.cc (сотые), но встречается и H:MM:SS.mmm — разбор принимает 0–3 знака дробной части.
+ * Разбор и форматирование работают прямо по UTF-8 байтам поля, без временных строк.
+ */
+struct AssTime
+{
+    qint64 ms = -1;
+
+    AssTime() = default;
+    explicit AssTime(qint64 milliseconds) : ms(milliseconds)
+    {
+    }
+
+    bool isValid() const
+    {
+        return ms >= 0;
+    }
+    double seconds() const
+    {
+        return static_cast<double>(ms) / 1000.0;
+    }
+    qint64 centiseconds() const
+    {
+        return ms / 10;
+    }
+
+    /// Невалидное время, если \a text не H:MM:SS[.fff] (пробелы по краям допускаются, знаки дроби после третьего
+    /// игнорируются).
+    static AssTime parse(QByteArrayView text);
+
+    /// Максимальная длина результата writeAss()/writeSrt() для часов < 10^6.
+    static constexpr int kMaxFormattedLength = 16;
+
+    /// "H:MM:SS.cc" (тысячные отбрасываются, как в Aegisub); возвращает число записанных байт.
+    int writeAss(char* out) const;
+    /// "HH:MM:SS,mmm"; возвращает число записанных байт.
+    int writeSrt(char* out) const;
+
+    QByteArray toAss() const;
+    QByteArray toSrt() const;
+
+    friend bool operator<(AssTime a, AssTime b)
+    {
+        return a.ms < b.ms;
+    }
+    friend bool operator==(AssTime a, AssTime b)
+    {
+        return a.ms == b.ms;
+    }
+};
+
+#endif // ASSTIME_H
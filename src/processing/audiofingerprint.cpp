@@ -0,0 +1,597 @@
+#include "audiofingerprint.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QProcess>
+#include <QRegularExpression>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QtAlgorithms>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <complex>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+constexpr double kPi = 3.14159265358979323846;
+constexpr int kFrameSize = 2048; // окно 256 мс
+constexpr int kBands = 33;       // 33 полосы дают 32 разности
+constexpr double kMinHz = 300.0;
+constexpr double kMaxHz = 2000.0;
+
+constexpr int kBlockHashes = 128; // ~4 с: по блокам считается доля несовпавших бит
+constexpr double kMaxBitErrorRate = 0.3;
+constexpr double kMinScore = 0.5;
+constexpr double kMinMatchedS = 12.0;
+constexpr int kCandidateOffsets = 5;
+
+constexpr double kEndingLengthS = 90.0; // эндинг без главы: длина типичного TV-size
+constexpr double kMaxSegmentLengthS = 120.0;
+constexpr double kMinSegmentLengthS = 10.0;
+constexpr double kChapterGapS = 1.0;
+
+constexpr int kReadTimeoutMs = 60000;
+constexpr quint32 kIndexMagic = 0x44465031; // "DFP1"
+constexpr quint16 kIndexVersion = 1;
+
+double hashesToSeconds(qint64 count)
+{
+    return double(count) * AudioFingerprint::kHopSamples / AudioFingerprint::kSampleRate;
+}
+
+qint64 secondsToHashes(double seconds)
+{
+    return std::llround(seconds * AudioFingerprint::kSampleRate / AudioFingerprint::kHopSamples);
+}
+
+/// Потоковый расчёт суботпечатков: отсчёты приходят кусками любой длины.
+class Hasher
+{
+public:
+    Hasher() : m_window(kFrameSize), m_twiddles(kFrameSize / 2), m_reversed(kFrameSize), m_buffer(kFrameSize)
+    {
+        for (int i = 0; i < kFrameSize; ++i)
+        {
+            m_window[i] = float(0.5 - 0.5 * std::cos(2.0 * kPi * i / kFrameSize));
+            int reversed = 0;
+            for (int bit = 1, mirror = kFrameSize >> 1; bit < kFrameSize; bit <<= 1, mirror >>= 1)
+            {
+                if (i & bit)
+                {
+                    reversed |= mirror;
+                }
+            }
+            m_reversed[i] = reversed;
+        }
+        for (int k = 0; k < kFrameSize / 2; ++k)
+        {
+            m_twiddles[k] = std::polar(1.0f, float(-2.0 * kPi * k / kFrameSize));
+        }
+        // Полосы равны в логарифмической шкале, но каждая не уже одного бина
+        for (int band = 0; band <= kBands; ++band)
+        {
+            const double hz = kMinHz * std::pow(kMaxHz / kMinHz, double(band) / kBands);
+            m_edges[band] = int(std::lround(hz * kFrameSize / AudioFingerprint::kSampleRate));
+            if (band > 0)
+            {
+                m_edges[band] = qMax(m_edges[band], m_edges[band - 1] + 1);
+            }
+        }
+    }
+
+    void push(const float* samples, qint64 count)
+    {
+        m_pending.insert(m_pending.end(), samples, samples + count);
+        size_t pos = 0;
+        for (; pos + kFrameSize <= m_pending.size(); pos += AudioFingerprint::kHopSamples)
+        {
+            processFrame(m_pending.data() + pos);
+        }
+        m_pending.erase(m_pending.begin(), m_pending.begin() + qint64(pos));
+    }
+
+    QList<quint32> takeHashes()
+    {
+        return std::move(m_hashes);
+    }
+
+private:
+    void processFrame(const float* frame)
+    {
+        for (int i = 0; i < kFrameSize; ++i)
+        {
+            m_buffer[m_reversed[i]] = frame[i] * m_window[i];
+        }
+        for (int length = 2; length <= kFrameSize; length <<= 1)
+        {
+            const int stride = kFrameSize / length;
+            for (int start = 0; start < kFrameSize; start += length)
+            {
+                for (int k = 0; k < length / 2; ++k)
+                {
+                    const std::complex<float> even = m_buffer[start + k];
+                    const std::complex<float> odd = m_buffer[start + k + length / 2] * m_twiddles[k * stride];
+                    m_buffer[start + k] = even + odd;
+                    m_buffer[start + k + length / 2] = even - odd;
+                }
+            }
+        }
+
+        std::array<float, kBands> energy{};
+        for (int band = 0; band < kBands; ++band)
+        {
+            for (int bin = m_edges[band]; bin < m_edges[band + 1]; ++bin)
+            {
+                energy[band] += std::norm(m_buffer[bin]);
+            }
+        }
+        std::array<float, kBands - 1> difference;
+        for (int band = 0; band < kBands - 1; ++band)
+        {
+            difference[band] = energy[band] - energy[band + 1];
+        }
+        if (m_hasPrevious)
+        {
+            quint32 hash = 0;
+            for (int band = 0; band < kBands - 1; ++band)
+            {
+                if (difference[band] > m_previous[band])
+                {
+                    hash |= 1u << band;
+                }
+            }
+            m_hashes.append(hash);
+        }
+        m_previous = difference;
+        m_hasPrevious = true;
+    }
+
+    std::vector<float> m_window;
+    std::vector<std::complex<float>> m_twiddles;
+    std::vector<int> m_reversed;
+    std::vector<std::complex<float>> m_buffer;
+    std::array<int, kBands + 1> m_edges{};
+
+    std::vector<float> m_pending;
+    std::array<float, kBands - 1> m_previous{};
+    bool m_hasPrevious = false;
+    QList<quint32> m_hashes;
+};
+
+/// Доля совпавших блоков при положении \a offset и сколько секунд они покрывают.
+double verify(const QList<quint32>& reference, const QList<quint32>& stream, qsizetype offset, double* matchedS)
+{
+    int blocks = 0;
+    int matched = 0;
+    for (qsizetype from = 0; from < reference.size(); from += kBlockHashes)
+    {
+        const qsizetype to = qMin(qMin(from + kBlockHashes, reference.size()), stream.size() - offset);
+        // Неполный блок в конце (серия кончилась раньше сегмента) не считается
+        if (to - from < kBlockHashes / 2)
+        {
+            break;
+        }
+        int errors = 0;
+        for (qsizetype i = from; i < to; ++i)
+        {
+            errors += qPopulationCount(reference.at(i) ^ stream.at(offset + i));
+        }
+        ++blocks;
+        if (errors < kMaxBitErrorRate * 32 * (to - from))
+        {
+            ++matched;
+        }
+    }
+    *matchedS = hashesToSeconds(qint64(matched) * kBlockHashes);
+    return blocks > 0 ? double(matched) / blocks : 0.0;
+}
+} // namespace
+
+// Вне анонимного пространства имён, иначе операторы не найдутся через ADL из QList
+static QDataStream& operator<<(QDataStream& out, const FingerprintSegment& segment)
+{
+    return out << segment.title << segment.isEnding << segment.lengthS << segment.hashes;
+}
+
+static QDataStream& operator>>(QDataStream& in, FingerprintSegment& segment)
+{
+    return in >> segment.title >> segment.isEnding >> segment.lengthS >> segment.hashes;
+}
+
+static QDataStream& operator<<(QDataStream& out, const FingerprintChapter& chapter)
+{
+    return out << chapter.title << qint32(chapter.segment) << chapter.atEnd;
+}
+
+static QDataStream& operator>>(QDataStream& in, FingerprintChapter& chapter)
+{
+    qint32 segment = -1;
+    in >> chapter.title >> segment >> chapter.atEnd;
+    chapter.segment = segment;
+    return in;
+}
+
+int FingerprintIndex::endingSegment() const
+{
+    for (int i = 0; i < segments.size(); ++i)
+    {
+        if (segments.at(i).isEnding)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+double FingerprintScan::durationS() const
+{
+    return hashesToSeconds(hashes.size());
+}
+
+namespace AudioFingerprint
+{
+bool isOpeningChapter(const QString& title)
+{
+    static const QRegularExpression pattern(QStringLiteral("^\\s*(op|opening|intro|опенинг|начальная)\\b"),
+                                            QRegularExpression::CaseInsensitiveOption |
+                                                QRegularExpression::UseUnicodePropertiesOption);
+    return pattern.match(title).hasMatch();
+}
+
+bool isEndingChapter(const QString& title, const QString& endingChapterName)
+{
+    if (!endingChapterName.trimmed().isEmpty() &&
+        title.trimmed().compare(endingChapterName.trimmed(), Qt::CaseInsensitive) == 0)
+    {
+        return true;
+    }
+    static const QRegularExpression pattern(QStringLiteral("^\\s*(ed|ending|outro|эндинг|финальная)\\b"),
+                                            QRegularExpression::CaseInsensitiveOption |
+                                                QRegularExpression::UseUnicodePropertiesOption);
+    return pattern.match(title).hasMatch();
+}
+
+QList<quint32> computeHashes(const float* samples, qint64 count)
+{
+    Hasher hasher;
+    hasher.push(samples, count);
+    return hasher.takeHashes();
+}
+
+FingerprintScan scan(const QString& ffmpegPath, const QString& path, const QString& streamSpecifier)
+{
+    QElapsedTimer timer;
+    timer.start();
+    FingerprintScan result;
+
+    QProcess ffmpeg;
+    ffmpeg.start(ffmpegPath, {"-v", "error", "-nostdin", "-i", path, "-map", "0:" + streamSpecifier, "-vn", "-ac",
+                              "1", "-ar", QString::number(kSampleRate), "-f", "f32le", "-"});
+    if (!ffmpeg.waitForStarted())
+    {
+        result.errorString = ffmpeg.errorString();
+        return result;
+    }
+
+    // Дорожка не попадает на диск и в память целиком: в памяти только хвост, не набравший окна
+    Hasher hasher;
+    QByteArray pending;
+    std::vector<float> samples;
+    for (;;)
+    {
+        if (ffmpeg.bytesAvailable() == 0 && !ffmpeg.waitForReadyRead(kReadTimeoutMs) && ffmpeg.bytesAvailable() == 0)
+        {
+            break;
+        }
+        pending += ffmpeg.readAllStandardOutput();
+        const qsizetype count = pending.size() / qsizetype(sizeof(float));
+        samples.resize(count);
+        std::memcpy(samples.data(), pending.constData(), count * sizeof(float));
+        pending.remove(0, count * qsizetype(sizeof(float)));
+        hasher.push(samples.data(), count);
+    }
+    if (ffmpeg.state() != QProcess::NotRunning && !ffmpeg.waitForFinished(kReadTimeoutMs))
+    {
+        ffmpeg.kill();
+        result.errorString = QStringLiteral("ffmpeg не ответил за %1 с").arg(kReadTimeoutMs / 1000);
+        return result;
+    }
+    if (ffmpeg.exitStatus() != QProcess::NormalExit || ffmpeg.exitCode() != 0)
+    {
+        result.errorString = QStringLiteral("ffmpeg: ") + QString::fromUtf8(ffmpeg.readAllStandardError()).trimmed();
+        return result;
+    }
+
+    result.hashes = hasher.takeHashes();
+    result.elapsedMs = timer.elapsed();
+    result.ok = !result.hashes.isEmpty();
+    if (!result.ok)
+    {
+        result.errorString = QStringLiteral("дорожка пуста");
+    }
+    return result;
+}
+
+QList<quint32> slice(const QList<quint32>& hashes, double startS, double lengthS)
+{
+    const qsizetype from = qBound<qsizetype>(0, secondsToHashes(startS), hashes.size());
+    const qsizetype count = qBound<qsizetype>(0, secondsToHashes(lengthS), hashes.size() - from);
+    return hashes.mid(from, count);
+}
+
+FingerprintMatch find(const QList<quint32>& reference, const QList<quint32>& stream)
+{
+    FingerprintMatch best;
+    if (reference.size() < kBlockHashes || stream.size() < kBlockHashes)
+    {
+        return best;
+    }
+
+    // Цифровая тишина даёт одинаковые суботпечатки, они голосуют за всё подряд
+    QHash<quint32, QList<qsizetype>> positions;
+    positions.reserve(reference.size());
+    for (qsizetype i = 0; i < reference.size(); ++i)
+    {
+        const quint32 hash = reference.at(i);
+        if (hash != 0 && hash != 0xFFFFFFFFu)
+        {
+            positions[hash].append(i);
+        }
+    }
+
+    // votes[o] — сколько суботпечатков совпадает, если сегмент начинается в серии с суботпечатка o
+    std::vector<int> votes(stream.size(), 0);
+    for (qsizetype j = 0; j < stream.size(); ++j)
+    {
+        for (int bit = -1; bit < 32; ++bit)
+        {
+            const quint32 hash = bit < 0 ? stream.at(j) : stream.at(j) ^ (1u << bit);
+            const auto it = positions.constFind(hash);
+            if (it == positions.cend())
+            {
+                continue;
+            }
+            for (qsizetype i : *it)
+            {
+                if (i <= j)
+                {
+                    ++votes[j - i];
+                }
+            }
+        }
+    }
+
+    std::vector<qsizetype> candidates;
+    for (qsizetype offset = 0; offset < stream.size(); ++offset)
+    {
+        if (votes[offset] > 1)
+        {
+            candidates.push_back(offset);
+        }
+    }
+    const auto byVotes = [&votes](qsizetype a, qsizetype b) { return votes[a] > votes[b]; };
+    const size_t top = qMin<size_t>(kCandidateOffsets, candidates.size());
+    std::partial_sort(candidates.begin(), candidates.begin() + top, candidates.end(), byVotes);
+
+    const double requiredS = qMin(kMinMatchedS, hashesToSeconds(reference.size()) / 2.0);
+    for (size_t c = 0; c < top; ++c)
+    {
+        double matchedS = 0.0;
+        const double score = verify(reference, stream, candidates[c], &matchedS);
+        if (score >= kMinScore && matchedS >= requiredS && score > best.score)
+        {
+            best.segment = 0;
+            best.startS = hashesToSeconds(candidates[c]);
+            best.score = score;
+        }
+    }
+    return best;
+}
+
+QList<FingerprintMatch> match(const FingerprintIndex& index, const QList<quint32>& stream)
+{
+    QList<FingerprintMatch> matches;
+    for (int i = 0; i < index.segments.size(); ++i)
+    {
+        FingerprintMatch found = find(index.segments.at(i).hashes, stream);
+        if (found.segment >= 0)
+        {
+            found.segment = i;
+            matches.append(found);
+        }
+    }
+    return matches;
+}
+
+void learnEnding(FingerprintIndex& index, const QList<quint32>& stream, double startS)
+{
+    const int existing = index.endingSegment();
+    const double lengthS = existing >= 0 && index.segments.at(existing).lengthS > 0.0
+                               ? qMin(index.segments.at(existing).lengthS, kMaxSegmentLengthS)
+                               : kEndingLengthS;
+    const QList<quint32> hashes = slice(stream, startS, lengthS);
+    if (hashes.size() < kBlockHashes)
+    {
+        return;
+    }
+    if (existing >= 0)
+    {
+        index.segments[existing].hashes = hashes;
+        return;
+    }
+    FingerprintSegment segment;
+    segment.isEnding = true;
+    segment.hashes = hashes;
+    index.segments.append(segment);
+}
+
+bool learnChapters(FingerprintIndex& index, const QList<quint32>& stream, const QList<ChapterMarker>& chapters,
+                   const QString& endingChapterName)
+{
+    const double durationS = hashesToSeconds(stream.size());
+    QList<FingerprintSegment> segments;
+    QList<FingerprintChapter> layout;
+    int previousSegment = -1;
+    double previousEndS = 0.0;
+    for (qsizetype i = 0; i < chapters.size(); ++i)
+    {
+        const ChapterMarker& chapter = chapters.at(i);
+        const double startS = chapter.startNs / 1e9;
+        double endS = durationS;
+        if (chapter.endNs > chapter.startNs)
+        {
+            endS = chapter.endNs / 1e9;
+        }
+        else if (i + 1 < chapters.size())
+        {
+            endS = chapters.at(i + 1).startNs / 1e9;
+        }
+
+        const bool isEnding = isEndingChapter(chapter.title, endingChapterName);
+        FingerprintChapter entry;
+        entry.title = chapter.title;
+        if ((isEnding || isOpeningChapter(chapter.title)) && endS - startS >= kMinSegmentLengthS)
+        {
+            FingerprintSegment segment;
+            segment.title = chapter.title;
+            segment.isEnding = isEnding;
+            segment.lengthS = endS - startS;
+            segment.hashes = slice(stream, startS, qMin(segment.lengthS, kMaxSegmentLengthS));
+            entry.segment = segments.size();
+            segments.append(segment);
+            layout.append(entry);
+            previousSegment = entry.segment;
+            previousEndS = endS;
+            continue;
+        }
+
+        // Главы, начало которых нельзя вывести из сегментов (например, вторая половина после заставки),
+        // в раскладку не попадают: их время достанется предыдущей главе
+        if (i == 0 && startS < kChapterGapS)
+        {
+            layout.append(entry);
+        }
+        else if (previousSegment >= 0 && qAbs(startS - previousEndS) < kChapterGapS)
+        {
+            entry.segment = previousSegment;
+            entry.atEnd = true;
+            layout.append(entry);
+        }
+        previousSegment = -1;
+    }
+
+    if (segments.isEmpty())
+    {
+        return false;
+    }
+    index.segments = segments;
+    index.chapters = layout;
+    return true;
+}
+
+QList<ChapterMarker> buildChapters(const FingerprintIndex& index, const QList<FingerprintMatch>& matches,
+                                   double durationS)
+{
+    QHash<int, double> starts;
+    for (const FingerprintMatch& match : matches)
+    {
+        starts.insert(match.segment, match.startS);
+    }
+
+    QList<ChapterMarker> result;
+    bool anchored = false;
+    for (const FingerprintChapter& chapter : index.chapters)
+    {
+        double startS = 0.0;
+        if (chapter.segment >= 0)
+        {
+            if (!starts.contains(chapter.segment))
+            {
+                continue;
+            }
+            startS = starts.value(chapter.segment);
+            if (chapter.atEnd)
+            {
+                const double lengthS = index.segments.value(chapter.segment).lengthS;
+                if (lengthS <= 0.0)
+                {
+                    continue;
+                }
+                startS += lengthS;
+            }
+            anchored = true;
+        }
+        if (startS >= durationS - kChapterGapS ||
+            (!result.isEmpty() && startS < result.last().startNs / 1e9 + kChapterGapS))
+        {
+            continue;
+        }
+        ChapterMarker marker;
+        marker.startNs = qint64(std::llround(startS * 1e9));
+        marker.title = chapter.title;
+        result.append(marker);
+    }
+    if (!anchored)
+    {
+        return {};
+    }
+    for (qsizetype i = 0; i < result.size(); ++i)
+    {
+        result[i].endNs = i + 1 < result.size() ? result.at(i + 1).startNs : qint64(std::llround(durationS * 1e9));
+    }
+    return result;
+}
+
+QString indexPath(const QString& seriesTitle)
+{
+    const QByteArray key =
+        QCryptographicHash::hash(seriesTitle.trimmed().toCaseFolded().toUtf8(), QCryptographicHash::Sha1).toHex();
+    return QDir(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation))
+        .filePath(QStringLiteral("fingerprints/%1.bin").arg(QString::fromLatin1(key)));
+}
+
+FingerprintIndex loadIndex(const QString& path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        return {};
+    }
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_6_0);
+    quint32 magic = 0;
+    quint16 version = 0;
+    in >> magic >> version;
+    if (magic != kIndexMagic || version != kIndexVersion)
+    {
+        return {};
+    }
+    FingerprintIndex index;
+    in >> index.segments >> index.chapters;
+    // Битый индекс не страшен — серия выучится заново
+    return in.status() == QDataStream::Ok ? index : FingerprintIndex();
+}
+
+bool saveIndex(const FingerprintIndex& index, const QString& path)
+{
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        return false;
+    }
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << kIndexMagic << kIndexVersion << index.segments << index.chapters;
+    return out.status() == QDataStream::Ok && file.commit();
+}
+} // namespace AudioFingerprint
@@ -0,0 +1,120 @@
+#ifndef AUDIOFINGERPRINT_H
+#define AUDIOFINGERPRINT_H
+
+#include "chapterhelper.h"
+
+#include <QList>
+#include <QString>
+
+/// Отпечаток опенинга или эндинга, выученный по серии с известным таймингом.
+struct FingerprintSegment
+{
+    QString title;         // название главы; у эндинга, выученного по времени ТБ, — пустое
+    bool isEnding = false; // по этому сегменту ищется время ТБ
+    double lengthS = -1.0; // длина главы; -1 — неизвестна (сегмент выучен по одному времени начала)
+    QList<quint32> hashes; // по суботпечатку на AudioFingerprint::kHopSamples отсчётов
+};
+
+/// Глава выученной серии: откуда берётся её начало в новой серии.
+struct FingerprintChapter
+{
+    QString title;
+    int segment = -1;   // -1 — глава с начала серии (только первая), иначе индекс в FingerprintIndex::segments
+    bool atEnd = false; // глава начинается сразу после сегмента, а не вместе с ним
+};
+
+/// Отпечатки одного сериала: сегменты и раскладка глав, которую по ним можно восстановить.
+struct FingerprintIndex
+{
+    QList<FingerprintSegment> segments;
+    QList<FingerprintChapter> chapters; // пустой — главы серии не выучены
+
+    int endingSegment() const;
+    bool isEmpty() const
+    {
+        return segments.isEmpty();
+    }
+};
+
+/// Найденное в серии положение сегмента.
+struct FingerprintMatch
+{
+    int segment = -1;
+    double startS = 0.0;
+    double score = 0.0; // доля совпавших блоков по 4 с в перекрытии, 0..1
+};
+
+/// Суботпечатки всей дорожки после одного потокового прохода.
+struct FingerprintScan
+{
+    bool ok = false;
+    QString errorString;
+
+    QList<quint32> hashes;
+    qint64 elapsedMs = 0;
+
+    double durationS() const;
+};
+
+/**
+ * @brief Акустические отпечатки опенингов и эндингов сериала.
+ *
+ * Дорожка сводится в моно 8 кГц; на каждый шаг 32 мс считаются энергии 33 полос от 300 до 2000 Гц
+ * в окне 256 мс, и 32 бита суботпечатка — знаки разностей соседних полос во времени (схема Haitsma–Kalker).
+ * Такие биты почти не меняются от перекодирования и громкости, а минута звука занимает ~7.5 КБ.
+ *
+ * Поиск: суботпечатки сегмента кладутся в хэш-таблицу, каждый суботпечаток серии (и его соседи на один бит)
+ * голосует за сдвиг, лучшие сдвиги проверяются долей несовпавших бит по блокам. Дорожку ffmpeg отдаёт
+ * через pipe, суботпечатки считаются по мере чтения, сам поиск по готовой серии занимает миллисекунды.
+ */
+namespace AudioFingerprint
+{
+constexpr int kSampleRate = 8000;
+constexpr int kHopSamples = 256; // шаг суботпечатков, 32 мс
+
+/// Глава — опенинг: OP, Opening, Intro, «Опенинг» в начале названия.
+bool isOpeningChapter(const QString& title);
+/// Глава — эндинг: совпадает с \a endingChapterName из шаблона или начинается с ED, Ending, Outro, «Эндинг».
+bool isEndingChapter(const QString& title, const QString& endingChapterName);
+
+/// Суботпечатки моно-сигнала с частотой kSampleRate.
+QList<quint32> computeHashes(const float* samples, qint64 count);
+
+/**
+ * @brief Потоково декодировать дорожку ffmpeg и посчитать суботпечатки.
+ * @param streamSpecifier поток в \a path для -map без номера входа, например "a:0"
+ */
+FingerprintScan scan(const QString& ffmpegPath, const QString& path, const QString& streamSpecifier);
+
+/// Суботпечатки фрагмента [\a startS, \a startS + \a lengthS) прохода.
+QList<quint32> slice(const QList<quint32>& hashes, double startS, double lengthS);
+
+/// Лучшее положение \a reference в \a stream; segment == -1, если совпадения нет.
+FingerprintMatch find(const QList<quint32>& reference, const QList<quint32>& stream);
+
+/// Найти в проходе все сегменты индекса; несовпавшие в результат не попадают.
+QList<FingerprintMatch> match(const FingerprintIndex& index, const QList<quint32>& stream);
+
+/// Запомнить эндинг, начинающийся в \a startS, вместо ранее выученного.
+void learnEnding(FingerprintIndex& index, const QList<quint32>& stream, double startS);
+
+/**
+ * @brief Выучить опенинг и эндинг по главам серии и запомнить раскладку глав.
+ *
+ * Сегментами становятся главы, для которых верны isOpeningChapter() или isEndingChapter().
+ * @return false, если таких глав нет
+ */
+bool learnChapters(FingerprintIndex& index, const QList<quint32>& stream, const QList<ChapterMarker>& chapters,
+                   const QString& endingChapterName);
+
+/// Главы новой серии по раскладке индекса; пустой список, если не найден ни один сегмент, от которого они идут.
+QList<ChapterMarker> buildChapters(const FingerprintIndex& index, const QList<FingerprintMatch>& matches,
+                                   double durationS);
+
+/// <AppDataLocation>/fingerprints/<sha1 названия>.bin
+QString indexPath(const QString& seriesTitle);
+FingerprintIndex loadIndex(const QString& path);
+bool saveIndex(const FingerprintIndex& index, const QString& path);
+} // namespace AudioFingerprint
+
+#endif // AUDIOFINGERPRINT_H
@@ -0,0 +1,332 @@
+#include "audiooffset.h"
+
+#include "wavfile.h"
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QProcess>
+#include <QTemporaryDir>
+#include <QtConcurrent/QtConcurrentMap>
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+constexpr double kPi = 3.14159265358979323846;
+constexpr int kDecodeRate = 8000;
+constexpr int kWindowCount = 4;
+constexpr double kWindowS = 60.0;
+constexpr double kMinWindowS = 10.0;
+constexpr int kDecodeTimeoutMs = 60000;
+constexpr int kAgreementMs = 3;
+constexpr double kMinScore = 0.2;
+
+using Spectrum = std::vector<std::complex<double>>;
+
+/// Итеративное БПФ по основанию 2; размер \a data — степень двойки.
+void fft(Spectrum& data, bool inverse)
+{
+    const size_t n = data.size();
+    for (size_t i = 1, j = 0; i < n; ++i)
+    {
+        size_t bit = n >> 1;
+        for (; j & bit; bit >>= 1)
+        {
+            j ^= bit;
+        }
+        j ^= bit;
+        if (i < j)
+        {
+            std::swap(data[i], data[j]);
+        }
+    }
+    for (size_t length = 2; length <= n; length <<= 1)
+    {
+        const double angle = 2.0 * kPi / double(length) * (inverse ? 1.0 : -1.0);
+        const std::complex<double> step(std::cos(angle), std::sin(angle));
+        for (size_t start = 0; start < n; start += length)
+        {
+            std::complex<double> twiddle(1.0, 0.0);
+            for (size_t k = 0; k < length / 2; ++k)
+            {
+                const std::complex<double> even = data[start + k];
+                const std::complex<double> odd = data[start + k + length / 2] * twiddle;
+                data[start + k] = even + odd;
+                data[start + k + length / 2] = even - odd;
+                twiddle *= step;
+            }
+        }
+    }
+    if (inverse)
+    {
+        for (std::complex<double>& value : data)
+        {
+            value /= double(n);
+        }
+    }
+}
+
+/// Огибающая без постоянной составляющей, дополненная нулями до \a size.
+Spectrum centered(const QList<float>& envelope, size_t size)
+{
+    double mean = 0.0;
+    for (float value : envelope)
+    {
+        mean += value;
+    }
+    mean /= qMax<qsizetype>(1, envelope.size());
+    Spectrum result(size);
+    for (qsizetype i = 0; i < envelope.size(); ++i)
+    {
+        result[i] = envelope.at(i) - mean;
+    }
+    return result;
+}
+
+/// Сведённый в моно кусок отображённого WAV.
+QList<float> downmix(const uchar* data, const WavInfo& format, qint64 firstFrame, qint64 count)
+{
+    QList<float> mono(count, 0.0f);
+    std::vector<float> channel(count);
+    const uchar* frames = data + firstFrame * format.blockAlign;
+    for (int ch = 0; ch < format.channels; ++ch)
+    {
+        WavFile::decodeChannel(frames, count, format, ch, channel.data());
+        for (qint64 i = 0; i < count; ++i)
+        {
+            mono[i] += channel[i];
+        }
+    }
+    return mono;
+}
+
+QList<float> readRawFloats(const QString& path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        return {};
+    }
+    const QByteArray bytes = file.readAll();
+    QList<float> samples(bytes.size() / qsizetype(sizeof(float)));
+    std::memcpy(samples.data(), bytes.constData(), samples.size() * sizeof(float));
+    return samples;
+}
+} // namespace
+
+namespace AudioOffset
+{
+QList<float> onsetEnvelope(const float* samples, qint64 count, int sampleRate)
+{
+    const qint64 bins = count * kEnvelopeRate / sampleRate;
+    QList<float> envelope(bins, 0.0f);
+    double previous = 0.0;
+    for (qint64 bin = 0; bin < bins; ++bin)
+    {
+        const qint64 from = bin * sampleRate / kEnvelopeRate;
+        const qint64 to = (bin + 1) * sampleRate / kEnvelopeRate;
+        double energy = 0.0;
+        for (qint64 i = from; i < to; ++i)
+        {
+            energy += double(samples[i]) * samples[i];
+        }
+        // Порог -100 дБ: цифровая тишина не должна давать всплесков атак
+        const double level = std::log10(energy / qMax<qint64>(1, to - from) + 1e-10);
+        envelope[bin] = bin > 0 ? float(qMax(0.0, level - previous)) : 0.0f;
+        previous = level;
+    }
+    return envelope;
+}
+
+AudioOffsetWindow correlate(const QList<float>& reference, const QList<float>& candidate, int maxLag)
+{
+    AudioOffsetWindow window;
+    const qsizetype lags = candidate.size() - reference.size();
+    if (reference.isEmpty() || lags < 0)
+    {
+        return window;
+    }
+
+    size_t size = 1;
+    while (size < size_t(candidate.size() + reference.size()))
+    {
+        size <<= 1;
+    }
+    Spectrum candidateSpectrum = centered(candidate, size);
+    Spectrum referenceSpectrum = centered(reference, size);
+    std::vector<double> prefixEnergy(candidate.size() + 1, 0.0);
+    for (qsizetype i = 0; i < candidate.size(); ++i)
+    {
+        prefixEnergy[i + 1] = prefixEnergy[i] + std::norm(candidateSpectrum[i]);
+    }
+    double referenceEnergy = 0.0;
+    for (qsizetype i = 0; i < reference.size(); ++i)
+    {
+        referenceEnergy += std::norm(referenceSpectrum[i]);
+    }
+
+    // corr[k] = сумма candidate[i + k] * reference[i]: совпадение, сдвинутое на k отсчётов вправо
+    fft(candidateSpectrum, false);
+    fft(referenceSpectrum, false);
+    for (size_t i = 0; i < size; ++i)
+    {
+        candidateSpectrum[i] *= std::conj(referenceSpectrum[i]);
+    }
+    fft(candidateSpectrum, true);
+
+    double bestScore = 0.0;
+    qsizetype bestLag = -1;
+    for (qsizetype k = 0; k <= lags; ++k)
+    {
+        const double segmentEnergy = prefixEnergy[k + reference.size()] - prefixEnergy[k];
+        const double norm = std::sqrt(referenceEnergy * segmentEnergy);
+        const double score = norm > 0.0 ? candidateSpectrum[k].real() / norm : 0.0;
+        if (score > bestScore)
+        {
+            bestScore = score;
+            bestLag = k;
+        }
+    }
+    if (bestLag >= 0)
+    {
+        window.offsetMs = int((bestLag - maxLag) * 1000 / kEnvelopeRate);
+        window.score = bestScore;
+    }
+    return window;
+}
+
+AudioOffsetResult detect(const QString& ffmpegPath, const QString& originalPath, const QString& streamSpecifier,
+                         const QString& dubWavPath)
+{
+    QElapsedTimer timer;
+    timer.start();
+    AudioOffsetResult result;
+
+    const WavInfo dub = WavFile::readHeader(dubWavPath);
+    if (!dub.ok)
+    {
+        result.errorString = dub.errorString;
+        return result;
+    }
+    const double durationS = dub.durationS();
+    const double marginS = kMaxOffsetMs / 1000.0;
+    const double windowS = qMin(kWindowS, durationS - 2.0 * marginS);
+    if (windowS < kMinWindowS)
+    {
+        result.errorString = QStringLiteral("аудио слишком короткое для сравнения");
+        return result;
+    }
+
+    // Окна равномерно по серии: одно неудачное (тишина, заставка без звука) не решает исход
+    QList<double> starts;
+    for (int i = 0; i < kWindowCount; ++i)
+    {
+        const double center = durationS * (i + 1) / (kWindowCount + 1);
+        const double start = qBound(marginS, center - windowS / 2.0, durationS - marginS - windowS);
+        if (!starts.contains(start))
+        {
+            starts.append(start);
+        }
+    }
+
+    QTemporaryDir tempDir;
+    if (!tempDir.isValid())
+    {
+        result.errorString = tempDir.errorString();
+        return result;
+    }
+    QStringList args{"-v", "error", "-y"};
+    for (double start : starts)
+    {
+        args << "-ss" << QString::number(start, 'f', 3) << "-t" << QString::number(windowS, 'f', 3) << "-i"
+             << originalPath;
+    }
+    for (int i = 0; i < starts.size(); ++i)
+    {
+        args << "-map" << QString("%1:%2").arg(i).arg(streamSpecifier) << "-ac" << "1" << "-ar"
+             << QString::number(kDecodeRate) << "-f" << "f32le" << tempDir.filePath(QString("window%1.f32").arg(i));
+    }
+    QProcess ffmpeg;
+    ffmpeg.start(ffmpegPath, args);
+    if (!ffmpeg.waitForFinished(kDecodeTimeoutMs) || ffmpeg.exitStatus() != QProcess::NormalExit ||
+        ffmpeg.exitCode() != 0)
+    {
+        ffmpeg.kill();
+        result.errorString = QStringLiteral("ffmpeg: ") + QString::fromUtf8(ffmpeg.readAllStandardError()).trimmed();
+        return result;
+    }
+
+    QFile dubFile(dubWavPath);
+    const uchar* dubData =
+        dubFile.open(QIODevice::ReadOnly) ? dubFile.map(dub.dataOffset, dub.dataSize) : nullptr;
+    if (dubData == nullptr)
+    {
+        result.errorString = dubFile.errorString();
+        return result;
+    }
+
+    QList<int> indexes;
+    for (int i = 0; i < starts.size(); ++i)
+    {
+        indexes.append(i);
+    }
+    const int maxLag = kMaxOffsetMs * kEnvelopeRate / 1000;
+    const QList<AudioOffsetWindow> windows = QtConcurrent::blockingMapped(
+        indexes,
+        [&](int i)
+        {
+            const QList<float> original = readRawFloats(tempDir.filePath(QString("window%1.f32").arg(i)));
+            const QList<float> reference = onsetEnvelope(original.constData(), original.size(), kDecodeRate);
+
+            const qint64 firstFrame = std::llround((starts.at(i) - marginS) * dub.sampleRate);
+            const qint64 count = qMin(std::llround((windowS + 2.0 * marginS) * dub.sampleRate),
+                                      dub.frameCount() - firstFrame);
+            const QList<float> mono = downmix(dubData, dub, firstFrame, count);
+            const QList<float> candidate = onsetEnvelope(mono.constData(), mono.size(), dub.sampleRate);
+
+            AudioOffsetWindow window = correlate(reference, candidate, maxLag);
+            window.startS = starts.at(i);
+            return window;
+        });
+    dubFile.unmap(const_cast<uchar*>(dubData));
+
+    QList<int> offsets;
+    for (const AudioOffsetWindow& window : windows)
+    {
+        if (window.score > 0.0)
+        {
+            result.windows.append(window);
+            offsets.append(window.offsetMs);
+        }
+    }
+    if (offsets.isEmpty())
+    {
+        result.errorString = QStringLiteral("ни в одном окне не нашлось общего звука");
+        return result;
+    }
+
+    std::sort(offsets.begin(), offsets.end());
+    result.offsetMs = offsets.at((offsets.size() - 1) / 2);
+    int agreeing = 0;
+    double scoreSum = 0.0;
+    for (const AudioOffsetWindow& window : std::as_const(result.windows))
+    {
+        if (qAbs(window.offsetMs - result.offsetMs) <= kAgreementMs)
+        {
+            ++agreeing;
+            scoreSum += window.score;
+        }
+    }
+    const double meanScore = scoreSum / agreeing;
+    result.confidence = meanScore * agreeing / starts.size();
+    // Большинство окон должно сойтись на одном сдвиге: случайные пики корреляции так не совпадают
+    result.reliable = agreeing >= 2 && agreeing * 2 > starts.size() && meanScore >= kMinScore;
+    result.elapsedMs = timer.elapsed();
+    result.ok = true;
+    return result;
+}
+} // namespace AudioOffset
@@ -0,0 +1,61 @@
+#ifndef AUDIOOFFSET_H
+#define AUDIOOFFSET_H
+
+#include <QList>
+#include <QString>
+
+/// Сдвиг, найденный в одном окне сравнения.
+struct AudioOffsetWindow
+{
+    double startS = 0.0;
+    int offsetMs = 0;
+    double score = 0.0; // косинусная близость огибающих при найденном сдвиге, 0..1
+};
+
+struct AudioOffsetResult
+{
+    bool ok = false;
+    QString errorString;
+
+    int offsetMs = 0;        // положительный — дубляж звучит позже оригинала
+    double confidence = 0.0; // доля согласных окон, умноженная на их среднюю близость
+    bool reliable = false;
+    QList<AudioOffsetWindow> windows;
+    qint64 elapsedMs = 0;
+};
+
+/**
+ * @brief Поиск сдвига дубляжа относительно оригинальной дорожки.
+ *
+ * Обе дорожки сводятся в моно и превращаются в огибающую атак с шагом 1 мс (положительная разность
+ * логарифма энергии): от громкости сведения и замены голосов она почти не зависит, а музыка и шумы,
+ * общие для дубляжа и оригинала, дают острые пики. Окна огибающих сравниваются взаимной корреляцией
+ * через БПФ в пределах ±kMaxOffsetMs; окна считаются в пуле потоков, итоговый сдвиг — медиана по окнам.
+ */
+namespace AudioOffset
+{
+constexpr int kEnvelopeRate = 1000; // отсчётов огибающей в секунду
+constexpr int kMaxOffsetMs = 2000;
+
+/// Огибающая атак моно-сигнала \a samples с частотой \a sampleRate.
+QList<float> onsetEnvelope(const float* samples, qint64 count, int sampleRate);
+
+/**
+ * @brief Найти сдвиг \a candidate относительно \a reference.
+ * @param candidate огибающая, начинающаяся на \a maxLag отсчётов раньше \a reference и на столько же длиннее её конца
+ * @return offsetMs > 0, если совпадение в \a candidate найдено позже
+ */
+AudioOffsetWindow correlate(const QList<float>& reference, const QList<float>& candidate, int maxLag);
+
+/**
+ * @brief Сравнить WAV дубляжа с оригинальной дорожкой.
+ *
+ * Окна оригинала декодируются одним запуском ffmpeg в моно 8 кГц, окна WAV читаются из отображённого файла.
+ * @param originalPath файл с оригинальным звуком (извлечённая дорожка или исходный контейнер)
+ * @param streamSpecifier поток в \a originalPath для -map без номера входа, например "a:0"
+ */
+AudioOffsetResult detect(const QString& ffmpegPath, const QString& originalPath, const QString& streamSpecifier,
+                         const QString& dubWavPath);
+} // namespace AudioOffset
+
+#endif // AUDIOOFFSET_H
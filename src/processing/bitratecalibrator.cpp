@@ -0,0 +1,346 @@
+#include "bitratecalibrator.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QRegularExpression>
+#include <QThread>
+
+#include <cmath>
+
+namespace
+{
+constexpr int kSampleCount = 5;
+constexpr double kSampleLengthS = 5.0;
+constexpr double kProbeRatio = 0.7; // второе значение -b:v для оценки наклона кривой
+constexpr double kMinFactor = 0.5;
+constexpr double kMaxFactor = 2.0;
+constexpr double kMinExponent = 0.3;
+constexpr double kMaxExponent = 1.5;
+
+// Все опции скорости пресета масштабируются вместе: -minrate 4M у NVENC при уменьшенном -b:v
+// оказался бы выше него, и кодер держал бы прежний битрейт
+const QRegularExpression& rateOptionRegex()
+{
+    static const QRegularExpression re(R"((-(?:b:v|minrate|maxrate|bufsize)\s+)(\d+(?:\.\d+)?)([kKmM]?)\b)");
+    return re;
+}
+
+bool isRateOption(const QString& arg)
+{
+    return arg == "-b:v" || arg == "-minrate" || arg == "-maxrate" || arg == "-bufsize";
+}
+
+double toKbps(double value, const QString& suffix)
+{
+    if (suffix.compare("M", Qt::CaseInsensitive) == 0)
+    {
+        return value * 1000.0;
+    }
+    if (suffix.compare("k", Qt::CaseInsensitive) == 0)
+    {
+        return value;
+    }
+    return value / 1000.0;
+}
+
+QString formatKbps(double kbps)
+{
+    return QString::number(qMax(1, qRound(kbps))) + "k";
+}
+
+QString scaleRateValue(const QString& value, double factor)
+{
+    static const QRegularExpression re(R"(^(\d+(?:\.\d+)?)([kKmM]?)$)");
+    const QRegularExpressionMatch m = re.match(value);
+    return m.hasMatch() ? formatKbps(toKbps(m.captured(1).toDouble(), m.captured(2)) * factor) : value;
+}
+
+double videoBitrateSettingKbps(const QString& command)
+{
+    static const QRegularExpression re(R"(-b:v\s+(\d+(?:\.\d+)?)([kKmM]?)\b)");
+    const QRegularExpressionMatch m = re.match(command);
+    return m.hasMatch() ? toKbps(m.captured(1).toDouble(), m.captured(2)) : 0.0;
+}
+
+bool isHardwareEncoder(const QStringList& args)
+{
+    const qsizetype idx = args.indexOf("-c:v");
+    const QString encoder = (idx >= 0 && idx + 1 < args.size()) ? args.at(idx + 1) : QString();
+    return encoder.contains("nvenc") || encoder.contains("qsv") || encoder.contains("amf");
+}
+} // namespace
+
+QString BitrateCalibrator::scaleRateOptions(const QString& command, double factor)
+{
+    QString result;
+    qsizetype last = 0;
+    auto it = rateOptionRegex().globalMatch(command);
+    while (it.hasNext())
+    {
+        const QRegularExpressionMatch m = it.next();
+        result += command.mid(last, m.capturedStart() - last);
+        result += m.captured(1) + formatKbps(toKbps(m.captured(2).toDouble(), m.captured(3)) * factor);
+        last = m.capturedEnd();
+    }
+    result += command.mid(last);
+    return result;
+}
+
+QStringList BitrateCalibrator::scaleRateArgs(QStringList args, double factor)
+{
+    for (int i = 0; i + 1 < args.size(); ++i)
+    {
+        if (isRateOption(args.at(i)))
+        {
+            args[i + 1] = scaleRateValue(args.at(i + 1), factor);
+        }
+    }
+    return args;
+}
+
+double BitrateCalibrator::fitExponent(double baseKbps, double probeKbps, double probeRatio)
+{
+    // bitrate = a * setting^k  =>  k = ln(m1/m0) / ln(s1/s0)
+    double exponent = std::log(probeKbps / baseKbps) / std::log(probeRatio);
+    if (!std::isfinite(exponent))
+    {
+        exponent = 1.0;
+    }
+    return qBound(kMinExponent, exponent, kMaxExponent);
+}
+
+double BitrateCalibrator::correctionFactor(double targetKbps, double measuredKbps, double exponent)
+{
+    const double factor = std::pow(targetKbps / measuredKbps, 1.0 / exponent);
+    return std::isfinite(factor) ? qBound(kMinFactor, factor, kMaxFactor) : 1.0;
+}
+
+BitrateCalibrator::BitrateCalibrator(const RenderPreset& preset, const QStringList& videoArgs,
+                                     const QString& workingDir, double durationS, QObject* parent)
+    : QObject(parent), m_preset(preset), m_videoArgs(videoArgs), m_workingDir(workingDir), m_durationS(durationS)
+{
+    m_baseSettingKbps = videoBitrateSettingKbps(m_preset.commandPass1);
+}
+
+bool BitrateCalibrator::isApplicable(const RenderPreset& preset, double durationS)
+{
+    return !preset.isTwoPass() && preset.targetBitrateKbps > 0 && videoBitrateSettingKbps(preset.commandPass1) > 0 &&
+           durationS >= kSampleCount * kSampleLengthS * 4;
+}
+
+void BitrateCalibrator::start()
+{
+    if (!m_tempDir.isValid())
+    {
+        finishUnchanged("не удалось создать временную папку");
+        return;
+    }
+
+    // NVENC/QSV ограничены числом одновременных сессий, CPU-кодеры и так используют все ядра
+    m_maxParallel = isHardwareEncoder(m_videoArgs) ? 2 : qBound(1, QThread::idealThreadCount() / 4, 4);
+
+    const double span = m_durationS - kSampleLengthS;
+    for (double ratio : {1.0, kProbeRatio})
+    {
+        for (int i = 0; i < kSampleCount; ++i)
+        {
+            SampleJob job;
+            job.startS = span * (i + 0.5) / kSampleCount;
+            job.settingKbps = m_baseSettingKbps * ratio;
+            job.outputPath = QDir(m_tempDir.path()).filePath(QString("sample_%1.mp4").arg(m_jobs.size()));
+            m_jobs.append(job);
+        }
+    }
+
+    emit logMessage(QString("Калибровка битрейта: %1 фрагментов по %2 с, -b:v %3 и %4 kbps, параллельно %5.")
+                        .arg(m_jobs.size())
+                        .arg(kSampleLengthS)
+                        .arg(qRound(m_baseSettingKbps))
+                        .arg(qRound(m_baseSettingKbps * kProbeRatio))
+                        .arg(m_maxParallel));
+
+    for (int i = 0; i < m_maxParallel; ++i)
+    {
+        launchNext();
+    }
+}
+
+void BitrateCalibrator::cancel()
+{
+    m_failed = true;
+    m_done = true;
+    for (QProcess* process : std::as_const(m_running))
+    {
+        process->disconnect(this);
+        process->kill();
+        process->waitForFinished(3000);
+    }
+    m_running.clear();
+    deleteLater();
+}
+
+QStringList BitrateCalibrator::buildSampleArgs(const SampleJob& job) const
+{
+    QStringList args = scaleRateArgs(m_videoArgs, job.settingKbps / m_baseSettingKbps);
+
+    // -copyts сохраняет исходные метки времени, иначе фильтр subtitles рисовал бы надписи с нуля серии
+    const qsizetype inputIdx = args.indexOf("-i");
+    if (inputIdx < 0 || args.size() < 2)
+    {
+        return {};
+    }
+    args.insert(inputIdx, "-copyts");
+    args.insert(inputIdx, QString::number(kSampleLengthS, 'f', 3));
+    args.insert(inputIdx, "-t");
+    args.insert(inputIdx, QString::number(job.startS, 'f', 3));
+    args.insert(inputIdx, "-ss");
+    if (!args.contains("-y"))
+    {
+        args.prepend("-y");
+    }
+    args.last() = job.outputPath;
+    return args;
+}
+
+void BitrateCalibrator::launchNext()
+{
+    if (m_failed || m_nextJob >= m_jobs.size())
+    {
+        return;
+    }
+
+    const int jobIndex = m_nextJob++;
+    const QStringList args = buildSampleArgs(m_jobs.at(jobIndex));
+    if (args.isEmpty())
+    {
+        m_failed = true;
+        finishUnchanged("не найден вход -i в команде пресета");
+        return;
+    }
+
+    auto* process = new QProcess(this);
+    process->setWorkingDirectory(m_workingDir);
+    if (!m_environment.isEmpty())
+    {
+        process->setProcessEnvironment(m_environment);
+    }
+    // Вывод не читаем: без этого ffmpeg упрётся в заполненный буфер stderr
+    process->setStandardOutputFile(QProcess::nullDevice());
+    process->setStandardErrorFile(QProcess::nullDevice());
+    connect(process, &QProcess::finished, this,
+            [this, process, jobIndex](int exitCode, QProcess::ExitStatus exitStatus)
+            {
+                m_running.removeOne(process);
+                process->deleteLater();
+                onJobFinished(jobIndex, exitCode, exitStatus);
+            });
+    connect(process, &QProcess::errorOccurred, this,
+            [this](QProcess::ProcessError error)
+            {
+                if (error == QProcess::FailedToStart)
+                {
+                    m_failed = true;
+                    finishUnchanged("не удалось запустить ffmpeg");
+                }
+            });
+    m_running.append(process);
+    process->start(AppSettings::instance().ffmpegPath(), args);
+}
+
+void BitrateCalibrator::onJobFinished(int jobIndex, int exitCode, QProcess::ExitStatus exitStatus)
+{
+    if (m_done)
+    {
+        return;
+    }
+
+    SampleJob& job = m_jobs[jobIndex];
+    const qint64 bytes = QFileInfo(job.outputPath).size();
+    if (exitCode != 0 || exitStatus != QProcess::NormalExit || bytes <= 0)
+    {
+        m_failed = true;
+        finishUnchanged(QString("фрагмент %1 не закодирован (код %2)").arg(jobIndex + 1).arg(exitCode));
+        return;
+    }
+
+    const double lengthS = qMin(kSampleLengthS, m_durationS - job.startS);
+    job.measuredKbps = static_cast<double>(bytes) * 8.0 / lengthS / 1000.0;
+    QFile::remove(job.outputPath);
+
+    ++m_completedJobs;
+    if (m_completedJobs == m_jobs.size())
+    {
+        finishCalibration();
+        return;
+    }
+    launchNext();
+}
+
+void BitrateCalibrator::finishCalibration()
+{
+    double baseSum = 0.0;
+    double probeSum = 0.0;
+    for (int i = 0; i < kSampleCount; ++i)
+    {
+        baseSum += m_jobs.at(i).measuredKbps;
+        probeSum += m_jobs.at(kSampleCount + i).measuredKbps;
+    }
+    const double baseKbps = baseSum / kSampleCount;
+    const double probeKbps = probeSum / kSampleCount;
+
+    const double exponent = fitExponent(baseKbps, probeKbps, kProbeRatio);
+    const double target = m_preset.targetBitrateKbps;
+    const double factor = correctionFactor(target, baseKbps, exponent);
+
+    emit logMessage(QString("Калибровка битрейта: при -b:v %1 kbps фрагменты дали %2 kbps, при %3 — %4 kbps "
+                            "(показатель %5). Цель %6 kbps.")
+                        .arg(qRound(m_baseSettingKbps))
+                        .arg(qRound(baseKbps))
+                        .arg(qRound(m_baseSettingKbps * kProbeRatio))
+                        .arg(qRound(probeKbps))
+                        .arg(exponent, 0, 'f', 2)
+                        .arg(qRound(target)));
+
+    if (qAbs(factor - 1.0) < 0.02)
+    {
+        finishUnchanged("поправка не требуется");
+        return;
+    }
+
+    RenderPreset adjusted = m_preset;
+    adjusted.commandPass1 = scaleRateOptions(m_preset.commandPass1, factor);
+    if (!adjusted.commandPass2.isEmpty())
+    {
+        adjusted.commandPass2 = scaleRateOptions(m_preset.commandPass2, factor);
+    }
+
+    emit logMessage(QString("Калибровка битрейта: -b:v %1 -> %2 (x%3).")
+                        .arg(formatKbps(m_baseSettingKbps))
+                        .arg(formatKbps(m_baseSettingKbps * factor))
+                        .arg(factor, 0, 'f', 3));
+    m_done = true;
+    emit finished(adjusted, true);
+    deleteLater();
+}
+
+void BitrateCalibrator::finishUnchanged(const QString& reason)
+{
+    if (m_done)
+    {
+        return;
+    }
+    m_done = true;
+    for (QProcess* process : std::as_const(m_running))
+    {
+        process->disconnect(this);
+        process->kill();
+        process->waitForFinished(3000);
+    }
+    m_running.clear();
+
+    emit logMessage("Калибровка битрейта: " + reason + ". Рендер с исходными настройками пресета.", LogCategory::APP,
+                    LogLevel::Info);
+    emit finished(m_preset, false);
+    deleteLater();
+}
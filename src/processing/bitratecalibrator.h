@@ -0,0 +1,85 @@
+#ifndef BITRATECALIBRATOR_H
+#define BITRATECALIBRATOR_H
+
+#include "appsettings.h"
+
+#include <QList>
+#include <QObject>
+#include <QProcess>
+#include <QProcessEnvironment>
+#include <QTemporaryDir>
+
+/// Предсказательная калибровка битрейта для однопроходных VBR-пресетов (NVENC/QSV).
+/// Кодирует несколько коротких фрагментов по всей серии (с тем же графом фильтров, т.е. с надписями)
+/// на двух значениях -b:v, подбирает степенную зависимость bitrate = a * setting^k и
+/// пересчитывает -b:v / -minrate / -maxrate / -bufsize в пресете так, чтобы попасть в targetBitrateKbps.
+class BitrateCalibrator : public QObject
+{
+    Q_OBJECT
+
+public:
+    /// \a videoArgs — готовые аргументы ffmpeg для видеопрохода (после подстановки %INPUT%/%SIGNS%),
+    /// \a workingDir — рабочая папка, относительно которой указан файл субтитров в фильтре.
+    BitrateCalibrator(const RenderPreset& preset, const QStringList& videoArgs, const QString& workingDir,
+                      double durationS, QObject* parent = nullptr);
+
+    /// Имеет ли смысл калибровка: однопроходный пресет с целевым битрейтом и явным -b:v.
+    static bool isApplicable(const RenderPreset& preset, double durationS);
+
+    /// Умножает значения всех -b:v / -minrate / -maxrate / -bufsize в строке команды пресета на \a factor.
+    static QString scaleRateOptions(const QString& command, double factor);
+    /// То же для готового списка аргументов ffmpeg.
+    static QStringList scaleRateArgs(QStringList args, double factor);
+    /// Показатель k зависимости bitrate = a * setting^k по двум замерам: при исходном -b:v и при
+    /// -b:v, умноженном на \a probeRatio. Ограничен разумным диапазоном, при вырожденных замерах — 1.
+    static double fitExponent(double baseKbps, double probeKbps, double probeRatio);
+    /// Во сколько раз изменить -b:v, чтобы \a measuredKbps стал \a targetKbps; ограничено 0.5..2.
+    static double correctionFactor(double targetKbps, double measuredKbps, double exponent);
+
+    /// Окружение ffmpeg для фрагментов, например FONTCONFIG_FILE из подготовки шрифтов рендера.
+    void setProcessEnvironment(const QProcessEnvironment& environment)
+    {
+        m_environment = environment;
+    }
+
+    void start();
+    void cancel();
+
+signals:
+    void logMessage(const QString& message, LogCategory category = LogCategory::APP, LogLevel level = LogLevel::Info);
+    /// \a preset — скорректированный пресет (или исходный, если калибровка не удалась/не нужна).
+    void finished(const RenderPreset& preset, bool adjusted);
+
+private:
+    struct SampleJob
+    {
+        double startS = 0.0;
+        double settingKbps = 0.0;
+        QString outputPath;
+        double measuredKbps = 0.0;
+    };
+
+    void launchNext();
+    void onJobFinished(int jobIndex, int exitCode, QProcess::ExitStatus exitStatus);
+    void finishCalibration();
+    void finishUnchanged(const QString& reason);
+    QStringList buildSampleArgs(const SampleJob& job) const;
+
+    RenderPreset m_preset;
+    QStringList m_videoArgs;
+    QString m_workingDir;
+    QProcessEnvironment m_environment;
+    double m_durationS = 0.0;
+    double m_baseSettingKbps = 0.0;
+
+    QTemporaryDir m_tempDir;
+    QList<SampleJob> m_jobs;
+    QList<QProcess*> m_running;
+    int m_nextJob = 0;
+    int m_completedJobs = 0;
+    int m_maxParallel = 1;
+    bool m_failed = false;
+    bool m_done = false;
+};
+
+#endif // BITRATECALIBRATOR_H
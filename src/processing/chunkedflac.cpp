@@ -0,0 +1,732 @@
+#include "chunkedflac.h"
+
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QFuture>
+#include <QProcess>
+#include <QSaveFile>
+#include <QTemporaryDir>
+#include <QtConcurrent/QtConcurrentMap>
+#include <QtConcurrent/QtConcurrentRun>
+#include <QtEndian>
+
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <vector>
+
+namespace
+{
+constexpr int kChunkTimeoutMs = 30 * 60 * 1000;
+constexpr int kCancelPollMs = 200;
+constexpr int kStreamInfoSize = 34;
+constexpr int kSeekPointSize = 18;
+constexpr quint8 kBlockStreamInfo = 0;
+constexpr quint8 kBlockSeekTable = 3;
+constexpr quint8 kBlockVorbisComment = 4;
+constexpr quint8 kLastBlockFlag = 0x80;
+
+struct CrcTables
+{
+    std::array<quint8, 256> crc8{};
+    std::array<quint16, 256> crc16{};
+
+    CrcTables()
+    {
+        // Полиномы FLAC: x^8 + x^2 + x + 1 для заголовка кадра и x^16 + x^15 + x^2 + 1 для всего кадра
+        for (int i = 0; i < 256; ++i)
+        {
+            quint8 c8 = quint8(i);
+            quint16 c16 = quint16(i << 8);
+            for (int bit = 0; bit < 8; ++bit)
+            {
+                c8 = quint8((c8 & 0x80) ? (c8 << 1) ^ 0x07 : c8 << 1);
+                c16 = quint16((c16 & 0x8000) ? (c16 << 1) ^ 0x8005 : c16 << 1);
+            }
+            crc8[i] = c8;
+            crc16[i] = c16;
+        }
+    }
+};
+
+const CrcTables& crcTables()
+{
+    static const CrcTables tables;
+    return tables;
+}
+
+quint8 crc8(const uchar* data, qsizetype size)
+{
+    quint8 crc = 0;
+    for (qsizetype i = 0; i < size; ++i)
+    {
+        crc = crcTables().crc8[crc ^ data[i]];
+    }
+    return crc;
+}
+
+quint16 updateCrc16(quint16 crc, const uchar* data, qsizetype size)
+{
+    const CrcTables& tables = crcTables();
+    for (qsizetype i = 0; i < size; ++i)
+    {
+        crc = quint16((crc << 8) ^ tables.crc16[(crc >> 8) ^ data[i]]);
+    }
+    return crc;
+}
+
+/// Номер кадра в «UTF-8» кодировке FLAC; 0 — байты не складываются в номер.
+int readCodedNumber(const uchar* p, qsizetype available, quint64* value)
+{
+    if (available < 1)
+    {
+        return 0;
+    }
+    // Число ведущих единиц первого байта — длина кода, как в UTF-8, но до 7 байт
+    int length = 0;
+    while (length < 8 && (p[0] & (0x80 >> length)))
+    {
+        ++length;
+    }
+    if (length == 1 || length == 8)
+    {
+        return 0;
+    }
+    length = qMax(1, length);
+    if (length > available)
+    {
+        return 0;
+    }
+    quint64 result = length == 1 ? p[0] : p[0] & (0x7F >> length);
+    for (int i = 1; i < length; ++i)
+    {
+        if ((p[i] & 0xC0) != 0x80)
+        {
+            return 0;
+        }
+        result = result << 6 | (p[i] & 0x3F);
+    }
+    *value = result;
+    return length;
+}
+
+QByteArray codedNumber(quint64 value)
+{
+    if (value < 0x80)
+    {
+        return QByteArray(1, char(value));
+    }
+    // В n байтах помещается (7 - n) + 6 * (n - 1) бит
+    int length = 2;
+    while (length < 7 && value >= (quint64(1) << (5 * length + 1)))
+    {
+        ++length;
+    }
+    QByteArray bytes(length, '\0');
+    for (int i = length - 1; i > 0; --i)
+    {
+        bytes[i] = char(0x80 | (value & 0x3F));
+        value >>= 6;
+    }
+    bytes[0] = char((0xFF00 >> length) | value);
+    return bytes;
+}
+
+struct FrameHeader
+{
+    int length = 0; // вместе с CRC-8
+    quint64 number = 0;
+    int numberLength = 0;
+    int blockSize = 0;
+};
+
+/// Заголовок кадра с фиксированным размером блока (номер кадра, а не отсчёта) и верной CRC-8.
+bool parseFrameHeader(const uchar* p, qsizetype available, FrameHeader* header)
+{
+    if (available < 6 || p[0] != 0xFF || p[1] != 0xF8)
+    {
+        return false;
+    }
+    const int sizeCode = p[2] >> 4;
+    const int rateCode = p[2] & 0x0F;
+    const int channelCode = p[3] >> 4;
+    const int sampleSizeCode = (p[3] >> 1) & 0x07;
+    if (sizeCode == 0 || rateCode == 0x0F || channelCode > 10 || sampleSizeCode == 3 || (p[3] & 1))
+    {
+        return false;
+    }
+    qsizetype pos = 4;
+    header->numberLength = readCodedNumber(p + pos, available - pos, &header->number);
+    if (header->numberLength == 0 || header->numberLength > 6)
+    {
+        return false;
+    }
+    pos += header->numberLength;
+
+    if (sizeCode == 1)
+    {
+        header->blockSize = 192;
+    }
+    else if (sizeCode <= 5)
+    {
+        header->blockSize = 576 << (sizeCode - 2);
+    }
+    else if (sizeCode == 6 && pos + 1 <= available)
+    {
+        header->blockSize = p[pos] + 1;
+        pos += 1;
+    }
+    else if (sizeCode == 7 && pos + 2 <= available)
+    {
+        header->blockSize = qFromBigEndian<quint16>(p + pos) + 1;
+        pos += 2;
+    }
+    else if (sizeCode >= 8)
+    {
+        header->blockSize = 256 << (sizeCode - 8);
+    }
+    else
+    {
+        return false;
+    }
+    pos += rateCode == 12 ? 1 : (rateCode == 13 || rateCode == 14) ? 2 : 0;
+    if (pos + 1 > available || crc8(p, pos) != p[pos])
+    {
+        return false;
+    }
+    header->length = int(pos + 1);
+    return true;
+}
+
+/// Число каналов по коду назначения: 8–10 — стерео с left/side, right/side или mid/side.
+int channelCount(int channelCode)
+{
+    return channelCode < 8 ? channelCode + 1 : 2;
+}
+
+/**
+ * Частота, число каналов и разрядность в заголовках кадров совпадают. Назначение каналов кодер выбирает
+ * для каждого стереокадра заново, а код размера блока у последнего кадра другой, поэтому они не сравниваются.
+ */
+bool sameFormat(const uchar* a, const uchar* b)
+{
+    return (a[2] & 0x0F) == (b[2] & 0x0F) && channelCount(a[3] >> 4) == channelCount(b[3] >> 4) &&
+           (a[3] & 0x0E) == (b[3] & 0x0E);
+}
+
+struct Frame
+{
+    qint64 offset = 0;
+    qint64 size = 0;
+    FrameHeader header;
+};
+
+struct StreamFormat
+{
+    int minBlockSize = 0;
+    int maxBlockSize = 0;
+    int sampleRate = 0;
+    int channels = 0;
+    int bitsPerSample = 0;
+    qint64 totalSamples = 0;
+};
+
+/// Разобранный FLAC-файл куска, отображённый в память.
+struct Chunk
+{
+    std::unique_ptr<QFile> file;
+    const uchar* data = nullptr;
+    qint64 size = 0;
+    StreamFormat format;
+    QByteArray vorbisComment; // содержимое блока, без заголовка
+    QList<Frame> frames;
+    qint64 samples = 0;
+    QString errorString;
+};
+
+bool parseMetadata(Chunk& chunk, qint64* framesOffset)
+{
+    const uchar* data = chunk.data;
+    if (chunk.size < 4 + 4 + kStreamInfoSize || std::memcmp(data, "fLaC", 4) != 0)
+    {
+        chunk.errorString = QStringLiteral("не FLAC");
+        return false;
+    }
+    qint64 pos = 4;
+    bool hasStreamInfo = false;
+    for (bool last = false; !last;)
+    {
+        if (pos + 4 > chunk.size)
+        {
+            chunk.errorString = QStringLiteral("обрезаны метаданные");
+            return false;
+        }
+        last = data[pos] & kLastBlockFlag;
+        const quint8 type = data[pos] & 0x7F;
+        const qint64 length = qint64(data[pos + 1]) << 16 | qint64(data[pos + 2]) << 8 | data[pos + 3];
+        pos += 4;
+        if (pos + length > chunk.size)
+        {
+            chunk.errorString = QStringLiteral("обрезаны метаданные");
+            return false;
+        }
+        if (type == kBlockStreamInfo && length == kStreamInfoSize)
+        {
+            const uchar* info = data + pos;
+            chunk.format.minBlockSize = qFromBigEndian<quint16>(info);
+            chunk.format.maxBlockSize = qFromBigEndian<quint16>(info + 2);
+            const quint64 packed = qFromBigEndian<quint64>(info + 10);
+            chunk.format.sampleRate = int(packed >> 44);
+            chunk.format.channels = int((packed >> 41) & 0x07) + 1;
+            chunk.format.bitsPerSample = int((packed >> 36) & 0x1F) + 1;
+            chunk.format.totalSamples = qint64(packed & 0xFFFFFFFFFULL);
+            hasStreamInfo = true;
+        }
+        else if (type == kBlockVorbisComment)
+        {
+            chunk.vorbisComment = QByteArray(reinterpret_cast<const char*>(data + pos), length);
+        }
+        pos += length;
+    }
+    if (!hasStreamInfo || chunk.format.minBlockSize != chunk.format.maxBlockSize)
+    {
+        chunk.errorString = QStringLiteral("нет STREAMINFO или размер блока не фиксирован");
+        return false;
+    }
+    *framesOffset = pos;
+    return true;
+}
+
+/**
+ * Границы кадров без разбора подкадров: следующий кадр начинается там, где встречается синхрослово
+ * со следующим номером и верной CRC-8, а CRC-16 всего, что было до него с начала текущего кадра, сходится.
+ */
+bool parseChunk(Chunk& chunk)
+{
+    if (!chunk.file->open(QIODevice::ReadOnly))
+    {
+        chunk.errorString = chunk.file->errorString();
+        return false;
+    }
+    chunk.size = chunk.file->size();
+    chunk.data = chunk.file->map(0, chunk.size);
+    if (chunk.data == nullptr)
+    {
+        chunk.errorString = chunk.file->errorString();
+        return false;
+    }
+    qint64 start = 0;
+    if (!parseMetadata(chunk, &start))
+    {
+        return false;
+    }
+
+    const uchar* data = chunk.data;
+    FrameHeader header;
+    if (!parseFrameHeader(data + start, chunk.size - start, &header) || header.number != 0)
+    {
+        chunk.errorString = QStringLiteral("нет первого кадра");
+        return false;
+    }
+    for (;;)
+    {
+        quint16 crc = 0;
+        qint64 next = -1;
+        FrameHeader nextHeader;
+        for (qint64 p = start; p < chunk.size; ++p)
+        {
+            if (crc == 0 && p >= start + header.length + 2 && data[p] == 0xFF && p + 1 < chunk.size &&
+                data[p + 1] == 0xF8 && parseFrameHeader(data + p, chunk.size - p, &nextHeader) &&
+                nextHeader.number == header.number + 1 && sameFormat(data + p, data + start))
+            {
+                next = p;
+                break;
+            }
+            crc = quint16((crc << 8) ^ crcTables().crc16[(crc >> 8) ^ data[p]]);
+        }
+        if (next < 0 && crc != 0)
+        {
+            chunk.errorString = QStringLiteral("кадр %1 повреждён").arg(header.number);
+            return false;
+        }
+        const qint64 end = next < 0 ? chunk.size : next;
+        chunk.frames.append({start, end - start, header});
+        chunk.samples += header.blockSize;
+        if (next < 0)
+        {
+            break;
+        }
+        start = next;
+        header = nextHeader;
+    }
+    // Размер блока в заголовке может быть закодирован явно (последний неполный кадр), он проверяется по сумме
+    if (chunk.format.totalSamples != 0 && chunk.format.totalSamples != chunk.samples)
+    {
+        chunk.errorString = QStringLiteral("в кадрах %1 отсчётов, в STREAMINFO %2")
+                                .arg(chunk.samples)
+                                .arg(chunk.format.totalSamples);
+        return false;
+    }
+    return true;
+}
+
+void appendBlockHeader(QByteArray& out, quint8 type, bool last, qint64 length)
+{
+    out.append(char(type | (last ? kLastBlockFlag : 0)));
+    out.append(char((length >> 16) & 0xFF));
+    out.append(char((length >> 8) & 0xFF));
+    out.append(char(length & 0xFF));
+}
+
+template<typename T>
+void appendBigEndian(QByteArray& out, T value)
+{
+    uchar bytes[sizeof(T)];
+    qToBigEndian(value, bytes);
+    out.append(reinterpret_cast<const char*>(bytes), sizeof(T));
+}
+
+bool isCancelled(const std::atomic_bool* cancelled)
+{
+    return cancelled != nullptr && cancelled->load();
+}
+
+/// Дождаться успешного завершения ffmpeg; по отмене или таймауту процесс убивается.
+bool waitForFfmpeg(QProcess& ffmpeg, const std::atomic_bool* cancelled)
+{
+    QElapsedTimer timer;
+    timer.start();
+    while (!ffmpeg.waitForFinished(kCancelPollMs))
+    {
+        if (ffmpeg.state() == QProcess::NotRunning)
+        {
+            return false;
+        }
+        if (isCancelled(cancelled) || timer.hasExpired(kChunkTimeoutMs))
+        {
+            ffmpeg.kill();
+            ffmpeg.waitForFinished();
+            return false;
+        }
+    }
+    return ffmpeg.exitStatus() == QProcess::NormalExit && ffmpeg.exitCode() == 0;
+}
+
+/// MD5 несжатого звука в формате FLAC: отсчёты со знаком, little-endian, по целому числу байт.
+QByteArray pcmMd5(const QString& ffmpegPath, const QString& wavPath, const QString& filter, int bitsPerSample,
+                  const std::atomic_bool* cancelled)
+{
+    QProcess ffmpeg;
+    ffmpeg.start(ffmpegPath, {"-v", "error", "-nostdin", "-i", wavPath, "-af", filter, "-c:a",
+                              bitsPerSample == 16 ? "pcm_s16le" : "pcm_s24le", "-f", "md5", "-"});
+    if (!waitForFfmpeg(ffmpeg, cancelled))
+    {
+        return {};
+    }
+    const QByteArray output = ffmpeg.readAllStandardOutput().trimmed();
+    const QByteArray md5 = output.startsWith("MD5=") ? QByteArray::fromHex(output.mid(4)) : QByteArray();
+    return md5.size() == 16 ? md5 : QByteArray();
+}
+
+/// Разрядность из STREAMINFO закодированного куска; 0 — не прочиталась.
+int streamBitsPerSample(const QString& path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        return 0;
+    }
+    const QByteArray head = file.read(8 + kStreamInfoSize);
+    if (head.size() < 8 + kStreamInfoSize || !head.startsWith("fLaC") || (head.at(4) & 0x7F) != kBlockStreamInfo)
+    {
+        return 0;
+    }
+    const quint64 packed = qFromBigEndian<quint64>(head.constData() + 8 + 10);
+    return int((packed >> 36) & 0x1F) + 1;
+}
+
+ChunkedFlacResult fail(const QString& reason)
+{
+    ChunkedFlacResult result;
+    result.errorString = reason;
+    return result;
+}
+} // namespace
+
+namespace ChunkedFlac
+{
+int chunkCount(const WavInfo& wav, int threads)
+{
+    // 24 бита в 32-битном контейнере и float ffmpeg кодирует в другую разрядность, MD5 бы не сошёлся
+    if (!wav.ok || wav.isFloat || (wav.bitsPerSample != 16 && wav.bitsPerSample != 24) ||
+        wav.containerBytes() * 8 != wav.bitsPerSample)
+    {
+        return 1;
+    }
+    return int(qBound<qint64>(1, qint64(wav.durationS() / kMinChunkS), qMax(1, threads)));
+}
+
+ChunkedFlacResult encode(const QString& ffmpegPath, const QString& wavPath, int chunks, int offsetMs, double gainDb,
+                         const QString& outputPath, const std::atomic_bool* cancelled)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    const WavInfo wav = WavFile::readHeader(wavPath);
+    if (!wav.ok)
+    {
+        return fail(wav.errorString);
+    }
+    // Выходной отсчёт n — это входной n + shift: shift > 0 обрезает начало, shift < 0 — тишина в начале
+    const qint64 shift = std::llround(offsetMs * double(wav.sampleRate) / 1000.0);
+    const qint64 total = wav.frameCount() - shift;
+    const qint64 blocks = (total + kBlockSize - 1) / kBlockSize;
+    const qint64 chunkSamples = (blocks + chunks - 1) / qMax(1, chunks) * kBlockSize;
+    if (total <= 0 || chunkSamples <= 0 || -shift >= chunkSamples)
+    {
+        return fail(QStringLiteral("нечего кодировать"));
+    }
+    QList<int> indexes;
+    for (qint64 from = 0; from < total; from += chunkSamples)
+    {
+        indexes.append(indexes.size());
+    }
+
+    QTemporaryDir tempDir(QFileInfo(outputPath).dir().filePath("flac_chunks_XXXXXX"));
+    if (!tempDir.isValid())
+    {
+        return fail(tempDir.errorString());
+    }
+    const QString volume = gainDb != 0.0 ? QString(",volume=%1dB").arg(gainDb, 0, 'f', 2) : QString();
+    const QString shiftFilter = shift > 0   ? QString("atrim=start_sample=%1,asetpts=PTS-STARTPTS").arg(shift)
+                                : shift < 0 ? QString("adelay=%1S:all=1").arg(-shift)
+                                            : QString("anull");
+    QFuture<QByteArray> md5Future = QtConcurrent::run(
+        [=]() { return pcmMd5(ffmpegPath, wavPath, shiftFilter + volume, wav.bitsPerSample, cancelled); });
+
+    const QStringList errors = QtConcurrent::blockingMapped(
+        indexes,
+        [&](int index) -> QString
+        {
+            if (isCancelled(cancelled))
+            {
+                return QStringLiteral("отменено");
+            }
+            const qint64 from = index * chunkSamples + shift;
+            const qint64 to = qMin(total, (index + 1) * chunkSamples) + shift;
+            QStringList args{"-v", "error", "-nostdin", "-y"};
+            QString filter;
+            if (from >= 0)
+            {
+                // Грубый переход на секунду раньше, точная граница — по времени: с -copyts pts входа сохраняются,
+                // а start_sample/end_sample считали бы отсчёты от точки перехода, а не от начала файла.
+                // atrim переводит время в номер отсчёта с округлением, микросекунд для этого хватает.
+                const auto seconds = [&](qint64 sample)
+                {
+                    return QString::number(double(sample) / wav.sampleRate, 'f', 6);
+                };
+                args << "-ss" << QString::number(qMax(0.0, double(from) / wav.sampleRate - 1.0), 'f', 6) << "-copyts";
+                filter = QString("atrim=start=%1:end=%2,asetpts=PTS-STARTPTS").arg(seconds(from), seconds(to));
+            }
+            else
+            {
+                filter = QString("atrim=end_sample=%1,asetpts=PTS-STARTPTS,adelay=%2S:all=1").arg(to).arg(-from);
+            }
+            args << "-i" << wavPath << "-af" << filter + volume << "-c:a" << "flac" << "-frame_size"
+                 << QString::number(kBlockSize) << "-f" << "flac" << tempDir.filePath(QString("%1.flac").arg(index));
+
+            QProcess ffmpeg;
+            ffmpeg.start(ffmpegPath, args);
+            if (!waitForFfmpeg(ffmpeg, cancelled))
+            {
+                return QStringLiteral("ffmpeg: ") + QString::fromUtf8(ffmpeg.readAllStandardError()).trimmed();
+            }
+            return {};
+        });
+    QByteArray md5 = md5Future.result();
+    if (isCancelled(cancelled))
+    {
+        return fail(QStringLiteral("отменено"));
+    }
+
+    QStringList paths;
+    for (int index : std::as_const(indexes))
+    {
+        if (!errors.at(index).isEmpty())
+        {
+            return fail(errors.at(index));
+        }
+        paths.append(tempDir.filePath(QString("%1.flac").arg(index)));
+    }
+    // MD5 посчитан по отсчётам исходной разрядности; если ffmpeg закодировал в другую, он бы не сошёлся
+    if (streamBitsPerSample(paths.constFirst()) != wav.bitsPerSample)
+    {
+        md5.clear();
+    }
+    ChunkedFlacResult result = stitch(paths, outputPath, md5);
+    if (result.ok && result.totalSamples != total)
+    {
+        QFile::remove(outputPath);
+        result = fail(QStringLiteral("в склеенном потоке %1 отсчётов вместо %2").arg(result.totalSamples).arg(total));
+    }
+    result.chunks = paths.size();
+    result.elapsedMs = timer.elapsed();
+    return result;
+}
+
+ChunkedFlacResult stitch(const QStringList& chunkPaths, const QString& outputPath, const QByteArray& md5)
+{
+    if (chunkPaths.isEmpty())
+    {
+        return fail(QStringLiteral("нет кусков"));
+    }
+    std::vector<Chunk> chunks(chunkPaths.size());
+    for (qsizetype i = 0; i < chunkPaths.size(); ++i)
+    {
+        chunks[i].file = std::make_unique<QFile>(chunkPaths.at(i));
+    }
+    // Поиск границ кадров — проход CRC-16 по всему файлу, куски разбираются параллельно
+    QtConcurrent::blockingMap(chunks, [](Chunk& chunk) { parseChunk(chunk); });
+
+    const StreamFormat& format = chunks.front().format;
+    for (size_t i = 0; i < chunks.size(); ++i)
+    {
+        const Chunk& chunk = chunks[i];
+        if (!chunk.errorString.isEmpty())
+        {
+            return fail(QFileInfo(chunkPaths.at(i)).fileName() + ": " + chunk.errorString);
+        }
+        if (chunk.format.sampleRate != format.sampleRate || chunk.format.channels != format.channels ||
+            chunk.format.bitsPerSample != format.bitsPerSample || chunk.format.maxBlockSize != format.maxBlockSize)
+        {
+            return fail(QFileInfo(chunkPaths.at(i)).fileName() + ": формат отличается от первого куска");
+        }
+        // Неполным в потоке с фиксированным блоком может быть только последний кадр
+        if (i + 1 < chunks.size() && chunk.samples != chunk.frames.size() * qint64(format.maxBlockSize))
+        {
+            return fail(QFileInfo(chunkPaths.at(i)).fileName() + ": кусок не кратен размеру блока");
+        }
+    }
+
+    // Размеры кадров после перенумерации: номер в UTF-8 кодировке может стать длиннее
+    struct Placement
+    {
+        quint64 number = 0;
+        QByteArray codedNumber;
+        qint64 size = 0;
+    };
+    std::vector<std::vector<Placement>> placements(chunks.size());
+    quint64 number = 0;
+    qint64 totalSamples = 0;
+    qint64 minFrameSize = std::numeric_limits<qint64>::max();
+    qint64 maxFrameSize = 0;
+    QByteArray seekTable;
+    int seekPoints = 0;
+    qint64 nextSeekSample = 0;
+    const qint64 seekInterval = qMax<qint64>(1, qint64(kSeekPointIntervalS * format.sampleRate));
+    qint64 offset = 0;
+    for (size_t i = 0; i < chunks.size(); ++i)
+    {
+        for (const Frame& frame : std::as_const(chunks[i].frames))
+        {
+            Placement placement;
+            placement.number = number++;
+            placement.codedNumber = codedNumber(placement.number);
+            placement.size = frame.size - frame.header.numberLength + placement.codedNumber.size();
+            if (totalSamples >= nextSeekSample)
+            {
+                appendBigEndian<quint64>(seekTable, quint64(totalSamples));
+                appendBigEndian<quint64>(seekTable, quint64(offset));
+                appendBigEndian<quint16>(seekTable, quint16(frame.header.blockSize));
+                ++seekPoints;
+                nextSeekSample = (totalSamples / seekInterval + 1) * seekInterval;
+            }
+            minFrameSize = qMin(minFrameSize, placement.size);
+            maxFrameSize = qMax(maxFrameSize, placement.size);
+            totalSamples += frame.header.blockSize;
+            offset += placement.size;
+            placements[i].push_back(placement);
+        }
+    }
+
+    QByteArray header("fLaC");
+    const bool hasComment = !chunks.front().vorbisComment.isEmpty();
+    appendBlockHeader(header, kBlockStreamInfo, false, kStreamInfoSize);
+    appendBigEndian<quint16>(header, quint16(format.maxBlockSize));
+    appendBigEndian<quint16>(header, quint16(format.maxBlockSize));
+    for (qint64 frameSize : {minFrameSize, maxFrameSize})
+    {
+        header.append(char((frameSize >> 16) & 0xFF));
+        header.append(char((frameSize >> 8) & 0xFF));
+        header.append(char(frameSize & 0xFF));
+    }
+    appendBigEndian<quint64>(header, quint64(format.sampleRate) << 44 | quint64(format.channels - 1) << 41 |
+                                         quint64(format.bitsPerSample - 1) << 36 |
+                                         (quint64(totalSamples) & 0xFFFFFFFFFULL));
+    header.append(md5.size() == 16 ? md5 : QByteArray(16, '\0'));
+    appendBlockHeader(header, kBlockSeekTable, !hasComment, seekTable.size());
+    header.append(seekTable);
+    if (hasComment)
+    {
+        appendBlockHeader(header, kBlockVorbisComment, true, chunks.front().vorbisComment.size());
+        header.append(chunks.front().vorbisComment);
+    }
+
+    QDir().mkpath(QFileInfo(outputPath).absolutePath());
+    QSaveFile out(outputPath);
+    if (!out.open(QIODevice::WriteOnly))
+    {
+        return fail(out.errorString());
+    }
+    out.write(header);
+    QByteArray frameHeader;
+    for (size_t i = 0; i < chunks.size(); ++i)
+    {
+        const Chunk& chunk = chunks[i];
+        for (qsizetype f = 0; f < chunk.frames.size(); ++f)
+        {
+            const Frame& frame = chunk.frames.at(f);
+            const Placement& placement = placements[i][f];
+            const uchar* source = chunk.data + frame.offset;
+            if (placement.number == frame.header.number)
+            {
+                out.write(reinterpret_cast<const char*>(source), frame.size);
+                continue;
+            }
+            const int tailStart = 4 + frame.header.numberLength;
+            frameHeader.clear();
+            frameHeader.append(reinterpret_cast<const char*>(source), 4);
+            frameHeader.append(placement.codedNumber);
+            frameHeader.append(reinterpret_cast<const char*>(source + tailStart),
+                               frame.header.length - 1 - tailStart);
+            frameHeader.append(char(crc8(reinterpret_cast<const uchar*>(frameHeader.constData()),
+                                         frameHeader.size())));
+            const uchar* body = source + frame.header.length;
+            const qint64 bodySize = frame.size - frame.header.length - 2;
+            quint16 crc = updateCrc16(0, reinterpret_cast<const uchar*>(frameHeader.constData()), frameHeader.size());
+            crc = updateCrc16(crc, body, bodySize);
+            out.write(frameHeader);
+            out.write(reinterpret_cast<const char*>(body), bodySize);
+            uchar footer[2];
+            qToBigEndian(crc, footer);
+            out.write(reinterpret_cast<const char*>(footer), 2);
+        }
+    }
+    if (!out.commit())
+    {
+        return fail(out.errorString());
+    }
+
+    ChunkedFlacResult result;
+    result.ok = true;
+    result.chunks = int(chunks.size());
+    result.totalSamples = totalSamples;
+    result.seekPoints = seekPoints;
+    result.hasMd5 = md5.size() == 16;
+    return result;
+}
+} // namespace ChunkedFlac
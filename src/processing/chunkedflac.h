@@ -0,0 +1,62 @@
+#ifndef CHUNKEDFLAC_H
+#define CHUNKEDFLAC_H
+
+#include "wavfile.h"
+
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+
+#include <atomic>
+
+struct ChunkedFlacResult
+{
+    bool ok = false;
+    QString errorString;
+
+    int chunks = 0;
+    qint64 totalSamples = 0;
+    int seekPoints = 0;
+    bool hasMd5 = false; // MD5 несжатого звука записан в STREAMINFO
+    qint64 elapsedMs = 0;
+};
+
+/**
+ * @brief Кодирование длинного WAV в FLAC несколькими процессами ffmpeg.
+ *
+ * Поток делится на куски по границам кадров FLAC (kBlockSize отсчётов), куски кодируются одновременно
+ * в пуле потоков, затем склеиваются в один поток: номера кадров сдвигаются, CRC заголовков и кадров
+ * пересчитываются, STREAMINFO собирается заново и дополняется таблицей SEEKTABLE. MD5 несжатого звука
+ * для STREAMINFO считает ещё один запуск ffmpeg без кодирования, параллельно с кусками.
+ */
+namespace ChunkedFlac
+{
+constexpr int kBlockSize = 4096;
+constexpr double kMinChunkS = 60.0; // короче процесс ffmpeg дороже, чем выигрыш от параллельности
+constexpr double kSeekPointIntervalS = 10.0;
+
+/**
+ * @brief Число кусков для \a wav: по одному на поток, но не короче kMinChunkS.
+ * @return 1, если кодировать стоит одним процессом (формат не целочисленный 16/24 бит, файл короткий)
+ */
+int chunkCount(const WavInfo& wav, int threads);
+
+/**
+ * @brief Закодировать \a wavPath в \a outputPath кусками.
+ * @param offsetMs > 0 — обрезать начало, < 0 — добавить тишину, как фильтры atrim/adelay при конвертации
+ * @param gainDb усиление, как фильтр volume при конвертации
+ * @param cancelled флаг отмены: запущенные процессы ffmpeg убиваются, не дожидаясь конца куска
+ */
+ChunkedFlacResult encode(const QString& ffmpegPath, const QString& wavPath, int chunks, int offsetMs, double gainDb,
+                         const QString& outputPath, const std::atomic_bool* cancelled = nullptr);
+
+/**
+ * @brief Склеить FLAC-файлы кусков в один поток.
+ *
+ * У кусков должен быть один формат и фиксированный размер блока, у всех, кроме последнего, — целое число блоков.
+ * @param md5 MD5 несжатого звука всего потока; пустой — в STREAMINFO пишутся нули («не известен»)
+ */
+ChunkedFlacResult stitch(const QStringList& chunkPaths, const QString& outputPath, const QByteArray& md5 = {});
+} // namespace ChunkedFlac
+
+#endif // CHUNKEDFLAC_H
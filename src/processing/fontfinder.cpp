@@ -1,31 +1,107 @@
 ﻿#include "fontfinder.h"
 
+#include "assdocument.h"
+#include "asstexttokenizer.h"
+
 #include <QDir>
+#include <QElapsedTimer>
 #include <QFile>
 #include <QFileInfo>
-#include <QRegularExpression>
+#include <QFutureWatcher>
+#include <QMutexLocker>
 #include <QStringConverter>
 #include <QTextStream>
-#include <QTimer>
+#include <QtConcurrent/QtConcurrentMap>
+#include <QtConcurrent/QtConcurrentRun>
+
+#include <algorithm>
+#include <tuple>
 
+#ifdef Q_OS_WIN
 #include <dwrite.h>
 #include <dwrite_1.h>
 #include <wrl/client.h>
 
 using Microsoft::WRL::ComPtr;
+#endif
+
+namespace
+{
+// Map style names to their font info
+QMap<QString, AssStyleInfo> fontStylesByName(const AssDocument& doc)
+{
+    QMap<QString, AssStyleInfo> styleMap;
+    for (int i = 0; i < doc.styles().size(); ++i)
+    {
+        // Bold/Italic: -1 = yes (V4+), 1 встречается в старых скриптах
+        const QString bold = doc.styleField(i, AssDocument::StyleField::Bold);
+        const QString italic = doc.styleField(i, AssDocument::StyleField::Italic);
+        AssStyleInfo info;
+        info.fontName = doc.styleField(i, AssDocument::StyleField::Fontname);
+        info.bold = (bold == "-1" || bold == "1");
+        info.italic = (italic == "-1" || italic == "1");
+        styleMap[doc.styleField(i, AssDocument::StyleField::Name)] = info;
+    }
+    return styleMap;
+}
+
+// Пробелы, управляющие и невидимые символы форматирования (ZWJ, LRM, мягкий перенос) глифа не требуют,
+// селекторы вариантов обрабатывает шейпер
+bool needsGlyph(char32_t codepoint)
+{
+    if ((codepoint >= 0xFE00 && codepoint <= 0xFE0F) || (codepoint >= 0xE0100 && codepoint <= 0xE01EF))
+    {
+        return false;
+    }
+    switch (QChar::category(codepoint))
+    {
+    case QChar::Other_Control:
+    case QChar::Other_Format:
+    case QChar::Other_Surrogate:
+    case QChar::Other_NotAssigned:
+    case QChar::Separator_Space:
+    case QChar::Separator_Line:
+    case QChar::Separator_Paragraph:
+        return false;
+    default:
+        return true;
+    }
+}
+
+QString styleDescription(const QString& fontName, bool bold, bool italic)
+{
+    QString description = fontName;
+    if (bold)
+    {
+        description += " Bold";
+    }
+    if (italic)
+    {
+        description += " Italic";
+    }
+    return description;
+}
+} // namespace
 
 FontFinder::FontFinder(QObject* parent) : QObject(parent)
 {
-    initDirectWrite();
 }
 
 FontFinder::~FontFinder()
 {
+    // Фоновые задачи обращаются к this — дожидаемся всех запусков до разрушения индекса
+    m_pending.waitForFinished();
     cleanupDirectWrite();
 }
 
 bool FontFinder::initDirectWrite()
 {
+#ifdef Q_OS_WIN
+    if (m_dwriteFactory != nullptr)
+    {
+        return m_fontCollection != nullptr;
+    }
+
     HRESULT hr = DWriteCreateFactory(DWRITE_FACTORY_TYPE_SHARED, __uuidof(IDWriteFactory),
                                      reinterpret_cast<IUnknown**>(&m_dwriteFactory));
 
@@ -38,10 +114,14 @@ bool FontFinder::initDirectWrite()
     hr = factory->GetSystemFontCollection(reinterpret_cast<IDWriteFontCollection**>(&m_fontCollection), FALSE);
 
     return SUCCEEDED(hr) && m_fontCollection != nullptr;
+#else
+    return false;
+#endif
 }
 
 void FontFinder::cleanupDirectWrite()
 {
+#ifdef Q_OS_WIN
     if (m_fontCollection != nullptr)
     {
         static_cast<IDWriteFontCollection*>(m_fontCollection)->Release();
@@ -52,199 +132,225 @@ void FontFinder::cleanupDirectWrite()
         static_cast<IDWriteFactory*>(m_dwriteFactory)->Release();
         m_dwriteFactory = nullptr;
     }
+#endif
 }
 
-void FontFinder::findFontsInSubs(const QStringList& subFilesToCheck)
+void FontFinder::updateFontIndex(const QStringList& fontDirs)
 {
-    // Use QTimer to make this async and not block the UI
-    QTimer::singleShot(
-        0, this,
-        [this, subFilesToCheck]()
-        {
-            FontFinderResult result;
+    const FontIndex::ScanStats stats = m_fontIndex.scanDirectories(fontDirs);
+    m_indexedDirs = fontDirs;
+    emit logMessage(QString("Индекс шрифтов: %1 файлов (%2 начертаний), из кэша %3, из хранилища %4, разобрано %5, "
+                            "ошибок %6 за %7 мс")
+                        .arg(stats.files)
+                        .arg(m_fontIndex.faceCount())
+                        .arg(stats.reused)
+                        .arg(stats.shared)
+                        .arg(stats.parsed)
+                        .arg(stats.failed)
+                        .arg(stats.elapsedMs),
+                    LogCategory::APP);
+    if (!m_fontIndex.save())
+    {
+        emit logMessage("Не удалось сохранить кэш индекса шрифтов", LogCategory::APP, LogLevel::Warning);
+    }
+}
 
-            if (m_dwriteFactory == nullptr || m_fontCollection == nullptr)
+void FontFinder::findFontsInSubs(const QStringList& subFilesToCheck)
+{
+    // Разбор и поиск идут в пуле потоков, результат приходит сигналом finished() в поток FontFinder
+    auto* watcher = new QFutureWatcher<FontFinderResult>(this);
+    connect(watcher, &QFutureWatcher<FontFinderResult>::finished, this,
+            [this, watcher]()
             {
-                emit logMessage("Ошибка: не удалось инициализировать DirectWrite", LogCategory::APP, LogLevel::Error);
+                const FontFinderResult result = watcher->result();
+                watcher->deleteLater();
                 emit finished(result);
-                return;
-            }
+            });
+    // Запуски могут пересекаться (ручная сборка): держим все, завершённые отбрасываем, чтобы список не рос
+    const QList<QFuture<FontFinderResult>> runs = m_pending.futures();
+    if (std::all_of(runs.cbegin(), runs.cend(), [](const QFuture<FontFinderResult>& run) { return run.isFinished(); }))
+    {
+        m_pending.clearFutures();
+    }
+    const QFuture<FontFinderResult> future =
+        QtConcurrent::run([this, subFilesToCheck]() { return resolveFonts(subFilesToCheck); });
+    m_pending.addFuture(future);
+    watcher->setFuture(future);
+}
 
-            if (subFilesToCheck.isEmpty())
-            {
-                emit finished(result);
-                return;
-            }
+FontFinderResult FontFinder::resolveFonts(const QStringList& subFilesToCheck)
+{
+    FontFinderResult result;
+    if (subFilesToCheck.isEmpty())
+    {
+        return result;
+    }
 
-            // Collect additional font directories (attached_fonts next to ASS files)
-            QStringList additionalFontDirs;
-            for (const QString& assPath : subFilesToCheck)
-            {
-                QFileInfo fileInfo(assPath);
-                QString attachedFontsDir = fileInfo.absolutePath() + "/attached_fonts";
-                if (QDir(attachedFontsDir).exists())
-                {
-                    additionalFontDirs.append(attachedFontsDir);
-                }
-            }
+    // Индекс перестраивается под каждый набор файлов, поэтому параллельные запуски идут по очереди
+    QMutexLocker locker(&m_indexMutex);
+    QElapsedTimer timer;
+    timer.start();
 
-            // Load additional fonts
-            QMap<QString, QString> additionalFonts = loadAdditionalFonts(additionalFontDirs);
+    // attached_fonts рядом с ASS идут раньше системных: при равном совпадении берём шрифт релиза
+    QStringList fontDirs;
+    for (const QString& assPath : subFilesToCheck)
+    {
+        QFileInfo fileInfo(assPath);
+        QString attachedFontsDir = fileInfo.absolutePath() + "/attached_fonts";
+        if (QDir(attachedFontsDir).exists() && !fontDirs.contains(attachedFontsDir))
+        {
+            fontDirs.append(attachedFontsDir);
+        }
+    }
+    fontDirs.append(FontIndex::systemFontDirs());
+    updateFontIndex(fontDirs);
+    // Фабрику DirectWrite создаём до параллельной части, дальше она только читается
+    initDirectWrite();
 
-            // Parse all ASS files and collect unique font styles
-            QSet<AssStyleInfo> allStyles;
-            for (const QString& assPath : subFilesToCheck)
-            {
-                QSet<AssStyleInfo> fileStyles = parseAssFile(assPath);
-                allStyles.unite(fileStyles);
-            }
+    // Parse all ASS files in parallel and collect unique font styles with the codepoints they render
+    const QList<QPair<QSet<AssStyleInfo>, GlyphUsage>> perFile = QtConcurrent::blockingMapped(
+        subFilesToCheck, [this](const QString& assPath)
+        { return qMakePair(parseAssFile(assPath), parseAssFileGlyphs(assPath)); });
+    QSet<AssStyleInfo> uniqueStyles;
+    GlyphUsage usage;
+    for (const auto& [fileStyles, fileUsage] : perFile)
+    {
+        uniqueStyles.unite(fileStyles);
+        for (auto it = fileUsage.cbegin(); it != fileUsage.cend(); ++it)
+        {
+            usage[it.key()].unite(it.value());
+            // Текст в этом начертании есть — шрифт нужен, даже если разбор тегов его не отметил
+            uniqueStyles.insert(it.key());
+        }
+    }
 
-            emit logMessage(QString("Найдено %1 уникальных шрифтовых стилей для поиска").arg(allStyles.size()),
-                            LogCategory::APP);
+    // Стабильный порядок, чтобы лог и список шрифтов не зависели от порядка в QSet
+    QList<AssStyleInfo> styles(uniqueStyles.cbegin(), uniqueStyles.cend());
+    std::sort(styles.begin(), styles.end(),
+              [](const AssStyleInfo& a, const AssStyleInfo& b)
+              {
+                  const int byName = a.fontName.compare(b.fontName, Qt::CaseInsensitive);
+                  if (byName != 0)
+                  {
+                      return byName < 0;
+                  }
+                  return std::tie(a.fontName, a.bold, a.italic) < std::tie(b.fontName, b.bold, b.italic);
+              });
+
+    emit logMessage(QString("Найдено %1 уникальных шрифтовых стилей для поиска").arg(styles.size()), LogCategory::APP);
+
+    const QStringList fontPaths =
+        QtConcurrent::blockingMapped(styles, [this](const AssStyleInfo& style) { return findFontFile(style); });
+
+    // Track which fonts and families we've already found to avoid duplicates
+    QSet<QString> foundPaths;
+    QSet<QString> foundFamilies;
+    for (int i = 0; i < styles.size(); ++i)
+    {
+        if (!fontPaths.at(i).isEmpty())
+        {
+            foundFamilies.insert(styles.at(i).fontName.toCaseFolded());
+        }
+    }
 
-            // Track which fonts we've already found to avoid duplicates
-            QSet<QString> foundPaths;
+    QSet<QString> notFoundFamilies;
+    for (int i = 0; i < styles.size(); ++i)
+    {
+        const AssStyleInfo& style = styles.at(i);
+        const QString& fontPath = fontPaths.at(i);
 
-            // Find each font
-            for (const AssStyleInfo& style : allStyles)
-            {
-                QString fontPath = findFontFile(style, additionalFontDirs);
+        if (!fontPath.isEmpty())
+        {
+            // DirectWrite мог вернуть файл не из индекса — тогда считаем, что это первое начертание
+            const FontFace* face = m_fontIndex.match(style.fontName, style.bold, style.italic);
+            const bool fromIndex = face != nullptr && face->path == fontPath;
+            result.resolvedStyles.append({style, fontPath, fromIndex ? face->faceIndex : 0, fromIndex});
+        }
 
-                if (!fontPath.isEmpty() && !foundPaths.contains(fontPath))
-                {
-                    foundPaths.insert(fontPath);
-                    FoundFontInfo info;
-                    info.path = fontPath;
-                    info.familyName = style.fontName;
-                    result.foundFonts.append(info);
-                    emit logMessage(QString("Найден шрифт: %1 -> %2").arg(style.fontName, fontPath), LogCategory::APP);
-                }
-                else if (fontPath.isEmpty())
-                {
-                    // Only add to not found if we haven't found any variant of this font
-                    bool alreadyFound = false;
-                    for (const FoundFontInfo& found : result.foundFonts)
-                    {
-                        if (found.familyName.compare(style.fontName, Qt::CaseInsensitive) == 0)
-                        {
-                            alreadyFound = true;
-                            break;
-                        }
-                    }
-                    if (!alreadyFound && !result.notFoundFontNames.contains(style.fontName))
-                    {
-                        result.notFoundFontNames.append(style.fontName);
-                        emit logMessage(QString("Шрифт не найден: %1 (Bold: %2, Italic: %3)")
-                                            .arg(style.fontName)
-                                            .arg(style.bold ? "да" : "нет")
-                                            .arg(style.italic ? "да" : "нет"),
-                                        LogCategory::APP);
-                    }
-                }
+        if (!fontPath.isEmpty() && !foundPaths.contains(fontPath))
+        {
+            foundPaths.insert(fontPath);
+            FoundFontInfo info;
+            info.path = fontPath;
+            info.familyName = style.fontName;
+            result.foundFonts.append(info);
+            emit logMessage(QString("Найден шрифт: %1 -> %2").arg(style.fontName, fontPath), LogCategory::APP);
+        }
+        else if (fontPath.isEmpty())
+        {
+            // Only add to not found if we haven't found any variant of this font
+            const QString family = style.fontName.toCaseFolded();
+            if (!foundFamilies.contains(family) && !notFoundFamilies.contains(family))
+            {
+                notFoundFamilies.insert(family);
+                result.notFoundFontNames.append(style.fontName);
+                emit logMessage(QString("Шрифт не найден: %1 (Bold: %2, Italic: %3)")
+                                    .arg(style.fontName)
+                                    .arg(style.bold ? "да" : "нет")
+                                    .arg(style.italic ? "да" : "нет"),
+                                LogCategory::APP);
             }
+        }
+    }
 
-            emit finished(result);
-        });
+    // Шрифт «найден», но без кириллицы — лучше узнать до сборки MKV и рендера MP4, а не по квадратам в кадре
+    result.missingGlyphs = checkGlyphCoverage(result.resolvedStyles, usage);
+    for (const MissingGlyphsInfo& info : std::as_const(result.missingGlyphs))
+    {
+        emit logMessage(QString("В шрифте %1 нет глифов для %2 символов из субтитров: %3 (%4)")
+                            .arg(styleDescription(info.fontName, info.bold, info.italic))
+                            .arg(info.missingCount)
+                            .arg(info.sample, info.path),
+                        LogCategory::APP, LogLevel::Warning);
+    }
+    if (!m_fontIndex.save())
+    {
+        emit logMessage("Не удалось сохранить кэш индекса шрифтов", LogCategory::APP, LogLevel::Warning);
+    }
+
+    emit logMessage(QString("Поиск шрифтов по %1 файлам занял %2 мс").arg(subFilesToCheck.size()).arg(timer.elapsed()),
+                    LogCategory::APP);
+    return result;
 }
 
 QSet<AssStyleInfo> FontFinder::parseAssFile(const QString& filePath)
 {
     QSet<AssStyleInfo> styles;
 
-    QFile file(filePath);
-    if (!file.open(QIODevice::ReadOnly))
+    const std::shared_ptr<const AssDocument> doc = AssDocument::load(filePath);
+    if (!doc)
     {
         emit logMessage("Ошибка: не удалось открыть файл " + filePath, LogCategory::APP, LogLevel::Error);
         return styles;
     }
 
-    QTextStream in(&file);
-    in.setEncoding(QStringConverter::Utf8);
-
-    // Map style names to their font info
-    QMap<QString, AssStyleInfo> styleMap;
-    bool inStylesSection = false;
-    bool inEventsSection = false;
+    // Don't add styles here - only add when actually used in dialogue
+    const QMap<QString, AssStyleInfo> styleMap = fontStylesByName(*doc);
 
-    while (!in.atEnd())
+    // Parse dialogue lines for inline font overrides
+    for (int i = 0; i < doc->events().size(); ++i)
     {
-        QString line = in.readLine().trimmed();
-
-        if (line == "[V4+ Styles]" || line == "[V4 Styles]")
+        if (doc->events().at(i).comment || !doc->isEventComplete(i))
         {
-            inStylesSection = true;
-            inEventsSection = false;
-            continue;
-        }
-        if (line == "[Events]")
-        {
-            inStylesSection = false;
-            inEventsSection = true;
-            continue;
-        }
-        if (line.startsWith("[") && line.endsWith("]"))
-        {
-            inStylesSection = false;
-            inEventsSection = false;
             continue;
         }
 
-        // Parse style definitions
-        // Format: Style: Name,Fontname,Fontsize,PrimaryColour,...,Bold,Italic,...
-        if (inStylesSection && line.startsWith("Style:"))
-        {
-            QString styleData = line.mid(6).trimmed();
-            QStringList parts = styleData.split(',');
+        const QByteArrayView textView = doc->eventFieldView(i, AssDocument::EventField::Text);
+        const AssStyleInfo baseStyle = styleMap.value(doc->eventField(i, AssDocument::EventField::Style));
 
-            // V4+ Style format has 23 fields
-            // Index 0: Name, 1: Fontname, 7: Bold (-1 = yes), 8: Italic (-1 = yes)
-            if (parts.size() >= 9)
-            {
-                AssStyleInfo info;
-                QString styleName = parts[0].trimmed();
-                info.fontName = parts[1].trimmed();
-                info.bold = (parts[7].trimmed() == "-1" || parts[7].trimmed() == "1");
-                info.italic = (parts[8].trimmed() == "-1" || parts[8].trimmed() == "1");
-
-                styleMap[styleName] = info;
-                // Don't add to styles here - only add when actually used in dialogue
-            }
-        }
+        // Check if text has any style-changing inline tags (\fn, \b, \i)
+        const bool hasStyleOverride =
+            textView.contains("\\fn") || textView.contains("\\b") || textView.contains("\\i");
 
-        // Parse dialogue lines for inline font overrides
-        if (inEventsSection && line.startsWith("Dialogue:"))
+        if (hasStyleOverride)
         {
-            QStringList parts = line.split(',');
-            if (parts.size() >= 10)
-            {
-                QString styleName = parts[3].trimmed();
-                QString text = parts.mid(9).join(',');
-
-                // Get base style
-                AssStyleInfo baseStyle;
-                if (styleMap.contains(styleName))
-                {
-                    baseStyle = styleMap[styleName];
-                }
-
-                // Check if text has any style-changing inline tags (\fn, \b, \i)
-                bool hasStyleOverride = text.contains("\\fn") || text.contains("\\b") || text.contains("\\i");
-
-                if (hasStyleOverride)
-                {
-                    // Parse inline tags - they may override font/bold/italic
-                    QSet<AssStyleInfo> inlineStyles = parseInlineFontTags(text, baseStyle);
-                    styles.unite(inlineStyles);
-                }
-                else
-                {
-                    // No style override - use base style font
-                    if (!baseStyle.fontName.isEmpty())
-                    {
-                        styles.insert(baseStyle);
-                    }
-                }
-            }
+            // Parse inline tags - they may override font/bold/italic
+            styles.unite(parseInlineFontTags(QString::fromUtf8(textView), baseStyle));
+        }
+        else if (!baseStyle.fontName.isEmpty())
+        {
+            // No style override - use base style font
+            styles.insert(baseStyle);
         }
     }
 
@@ -258,74 +364,58 @@ QSet<AssStyleInfo> FontFinder::parseInlineFontTags(const QString& text, const As
     // Current state
     AssStyleInfo current = baseStyle;
 
-    // Regex to find tag blocks: {...}
-    QRegularExpression tagBlockRegex(R"(\{([^\}]*)\})");
-
-    // Check if there's text before the first tag block that would use base style
-    auto firstMatch = tagBlockRegex.match(text);
-    bool hasTextBeforeFirstTag = !firstMatch.hasMatch() || firstMatch.capturedStart() > 0;
-
-    // Check if ANY of the initial consecutive tag blocks contains \fn override
-    // This handles cases like {=0=2}{\fnArial...} where \fn is in the second block
+    // Base style is used if there's text before the first tag block, or if none of the initial consecutive
+    // tag blocks overrides the font. Handles cases like {=0=2}{\fnArial...} where \fn is in the second block
+    bool seenFirstToken = false;
+    bool hasTextBeforeFirstTag = true;
+    bool inInitialTags = true;
     bool initialTagsHaveFontOverride = false;
-    if (!hasTextBeforeFirstTag)
+    bool fontChanged = false;
+
+    AssTextTokenizer tokenizer(text);
+    AssTextToken token;
+    while (tokenizer.next(token))
     {
-        // Text starts with tags - check all consecutive tag blocks at the start
-        auto it = tagBlockRegex.globalMatch(text);
-        qsizetype expectedPos = 0;
-        while (it.hasNext())
+        if (!seenFirstToken)
         {
-            auto match = it.next();
-            // Check if this tag block is consecutive (no text gap)
-            if (match.capturedStart() != expectedPos)
-            {
-                break; // There's text between tag blocks
-            }
+            seenFirstToken = true;
+            hasTextBeforeFirstTag = token.kind != AssTextToken::Kind::BlockStart;
+        }
 
-            QString tagContent = match.captured(1);
-            if (tagContent.contains("\\fn"))
+        switch (token.kind)
+        {
+        case AssTextToken::Kind::Text:
+        case AssTextToken::Kind::LineBreak:
+            inInitialTags = false;
+            break;
+        case AssTextToken::Kind::BlockStart:
+            fontChanged = false;
+            break;
+        case AssTextToken::Kind::BlockEnd:
+            if (fontChanged && !current.fontName.isEmpty())
             {
-                initialTagsHaveFontOverride = true;
-                break;
+                styles.insert(current);
             }
-            expectedPos = match.capturedEnd();
-        }
-    }
-
-    // Add base style only if there's text before first tag, or initial tags don't override font
-    if (!baseStyle.fontName.isEmpty() && (hasTextBeforeFirstTag || !initialTagsHaveFontOverride))
-    {
-        styles.insert(baseStyle);
-    }
-    auto it = tagBlockRegex.globalMatch(text);
-
-    while (it.hasNext())
-    {
-        auto match = it.next();
-        QString tagBlock = match.captured(1);
-
-        // Split by backslash to get individual tags
-        QStringList tags = tagBlock.split('\\', Qt::SkipEmptyParts);
-
-        bool fontChanged = false;
-
-        for (const QString& tag : tags)
+            break;
+        case AssTextToken::Kind::Tag:
         {
-            if (tag.startsWith("fn"))
+            const QStringView tag = token.text;
+            if (tag.startsWith(u"fn"))
             {
                 // Font name change: \fnArial
-                current.fontName = tag.mid(2).trimmed();
+                initialTagsHaveFontOverride = initialTagsHaveFontOverride || inInitialTags;
+                current.fontName = tag.mid(2).trimmed().toString();
                 if (current.fontName.isEmpty())
                 {
                     current.fontName = baseStyle.fontName;
                 }
                 fontChanged = true;
             }
-            else if (tag.startsWith("b") && tag.size() > 1 && tag[1].isDigit())
+            else if (tag.startsWith(u'b') && tag.size() > 1 && tag.at(1).isDigit())
             {
                 // Bold: \b1 or \b0 or \b700 etc
-                QString value = tag.mid(1);
-                if (value == "0")
+                const QStringView value = tag.mid(1);
+                if (value == u"0")
                 {
                     current.bold = false;
                 }
@@ -337,46 +427,212 @@ QSet<AssStyleInfo> FontFinder::parseInlineFontTags(const QString& text, const As
                 }
                 fontChanged = true;
             }
-            else if (tag.startsWith("i") && tag.size() > 1 && tag[1].isDigit())
+            else if (tag.startsWith(u'i') && tag.size() > 1 && tag.at(1).isDigit())
             {
                 // Italic: \i1 or \i0
                 current.italic = (tag.mid(1).toInt() != 0);
                 fontChanged = true;
             }
-            else if (tag == "r" || tag.startsWith("r"))
+            else if (tag.startsWith(u'r'))
             {
                 // Reset to base style (or specific style via \rStyleName)
                 // We don't have access to other styles here, so just reset to base
                 current = baseStyle;
                 fontChanged = true;
             }
+            break;
+        }
         }
+    }
 
-        if (fontChanged && !current.fontName.isEmpty())
+    // Add base style only if there's text before first tag, or initial tags don't override font
+    if (!baseStyle.fontName.isEmpty() && (hasTextBeforeFirstTag || !initialTagsHaveFontOverride))
+    {
+        styles.insert(baseStyle);
+    }
+
+    return styles;
+}
+
+GlyphUsage FontFinder::parseAssFileGlyphs(const QString& filePath)
+{
+    GlyphUsage usage;
+    const std::shared_ptr<const AssDocument> doc = AssDocument::load(filePath);
+    if (!doc)
+    {
+        return usage;
+    }
+
+    const QMap<QString, AssStyleInfo> styleMap = fontStylesByName(*doc);
+    for (int i = 0; i < doc->events().size(); ++i)
+    {
+        if (doc->events().at(i).comment || !doc->isEventComplete(i))
         {
-            styles.insert(current);
+            continue;
         }
+        collectGlyphUsage(doc->eventField(i, AssDocument::EventField::Text),
+                          styleMap.value(doc->eventField(i, AssDocument::EventField::Style)), usage);
     }
+    return usage;
+}
 
-    return styles;
+void FontFinder::collectGlyphUsage(const QString& text, const AssStyleInfo& baseStyle, GlyphUsage& usage) // static
+{
+    AssStyleInfo current = baseStyle;
+    bool drawing = false;
+
+    AssTextTokenizer tokenizer(text);
+    AssTextToken token;
+    while (tokenizer.next(token))
+    {
+        if (token.kind == AssTextToken::Kind::Tag)
+        {
+            const QStringView tag = token.text;
+            if (tag.startsWith(u"fn"))
+            {
+                current.fontName = tag.mid(2).trimmed().toString();
+                if (current.fontName.isEmpty())
+                {
+                    current.fontName = baseStyle.fontName;
+                }
+            }
+            else if (tag.startsWith(u'b') && tag.size() > 1 && tag.at(1).isDigit())
+            {
+                const int weight = tag.mid(1).toInt();
+                current.bold = (weight >= 1 && (weight == 1 || weight >= 600));
+            }
+            else if (tag.startsWith(u'i') && tag.size() > 1 && tag.at(1).isDigit())
+            {
+                current.italic = (tag.mid(1).toInt() != 0);
+            }
+            else if (tag.startsWith(u'p') && tag.size() > 1 && tag.at(1).isDigit())
+            {
+                // \p1 и выше — векторное рисование: буквы там команды, а не текст
+                drawing = tag.mid(1).toInt() > 0;
+            }
+            else if (tag.startsWith(u'r'))
+            {
+                current = baseStyle;
+                drawing = false;
+            }
+            continue;
+        }
+        if (token.kind != AssTextToken::Kind::Text || drawing || current.fontName.isEmpty())
+        {
+            continue;
+        }
+
+        QSet<char32_t>* codepoints = nullptr;
+        const QStringView run = token.text;
+        for (qsizetype i = 0; i < run.size(); ++i)
+        {
+            char32_t codepoint = run.at(i).unicode();
+            if (codepoint == u'\\' && i + 1 < run.size() && run.at(i + 1) == u'h')
+            {
+                // \h — неразрывный пробел
+                ++i;
+                continue;
+            }
+            if (QChar::isHighSurrogate(codepoint) && i + 1 < run.size() && run.at(i + 1).isLowSurrogate())
+            {
+                codepoint = QChar::surrogateToUcs4(run.at(i), run.at(i + 1));
+                ++i;
+            }
+            if (!needsGlyph(codepoint))
+            {
+                continue;
+            }
+            if (codepoints == nullptr)
+            {
+                codepoints = &usage[current];
+            }
+            codepoints->insert(codepoint);
+        }
+    }
+}
+
+QList<MissingGlyphsInfo> FontFinder::checkGlyphCoverage(const QList<ResolvedFontStyle>& resolved,
+                                                         const GlyphUsage& usage)
+{
+    constexpr int kSampleLength = 40;
+    QList<MissingGlyphsInfo> missing;
+    for (const ResolvedFontStyle& font : resolved)
+    {
+        const AssStyleInfo& style = font.style;
+        const auto used = usage.constFind(style);
+        if (used == usage.cend())
+        {
+            continue;
+        }
+
+        const GlyphCoverage coverage = m_fontIndex.coverage(font.path, font.faceIndex);
+        if (coverage.isEmpty())
+        {
+            continue;
+        }
+
+        QList<char32_t> absent;
+        for (char32_t codepoint : *used)
+        {
+            if (!coverage.contains(codepoint))
+            {
+                absent.append(codepoint);
+            }
+        }
+        if (absent.isEmpty())
+        {
+            continue;
+        }
+        std::sort(absent.begin(), absent.end());
+
+        MissingGlyphsInfo info;
+        info.fontName = style.fontName;
+        info.bold = style.bold;
+        info.italic = style.italic;
+        info.path = font.path;
+        info.missingCount = static_cast<int>(absent.size());
+        info.sample = QString::fromUcs4(absent.constData(), qMin<qsizetype>(absent.size(), kSampleLength));
+        missing.append(info);
+    }
+    return missing;
 }
 
 QString FontFinder::findSystemFont(const AssStyleInfo& style)
 {
-    if (!initDirectWrite())
+    QMutexLocker locker(&m_indexMutex);
+    const QStringList systemDirs = FontIndex::systemFontDirs();
+    if (m_indexedDirs != systemDirs)
     {
-        return QString();
+        updateFontIndex(systemDirs);
     }
-    return findFontFile(style, QStringList());
+    initDirectWrite();
+    return findFontFile(style);
 }
 
-QString FontFinder::findFontFile(const AssStyleInfo& style, const QStringList& additionalFontDirs)
+QString FontFinder::findFontFile(const AssStyleInfo& style)
 {
     if (style.fontName.isEmpty())
     {
         return QString();
     }
 
+    if (const FontFace* face = m_fontIndex.match(style.fontName, style.bold, style.italic))
+    {
+        return face->path;
+    }
+
+#ifdef Q_OS_WIN
+    // Шрифты, зарегистрированные в системе из других каталогов, индекс не видит — спрашиваем DirectWrite
+    return findDirectWriteFont(style);
+#else
+    return QString();
+#endif
+}
+
+#ifdef Q_OS_WIN
+QString FontFinder::findDirectWriteFont(const AssStyleInfo& style)
+{
+    // Коллекцию создаёт initDirectWrite() до параллельного поиска, здесь она только читается
     auto* collection = static_cast<IDWriteFontCollection*>(m_fontCollection);
     if (collection == nullptr)
     {
@@ -390,16 +646,8 @@ QString FontFinder::findFontFile(const AssStyleInfo& style, const QStringList& a
     UINT32 familyIndex = 0;
     BOOL exists = FALSE;
     HRESULT hr = collection->FindFamilyName(fontNameW.c_str(), &familyIndex, &exists);
-
     if (FAILED(hr) || exists == FALSE)
     {
-        // Try searching in additional font directories
-        QMap<QString, QString> additionalFonts = loadAdditionalFonts(additionalFontDirs);
-        QString lowerName = style.fontName.toLower();
-        if (additionalFonts.contains(lowerName))
-        {
-            return additionalFonts[lowerName];
-        }
         return QString();
     }
 
@@ -501,42 +749,4 @@ QString FontFinder::findFontFile(const AssStyleInfo& style, const QStringList& a
 
     return fontPath;
 }
-
-QMap<QString, QString> FontFinder::loadAdditionalFonts(const QStringList& dirs) // static
-{
-    QMap<QString, QString> fonts;
-
-    QStringList fontExtensions = {"*.ttf", "*.otf", "*.ttc", "*.woff", "*.woff2"};
-
-    for (const QString& dirPath : dirs)
-    {
-        QDir dir(dirPath);
-        if (!dir.exists())
-        {
-            continue;
-        }
-
-        QFileInfoList files = dir.entryInfoList(fontExtensions, QDir::Files);
-        for (const QFileInfo& fileInfo : files)
-        {
-            // Use filename without extension as family name (rough approximation)
-            QString baseName = fileInfo.baseName().toLower();
-            // Remove common suffixes like -Bold, -Italic, etc.
-            baseName = baseName.replace(
-                QRegularExpression(
-                    R"([-_](bold|italic|regular|light|medium|semibold|black|thin|heavy|oblique|condensed|expanded))"),
-                "");
-            fonts[baseName] = fileInfo.absoluteFilePath();
-        }
-    }
-
-    return fonts;
-}
-
-bool FontFinder::fontFileMatchesStyle(const QString& fontPath, const AssStyleInfo& style) // static
-{
-    Q_UNUSED(fontPath)
-    Q_UNUSED(style)
-    // This is a simplified check - DirectWrite already does the matching for us
-    return true;
-}
+#endif
@@ -2,9 +2,14 @@
 #define FONTFINDER_H
 
 #include "appsettings.h"
+#include "fontindex.h"
 
+#include <QFuture>
+#include <QFutureSynchronizer>
+#include <QHash>
 #include <QList>
 #include <QMap>
+#include <QMutex>
 #include <QObject>
 #include <QSet>
 #include <QStringList>
@@ -19,12 +24,16 @@ struct FoundFontInfo
 };
 
 /**
- * @brief Result of font finding operation
+ * @brief Characters used in the subtitles that a found font has no glyphs for
  */
-struct FontFinderResult
+struct MissingGlyphsInfo
 {
-    QList<FoundFontInfo> foundFonts;
-    QStringList notFoundFontNames;
+    QString fontName;
+    bool bold = false;
+    bool italic = false;
+    QString path;
+    int missingCount = 0;
+    QString sample; // first missing characters, for the log and the UI
 };
 
 /**
@@ -47,12 +56,38 @@ inline size_t qHash(const AssStyleInfo& key, size_t seed = 0)
     return qHash(key.fontName, seed) ^ qHash(key.bold, seed) ^ qHash(key.italic, seed);
 }
 
+/// Codepoints rendered with each (font, bold, italic)
+using GlyphUsage = QHash<AssStyleInfo, QSet<char32_t>>;
+
+/**
+ * @brief Font face a style was resolved to
+ */
+struct ResolvedFontStyle
+{
+    AssStyleInfo style;
+    QString path;
+    int faceIndex = 0;
+    bool fromIndex = false; // false: found only by the DirectWrite fallback, faceIndex is a guess
+};
+
+/**
+ * @brief Result of font finding operation
+ */
+struct FontFinderResult
+{
+    QList<FoundFontInfo> foundFonts;
+    QStringList notFoundFontNames;
+    QList<MissingGlyphsInfo> missingGlyphs;
+    QList<ResolvedFontStyle> resolvedStyles; // every found style, in the order of the log
+};
+
 /**
- * @brief Native font finder using DirectWrite API
+ * @brief Native font finder backed by FontIndex
  *
  * Parses ASS subtitle files to extract font requirements (family, bold, italic)
- * and uses Windows DirectWrite API to find matching font files on the system.
- * This provides accurate font matching similar to libass/Aegisub behavior.
+ * and looks them up in a FontIndex built from attached_fonts and the system font
+ * directories, selecting faces the same way libass does. On Windows, DirectWrite
+ * is kept as a fallback for fonts registered outside the standard directories.
  */
 class FontFinder : public QObject
 {
@@ -66,6 +101,9 @@ public:
     /**
      * @brief Start asynchronous font finding for given ASS files
      * @param subFilesToCheck List of ASS file paths to analyze
+     *
+     * Files are parsed and styles are looked up in parallel on the global thread pool;
+     * the result is delivered via finished() in the thread FontFinder lives in.
      */
     void findFontsInSubs(const QStringList& subFilesToCheck);
 
@@ -87,6 +125,24 @@ public:
      */
     static QSet<AssStyleInfo> parseInlineFontTags(const QString& text, const AssStyleInfo& baseStyle);
 
+    /**
+     * @brief Collect codepoints that need glyphs from ASS dialogue text, per active font style
+     * @param text Raw dialogue text with ASS tags
+     * @param baseStyle Style of the dialogue line
+     * @param usage Accumulated codepoints per style
+     *
+     * Follows \fn, \b, \i and \r like parseInlineFontTags(). Drawing mode (\p1 and up),
+     * \N, \h, whitespace and invisible format characters need no glyphs and are skipped.
+     */
+    static void collectGlyphUsage(const QString& text, const AssStyleInfo& baseStyle, GlyphUsage& usage);
+
+    /**
+     * @brief Parse ASS file and collect codepoints per font style
+     * @param filePath Path to ASS file
+     * @return Codepoints used with each font style in non-comment events
+     */
+    GlyphUsage parseAssFileGlyphs(const QString& filePath);
+
     /**
      * @brief Parse ASS file and extract unique font styles
      * @param filePath Path to ASS file
@@ -109,30 +165,44 @@ signals:
 
 private:
     /**
-     * @brief Find font file path using DirectWrite API
+     * @brief Worker part of findFontsInSubs(), runs on the thread pool
+     * @param subFilesToCheck List of ASS file paths to analyze
+     * @return Found and missing fonts, deduplicated by path and family
+     */
+    FontFinderResult resolveFonts(const QStringList& subFilesToCheck);
+
+    /**
+     * @brief Rescan font directories into the index and persist its cache
+     * @param fontDirs Directories in priority order (attached_fonts first)
+     */
+    void updateFontIndex(const QStringList& fontDirs);
+
+    /**
+     * @brief Find font file path in the font index (DirectWrite fallback on Windows)
      * @param style Font style to search for
-     * @param additionalFontDirs Additional directories to search (e.g., attached_fonts)
      * @return Font file path if found, empty string otherwise
      */
-    QString findFontFile(const AssStyleInfo& style, const QStringList& additionalFontDirs);
+    QString findFontFile(const AssStyleInfo& style);
 
     /**
-     * @brief Load fonts from additional directories (attached_fonts)
-     * @param dirs Directories to scan for font files
-     * @return Map of font family name (lowercase) to file path
+     * @brief Check used codepoints against the cmap of each resolved font
+     * @param resolved Found styles with their faces
+     * @param usage Codepoints per style
+     * @return Fonts lacking glyphs for some of the codepoints
      */
-    static QMap<QString, QString> loadAdditionalFonts(const QStringList& dirs);
+    QList<MissingGlyphsInfo> checkGlyphCoverage(const QList<ResolvedFontStyle>& resolved, const GlyphUsage& usage);
 
+#ifdef Q_OS_WIN
     /**
-     * @brief Check if font file matches the required style
-     * @param fontPath Path to font file
-     * @param style Required style
-     * @return true if font matches
+     * @brief Find font file path using DirectWrite API
+     * @param style Font style to search for
+     * @return Font file path if found, empty string otherwise
      */
-    static bool fontFileMatchesStyle(const QString& fontPath, const AssStyleInfo& style);
+    QString findDirectWriteFont(const AssStyleInfo& style);
+#endif
 
     /**
-     * @brief Initialize DirectWrite factory
+     * @brief Initialize DirectWrite factory (no-op outside Windows)
      * @return true if initialization succeeded
      */
     bool initDirectWrite();
@@ -142,6 +212,11 @@ private:
      */
     void cleanupDirectWrite();
 
+    QMutex m_indexMutex; // guards m_fontIndex and m_indexedDirs between runs
+    FontIndex m_fontIndex;
+    QStringList m_indexedDirs;
+    QFutureSynchronizer<FontFinderResult> m_pending; // every run still in flight, awaited on destruction
+
     void* m_dwriteFactory = nullptr;
     void* m_fontCollection = nullptr;
 };
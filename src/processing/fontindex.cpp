@@ -0,0 +1,768 @@
+#include "fontindex.h"
+
+#include "sfnt.h"
+
+#include <QDataStream>
+#include <QDir>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QSet>
+#include <QStandardPaths>
+#include <QtConcurrent/QtConcurrentMap>
+
+#include <algorithm>
+#include <limits>
+
+namespace
+{
+constexpr quint32 kCacheMagic = 0x44544649; // "DTFI"
+constexpr quint16 kCacheVersion = 3;
+
+using Sfnt::faceOffsets;
+using Sfnt::findTable;
+using Sfnt::FontView;
+using Sfnt::forEachCmapEntry;
+using Sfnt::readU16;
+using Sfnt::readU32;
+using Sfnt::TableRef;
+
+constexpr int kSlantItalic = 100; // FONT_SLANT_ITALIC из libass
+
+QString decodeUtf16Be(const uchar* p, quint16 length)
+{
+    QString result(length / 2, Qt::Uninitialized);
+    QChar* out = result.data();
+    for (quint16 i = 0; i + 1 < length; i += 2)
+    {
+        *out++ = QChar(readU16(p + i));
+    }
+    return result;
+}
+
+void appendUnique(QStringList& list, const QString& value)
+{
+    const QString trimmed = value.trimmed();
+    if (!trimmed.isEmpty() && !list.contains(trimmed, Qt::CaseInsensitive))
+    {
+        list.append(trimmed);
+    }
+}
+
+// libass берёт имена только из записей Windows (Unicode BMP / Symbol); Mac Roman — запасной вариант
+// для старых шрифтов без них, и только если имя в ASCII
+void readNameTable(const FontView& font, TableRef table, FontFace& face)
+{
+    if (table.length < 6)
+    {
+        return;
+    }
+    const uchar* base = font.data + table.offset;
+    const quint16 count = readU16(base + 2);
+    const quint16 stringOffset = readU16(base + 4);
+    if (quint64(6) + quint64(count) * 12 > table.length)
+    {
+        return;
+    }
+
+    QStringList macFamilies;
+    QStringList macFullNames;
+    for (quint16 i = 0; i < count; ++i)
+    {
+        const uchar* record = base + 6 + i * 12;
+        const quint16 platformId = readU16(record);
+        const quint16 encodingId = readU16(record + 2);
+        const quint16 nameId = readU16(record + 6);
+        const quint16 length = readU16(record + 8);
+        const quint32 offset = quint32(stringOffset) + readU16(record + 10);
+        if ((nameId != 1 && nameId != 2 && nameId != 4 && nameId != 6) || offset + quint64(length) > table.length)
+        {
+            continue;
+        }
+
+        QString value;
+        const bool windows = platformId == 3 && (encodingId == 0 || encodingId == 1 || encodingId == 10);
+        if (windows)
+        {
+            value = decodeUtf16Be(base + offset, length);
+        }
+        else if (platformId == 1 && encodingId == 0)
+        {
+            const QByteArrayView raw(base + offset, length);
+            if (std::any_of(raw.begin(), raw.end(), [](char c) { return static_cast<uchar>(c) >= 0x80; }))
+            {
+                continue;
+            }
+            value = QString::fromLatin1(raw);
+        }
+        else
+        {
+            continue;
+        }
+
+        switch (nameId)
+        {
+        case 1:
+            appendUnique(windows ? face.families : macFamilies, value);
+            break;
+        case 2:
+            if (face.subfamily.isEmpty() || windows)
+            {
+                face.subfamily = value.trimmed();
+            }
+            break;
+        default:
+            appendUnique(windows ? face.fullNames : macFullNames, value);
+            break;
+        }
+    }
+
+    if (face.families.isEmpty())
+    {
+        face.families = macFamilies;
+    }
+    if (face.fullNames.isEmpty())
+    {
+        face.fullNames = macFullNames;
+    }
+}
+
+int widthPercent(quint16 widthClass)
+{
+    static constexpr int kWidths[] = {50, 62, 75, 87, 100, 112, 125, 150, 200};
+    return (widthClass >= 1 && widthClass <= 9) ? kWidths[widthClass - 1] : 100;
+}
+
+bool readFace(const FontView& font, quint32 faceOffset, FontFace& face)
+{
+    const TableRef name = findTable(font, faceOffset, Sfnt::kTagName);
+    if (!name.isValid())
+    {
+        return false;
+    }
+    readNameTable(font, name, face);
+    if (face.families.isEmpty())
+    {
+        return false;
+    }
+
+    const TableRef os2 = findTable(font, faceOffset, Sfnt::kTagOs2);
+    if (os2.length >= 64)
+    {
+        const uchar* p = font.data + os2.offset;
+        int weight = readU16(p + 4);
+        // Часть старых шрифтов пишет 1..9 вместо 100..900
+        if (weight >= 1 && weight <= 9)
+        {
+            weight *= 100;
+        }
+        face.weight = weight > 0 ? qBound(100, weight, 1000) : 400;
+        face.width = widthPercent(readU16(p + 6));
+        const quint16 fsSelection = readU16(p + 62);
+        face.italic = (fsSelection & 0x0001) != 0 || (fsSelection & 0x0200) != 0;
+        return true;
+    }
+
+    const TableRef head = findTable(font, faceOffset, Sfnt::kTagHead);
+    if (head.length >= 46)
+    {
+        const quint16 macStyle = readU16(font.data + head.offset + 44);
+        face.weight = (macStyle & 0x0001) != 0 ? 700 : 400;
+        face.italic = (macStyle & 0x0002) != 0;
+    }
+    return true;
+}
+
+class CoverageBuilder
+{
+public:
+    void add(char32_t codepoint)
+    {
+        if (codepoint > 0x10FFFF)
+        {
+            return;
+        }
+        QByteArray& page = m_pages[static_cast<quint16>(codepoint >> 8)];
+        if (page.isEmpty())
+        {
+            page = QByteArray(32, '\0');
+        }
+        page[(codepoint & 0xFF) >> 3] = static_cast<char>(page.at((codepoint & 0xFF) >> 3) | (1 << (codepoint & 7)));
+    }
+
+    // Символьные шрифты (cmap 3,0) кладут глифы в U+F000..F0FF; libass ищет там же символы U+0000..00FF
+    void addSymbolAliases()
+    {
+        const auto page = m_pages.constFind(0xF0);
+        if (page == m_pages.cend())
+        {
+            return;
+        }
+        const QByteArray bits = *page;
+        for (int c = 0; c < 256; ++c)
+        {
+            if ((bits.at(c >> 3) & (1 << (c & 7))) != 0)
+            {
+                add(static_cast<char32_t>(c));
+            }
+        }
+    }
+
+    GlyphCoverage build() const
+    {
+        return GlyphCoverage(m_pages);
+    }
+
+private:
+    QMap<quint16, QByteArray> m_pages;
+};
+
+GlyphCoverage readFaceCoverage(const FontView& font, quint32 faceOffset)
+{
+    CoverageBuilder builder;
+    bool symbol = false;
+    if (!forEachCmapEntry(font, faceOffset, [&builder](char32_t c, quint16) { builder.add(c); }, &symbol))
+    {
+        return {};
+    }
+    if (symbol)
+    {
+        builder.addSymbolAliases();
+    }
+    return builder.build();
+}
+
+bool isFontFileSuffix(const QString& suffix)
+{
+    return suffix.compare(QLatin1String("ttf"), Qt::CaseInsensitive) == 0 ||
+           suffix.compare(QLatin1String("otf"), Qt::CaseInsensitive) == 0 ||
+           suffix.compare(QLatin1String("ttc"), Qt::CaseInsensitive) == 0 ||
+           suffix.compare(QLatin1String("otc"), Qt::CaseInsensitive) == 0;
+}
+} // namespace
+
+// Вне анонимного пространства имён, иначе операторы не найдутся через ADL из QList<FontFace>
+static QDataStream& operator<<(QDataStream& out, const FontFace& face)
+{
+    return out << qint32(face.faceIndex) << face.families << face.fullNames << face.subfamily << qint32(face.weight)
+               << qint32(face.width) << face.italic;
+}
+
+static QDataStream& operator>>(QDataStream& in, FontFace& face)
+{
+    qint32 faceIndex = 0;
+    qint32 weight = 0;
+    qint32 width = 0;
+    in >> faceIndex >> face.families >> face.fullNames >> face.subfamily >> weight >> width >> face.italic;
+    face.faceIndex = faceIndex;
+    face.weight = weight;
+    face.width = width;
+    return in;
+}
+
+FontIndex::FontIndex(QString cachePath) : m_cachePath(std::move(cachePath))
+{
+}
+
+QString FontIndex::defaultCachePath()
+{
+    return QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)).filePath("font_index.bin");
+}
+
+QStringList FontIndex::systemFontDirs()
+{
+    QStringList candidates;
+#if defined(Q_OS_WIN)
+    candidates << QDir(QDir::fromNativeSeparators(qEnvironmentVariable("WINDIR", "C:/Windows"))).filePath("Fonts");
+    const QString localAppData = QDir::fromNativeSeparators(qEnvironmentVariable("LOCALAPPDATA"));
+    if (!localAppData.isEmpty())
+    {
+        // Шрифты, установленные «только для меня»
+        candidates << QDir(localAppData).filePath("Microsoft/Windows/Fonts");
+    }
+#elif defined(Q_OS_MACOS)
+    candidates << "/System/Library/Fonts" << "/Library/Fonts" << QDir::home().filePath("Library/Fonts");
+#else
+    for (const QString& dataDir : QStandardPaths::standardLocations(QStandardPaths::GenericDataLocation))
+    {
+        candidates << QDir(dataDir).filePath("fonts");
+    }
+    candidates << QDir::home().filePath(".fonts");
+#endif
+
+    QStringList dirs;
+    for (const QString& dir : std::as_const(candidates))
+    {
+        const QString cleaned = QDir::cleanPath(dir);
+        if (!dirs.contains(cleaned) && QFileInfo(cleaned).isDir())
+        {
+            dirs.append(cleaned);
+        }
+    }
+    return dirs;
+}
+
+QList<FontFace> FontIndex::readFontFile(const QString& path, QString* errorString)
+{
+    QList<FontFace> faces;
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        if (errorString != nullptr)
+        {
+            *errorString = file.errorString();
+        }
+        return faces;
+    }
+
+    // Отображаем файл целиком: читаются только каталог и три небольшие таблицы,
+    // так что с диска подтягиваются лишь нужные страницы даже у многомегабайтных CJK-шрифтов
+    const qint64 size = file.size();
+    uchar* mapped = size >= 12 ? file.map(0, size) : nullptr;
+    if (mapped == nullptr)
+    {
+        if (errorString != nullptr)
+        {
+            *errorString = size < 12 ? QStringLiteral("файл слишком мал") : file.errorString();
+        }
+        return faces;
+    }
+
+    faces = readFontData(mapped, size, path);
+    file.unmap(mapped);
+    if (faces.isEmpty() && errorString != nullptr)
+    {
+        *errorString = QStringLiteral("нет таблицы name или это не sfnt");
+    }
+    return faces;
+}
+
+QList<FontFace> FontIndex::readFontData(const uchar* data, qint64 size, const QString& path)
+{
+    QList<FontFace> faces;
+    const FontView font{data, size};
+    const QList<quint32> offsets = faceOffsets(font);
+    for (int i = 0; i < offsets.size(); ++i)
+    {
+        FontFace face;
+        face.path = path;
+        face.faceIndex = i;
+        if (readFace(font, offsets.at(i), face))
+        {
+            faces.append(face);
+        }
+    }
+    return faces;
+}
+
+QList<GlyphCoverage> FontIndex::readCoverage(const QString& path)
+{
+    QList<GlyphCoverage> result;
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly) || file.size() < 12)
+    {
+        return result;
+    }
+    uchar* mapped = file.map(0, file.size());
+    if (mapped == nullptr)
+    {
+        return result;
+    }
+
+    const FontView font{mapped, file.size()};
+    for (quint32 offset : faceOffsets(font))
+    {
+        result.append(readFaceCoverage(font, offset));
+    }
+    file.unmap(mapped);
+    return result;
+}
+
+void FontIndex::loadCache()
+{
+    m_cacheLoaded = true;
+    QFile file(m_cachePath);
+    if (m_cachePath.isEmpty() || !file.open(QIODevice::ReadOnly))
+    {
+        return;
+    }
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_6_0);
+    quint32 magic = 0;
+    quint16 version = 0;
+    qint32 count = 0;
+    in >> magic >> version >> count;
+    if (magic != kCacheMagic || version != kCacheVersion || count < 0)
+    {
+        return;
+    }
+
+    QHash<QString, CachedFile> files;
+    files.reserve(count);
+    for (qint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i)
+    {
+        QString path;
+        CachedFile entry;
+        in >> path >> entry.size >> entry.mtimeMs >> entry.contentHash >> entry.faces >> entry.hasCoverage >>
+            entry.coverage;
+        for (FontFace& face : entry.faces)
+        {
+            face.path = path;
+        }
+        files.insert(path, entry);
+    }
+    // Битый кэш не страшен — просто разберём всё заново
+    if (in.status() == QDataStream::Ok)
+    {
+        m_files = std::move(files);
+    }
+}
+
+FontIndex::ScanStats FontIndex::scanDirectories(const QStringList& dirs)
+{
+    QElapsedTimer timer;
+    timer.start();
+    if (!m_cacheLoaded)
+    {
+        loadCache();
+    }
+
+    ScanStats stats;
+    m_faces.clear();
+    m_byFamily.clear();
+    m_byFullName.clear();
+
+    // Сначала только обходим каталоги и сверяем размер и mtime с кэшем
+    QStringList orderedPaths;
+    QList<QPair<QString, CachedFile>> changed;
+    QSet<QString> seenPaths;
+    QHash<QString, QHash<QString, QString>> manifests; // каталог -> имя файла -> хэш
+    QHash<QString, QString> pathByContent;
+    for (auto it = m_files.cbegin(); it != m_files.cend(); ++it)
+    {
+        if (!it->contentHash.isEmpty())
+        {
+            pathByContent.insert(it->contentHash, it.key());
+        }
+    }
+    for (const QString& dirPath : dirs)
+    {
+        const QString root = QDir::cleanPath(QFileInfo(dirPath).absoluteFilePath());
+        QDirIterator it(root, QDir::Files | QDir::Readable, QDirIterator::Subdirectories);
+        while (it.hasNext())
+        {
+            const QFileInfo info = it.nextFileInfo();
+            if (!isFontFileSuffix(info.suffix()))
+            {
+                continue;
+            }
+            const QString path = info.absoluteFilePath();
+            if (seenPaths.contains(path))
+            {
+                continue;
+            }
+            seenPaths.insert(path);
+            orderedPaths.append(path);
+
+            const QString dir = info.absolutePath();
+            if (!manifests.contains(dir))
+            {
+                manifests.insert(dir, readContentManifest(dir));
+            }
+            const QString contentHash = manifests.value(dir).value(info.fileName());
+
+            const qint64 size = info.size();
+            const qint64 mtimeMs = info.lastModified().toMSecsSinceEpoch();
+            const auto cached = m_files.find(path);
+            const auto sameContent = pathByContent.constFind(contentHash);
+            if (cached != m_files.end() && cached->size == size && cached->mtimeMs == mtimeMs)
+            {
+                if (cached->contentHash != contentHash && !contentHash.isEmpty())
+                {
+                    cached->contentHash = contentHash;
+                    pathByContent.insert(contentHash, path);
+                    m_cacheDirty = true;
+                }
+                ++stats.reused;
+            }
+            else if (!contentHash.isEmpty() && sameContent != pathByContent.cend() &&
+                     m_files.value(*sameContent).size == size)
+            {
+                CachedFile entry = m_files.value(*sameContent);
+                entry.mtimeMs = mtimeMs;
+                for (FontFace& face : entry.faces)
+                {
+                    face.path = path;
+                }
+                m_files.insert(path, entry);
+                m_cacheDirty = true;
+                ++stats.shared;
+            }
+            else
+            {
+                changed.append({path, CachedFile{size, mtimeMs, contentHash, {}}});
+            }
+        }
+    }
+    stats.files = static_cast<int>(orderedPaths.size());
+
+    // Новые и изменённые файлы разбираем параллельно: при первом запуске это тысячи системных шрифтов
+    const QList<QList<FontFace>> parsedFaces = QtConcurrent::blockingMapped(
+        changed, [](const QPair<QString, CachedFile>& entry) { return readFontFile(entry.first); });
+    for (int i = 0; i < changed.size(); ++i)
+    {
+        CachedFile entry = changed.at(i).second;
+        entry.faces = parsedFaces.at(i);
+        if (entry.faces.isEmpty())
+        {
+            ++stats.failed;
+        }
+        else
+        {
+            ++stats.parsed;
+        }
+        // Непрочитанные файлы тоже кэшируются, чтобы не разбирать их при каждом запуске
+        m_files.insert(changed.at(i).first, entry);
+        m_cacheDirty = true;
+    }
+
+    for (const QString& path : std::as_const(orderedPaths))
+    {
+        for (const FontFace& face : std::as_const(m_files[path].faces))
+        {
+            appendFace(face);
+        }
+    }
+
+    stats.elapsedMs = timer.elapsed();
+    return stats;
+}
+
+void FontIndex::setFaces(const QList<FontFace>& faces)
+{
+    m_faces.clear();
+    m_byFamily.clear();
+    m_byFullName.clear();
+    for (const FontFace& face : faces)
+    {
+        appendFace(face);
+    }
+}
+
+void FontIndex::appendFace(const FontFace& face)
+{
+    const int index = static_cast<int>(m_faces.size());
+    m_faces.append(face);
+    for (const QString& family : face.families)
+    {
+        QList<int>& bucket = m_byFamily[lookupKey(family)];
+        if (bucket.isEmpty() || bucket.constLast() != index)
+        {
+            bucket.append(index);
+        }
+    }
+    for (const QString& fullName : face.fullNames)
+    {
+        QList<int>& bucket = m_byFullName[lookupKey(fullName)];
+        if (bucket.isEmpty() || bucket.constLast() != index)
+        {
+            bucket.append(index);
+        }
+    }
+}
+
+bool FontIndex::save()
+{
+    if (!m_cacheDirty || m_cachePath.isEmpty())
+    {
+        return true;
+    }
+
+    // Удалённые шрифты (в том числе attached_fonts старых эпизодов) выбрасываем из кэша. Из записей
+    // с известным хэшем одна остаётся, пока нет живого файла с тем же содержимым: следующая серия возьмёт её
+    QSet<QString> keptHashes;
+    for (auto it = m_files.cbegin(); it != m_files.cend(); ++it)
+    {
+        if (!it->contentHash.isEmpty() && QFileInfo::exists(it.key()))
+        {
+            keptHashes.insert(it->contentHash);
+        }
+    }
+    for (auto it = m_files.begin(); it != m_files.end();)
+    {
+        if (QFileInfo::exists(it.key()))
+        {
+            ++it;
+        }
+        else if (!it->contentHash.isEmpty() && !keptHashes.contains(it->contentHash))
+        {
+            keptHashes.insert(it->contentHash);
+            ++it;
+        }
+        else
+        {
+            it = m_files.erase(it);
+        }
+    }
+
+    QDir().mkpath(QFileInfo(m_cachePath).absolutePath());
+    QSaveFile file(m_cachePath);
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        return false;
+    }
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << kCacheMagic << kCacheVersion << qint32(m_files.size());
+    for (auto it = m_files.cbegin(); it != m_files.cend(); ++it)
+    {
+        out << it.key() << it->size << it->mtimeMs << it->contentHash << it->faces << it->hasCoverage << it->coverage;
+    }
+    if (out.status() != QDataStream::Ok || !file.commit())
+    {
+        return false;
+    }
+    m_cacheDirty = false;
+    return true;
+}
+
+QString FontIndex::contentManifestName()
+{
+    return QStringLiteral("fonts.sha1");
+}
+
+QHash<QString, QString> FontIndex::readContentManifest(const QString& dir)
+{
+    QHash<QString, QString> hashes;
+    QFile file(QDir(dir).filePath(contentManifestName()));
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        return hashes;
+    }
+    while (!file.atEnd())
+    {
+        // "<40 hex>  <имя>" или "<40 hex> *<имя>", как пишет sha1sum в текстовом и двоичном режимах
+        const QString line = QString::fromUtf8(file.readLine()).trimmed();
+        if (line.size() > 42 && line.at(40) == u' ' && (line.at(41) == u' ' || line.at(41) == u'*'))
+        {
+            hashes.insert(line.mid(42), line.left(40).toLower());
+        }
+    }
+    return hashes;
+}
+
+QString FontIndex::lookupKey(QString name)
+{
+    name = name.trimmed();
+    if (name.startsWith(u'@'))
+    {
+        name.remove(0, 1);
+    }
+    return name.toCaseFolded();
+}
+
+const FontFace* FontIndex::match(const QString& family, bool bold, bool italic) const
+{
+    const QString key = lookupKey(family);
+    if (key.isEmpty())
+    {
+        return nullptr;
+    }
+
+    const int weight = bold ? 700 : 400;
+    const int slant = italic ? kSlantItalic : 0;
+    const auto byFamily = m_byFamily.constFind(key);
+    if (byFamily != m_byFamily.cend())
+    {
+        return bestMatch(*byFamily, weight, slant);
+    }
+    // В ASS нередко пишут полное имя начертания ("Arial Bold") или PostScript-имя
+    const auto byFullName = m_byFullName.constFind(key);
+    if (byFullName != m_byFullName.cend())
+    {
+        return bestMatch(*byFullName, weight, slant);
+    }
+    return nullptr;
+}
+
+// Та же метрика, что font_attributes_similarity() в libass: сумма расхождений веса, наклона и ширины
+const FontFace* FontIndex::bestMatch(const QList<int>& candidates, int weight, int slant) const
+{
+    const FontFace* best = nullptr;
+    int bestScore = std::numeric_limits<int>::max();
+    for (int index : candidates)
+    {
+        const FontFace& face = m_faces.at(index);
+        const int score =
+            qAbs(face.weight - weight) + qAbs((face.italic ? kSlantItalic : 0) - slant) + qAbs(face.width - 100);
+        // Индексы идут по приоритету каталогов, поэтому при равенстве остаётся более ранний
+        if (score < bestScore)
+        {
+            best = &face;
+            bestScore = score;
+        }
+    }
+    return best;
+}
+
+GlyphCoverage FontIndex::coverage(const QString& path, int faceIndex)
+{
+    const auto cached = m_files.find(path);
+    if (cached != m_files.end() && cached->hasCoverage)
+    {
+        return cached->coverage.value(faceIndex);
+    }
+
+    const QList<GlyphCoverage> coverage = readCoverage(path);
+    // Шрифт не из индекса (например, найденный через DirectWrite) не кэшируем: его размер и mtime неизвестны
+    if (cached != m_files.end())
+    {
+        cached->coverage = coverage;
+        cached->hasCoverage = true;
+        m_cacheDirty = true;
+    }
+    return coverage.value(faceIndex);
+}
+
+GlyphCoverage::GlyphCoverage(const QMap<quint16, QByteArray>& pages)
+{
+    m_pages.reserve(pages.size());
+    m_bits.reserve(pages.size() * 32);
+    for (auto it = pages.cbegin(); it != pages.cend(); ++it)
+    {
+        m_pages.append(it.key());
+        m_bits.append(it.value());
+    }
+}
+
+bool GlyphCoverage::contains(char32_t codepoint) const
+{
+    const quint16 page = static_cast<quint16>(codepoint >> 8);
+    const auto it = std::lower_bound(m_pages.cbegin(), m_pages.cend(), page);
+    if (codepoint > 0x10FFFF || it == m_pages.cend() || *it != page)
+    {
+        return false;
+    }
+    const qsizetype byte = (it - m_pages.cbegin()) * 32 + ((codepoint & 0xFF) >> 3);
+    return (static_cast<uchar>(m_bits.at(byte)) & (1 << (codepoint & 7))) != 0;
+}
+
+QDataStream& operator<<(QDataStream& out, const GlyphCoverage& coverage)
+{
+    return out << coverage.m_pages << coverage.m_bits;
+}
+
+QDataStream& operator>>(QDataStream& in, GlyphCoverage& coverage)
+{
+    in >> coverage.m_pages >> coverage.m_bits;
+    if (coverage.m_bits.size() != coverage.m_pages.size() * 32)
+    {
+        coverage = GlyphCoverage();
+        in.setStatus(QDataStream::ReadCorruptData);
+    }
+    return in;
+}
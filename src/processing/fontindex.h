@@ -0,0 +1,161 @@
+#ifndef FONTINDEX_H
+#define FONTINDEX_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QMap>
+#include <QString>
+#include <QStringList>
+
+class QDataStream;
+
+/// Одно начертание шрифта (в .ttc их несколько) с атрибутами, по которым libass выбирает шрифт.
+struct FontFace
+{
+    QString path;
+    int faceIndex = 0;       // номер начертания внутри .ttc, для .ttf/.otf всегда 0
+    QStringList families;    // name ID 1 на всех языках
+    QStringList fullNames;   // name ID 4 и PostScript-имя (ID 6)
+    QString subfamily;       // name ID 2, только для лога
+    int weight = 400;        // OS/2 usWeightClass
+    int width = 100;         // OS/2 usWidthClass в процентах, 100 — обычная ширина
+    bool italic = false;     // OS/2 fsSelection (italic/oblique), без OS/2 — head.macStyle
+};
+
+/**
+ * @brief Набор символов, для которых в cmap начертания есть глиф.
+ *
+ * Хранится постранично: на каждые 256 кодовых точек, где есть хоть один глиф, — 32 байта битовой маски.
+ * Кириллический шрифт занимает так несколько сотен байт, CJK — единицы килобайт.
+ */
+class GlyphCoverage
+{
+public:
+    GlyphCoverage() = default;
+    /// \a pages: номер страницы (codepoint >> 8) -> 32 байта маски.
+    explicit GlyphCoverage(const QMap<quint16, QByteArray>& pages);
+
+    bool isEmpty() const
+    {
+        return m_pages.isEmpty();
+    }
+    bool contains(char32_t codepoint) const;
+
+    friend QDataStream& operator<<(QDataStream& out, const GlyphCoverage& coverage);
+    friend QDataStream& operator>>(QDataStream& in, GlyphCoverage& coverage);
+
+private:
+    QList<quint16> m_pages; // по возрастанию
+    QByteArray m_bits;      // 32 байта на страницу, в порядке m_pages
+};
+
+/**
+ * @brief Индекс шрифтов, собранный разбором таблиц sfnt (name, OS/2, head) без DirectWrite и fontconfig.
+ *
+ * scanDirectories() обходит каталоги и параллельно разбирает только новые или изменённые файлы: для остальных
+ * атрибуты берутся из дискового кэша (ключ — путь, размер и mtime). После сканирования поиск — это
+ * поиск в хэше по имени семейства и выбор ближайшего начертания так же, как это делает libass.
+ *
+ * После scanDirectories() объект только читается, так что match() можно звать из нескольких потоков.
+ */
+class FontIndex
+{
+public:
+    struct ScanStats
+    {
+        int files = 0;  // файлов шрифтов в каталогах
+        int reused = 0; // взяты из кэша без разбора
+        int shared = 0; // тот же шрифт уже разобран под другим путём (ссылки из хранилища шрифтов)
+        int parsed = 0; // разобраны заново
+        int failed = 0; // не sfnt или повреждены
+        qint64 elapsedMs = 0;
+    };
+
+    explicit FontIndex(QString cachePath = defaultCachePath());
+
+    /// <CacheLocation>/font_index.bin
+    static QString defaultCachePath();
+    /// Системные каталоги шрифтов текущей ОС, включая пользовательские.
+    static QStringList systemFontDirs();
+
+    /// Все начертания файла .ttf/.otf/.ttc; пустой список, если файл не sfnt.
+    static QList<FontFace> readFontFile(const QString& path, QString* errorString = nullptr);
+    /// То же для шрифта в памяти, например вложения внутри MKV; \a path попадает в FontFace::path как есть.
+    static QList<FontFace> readFontData(const uchar* data, qint64 size, const QString& path);
+    /// Покрытие cmap для каждого начертания файла (по faceIndex).
+    static QList<GlyphCoverage> readCoverage(const QString& path);
+
+    /**
+     * @brief Перестроить индекс по каталогам (рекурсивно).
+     *
+     * Каталоги перечисляются по убыванию приоритета: при одинаковом совпадении побеждает шрифт из
+     * каталога, указанного раньше (attached_fonts раньше системных). Кэш с диска читается один раз.
+     * Если хэш файла известен из манифеста каталога, атрибуты берутся у любого уже разобранного файла
+     * с тем же содержимым: шрифт, вложенный в каждую серию сезона, разбирается один раз.
+     */
+    ScanStats scanDirectories(const QStringList& dirs);
+
+    /// Собрать индекс из уже разобранных начертаний без сканирования и кэша; приоритет — порядок в \a faces.
+    void setFaces(const QList<FontFace>& faces);
+
+    /// Записать кэш атрибутов на диск, если он изменился. Файлы, которых больше нет, выбрасываются.
+    bool save();
+
+    /**
+     * @brief Подобрать начертание как libass: сначала по имени семейства (без учёта регистра) с выбором
+     * ближайшего по весу, наклону и ширине, иначе по полному или PostScript-имени.
+     * @return nullptr, если ни одно имя не совпало
+     */
+    const FontFace* match(const QString& family, bool bold, bool italic) const;
+
+    /// Файл в каталоге шрифтов со строками "<sha1>  <имя файла>" (формат sha1sum), см. FontStore.
+    static QString contentManifestName();
+    /// Хэши содержимого из манифеста каталога: имя файла -> SHA-1 в hex; пустой, если манифеста нет.
+    static QHash<QString, QString> readContentManifest(const QString& dir);
+
+    /// Ключ поиска по имени: без учёта регистра и без '@' в начале (вертикальный вариант), как в libass.
+    static QString lookupKey(QString name);
+
+    /**
+     * @brief Покрытие cmap начертания. Для файлов из индекса разбирается один раз и сохраняется
+     * в том же дисковом кэше (save()), пока у файла не изменятся размер или mtime.
+     * @return пустое покрытие, если cmap не читается
+     */
+    GlyphCoverage coverage(const QString& path, int faceIndex);
+
+    bool isEmpty() const
+    {
+        return m_faces.isEmpty();
+    }
+    int faceCount() const
+    {
+        return m_faces.size();
+    }
+
+private:
+    struct CachedFile
+    {
+        qint64 size = 0;
+        qint64 mtimeMs = 0;
+        QString contentHash; // из манифеста каталога, пустой — неизвестен
+        QList<FontFace> faces;
+        bool hasCoverage = false;      // cmap разбирается лениво, только для найденных шрифтов
+        QList<GlyphCoverage> coverage; // по faceIndex
+    };
+
+    void loadCache();
+    void appendFace(const FontFace& face);
+    const FontFace* bestMatch(const QList<int>& candidates, int weight, int slant) const;
+
+    QString m_cachePath;
+    bool m_cacheLoaded = false;
+    bool m_cacheDirty = false;
+    QHash<QString, CachedFile> m_files; // путь -> атрибуты, в том числе из каталогов прошлых запусков
+
+    QList<FontFace> m_faces;              // начертания из последнего scanDirectories(), по приоритету
+    QHash<QString, QList<int>> m_byFamily; // casefold(имя семейства) -> индексы в m_faces
+    QHash<QString, QList<int>> m_byFullName;
+};
+
+#endif // FONTINDEX_H
@@ -0,0 +1,188 @@
+#include "fontstore.h"
+
+#include "fontindex.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QMap>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+namespace
+{
+/// Разместить файл хранилища по \a destPath. Старый файл по этому пути удаляется, а не перезаписывается:
+/// он может быть жёсткой ссылкой на другой шрифт хранилища.
+StoredFont linkFromStore(StoredFont stored, const QString& destPath)
+{
+    stored.link = FileStager::stageFile(stored.storePath, destPath, StageMode::ReadOnlyCopy);
+    stored.ok = stored.link.ok;
+    if (!stored.ok)
+    {
+        stored.errorString = stored.link.errorString;
+    }
+    return stored;
+}
+} // namespace
+
+QString FontStore::defaultStoreDir()
+{
+    return QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)).filePath("font_store");
+}
+
+QString FontStore::storePath(const QString& storeDir, const QString& hash, const QString& suffix)
+{
+    // Подкаталоги по первым символам хэша, чтобы за годы релизов не копить тысячи файлов в одном каталоге
+    return QDir(storeDir).filePath(QStringLiteral("%1/%2.%3").arg(hash.left(2), hash, suffix.toLower()));
+}
+
+StoredFont FontStore::placeData(const uchar* data, qint64 size, const QString& destPath, const QString& storeDir)
+{
+    StoredFont stored;
+    const QByteArrayView bytes(data, size);
+    stored.hash = QString::fromLatin1(QCryptographicHash::hash(bytes, QCryptographicHash::Sha1).toHex());
+    stored.storePath = storePath(storeDir, stored.hash, QFileInfo(destPath).suffix());
+
+    const QFileInfo existing(stored.storePath);
+    if (existing.exists() && existing.size() == size)
+    {
+        stored.reused = true;
+    }
+    else
+    {
+        QDir().mkpath(existing.absolutePath());
+        QSaveFile out(stored.storePath);
+        if (!out.open(QIODevice::WriteOnly) || out.write(bytes.data(), size) != size || !out.commit())
+        {
+            stored.errorString = out.errorString();
+            return stored;
+        }
+    }
+    return linkFromStore(stored, destPath);
+}
+
+StoredFont FontStore::adoptFile(const QString& path, const QString& storeDir)
+{
+    StoredFont stored;
+    QFile file(path);
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    if (!file.open(QIODevice::ReadOnly) || !hash.addData(&file))
+    {
+        stored.errorString = file.errorString();
+        return stored;
+    }
+    file.close();
+    stored.hash = QString::fromLatin1(hash.result().toHex());
+    stored.storePath = storePath(storeDir, stored.hash, QFileInfo(path).suffix());
+
+    const QFileInfo existing(stored.storePath);
+    if (existing.exists() && existing.size() == QFileInfo(path).size())
+    {
+        stored.reused = true;
+    }
+    else
+    {
+        QDir().mkpath(existing.absolutePath());
+        const StageResult moved = FileStager::stageFile(path, stored.storePath, StageMode::Move);
+        if (!moved.ok)
+        {
+            stored.errorString = moved.errorString;
+            return stored;
+        }
+    }
+    return linkFromStore(stored, path);
+}
+
+bool FontStore::writeManifest(const QString& dir, const QHash<QString, QString>& hashesByFileName)
+{
+    // QMap — стабильный порядок строк, чтобы манифест не менялся от запуска к запуску
+    QMap<QString, QString> entries;
+    const QHash<QString, QString> existing = FontIndex::readContentManifest(dir);
+    for (auto it = existing.cbegin(); it != existing.cend(); ++it)
+    {
+        entries.insert(it.key(), it.value());
+    }
+    for (auto it = hashesByFileName.cbegin(); it != hashesByFileName.cend(); ++it)
+    {
+        entries.insert(it.key(), it.value());
+    }
+
+    QSaveFile out(QDir(dir).filePath(FontIndex::contentManifestName()));
+    if (!out.open(QIODevice::WriteOnly))
+    {
+        return false;
+    }
+    for (auto it = entries.cbegin(); it != entries.cend(); ++it)
+    {
+        const QString line = it.value() + QStringLiteral("  ") + it.key() + u'\n';
+        out.write(line.toUtf8());
+    }
+    return out.commit();
+}
+
+QString FontStore::usageJournalName()
+{
+    return QStringLiteral("last_used.txt");
+}
+
+int FontStore::pruneStore(const QStringList& usedStorePaths, int maxUnusedDays, const QString& storeDir)
+{
+    const QDir store(storeDir);
+    const QString journalPath = store.filePath(usageJournalName());
+    QHash<QString, qint64> lastUsed;
+    QFile journal(journalPath);
+    if (journal.open(QIODevice::ReadOnly | QIODevice::Text))
+    {
+        while (!journal.atEnd())
+        {
+            const QString line = QString::fromUtf8(journal.readLine()).trimmed();
+            const qsizetype separator = line.indexOf(QLatin1String("  "));
+            if (separator > 0)
+            {
+                lastUsed.insert(line.mid(separator + 2), line.left(separator).toLongLong());
+            }
+        }
+        journal.close();
+    }
+    const qint64 now = QDateTime::currentSecsSinceEpoch();
+    for (const QString& path : usedStorePaths)
+    {
+        lastUsed.insert(store.relativeFilePath(path), now);
+    }
+
+    // Записи об уже удалённых файлах в журнал не переносятся: он описывает только то, что лежит на диске
+    const qint64 cutoff = now - qint64(maxUnusedDays) * 24 * 3600;
+    QMap<QString, qint64> kept;
+    int removed = 0;
+    QDirIterator it(storeDir, QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext())
+    {
+        const QString relative = store.relativeFilePath(it.next());
+        if (!relative.contains(u'/'))
+        {
+            continue; // в корне лежит только журнал, содержимое — в подкаталогах по хэшу
+        }
+        const qint64 used = lastUsed.value(relative, now);
+        if (used < cutoff && QFile::remove(store.filePath(relative)))
+        {
+            ++removed;
+            store.rmdir(QFileInfo(relative).path()); // удалится, только если подкаталог опустел
+            continue;
+        }
+        kept.insert(relative, used);
+    }
+
+    QSaveFile out(journalPath);
+    if (out.open(QIODevice::WriteOnly))
+    {
+        for (auto entry = kept.cbegin(); entry != kept.cend(); ++entry)
+        {
+            out.write(QStringLiteral("%1  %2\n").arg(entry.value()).arg(entry.key()).toUtf8());
+        }
+        out.commit();
+    }
+    return removed;
+}
@@ -0,0 +1,68 @@
+#ifndef FONTSTORE_H
+#define FONTSTORE_H
+
+#include "filestager.h"
+
+#include <QHash>
+#include <QString>
+#include <QStringList>
+
+/// Шрифт, размещённый в каталоге эпизода из общего хранилища.
+struct StoredFont
+{
+    bool ok = false;
+    QString hash;        // SHA-1 содержимого в hex
+    QString storePath;   // файл в хранилище
+    bool reused = false; // такой шрифт уже был в хранилище, его содержимое заново не записывалось
+    StageResult link;    // как файл появился по пути в каталоге эпизода
+    QString errorString;
+};
+
+/**
+ * @brief Общее для всех серий и сериалов хранилище шрифтов с адресацией по содержимому.
+ *
+ * Файл лежит в <store>/<первые 2 символа хэша>/<sha1>.<расширение> один раз, а в attached_fonts эпизода
+ * появляется ссылкой через FileStager (reflink или жёсткая ссылка, копия — только если хранилище на
+ * другом томе). Хэши пишутся в манифест каталога (FontIndex::contentManifestName()), по которому
+ * FontIndex берёт уже разобранные атрибуты вместо повторного разбора таблиц.
+ *
+ * Файлы в каталоге эпизода могут оказаться жёсткими ссылками: перед записью по тому же пути их
+ * нужно удалять, а не перезаписывать, иначе изменится общая копия.
+ */
+namespace FontStore
+{
+/// Шрифт, который не понадобился ни одному эпизоду столько дней, удаляется из хранилища (pruneStore()).
+constexpr int kStoreMaxUnusedDays = 180;
+
+/// <CacheLocation>/font_store
+QString defaultStoreDir();
+
+/// Путь содержимого с хэшем \a hash в хранилище.
+QString storePath(const QString& storeDir, const QString& hash, const QString& suffix);
+
+/// Положить шрифт из памяти в хранилище, если его там ещё нет, и разместить ссылку на него по \a destPath.
+StoredFont placeData(const uchar* data, qint64 size, const QString& destPath,
+                     const QString& storeDir = defaultStoreDir());
+
+/// Перенести уже извлечённый файл в хранилище (или выбросить, если там есть такой же) и заменить его ссылкой.
+StoredFont adoptFile(const QString& path, const QString& storeDir = defaultStoreDir());
+
+/// Дописать хэши в манифест каталога \a dir, сохранив записи о других файлах.
+bool writeManifest(const QString& dir, const QHash<QString, QString>& hashesByFileName);
+
+/// Журнал использования в корне хранилища: строки "<секунды от эпохи Unix>  <путь относительно хранилища>".
+QString usageJournalName();
+
+/**
+ * @brief Отметить \a usedStorePaths как нужные сейчас и удалить содержимое, не нужное \a maxUnusedDays дней.
+ *
+ * Время использования ведётся в журнале, а не в mtime: файлы хранилища — жёсткие ссылки из эпизодов,
+ * mtime у них общий и входит в ключ кэша FontIndex. Эпизодам удаление не мешает — их ссылки и
+ * reflink-копии держат данные сами. Файл, которого ещё нет в журнале, считается использованным сейчас.
+ * @return число удалённых файлов
+ */
+int pruneStore(const QStringList& usedStorePaths, int maxUnusedDays = kStoreMaxUnusedDays,
+               const QString& storeDir = defaultStoreDir());
+} // namespace FontStore
+
+#endif // FONTSTORE_H
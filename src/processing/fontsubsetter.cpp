@@ -0,0 +1,848 @@
+#include "fontsubsetter.h"
+
+#include "assdocument.h"
+#include "asstexttokenizer.h"
+#include "fontindex.h"
+#include "sfnt.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMap>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QtConcurrent/QtConcurrentMap>
+
+#include <algorithm>
+#include <tuple>
+
+namespace
+{
+using Sfnt::findTable;
+using Sfnt::FontView;
+using Sfnt::readU16;
+using Sfnt::readU32;
+using Sfnt::TableRef;
+
+constexpr quint32 kChecksumMagic = 0xB1B0AFBA;
+constexpr quint16 kFsTypeNoSubsetting = 0x0100;
+constexpr quint16 kFsTypeBitmapOnly = 0x0200;
+
+// Окно в таблицу: чтение за её пределами даёт 0, так что битые смещения просто обрывают обход
+struct Slice
+{
+    const uchar* data = nullptr;
+    quint32 size = 0;
+
+    quint16 u16(quint64 offset) const
+    {
+        return offset + 2 <= size ? readU16(data + offset) : 0;
+    }
+    quint32 u32(quint64 offset) const
+    {
+        return offset + 4 <= size ? readU32(data + offset) : 0;
+    }
+    Slice at(quint64 offset) const
+    {
+        return offset < size ? Slice{data + offset, static_cast<quint32>(size - offset)} : Slice{};
+    }
+};
+
+Slice tableSlice(const FontView& font, TableRef table)
+{
+    return table.isValid() ? Slice{font.data + table.offset, table.length} : Slice{};
+}
+
+void appendU16(QByteArray& out, quint16 value)
+{
+    out.append(static_cast<char>(value >> 8));
+    out.append(static_cast<char>(value & 0xFF));
+}
+
+void appendU32(QByteArray& out, quint32 value)
+{
+    appendU16(out, static_cast<quint16>(value >> 16));
+    appendU16(out, static_cast<quint16>(value & 0xFFFF));
+}
+
+void writeU32(QByteArray& out, qsizetype offset, quint32 value)
+{
+    out[offset] = static_cast<char>(value >> 24);
+    out[offset + 1] = static_cast<char>((value >> 16) & 0xFF);
+    out[offset + 2] = static_cast<char>((value >> 8) & 0xFF);
+    out[offset + 3] = static_cast<char>(value & 0xFF);
+}
+
+quint32 tableChecksum(const QByteArray& data)
+{
+    quint32 sum = 0;
+    const auto* p = reinterpret_cast<const uchar*>(data.constData());
+    qsizetype i = 0;
+    for (; i + 4 <= data.size(); i += 4)
+    {
+        sum += readU32(p + i);
+    }
+    // Хвост таблицы дополняется нулями до границы 4 байт
+    quint32 tail = 0;
+    for (int shift = 24; i < data.size(); ++i, shift -= 8)
+    {
+        tail |= quint32(p[i]) << shift;
+    }
+    return sum + tail;
+}
+
+// Глифы из таблицы Coverage (форматы 1 и 2)
+QList<quint16> coverageGlyphs(Slice coverage)
+{
+    QList<quint16> glyphs;
+    const quint16 format = coverage.u16(0);
+    const quint16 count = coverage.u16(2);
+    for (quint16 i = 0; i < count; ++i)
+    {
+        if (format == 1)
+        {
+            glyphs.append(coverage.u16(4 + quint64(i) * 2));
+        }
+        else if (format == 2)
+        {
+            const quint64 range = 4 + quint64(i) * 6;
+            for (quint32 glyph = coverage.u16(range); glyph <= coverage.u16(range + 2); ++glyph)
+            {
+                glyphs.append(static_cast<quint16>(glyph));
+            }
+        }
+    }
+    return glyphs;
+}
+
+// Все глифы, которые подстановка может вывести. Входы не проверяются: лишний глиф дешевле квадрата в кадре
+void collectSubstitutes(Slice sub, quint16 lookupType, QSet<quint16>& out)
+{
+    switch (lookupType)
+    {
+    case 1: // Single
+        if (sub.u16(0) == 1)
+        {
+            const auto delta = static_cast<qint16>(sub.u16(4));
+            for (quint16 glyph : coverageGlyphs(sub.at(sub.u16(2))))
+            {
+                out.insert(static_cast<quint16>(glyph + delta));
+            }
+        }
+        else
+        {
+            for (quint16 i = 0; i < sub.u16(4); ++i)
+            {
+                out.insert(sub.u16(6 + quint64(i) * 2));
+            }
+        }
+        break;
+    case 2: // Multiple: Sequence и AlternateSet устроены одинаково
+    case 3: // Alternate
+        for (quint16 i = 0; i < sub.u16(4); ++i)
+        {
+            const Slice sequence = sub.at(sub.u16(6 + quint64(i) * 2));
+            for (quint16 j = 0; j < sequence.u16(0); ++j)
+            {
+                out.insert(sequence.u16(2 + quint64(j) * 2));
+            }
+        }
+        break;
+    case 4: // Ligature
+        for (quint16 i = 0; i < sub.u16(4); ++i)
+        {
+            const Slice ligatureSet = sub.at(sub.u16(6 + quint64(i) * 2));
+            for (quint16 j = 0; j < ligatureSet.u16(0); ++j)
+            {
+                out.insert(ligatureSet.at(ligatureSet.u16(2 + quint64(j) * 2)).u16(0));
+            }
+        }
+        break;
+    case 7: // Extension
+    {
+        const quint16 extensionType = sub.u16(2);
+        if (sub.u16(0) == 1 && extensionType != 7)
+        {
+            collectSubstitutes(sub.at(sub.u32(4)), extensionType, out);
+        }
+        break;
+    }
+    case 8: // Reverse chaining single
+    {
+        quint64 pos = 4;
+        pos += 2 + quint64(sub.u16(pos)) * 2; // backtrack
+        pos += 2 + quint64(sub.u16(pos)) * 2; // lookahead
+        for (quint16 i = 0; i < sub.u16(pos); ++i)
+        {
+            out.insert(sub.u16(pos + 2 + quint64(i) * 2));
+        }
+        break;
+    }
+    default: // 5 и 6 только вызывают другие подстановки, их выходы соберутся из тех
+        break;
+    }
+}
+
+QSet<quint16> gsubOutputs(Slice gsub)
+{
+    QSet<quint16> outputs;
+    const Slice lookupList = gsub.at(gsub.u16(8));
+    for (quint16 i = 0; i < lookupList.u16(0); ++i)
+    {
+        const Slice lookup = lookupList.at(lookupList.u16(2 + quint64(i) * 2));
+        const quint16 type = lookup.u16(0);
+        for (quint16 j = 0; j < lookup.u16(4); ++j)
+        {
+            collectSubstitutes(lookup.at(lookup.u16(6 + quint64(j) * 2)), type, outputs);
+        }
+    }
+    return outputs;
+}
+
+// Компоненты составного глифа (numberOfContours < 0)
+void appendComponents(Slice glyph, QList<quint16>& pending)
+{
+    if (glyph.size < 10 || static_cast<qint16>(glyph.u16(0)) >= 0)
+    {
+        return;
+    }
+    constexpr quint16 kArgsAreWords = 0x0001;
+    constexpr quint16 kHaveScale = 0x0008;
+    constexpr quint16 kMoreComponents = 0x0020;
+    constexpr quint16 kHaveXYScale = 0x0040;
+    constexpr quint16 kHaveTwoByTwo = 0x0080;
+
+    quint64 pos = 10;
+    quint16 flags = kMoreComponents;
+    while ((flags & kMoreComponents) != 0 && pos + 4 <= glyph.size)
+    {
+        flags = glyph.u16(pos);
+        pending.append(glyph.u16(pos + 2));
+        pos += 4 + ((flags & kArgsAreWords) != 0 ? 4 : 2);
+        if ((flags & kHaveScale) != 0)
+        {
+            pos += 2;
+        }
+        else if ((flags & kHaveXYScale) != 0)
+        {
+            pos += 4;
+        }
+        else if ((flags & kHaveTwoByTwo) != 0)
+        {
+            pos += 8;
+        }
+    }
+}
+
+struct NameRecord
+{
+    quint16 platformId = 3;
+    quint16 encodingId = 1;
+    quint16 languageId = 0x0409;
+    quint16 nameId = 0;
+    QByteArray value; // UTF-16BE
+
+    bool operator<(const NameRecord& other) const
+    {
+        return std::tie(platformId, encodingId, languageId, nameId) <
+               std::tie(other.platformId, other.encodingId, other.languageId, other.nameId);
+    }
+};
+
+QByteArray utf16Be(const QString& text)
+{
+    QByteArray out;
+    out.reserve(text.size() * 2);
+    for (QChar c : text)
+    {
+        appendU16(out, c.unicode());
+    }
+    return out;
+}
+
+// Новая таблица name: имена семейства заменяются, копирайт, версия и лицензия (ID 0, 5, 7-14) и имена
+// фич/осей (ID 256+) переносятся из записей Windows. Типографское семейство (ID 16/17) выбрасывается,
+// иначе часть рендереров нашла бы шрифт по старому имени.
+QByteArray buildNameTable(Slice name, const QString& newFamily)
+{
+    QList<NameRecord> records;
+    QString subfamily;
+    bool subfamilyIsEnglish = false;
+
+    const quint16 count = name.u16(2);
+    const quint16 stringOffset = name.u16(4);
+    for (quint16 i = 0; i < count; ++i)
+    {
+        const quint64 record = 6 + quint64(i) * 12;
+        NameRecord entry;
+        entry.platformId = name.u16(record);
+        entry.encodingId = name.u16(record + 2);
+        entry.languageId = name.u16(record + 4);
+        entry.nameId = name.u16(record + 6);
+        const quint16 length = name.u16(record + 8);
+        const quint64 offset = quint64(stringOffset) + name.u16(record + 10);
+        if (entry.platformId != 3 || (entry.encodingId != 1 && entry.encodingId != 10) ||
+            offset + length > name.size)
+        {
+            continue;
+        }
+        entry.value = QByteArray(reinterpret_cast<const char*>(name.data + offset), length);
+
+        if (entry.nameId == 2 && (subfamily.isEmpty() || (!subfamilyIsEnglish && entry.languageId == 0x0409)))
+        {
+            QString value;
+            for (qsizetype c = 0; c + 1 < entry.value.size(); c += 2)
+            {
+                value.append(QChar(readU16(reinterpret_cast<const uchar*>(entry.value.constData()) + c)));
+            }
+            subfamily = value.trimmed();
+            subfamilyIsEnglish = entry.languageId == 0x0409;
+        }
+        const bool keep = entry.nameId == 0 || entry.nameId == 5 || (entry.nameId >= 7 && entry.nameId <= 14) ||
+                          entry.nameId >= 256;
+        if (keep)
+        {
+            records.append(entry);
+        }
+    }
+    if (subfamily.isEmpty())
+    {
+        subfamily = QStringLiteral("Regular");
+    }
+
+    QString postScriptSuffix;
+    for (QChar c : subfamily)
+    {
+        if (c.unicode() < 0x80 && c.isLetterOrNumber())
+        {
+            postScriptSuffix.append(c);
+        }
+    }
+
+    const auto addName = [&records](quint16 nameId, const QString& value)
+    {
+        NameRecord entry;
+        entry.nameId = nameId;
+        entry.value = utf16Be(value);
+        records.append(entry);
+    };
+    addName(1, newFamily);
+    addName(2, subfamily);
+    addName(3, newFamily + u';' + subfamily);
+    addName(4, newFamily + u' ' + subfamily);
+    addName(6, postScriptSuffix.isEmpty() ? newFamily : QString(newFamily + u'-' + postScriptSuffix));
+    std::stable_sort(records.begin(), records.end());
+
+    QByteArray table;
+    QByteArray strings;
+    appendU16(table, 0);
+    appendU16(table, static_cast<quint16>(records.size()));
+    appendU16(table, static_cast<quint16>(6 + records.size() * 12));
+    for (const NameRecord& entry : std::as_const(records))
+    {
+        appendU16(table, entry.platformId);
+        appendU16(table, entry.encodingId);
+        appendU16(table, entry.languageId);
+        appendU16(table, entry.nameId);
+        appendU16(table, static_cast<quint16>(entry.value.size()));
+        appendU16(table, static_cast<quint16>(strings.size()));
+        strings += entry.value;
+    }
+    return table + strings;
+}
+
+// Собрать sfnt из таблиц: каталог по возрастанию тегов, таблицы выровнены на 4 байта
+QByteArray writeFont(quint32 sfntVersion, const QMap<quint32, QByteArray>& tables)
+{
+    const auto numTables = static_cast<quint16>(tables.size());
+    quint16 maxPowerOfTwo = 1;
+    quint16 entrySelector = 0;
+    while (maxPowerOfTwo * 2 <= numTables)
+    {
+        maxPowerOfTwo *= 2;
+        ++entrySelector;
+    }
+
+    QByteArray font;
+    appendU32(font, sfntVersion);
+    appendU16(font, numTables);
+    appendU16(font, static_cast<quint16>(maxPowerOfTwo * 16));
+    appendU16(font, entrySelector);
+    appendU16(font, static_cast<quint16>(numTables * 16 - maxPowerOfTwo * 16));
+
+    quint32 offset = 12 + quint32(numTables) * 16;
+    QByteArray body;
+    qsizetype headOffset = -1;
+    for (auto it = tables.cbegin(); it != tables.cend(); ++it)
+    {
+        appendU32(font, it.key());
+        appendU32(font, tableChecksum(it.value()));
+        appendU32(font, offset + static_cast<quint32>(body.size()));
+        appendU32(font, static_cast<quint32>(it.value().size()));
+        if (it.key() == Sfnt::kTagHead)
+        {
+            headOffset = offset + body.size();
+        }
+        body += it.value();
+        body.append((4 - body.size() % 4) % 4, '\0');
+    }
+    font += body;
+
+    if (headOffset >= 0)
+    {
+        writeU32(font, headOffset + 8, kChecksumMagic - tableChecksum(font));
+    }
+    return font;
+}
+
+QString hashHex(const QByteArray& data)
+{
+    return QString::fromLatin1(QCryptographicHash::hash(data, QCryptographicHash::Sha1).toHex());
+}
+
+QByteArray codepointKey(const QSet<char32_t>& codepoints)
+{
+    QList<char32_t> sorted(codepoints.cbegin(), codepoints.cend());
+    std::sort(sorted.begin(), sorted.end());
+    return QByteArray(reinterpret_cast<const char*>(sorted.constData()),
+                      sorted.size() * static_cast<qsizetype>(sizeof(char32_t)));
+}
+
+struct SubsetJob
+{
+    QString groupKey;
+    QString path;
+    QSet<char32_t> codepoints;
+    QString newFamily;
+};
+
+struct SubsetGroup
+{
+    QString family;                         // имя, как в ASS
+    QHash<QString, QSet<char32_t>> perFile; // файл -> символы его начертаний
+    QSet<char32_t> codepoints;              // все символы группы, для имени подмножества
+    QString skipReason;
+};
+} // namespace
+
+QString FontSubsetter::defaultCacheDir()
+{
+    return QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)).filePath("font_subsets");
+}
+
+QString FontSubsetter::subsetFamilyName(const QString& family, const QSet<char32_t>& codepoints)
+{
+    const QByteArray key = FontIndex::lookupKey(family).toUtf8() + '\0' + codepointKey(codepoints);
+    return QStringLiteral("DT") + hashHex(key).left(8).toUpper();
+}
+
+QByteArray FontSubsetter::subsetFontData(const QByteArray& data, const QSet<char32_t>& codepoints,
+                                         const QString& newFamily, QString* errorString)
+{
+    const auto fail = [errorString](const QString& reason)
+    {
+        if (errorString != nullptr)
+        {
+            *errorString = reason;
+        }
+        return QByteArray();
+    };
+
+    const FontView font{reinterpret_cast<const uchar*>(data.constData()), data.size()};
+    if (!font.contains(0, 12))
+    {
+        return fail(QStringLiteral("файл слишком мал"));
+    }
+    if (readU32(font.data) == Sfnt::kTagTtcf)
+    {
+        return fail(QStringLiteral("коллекция .ttc"));
+    }
+    if (findTable(font, 0, Sfnt::kTagCff).isValid() || findTable(font, 0, Sfnt::kTagCff2).isValid())
+    {
+        return fail(QStringLiteral("контуры CFF"));
+    }
+    if (findTable(font, 0, Sfnt::kTagFvar).isValid())
+    {
+        return fail(QStringLiteral("вариативный шрифт"));
+    }
+    const TableRef os2 = findTable(font, 0, Sfnt::kTagOs2);
+    if (os2.length >= 10)
+    {
+        const quint16 fsType = readU16(font.data + os2.offset + 8);
+        if ((fsType & (kFsTypeNoSubsetting | kFsTypeBitmapOnly)) != 0)
+        {
+            return fail(QStringLiteral("лицензия шрифта (fsType) запрещает урезание"));
+        }
+    }
+
+    const TableRef head = findTable(font, 0, Sfnt::kTagHead);
+    const TableRef maxp = findTable(font, 0, Sfnt::kTagMaxp);
+    const TableRef loca = findTable(font, 0, Sfnt::kTagLoca);
+    const TableRef glyf = findTable(font, 0, Sfnt::kTagGlyf);
+    const TableRef name = findTable(font, 0, Sfnt::kTagName);
+    if (head.length < 54 || maxp.length < 6 || !loca.isValid() || !glyf.isValid() || !name.isValid())
+    {
+        return fail(QStringLiteral("нет таблиц head/maxp/loca/glyf/name"));
+    }
+    const quint16 numGlyphs = readU16(font.data + maxp.offset + 4);
+    const bool longLoca = readU16(font.data + head.offset + 50) == 1;
+    if (quint64(numGlyphs + 1) * (longLoca ? 4 : 2) > loca.length)
+    {
+        return fail(QStringLiteral("таблица loca короче числа глифов"));
+    }
+
+    const Slice locaTable = tableSlice(font, loca);
+    const auto glyphStart = [&](quint32 glyph) -> quint32
+    { return longLoca ? locaTable.u32(quint64(glyph) * 4) : quint32(locaTable.u16(quint64(glyph) * 2)) * 2; };
+    const Slice glyfTable = tableSlice(font, glyf);
+    const auto glyphData = [&](quint16 glyph) -> Slice
+    {
+        const quint32 start = glyphStart(glyph);
+        const quint32 end = glyphStart(glyph + 1);
+        return (start < end && end <= glyfTable.size) ? Slice{glyfTable.data + start, end - start} : Slice{};
+    };
+
+    // Пробелы субтитры не учитывают (для них не нужен глиф), но libass ими отступает
+    const auto wanted = [&codepoints](char32_t c) { return codepoints.contains(c) || QChar::isSpace(c); };
+    QList<bool> keep(numGlyphs, false);
+    QList<bool> mapped(numGlyphs, false);
+    bool symbol = false;
+    Sfnt::forEachCmapEntry(
+        font, 0,
+        [&](char32_t c, quint16 glyph)
+        {
+            if (glyph >= numGlyphs)
+            {
+                return;
+            }
+            mapped[glyph] = true;
+            // Символьный шрифт: U+F0xx в cmap отвечает символу U+00xx в тексте
+            if (wanted(c) || (symbol && c >= 0xF000 && c <= 0xF0FF && wanted(c - 0xF000)))
+            {
+                keep[glyph] = true;
+            }
+        },
+        &symbol);
+
+    QList<quint16> pending;
+    if (numGlyphs > 0)
+    {
+        pending.append(0); // .notdef
+    }
+    for (quint16 glyph = 0; glyph < numGlyphs; ++glyph)
+    {
+        // Глифы без символа доступны только шейперу (лигатуры, локальные формы) — их не трогаем
+        if (keep.at(glyph) || !mapped.at(glyph))
+        {
+            pending.append(glyph);
+        }
+    }
+    const TableRef gsub = findTable(font, 0, Sfnt::kTagGsub);
+    for (quint16 glyph : gsubOutputs(tableSlice(font, gsub)))
+    {
+        pending.append(glyph);
+    }
+    std::fill(keep.begin(), keep.end(), false);
+    while (!pending.isEmpty())
+    {
+        const quint16 glyph = pending.takeLast();
+        if (glyph >= numGlyphs || keep.at(glyph))
+        {
+            continue;
+        }
+        keep[glyph] = true;
+        appendComponents(glyphData(glyph), pending);
+    }
+
+    // Номера глифов остаются прежними: у выброшенных пустой контур, как у пробела
+    QByteArray newGlyf;
+    QByteArray newLoca;
+    for (quint32 glyph = 0; glyph <= numGlyphs; ++glyph)
+    {
+        if (longLoca)
+        {
+            appendU32(newLoca, static_cast<quint32>(newGlyf.size()));
+        }
+        else
+        {
+            appendU16(newLoca, static_cast<quint16>(newGlyf.size() / 2));
+        }
+        if (glyph < numGlyphs && keep.at(glyph))
+        {
+            const Slice outline = glyphData(static_cast<quint16>(glyph));
+            newGlyf.append(reinterpret_cast<const char*>(outline.data), outline.size);
+            if (!longLoca && newGlyf.size() % 2 != 0)
+            {
+                newGlyf.append('\0');
+            }
+        }
+    }
+
+    QMap<quint32, QByteArray> tables;
+    const quint16 numTables = readU16(font.data + 4);
+    if (!font.contains(12, quint64(numTables) * 16))
+    {
+        return fail(QStringLiteral("повреждён каталог таблиц"));
+    }
+    for (quint16 i = 0; i < numTables; ++i)
+    {
+        const quint32 tag = readU32(font.data + 12 + i * 16);
+        const TableRef table = findTable(font, 0, tag);
+        if (tag != Sfnt::kTagDsig && table.isValid())
+        {
+            tables.insert(tag, QByteArray(reinterpret_cast<const char*>(font.data + table.offset), table.length));
+        }
+    }
+    tables.insert(Sfnt::kTagGlyf, newGlyf);
+    tables.insert(Sfnt::kTagLoca, newLoca);
+    tables.insert(Sfnt::kTagName, buildNameTable(tableSlice(font, name), newFamily));
+    writeU32(tables[Sfnt::kTagHead], 8, 0); // checkSumAdjustment считается по готовому файлу
+    return writeFont(readU32(font.data), tables);
+}
+
+FontSubsetResult FontSubsetter::subsetFont(const QString& fontPath, const QSet<char32_t>& codepoints,
+                                           const QString& newFamily, const QString& cacheDir)
+{
+    FontSubsetResult result;
+    QFile file(fontPath);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        result.errorString = file.errorString();
+        return result;
+    }
+    const QByteArray original = file.readAll();
+    file.close();
+    result.originalBytes = original.size();
+
+    // Ключ кэша — содержимое шрифта, а не путь: один и тот же файл из разных релизов урезается один раз
+    const QString fileName = QStringLiteral("%1_%2.%3")
+                                 .arg(hashHex(original).left(16),
+                                      hashHex(codepointKey(codepoints) + newFamily.toUtf8()).left(16),
+                                      QFileInfo(fontPath).suffix().toLower());
+    result.path = QDir(cacheDir).filePath(fileName);
+    if (QFileInfo::exists(result.path))
+    {
+        // Отметка использования для pruneCache(); подмножество ни с чем не связано ссылкой, mtime трогать можно
+        QFile cached(result.path);
+        if (cached.open(QIODevice::ReadWrite | QIODevice::ExistingOnly))
+        {
+            cached.setFileTime(QDateTime::currentDateTime(), QFileDevice::FileModificationTime);
+        }
+        result.ok = true;
+        result.fromCache = true;
+        result.subsetBytes = QFileInfo(result.path).size();
+        return result;
+    }
+
+    const QByteArray subset = subsetFontData(original, codepoints, newFamily, &result.errorString);
+    if (subset.isEmpty())
+    {
+        return result;
+    }
+    QDir().mkpath(cacheDir);
+    QSaveFile out(result.path);
+    if (!out.open(QIODevice::WriteOnly) || out.write(subset) != subset.size() || !out.commit())
+    {
+        result.errorString = out.errorString();
+        return result;
+    }
+    result.ok = true;
+    result.subsetBytes = subset.size();
+    return result;
+}
+
+SubsetPlan FontSubsetter::planSubsets(const FontFinderResult& fonts, const GlyphUsage& usage, const QString& cacheDir)
+{
+    SubsetPlan plan;
+    QMap<QString, SubsetGroup> groups; // QMap — стабильный порядок в логе
+    QHash<QString, QString> ownerByPath;
+    QSet<AssStyleInfo> resolved;
+    for (const ResolvedFontStyle& font : fonts.resolvedStyles)
+    {
+        const QString key = FontIndex::lookupKey(font.style.fontName);
+        SubsetGroup& group = groups[key];
+        if (group.family.isEmpty())
+        {
+            group.family = font.style.fontName;
+        }
+        resolved.insert(font.style);
+
+        if (!font.fromIndex)
+        {
+            group.skipReason = QStringLiteral("найден не через индекс шрифтов");
+        }
+        else if (font.faceIndex != 0)
+        {
+            group.skipReason = QStringLiteral("начертание внутри коллекции .ttc");
+        }
+        const QString owner = ownerByPath.value(font.path);
+        if (!owner.isEmpty() && owner != key)
+        {
+            // Один файл под двумя именами: переименовать его можно только в одно из них
+            group.skipReason = QStringLiteral("файл нужен и шрифту %1").arg(groups[owner].family);
+            groups[owner].skipReason = QStringLiteral("файл нужен и шрифту %1").arg(group.family);
+        }
+        ownerByPath.insert(font.path, key);
+
+        const QSet<char32_t> used = usage.value(font.style);
+        group.perFile[font.path].unite(used);
+        group.codepoints.unite(used);
+    }
+    // Начертание, которого нет среди найденных, после переименования ушло бы на подмножество другого файла
+    for (auto it = usage.cbegin(); it != usage.cend(); ++it)
+    {
+        const auto group = groups.find(FontIndex::lookupKey(it.key().fontName));
+        if (group != groups.end() && !resolved.contains(it.key()))
+        {
+            group->skipReason = QStringLiteral("найдены не все начертания");
+        }
+    }
+
+    QList<SubsetJob> jobs;
+    for (auto group = groups.cbegin(); group != groups.cend(); ++group)
+    {
+        if (!group->skipReason.isEmpty())
+        {
+            continue;
+        }
+        const QString newFamily = subsetFamilyName(group->family, group->codepoints);
+        for (auto file = group->perFile.cbegin(); file != group->perFile.cend(); ++file)
+        {
+            jobs.append({group.key(), file.key(), file.value(), newFamily});
+        }
+    }
+    const QList<FontSubsetResult> results =
+        QtConcurrent::blockingMapped(jobs, [cacheDir](const SubsetJob& job)
+                                     { return subsetFont(job.path, job.codepoints, job.newFamily, cacheDir); });
+
+    QHash<QString, FontSubsetResult> subsetByPath;
+    for (int i = 0; i < jobs.size(); ++i)
+    {
+        const SubsetJob& job = jobs.at(i);
+        if (!results.at(i).ok)
+        {
+            groups[job.groupKey].skipReason =
+                QStringLiteral("%1: %2").arg(QFileInfo(job.path).fileName(), results.at(i).errorString);
+            continue;
+        }
+        subsetByPath.insert(job.path, results.at(i));
+        plan.renames.insert(job.groupKey, job.newFamily);
+    }
+    for (auto group = groups.cbegin(); group != groups.cend(); ++group)
+    {
+        if (!group->skipReason.isEmpty())
+        {
+            plan.renames.remove(group.key());
+            plan.skipped.append(QStringLiteral("%1 (%2)").arg(group->family, group->skipReason));
+        }
+    }
+
+    QSet<QString> attached;
+    for (const FoundFontInfo& found : fonts.foundFonts)
+    {
+        if (attached.contains(found.path))
+        {
+            continue;
+        }
+        attached.insert(found.path);
+
+        SubsetAttachment attachment;
+        attachment.path = found.path;
+        attachment.attachmentName = QFileInfo(found.path).fileName();
+        const QString owner = ownerByPath.value(found.path);
+        const auto subset = subsetByPath.constFind(found.path);
+        if (plan.renames.contains(owner) && subset != subsetByPath.cend())
+        {
+            attachment.path = subset->path;
+            attachment.subset = true;
+            plan.originalBytes += subset->originalBytes;
+            plan.subsetBytes += subset->subsetBytes;
+            plan.fromCache += subset->fromCache ? 1 : 0;
+        }
+        plan.attachments.append(attachment);
+    }
+    return plan;
+}
+
+int FontSubsetter::pruneCache(const QString& cacheDir, int maxUnusedDays)
+{
+    const QDateTime cutoff = QDateTime::currentDateTime().addDays(-maxUnusedDays);
+    int removed = 0;
+    const QFileInfoList files = QDir(cacheDir).entryInfoList(QDir::Files);
+    for (const QFileInfo& info : files)
+    {
+        if (info.lastModified() < cutoff && QFile::remove(info.filePath()))
+        {
+            ++removed;
+        }
+    }
+    return removed;
+}
+
+bool FontSubsetter::renameFontsInAss(const QString& sourcePath, const QString& destPath,
+                                     const QHash<QString, QString>& renames)
+{
+    AssDocument doc = AssDocument::fromFile(sourcePath);
+    if (!doc.isValid())
+    {
+        return false;
+    }
+
+    // '@' (вертикальный текст) сохраняется перед новым именем
+    const auto renamed = [&renames](QStringView name) -> QString
+    {
+        const QString trimmed = name.trimmed().toString();
+        const auto it = renames.constFind(FontIndex::lookupKey(trimmed));
+        if (it == renames.cend())
+        {
+            return QString();
+        }
+        if (trimmed.startsWith(u'@'))
+        {
+            return u'@' + *it;
+        }
+        return *it;
+    };
+
+    for (int i = 0; i < doc.styles().size(); ++i)
+    {
+        const QString name = renamed(doc.styleField(i, AssDocument::StyleField::Fontname));
+        if (!name.isEmpty())
+        {
+            doc.setStyleField(i, AssDocument::StyleField::Fontname, name);
+        }
+    }
+
+    for (int i = 0; i < doc.events().size(); ++i)
+    {
+        const QString text = doc.eventField(i, AssDocument::EventField::Text);
+        QString rewritten;
+        qsizetype copied = 0;
+        AssTextTokenizer tokenizer(text);
+        AssTextToken token;
+        while (tokenizer.next(token))
+        {
+            if (token.kind != AssTextToken::Kind::Tag || !token.text.startsWith(u"fn"))
+            {
+                continue;
+            }
+            const QString name = renamed(token.text.mid(2));
+            if (name.isEmpty())
+            {
+                continue;
+            }
+            const qsizetype valueStart = token.position + 2;
+            rewritten += QStringView(text).mid(copied, valueStart - copied);
+            rewritten += name;
+            copied = token.position + token.text.size();
+        }
+        if (copied > 0)
+        {
+            rewritten += QStringView(text).mid(copied);
+            doc.setEventText(i, rewritten);
+        }
+    }
+    return doc.save(destPath);
+}
@@ -0,0 +1,97 @@
+#ifndef FONTSUBSETTER_H
+#define FONTSUBSETTER_H
+
+#include "fontfinder.h"
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+
+struct FontSubsetResult
+{
+    bool ok = false;
+    bool fromCache = false;
+    QString path; // файл подмножества в кэше
+    qint64 originalBytes = 0;
+    qint64 subsetBytes = 0;
+    QString errorString;
+};
+
+/// Шрифт для вложения в MKV: подмножество из кэша или исходный файл целиком.
+struct SubsetAttachment
+{
+    QString path;
+    QString attachmentName; // имя исходного файла, чтобы в MKV было видно, какой это шрифт
+    bool subset = false;
+};
+
+struct SubsetPlan
+{
+    QList<SubsetAttachment> attachments; // в порядке FontFinderResult::foundFonts
+    QHash<QString, QString> renames;     // FontIndex::lookupKey(имя из ASS) -> новое имя семейства
+    QStringList skipped;                 // причины, по которым шрифт вложен целиком, для лога
+    qint64 originalBytes = 0;            // только по шрифтам, которые удалось урезать
+    qint64 subsetBytes = 0;
+    int fromCache = 0;
+};
+
+/**
+ * @brief Урезание TrueType-шрифтов до символов, которые реально встречаются в субтитрах.
+ *
+ * Контуры неиспользуемых глифов выбрасываются из glyf, номера глифов не меняются, поэтому cmap,
+ * hmtx, kern, GPOS и GSUB остаются корректными без перестройки. Сохраняются глифы, которые могут
+ * понадобиться шейперу: без записи в cmap, результаты любых подстановок GSUB и компоненты составных глифов.
+ * Семейство переименовывается (name ID 1/3/4/6), чтобы libass не спутал подмножество с полным
+ * шрифтом, установленным у зрителя; в субтитрах имя меняется так же (renameFontsInAss()).
+ */
+namespace FontSubsetter
+{
+/// Подмножество, не понадобившееся столько дней, удаляется из кэша (pruneCache()).
+constexpr int kCacheMaxUnusedDays = 90;
+
+/// <CacheLocation>/font_subsets
+QString defaultCacheDir();
+
+/// Имя семейства подмножества: зависит от исходного имени и набора символов, например "DT3F9A0C21".
+QString subsetFamilyName(const QString& family, const QSet<char32_t>& codepoints);
+
+/**
+ * @brief Урезать шрифт в памяти.
+ * @return пустой массив, если шрифт нельзя урезать (CFF, вариативный, .ttc, запрет в fsType);
+ *         причина — в \a errorString
+ */
+QByteArray subsetFontData(const QByteArray& data, const QSet<char32_t>& codepoints, const QString& newFamily,
+                          QString* errorString = nullptr);
+
+/// Урезать файл шрифта с кэшем по (хэш файла, хэш набора символов и имени).
+/// Попадание в кэш обновляет mtime файла подмножества — по нему pruneCache() судит, нужен ли он ещё.
+FontSubsetResult subsetFont(const QString& fontPath, const QSet<char32_t>& codepoints, const QString& newFamily,
+                            const QString& cacheDir = defaultCacheDir());
+
+/**
+ * @brief Решить, какие шрифты вложить подмножеством.
+ *
+ * Шрифты группируются по имени из ASS. Группа урезается целиком или не урезается вовсе: если хотя бы
+ * одно её начертание найдено не через индекс, файл нужен другому имени или не урезался, вся группа
+ * вкладывается как есть, а её имя в субтитрах не меняется.
+ * @param usage символы по стилям из всех субтитров, которые пойдут в MKV
+ */
+SubsetPlan planSubsets(const FontFinderResult& fonts, const GlyphUsage& usage,
+                       const QString& cacheDir = defaultCacheDir());
+
+/**
+ * @brief Удалить из кэша подмножества, которые не создавались и не использовались \a maxUnusedDays дней.
+ *
+ * Каждый набор символов даёт свой файл, и без очистки кэш растёт с каждой серией.
+ * @return число удалённых файлов
+ */
+int pruneCache(const QString& cacheDir = defaultCacheDir(), int maxUnusedDays = kCacheMaxUnusedDays);
+
+/// Переписать Fontname в стилях и \\fn в событиях по \a renames (ключ — FontIndex::lookupKey()).
+bool renameFontsInAss(const QString& sourcePath, const QString& destPath, const QHash<QString, QString>& renames);
+} // namespace FontSubsetter
+
+#endif // FONTSUBSETTER_H
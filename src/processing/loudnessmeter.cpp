@@ -0,0 +1,404 @@
+#include "loudnessmeter.h"
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QList>
+#include <QtConcurrent/QtConcurrentMap>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+constexpr double kPi = 3.14159265358979323846;
+constexpr double kAbsoluteGateLufs = -70.0;
+constexpr double kIntegratedRelativeGateLu = -10.0;
+constexpr double kRangeRelativeGateLu = -20.0;
+constexpr int kBlocksPerMomentary = 4;  // 400 мс
+constexpr int kBlocksPerShortTerm = 30; // 3 с
+constexpr int kWarmupBlocks = 2;
+constexpr qint64 kChunkBlocks = 300; // 30 с на задачу пула
+constexpr int kTapsPerPhase = 12;
+
+struct Biquad
+{
+    double b0 = 1.0;
+    double b1 = 0.0;
+    double b2 = 0.0;
+    double a1 = 0.0;
+    double a2 = 0.0;
+};
+
+struct BiquadState
+{
+    double z1 = 0.0;
+    double z2 = 0.0;
+};
+
+inline double runBiquad(const Biquad& filter, BiquadState& state, double x)
+{
+    const double y = filter.b0 * x + state.z1;
+    state.z1 = filter.b1 * x - filter.a1 * y + state.z2;
+    state.z2 = filter.b2 * x - filter.a2 * y;
+    return y;
+}
+
+/// Первая ступень K-фильтра BS.1770 (полка +4 дБ), пересчитанная для частоты \a fs.
+Biquad kWeightingShelf(double fs)
+{
+    const double f0 = 1681.974450955533;
+    const double gainDb = 3.999843853973347;
+    const double q = 0.7071752369554196;
+    const double k = std::tan(kPi * f0 / fs);
+    const double vh = std::pow(10.0, gainDb / 20.0);
+    const double vb = std::pow(vh, 0.4996667741545416);
+    const double a0 = 1.0 + k / q + k * k;
+
+    Biquad filter;
+    filter.b0 = (vh + vb * k / q + k * k) / a0;
+    filter.b1 = 2.0 * (k * k - vh) / a0;
+    filter.b2 = (vh - vb * k / q + k * k) / a0;
+    filter.a1 = 2.0 * (k * k - 1.0) / a0;
+    filter.a2 = (1.0 - k / q + k * k) / a0;
+    return filter;
+}
+
+/// Вторая ступень K-фильтра (ФВЧ RLB около 38 Гц).
+Biquad kWeightingHighpass(double fs)
+{
+    const double f0 = 38.13547087602444;
+    const double q = 0.5003270373238773;
+    const double k = std::tan(kPi * f0 / fs);
+    const double a0 = 1.0 + k / q + k * k;
+
+    Biquad filter;
+    filter.b0 = 1.0;
+    filter.b1 = -2.0;
+    filter.b2 = 1.0;
+    filter.a1 = 2.0 * (k * k - 1.0) / a0;
+    filter.a2 = (1.0 - k / q + k * k) / a0;
+    return filter;
+}
+
+/// Фазы интерполирующего ФНЧ (окно Ханна) для передискретизации в \a factor раз.
+/// Коэффициенты каждой фазы записаны в обратном порядке, чтобы свёртка шла по памяти подряд.
+std::vector<std::vector<float>> interpolationPhases(int factor)
+{
+    const int length = factor * kTapsPerPhase;
+    std::vector<std::vector<float>> phases(factor, std::vector<float>(kTapsPerPhase));
+    for (int phase = 0; phase < factor; ++phase)
+    {
+        double sum = 0.0;
+        std::vector<double> taps(kTapsPerPhase);
+        for (int j = 0; j < kTapsPerPhase; ++j)
+        {
+            const int n = j * factor + phase;
+            const double t = (n - (length - 1) / 2.0) / factor;
+            const double sinc = t == 0.0 ? 1.0 : std::sin(kPi * t) / (kPi * t);
+            const double window = 0.5 - 0.5 * std::cos(2.0 * kPi * (n + 1) / (length + 1));
+            taps[j] = sinc * window;
+            sum += taps[j];
+        }
+        // Каждая фаза пропускает постоянную составляющую без изменения
+        for (int j = 0; j < kTapsPerPhase; ++j)
+        {
+            phases[phase][kTapsPerPhase - 1 - j] = static_cast<float>(taps[j] / sum);
+        }
+    }
+    return phases;
+}
+
+/// Веса каналов BS.1770 в порядке WAV (L R C LFE Ls Rs ...): LFE не учитывается, тылы +1,5 дБ.
+std::vector<double> channelWeights(int channels)
+{
+    std::vector<double> weights(channels, 1.0);
+    if (channels == 6 || channels == 8)
+    {
+        weights[3] = 0.0;
+        std::fill(weights.begin() + 4, weights.end(), 1.41);
+    }
+    else if (channels == 5)
+    {
+        weights[3] = 1.41;
+        weights[4] = 1.41;
+    }
+    return weights;
+}
+
+struct MeterSetup
+{
+    WavInfo format;
+    const uchar* data = nullptr;
+    qint64 frames = 0;
+    int blockFrames = 0; // 100 мс
+    Biquad shelf;
+    Biquad highpass;
+    std::vector<double> weights;
+    std::vector<std::vector<float>> phases; // пусто — частота уже не ниже 192 кГц
+    float clipLevel = 1.0f;
+};
+
+struct Chunk
+{
+    qint64 firstBlock = 0;
+    qint64 endFrame = 0;
+};
+
+struct ChunkStats
+{
+    std::vector<double> blockEnergy; // взвешенная сумма квадратов K-фильтрованных отсчётов за 100 мс
+    float samplePeak = 0.0f;
+    float truePeak = 0.0f;
+    qint64 clipped = 0;
+};
+
+ChunkStats measureChunk(const MeterSetup& setup, const Chunk& chunk)
+{
+    ChunkStats stats;
+    const int channels = setup.format.channels;
+    const int history = kTapsPerPhase - 1;
+    const qint64 firstFrame = chunk.firstBlock * setup.blockFrames;
+    // Прогрев на предыдущих отсчётах: состояние фильтров на границе куска как при сплошном проходе
+    const qint64 startFrame = qMax<qint64>(0, firstFrame - kWarmupBlocks * setup.blockFrames);
+
+    std::vector<BiquadState> shelfState(channels);
+    std::vector<BiquadState> highpassState(channels);
+    // В начале каждого канала — последние отсчёты прошлого блока для интерполятора true peak
+    std::vector<std::vector<float>> planar(channels, std::vector<float>(history + setup.blockFrames, 0.0f));
+    stats.blockEnergy.reserve(kChunkBlocks);
+
+    for (qint64 frame = startFrame; frame < chunk.endFrame; frame += setup.blockFrames)
+    {
+        const int count = static_cast<int>(qMin<qint64>(setup.blockFrames, chunk.endFrame - frame));
+        const bool measured = frame >= firstFrame;
+        const uchar* frames = setup.data + frame * setup.format.blockAlign;
+        for (int ch = 0; ch < channels; ++ch)
+        {
+            WavFile::decodeChannel(frames, count, setup.format, ch, planar[ch].data() + history);
+        }
+
+        double blockEnergy = 0.0;
+        for (int ch = 0; ch < channels; ++ch)
+        {
+            float* samples = planar[ch].data();
+            const float* current = samples + history;
+            double sum = 0.0;
+            for (int i = 0; i < count; ++i)
+            {
+                const double y = runBiquad(setup.highpass, highpassState[ch],
+                                           runBiquad(setup.shelf, shelfState[ch], current[i]));
+                sum += y * y;
+            }
+            blockEnergy += setup.weights[ch] * sum;
+
+            if (measured)
+            {
+                for (int i = 0; i < count; ++i)
+                {
+                    const float level = std::fabs(current[i]);
+                    stats.samplePeak = std::max(stats.samplePeak, level);
+                    stats.clipped += level >= setup.clipLevel ? 1 : 0;
+                }
+                for (const std::vector<float>& phase : setup.phases)
+                {
+                    const float* taps = phase.data();
+                    for (int i = 0; i < count; ++i)
+                    {
+                        float acc = 0.0f;
+                        for (int t = 0; t < kTapsPerPhase; ++t)
+                        {
+                            acc += taps[t] * samples[i + t];
+                        }
+                        stats.truePeak = std::max(stats.truePeak, std::fabs(acc));
+                    }
+                }
+            }
+            std::memmove(samples, samples + count, history * sizeof(float));
+        }
+        // Неполный последний блок в стробирование не входит
+        if (measured && count == setup.blockFrames)
+        {
+            stats.blockEnergy.push_back(blockEnergy);
+        }
+    }
+    return stats;
+}
+
+double energyToLufs(double energy)
+{
+    return energy > 0.0 ? -0.691 + 10.0 * std::log10(energy) : -std::numeric_limits<double>::infinity();
+}
+
+double lufsToEnergy(double lufs)
+{
+    return std::pow(10.0, (lufs + 0.691) / 10.0);
+}
+
+/// Средние квадраты окон из \a window блоков с шагом в один блок.
+std::vector<double> windowEnergies(const std::vector<double>& blocks, int window, int blockFrames)
+{
+    std::vector<double> energies;
+    for (size_t end = window; end <= blocks.size(); ++end)
+    {
+        double sum = 0.0;
+        for (size_t i = end - window; i < end; ++i)
+        {
+            sum += blocks[i];
+        }
+        energies.push_back(sum / (double(window) * blockFrames));
+    }
+    return energies;
+}
+
+/// Среднее по окнам, прошедшим абсолютный порог -70 LUFS и относительный \a relativeGateLu.
+std::vector<double> gate(const std::vector<double>& energies, double relativeGateLu)
+{
+    const double absoluteGate = lufsToEnergy(kAbsoluteGateLufs);
+    double sum = 0.0;
+    int count = 0;
+    for (double energy : energies)
+    {
+        if (energy > absoluteGate)
+        {
+            sum += energy;
+            ++count;
+        }
+    }
+    std::vector<double> passed;
+    if (count == 0)
+    {
+        return passed;
+    }
+    const double relativeGate = sum / count * std::pow(10.0, relativeGateLu / 10.0);
+    for (double energy : energies)
+    {
+        if (energy > absoluteGate && energy > relativeGate)
+        {
+            passed.push_back(energy);
+        }
+    }
+    return passed;
+}
+
+double toDb(float level)
+{
+    return level > 0.0f ? 20.0 * std::log10(double(level)) : -std::numeric_limits<double>::infinity();
+}
+} // namespace
+
+namespace LoudnessMeter
+{
+LoudnessResult analyzeFile(const QString& wavPath)
+{
+    const WavInfo format = WavFile::readHeader(wavPath);
+    if (!format.ok)
+    {
+        LoudnessResult result;
+        result.errorString = format.errorString;
+        return result;
+    }
+    QFile file(wavPath);
+    uchar* mapped = file.open(QIODevice::ReadOnly) && format.dataSize > 0
+                        ? file.map(format.dataOffset, format.dataSize)
+                        : nullptr;
+    if (mapped == nullptr)
+    {
+        LoudnessResult result;
+        result.errorString = format.dataSize > 0 ? file.errorString() : QStringLiteral("нет аудиоданных");
+        return result;
+    }
+    LoudnessResult result = analyzePcm(mapped, format.dataSize, format);
+    file.unmap(mapped);
+    return result;
+}
+
+LoudnessResult analyzePcm(const uchar* data, qint64 size, const WavInfo& format)
+{
+    QElapsedTimer timer;
+    timer.start();
+    LoudnessResult result;
+
+    MeterSetup setup;
+    setup.format = format;
+    setup.data = data;
+    setup.frames = format.blockAlign > 0 ? size / format.blockAlign : 0;
+    setup.blockFrames = qMax(1, format.sampleRate / 10);
+    setup.shelf = kWeightingShelf(format.sampleRate);
+    setup.highpass = kWeightingHighpass(format.sampleRate);
+    setup.weights = channelWeights(format.channels);
+    const int oversampling = format.sampleRate < 96000 ? 4 : format.sampleRate < 192000 ? 2 : 1;
+    if (oversampling > 1)
+    {
+        setup.phases = interpolationPhases(oversampling);
+    }
+    // Полная шкала целого PCM — на один шаг квантования ниже 1.0
+    setup.clipLevel =
+        format.isFloat ? 1.0f : static_cast<float>(1.0 - std::ldexp(1.0, -(8 * format.containerBytes() - 1)));
+    result.durationS = format.sampleRate > 0 ? double(setup.frames) / format.sampleRate : 0.0;
+
+    QList<Chunk> chunks;
+    for (qint64 block = 0; block * setup.blockFrames < setup.frames; block += kChunkBlocks)
+    {
+        chunks.append({block, qMin(setup.frames, (block + kChunkBlocks) * setup.blockFrames)});
+    }
+    const QList<ChunkStats> perChunk =
+        QtConcurrent::blockingMapped(chunks, [&setup](const Chunk& chunk) { return measureChunk(setup, chunk); });
+
+    std::vector<double> blocks;
+    float samplePeak = 0.0f;
+    float truePeak = 0.0f;
+    for (const ChunkStats& stats : perChunk)
+    {
+        blocks.insert(blocks.end(), stats.blockEnergy.cbegin(), stats.blockEnergy.cend());
+        samplePeak = std::max(samplePeak, stats.samplePeak);
+        truePeak = std::max(truePeak, stats.truePeak);
+        result.clippedSamples += stats.clipped;
+    }
+
+    const std::vector<double> momentary = gate(
+        windowEnergies(blocks, kBlocksPerMomentary, setup.blockFrames), kIntegratedRelativeGateLu);
+    if (!momentary.empty())
+    {
+        double sum = 0.0;
+        for (double energy : momentary)
+        {
+            sum += energy;
+        }
+        result.integratedLufs = energyToLufs(sum / momentary.size());
+    }
+
+    const std::vector<double> shortTerm =
+        gate(windowEnergies(blocks, kBlocksPerShortTerm, setup.blockFrames), kRangeRelativeGateLu);
+    if (!shortTerm.empty())
+    {
+        std::vector<double> sorted = shortTerm;
+        std::sort(sorted.begin(), sorted.end());
+        const auto percentile = [&sorted](double p)
+        { return energyToLufs(sorted[static_cast<size_t>(std::lround((sorted.size() - 1) * p))]); };
+        result.loudnessRangeLu = percentile(0.95) - percentile(0.10);
+    }
+
+    result.samplePeakDbfs = toDb(samplePeak);
+    // Интерполятор может слегка занизить пик рядом с отсчётом; true peak не бывает ниже пика отсчётов
+    result.truePeakDbtp = toDb(std::max(truePeak, samplePeak));
+    result.elapsedMs = timer.elapsed();
+    result.ok = true;
+    return result;
+}
+
+double recommendedGainDb(const LoudnessResult& result, double targetLufs, double maxTruePeakDbtp)
+{
+    if (!result.ok || !std::isfinite(result.integratedLufs))
+    {
+        return 0.0;
+    }
+    double gain = targetLufs - result.integratedLufs;
+    if (std::isfinite(result.truePeakDbtp))
+    {
+        gain = std::min(gain, maxTruePeakDbtp - result.truePeakDbtp);
+    }
+    return gain;
+}
+} // namespace LoudnessMeter
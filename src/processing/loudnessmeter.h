@@ -0,0 +1,53 @@
+#ifndef LOUDNESSMETER_H
+#define LOUDNESSMETER_H
+
+#include "wavfile.h"
+
+#include <QString>
+
+#include <limits>
+
+/// Результат измерения по ITU-R BS.1770-4 / EBU R128.
+struct LoudnessResult
+{
+    bool ok = false;
+    QString errorString;
+
+    double integratedLufs = -std::numeric_limits<double>::infinity(); // -inf — тишина или короче 400 мс
+    double loudnessRangeLu = 0.0;
+    double truePeakDbtp = -std::numeric_limits<double>::infinity();
+    double samplePeakDbfs = -std::numeric_limits<double>::infinity();
+    qint64 clippedSamples = 0; // отсчёты на полной шкале и выше
+    double durationS = 0.0;
+    qint64 elapsedMs = 0;
+};
+
+/**
+ * @brief Измеритель громкости WAV без внешних программ.
+ *
+ * PCM читается из отображённого в память чанка data. Файл делится на куски по 30 с, которые считаются
+ * в пуле потоков: перед каждым куском фильтры прогреваются на 200 мс предыдущих отсчётов, так что
+ * K-фильтр и интерполятор true peak входят в кусок с тем же состоянием, что и при последовательном проходе.
+ * Из кусков собираются энергии блоков по 100 мс, по ним считаются интегральная громкость (окна 400 мс)
+ * и LRA (окна 3 с, EBU Tech 3342). True peak — по 4-кратной передискретизации (2-кратной от 96 кГц).
+ */
+namespace LoudnessMeter
+{
+/// Целевая громкость и потолок true peak EBU R128.
+constexpr double kTargetLufs = -23.0;
+constexpr double kMaxTruePeakDbtp = -1.0;
+
+LoudnessResult analyzeFile(const QString& wavPath);
+
+/// Измерить PCM в памяти; \a data — начало чанка data в формате \a format.
+LoudnessResult analyzePcm(const uchar* data, qint64 size, const WavInfo& format);
+
+/**
+ * @brief Усиление, которое приводит запись к \a targetLufs, не поднимая true peak выше \a maxTruePeakDbtp.
+ * @return 0, если громкость не измерена (тишина или ошибка)
+ */
+double recommendedGainDb(const LoudnessResult& result, double targetLufs = kTargetLufs,
+                         double maxTruePeakDbtp = kMaxTruePeakDbtp);
+} // namespace LoudnessMeter
+
+#endif // LOUDNESSMETER_H
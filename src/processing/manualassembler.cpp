@@ -3,14 +3,18 @@
 #include "appsettings.h"
 #include "assprocessor.h"
 #include "chapterhelper.h"
+#include "filestager.h"
 #include "processmanager.h"
 #include "releasetemplate.h"
+#include "wavfile.h"
 
 #include <QByteArray>
 #include <QDir>
 #include <QFile>
 #include <QFileInfo>
+#include <QJsonArray>
 #include <QJsonDocument>
+#include <QJsonObject>
 #include <QTimer>
 
 ManualAssembler::ManualAssembler(const QVariantMap& params, QObject* parent)
@@ -32,6 +36,16 @@ void ManualAssembler::start()
     emit logMessage("--- Начало ручной сборки ---", LogCategory::APP);
     m_currentStep = Step::Idle;
 
+    // Оборванную загрузку WAV видно по заголовку сразу, а не после нормализации и конвертации
+    const QString audioError = WavFile::integrityError(WavFile::readHeader(m_params["russianAudioPath"].toString()));
+    if (!audioError.isEmpty())
+    {
+        emit logMessage(QString("Ошибка: аудиофайл повреждён (%1). Сборка отменена.").arg(audioError), LogCategory::APP,
+                        LogLevel::Error);
+        emit finished(false);
+        return;
+    }
+
     if (m_params["normalizeAudio"].toBool())
     {
         normalizeAudio();
@@ -55,9 +69,9 @@ void ManualAssembler::normalizeAudio()
     QString nugenPath = AppSettings::instance().nugenAmbPath();
     QString originalAudioPath = m_params["russianAudioPath"].toString();
 
-    if (nugenPath.isEmpty() || !originalAudioPath.endsWith(".wav", Qt::CaseInsensitive))
+    if (nugenPath.isEmpty() || !WavFile::isWav(originalAudioPath))
     {
-        emit logMessage("Нормализация пропущена (не указан путь к NUGEN или файл не .wav).", LogCategory::APP);
+        emit logMessage("Нормализация пропущена (не указан путь к NUGEN или файл не WAV).", LogCategory::APP);
         if (m_params["convertAudio"].toBool())
         {
             convertAudio();
@@ -78,7 +92,9 @@ void ManualAssembler::normalizeAudio()
         QFile::remove(tempInputPath);
     }
 
-    if (!QFile::copy(originalAudioPath, tempInputPath))
+    // AMBCmd пишет результат в отдельный *_corrected.wav, вход только читается — жёсткая ссылка допустима.
+    const StageResult staged = FileStager::stageFile(originalAudioPath, tempInputPath, StageMode::ReadOnlyCopy);
+    if (!staged.ok)
     {
         emit logMessage("ОШИБКА: Не удалось переименовать аудиофайл. Нормализация отменена.", LogCategory::APP,
                         LogLevel::Error);
@@ -93,7 +109,9 @@ void ManualAssembler::normalizeAudio()
         return;
     }
 
-    emit logMessage("Аудиофайл переименован в temp_audio_for_nugen.wav  для безопасной обработки.", LogCategory::APP);
+    emit logMessage(QString("Аудиофайл подготовлен как temp_audio_for_nugen.wav для безопасной обработки (%1).")
+                        .arg(FileStager::describe(staged)),
+                    LogCategory::APP);
 
     QFileInfo nugenInfo(nugenPath);
     QString ambCmdPath = nugenInfo.dir().filePath("AMBCmd.exe");
@@ -147,16 +165,21 @@ void ManualAssembler::convertAudio()
     }
 
     emit logMessage("Определение длительности аудиофайла...", LogCategory::APP);
+    // Длительность WAV берётся из заголовка, ffprobe нужен только для сжатых форматов
+    const WavInfo wav = WavFile::readHeader(audioPath);
+    m_sourceAudioDurationUs = wav.ok ? wav.durationUs() : 0;
     QByteArray jsonData;
-    QString ffprobePath = AppSettings::instance().ffprobePath();
-    QStringList ffprobeArgs = {"-v", "error", "-show_format", "-print_format", "json", audioPath};
-
-    m_sourceAudioDurationS = 0.0;
-    if (m_processManager->executeAndWait(ffprobePath, ffprobeArgs, jsonData) && !jsonData.isEmpty())
+    if (!wav.ok && m_processManager->executeAndWait(AppSettings::instance().ffprobePath(),
+                                                    {"-v", "error", "-show_format", "-print_format", "json", audioPath},
+                                                    jsonData) &&
+        !jsonData.isEmpty())
     {
         QJsonObject format = QJsonDocument::fromJson(jsonData).object()["format"].toObject();
-        m_sourceAudioDurationS = format["duration"].toString().toDouble();
-        emit logMessage(QString("Длительность: %1 секунд.").arg(m_sourceAudioDurationS), LogCategory::APP);
+        m_sourceAudioDurationUs = static_cast<qint64>(format["duration"].toString().toDouble() * 1000000);
+    }
+    if (m_sourceAudioDurationUs > 0)
+    {
+        emit logMessage(QString("Длительность: %1 секунд.").arg(m_sourceAudioDurationUs / 1000000.0), LogCategory::APP);
     }
     else
     {
@@ -193,7 +216,7 @@ void ManualAssembler::convertAudio()
     }
     args << "-progress" << QDir::toNativeSeparators(m_progressLogPath) << newAudioPath;
 
-    if (m_sourceAudioDurationS > 0)
+    if (m_sourceAudioDurationUs > 0)
     {
         connect(m_progressTimer, &QTimer::timeout, this, &ManualAssembler::onConversionProgress);
         m_progressTimer->start(500);
@@ -338,6 +361,50 @@ QString ManualAssembler::resolveChaptersPathForMkvMerge()
     return {};
 }
 
+QString ManualAssembler::selectSourceTrack(QStringList& args, const QString& path, const QString& trackType)
+{
+    // Обычный файл (h264, aac, wav...) содержит одну дорожку с ID 0.
+    const QString ext = QFileInfo(path).suffix().toLower();
+    const bool isContainer = ext == QStringLiteral("mkv") || ext == QStringLiteral("mka") ||
+                             ext == QStringLiteral("mp4") || ext == QStringLiteral("m4a");
+    if (!isContainer || !AppSettings::instance().directSourceTracks())
+    {
+        return QStringLiteral("0");
+    }
+
+    QByteArray jsonData;
+    if (!m_processManager->executeAndWait(AppSettings::instance().mkvmergePath(), {"-J", path}, jsonData))
+    {
+        return QStringLiteral("0");
+    }
+
+    const QJsonArray tracks = QJsonDocument::fromJson(jsonData).object()["tracks"].toArray();
+    for (const QJsonValue& val : tracks)
+    {
+        const QJsonObject track = val.toObject();
+        if (track["type"].toString() != trackType)
+        {
+            continue;
+        }
+        // Берём из контейнера только нужную дорожку по ID, без промежуточного извлечения
+        const QString id = QString::number(track["id"].toInt());
+        if (trackType == QStringLiteral("video"))
+        {
+            args << "--video-tracks" << id << "--no-audio";
+        }
+        else
+        {
+            args << "--audio-tracks" << id << "--no-video";
+        }
+        args << "--no-subtitles" << "--no-attachments" << "--no-global-tags";
+        emit logMessage(QString("mkvmerge: дорожка %1 берётся напрямую из %2 (ID %3).")
+                            .arg(trackType, QFileInfo(path).fileName(), id),
+                        LogCategory::APP);
+        return id;
+    }
+    return QStringLiteral("0");
+}
+
 void ManualAssembler::assemble()
 {
     m_currentStep = Step::AssemblingMkv;
@@ -438,13 +505,14 @@ void ManualAssembler::assemble()
         if (m_params.contains("videoPath"))
         {
             const QString videoPath = m_params["videoPath"].toString();
+            const QString tid = selectSourceTrack(args, videoPath, QStringLiteral("video"));
             if (!lang.isEmpty())
             {
-                args << "--language" << "0:" + lang;
+                args << "--language" << tid + ":" + lang;
             }
             if (!studio.isEmpty())
             {
-                args << "--track-name" << QString("0:Видеоряд [%1]").arg(studio);
+                args << "--track-name" << QString("%1:Видеоряд [%2]").arg(tid, studio);
             }
             addNoChaptersForContainer(videoPath);
             args << videoPath;
@@ -460,14 +528,15 @@ void ManualAssembler::assemble()
         if (m_params.contains("originalAudioPath"))
         {
             const QString originalAudioPath = m_params["originalAudioPath"].toString();
-            args << "--default-track-flag" << "0:no";
+            const QString tid = selectSourceTrack(args, originalAudioPath, QStringLiteral("audio"));
+            args << "--default-track-flag" << tid + ":no";
             if (!lang.isEmpty())
             {
-                args << "--language" << "0:" + lang;
+                args << "--language" << tid + ":" + lang;
             }
             if (!studio.isEmpty())
             {
-                args << "--track-name" << QString("0:Оригинал [%1]").arg(studio);
+                args << "--track-name" << QString("%1:Оригинал [%2]").arg(tid, studio);
             }
             addNoChaptersForContainer(originalAudioPath);
             args << originalAudioPath;
@@ -495,8 +564,9 @@ void ManualAssembler::assemble()
         if (m_params.contains("videoPath"))
         {
             const QString videoPath = m_params["videoPath"].toString();
-            args << "--language" << "0:" + t.originalLanguage << "--track-name"
-                 << QString("0:Видеоряд [%1]").arg(t.animationStudio);
+            const QString tid = selectSourceTrack(args, videoPath, QStringLiteral("video"));
+            args << "--language" << tid + ":" + t.originalLanguage << "--track-name"
+                 << QString("%1:Видеоряд [%2]").arg(tid, t.animationStudio);
             addNoChaptersForContainer(videoPath);
             args << videoPath;
         }
@@ -511,8 +581,9 @@ void ManualAssembler::assemble()
         if (m_params.contains("originalAudioPath"))
         {
             const QString originalAudioPath = m_params["originalAudioPath"].toString();
-            args << "--default-track-flag" << "0:no" << "--language" << "0:" + t.originalLanguage << "--track-name"
-                 << QString("0:Оригинал [%1]").arg(t.animationStudio);
+            const QString tid = selectSourceTrack(args, originalAudioPath, QStringLiteral("audio"));
+            args << "--default-track-flag" << tid + ":no" << "--language" << tid + ":" + t.originalLanguage
+                 << "--track-name" << QString("%1:Оригинал [%2]").arg(tid, t.animationStudio);
             addNoChaptersForContainer(originalAudioPath);
             args << originalAudioPath;
         }
@@ -651,7 +722,7 @@ void ManualAssembler::onConversionProgress()
     qint64 totalDurationUs = 0;
     qint64 currentTimeUs = 0;
 
-    totalDurationUs = static_cast<qint64>(m_sourceAudioDurationS * 1000000);
+    totalDurationUs = m_sourceAudioDurationUs;
 
     while (!in.atEnd())
     {
@@ -41,6 +41,7 @@ private:
     void convertAudio();
     void processSubtitlesAndAssemble();
     QString resolveChaptersPathForMkvMerge();
+    QString selectSourceTrack(QStringList& args, const QString& path, const QString& trackType);
     void assemble();
 
     QVariantMap m_params;
@@ -58,7 +59,7 @@ private:
 
     QString m_ffmpegPath;
     QString m_finalMkvPath;
-    double m_sourceAudioDurationS = 0.0;
+    qint64 m_sourceAudioDurationUs = 0;
     QTimer* m_progressTimer;
     QString m_progressLogPath;
     QString m_originalAudioPathBeforeNormalization;
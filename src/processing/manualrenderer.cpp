@@ -2,6 +2,7 @@
 
 #include "appsettings.h"
 #include "assprocessor.h"
+#include "bitratecalibrator.h"
 #include "chapterhelper.h"
 #include "processmanager.h"
 
@@ -224,7 +225,8 @@ void ManualRenderer::start()
             {
                 continue;
             }
-            QString codec = track["codec"].toString().toLower();
+            m_sourceVideoCodec = track["codec"].toString();
+            QString codec = m_sourceVideoCodec.toLower();
             if (codec.contains("hevc") || codec.contains("h265"))
             {
                 videoCodecExtension = "h265";
@@ -272,6 +274,31 @@ void ManualRenderer::start()
                         LogCategory::APP, LogLevel::Warning);
     }
 
+    // Внешние .ass проверяем заранее: если видимых событий нет, фильтр subtitles не подключаем вовсе
+    const QString externalSubsPath = m_params.value("externalSubsPath").toString();
+    if (m_params.value("useHardsub").toBool() && m_params.value("hardsubMode").toString() == "external" &&
+        externalSubsPath.endsWith(".ass", Qt::CaseInsensitive))
+    {
+        const QList<TbSegment> intervals = AssProcessor::detectActiveIntervalsFromFile(externalSubsPath);
+        if (intervals.isEmpty())
+        {
+            emit logMessage("В файле надписей нет видимых событий — рендер без фильтра subtitles.", LogCategory::APP);
+            m_params["useHardsub"] = false;
+        }
+        else
+        {
+            double coveredS = 0.0;
+            for (const TbSegment& interval : intervals)
+            {
+                coveredS += interval.endSeconds - interval.startSeconds;
+            }
+            emit logMessage(QString("Надписи на экране: %1 интервалов, %2 с.")
+                                .arg(intervals.size())
+                                .arg(coveredS, 0, 'f', 1),
+                            LogCategory::APP);
+        }
+    }
+
     const bool useConcatTb = m_params.value("useConcatTb").toBool();
     const bool useHardsub = m_params.value("useHardsub").toBool();
     if (useConcatTb && useHardsub)
@@ -364,10 +391,62 @@ void ManualRenderer::start()
         emit logMessage("Concat рендер: границы ТБ не найдены, используется обычный полный рендер.", LogCategory::APP);
     }
 
+    if (!useHardsub && RenderHelper::isMp4CompatibleVideoCodec(m_sourceVideoCodec))
+    {
+        if (m_preset.targetBitrateKbps > 0 && detectedVideoBitrateKbps > m_preset.targetBitrateKbps * 1.15)
+        {
+            emit logMessage(QString("Hardsub не нужен, но битрейт исходника (%1 kbps) выше целевого (%2 kbps) — "
+                                    "видео будет перекодировано.")
+                                .arg(detectedVideoBitrateKbps)
+                                .arg(m_preset.targetBitrateKbps),
+                            LogCategory::APP);
+        }
+        else
+        {
+            emit logMessage("Hardsub не нужен, кодек совместим с MP4 — видео копируется без перекодирования.",
+                            LogCategory::APP);
+            m_currentState = RenderState::VideoCopy;
+            runStep();
+            return;
+        }
+    }
+
+    if (startBitrateCalibration())
+    {
+        return;
+    }
+
     m_currentState = RenderState::VideoPass1;
     runStep();
 }
 
+bool ManualRenderer::startBitrateCalibration()
+{
+    const double durationS = static_cast<double>(m_sourceDurationS);
+    if (!AppSettings::instance().bitrateCalibration() || !BitrateCalibrator::isApplicable(m_preset, durationS) ||
+        !parsePreset(m_preset.commandPass1, m_currentVideoArgs, m_currentAudioArgs))
+    {
+        return false;
+    }
+
+    emit progressUpdated(-1, "Калибровка битрейта");
+    m_bitrateCalibrator = new BitrateCalibrator(m_preset, m_currentVideoArgs, pass1StatsDir(), durationS, this);
+    connect(m_bitrateCalibrator, &BitrateCalibrator::logMessage, this, &ManualRenderer::logMessage);
+    connect(m_bitrateCalibrator, &BitrateCalibrator::finished, this,
+            [this](const RenderPreset& preset, bool adjusted)
+            {
+                m_bitrateCalibrator = nullptr;
+                if (adjusted)
+                {
+                    m_preset = preset;
+                }
+                m_currentState = RenderState::VideoPass1;
+                runStep();
+            });
+    m_bitrateCalibrator->start();
+    return true;
+}
+
 void ManualRenderer::runStep()
 {
     QString program = AppSettings::instance().ffmpegPath();
@@ -389,10 +468,49 @@ void ManualRenderer::runStep()
             return;
         }
 
+        if (m_preset.isTwoPass())
+        {
+            const QString statsName = pass1StatsFileName(m_preset);
+            if (RenderHelper::applyPassStatsFile(m_currentVideoArgs, statsName))
+            {
+                m_processManager->setWorkingDirectory(pass1StatsDir());
+                if (m_currentState == RenderState::VideoPass1)
+                {
+                    RenderHelper::removePass1Stats(pass1StatsDir(), statsName);
+                }
+            }
+        }
+
+        if (m_currentState == RenderState::VideoPass1)
+        {
+            m_renderTimer.start();
+        }
         args = m_currentVideoArgs;
         stepName = (m_currentState == RenderState::VideoPass1) ? "Видео: Проход 1" : "Видео: Проход 2";
         break;
     }
+    case RenderState::VideoCopy:
+    {
+        // Аудиопроход готовим из пресета как обычно
+        const QString finalPassTemplate = m_preset.isTwoPass() ? m_preset.commandPass2 : m_preset.commandPass1;
+        if (!parsePreset(finalPassTemplate, m_currentVideoArgs, m_currentAudioArgs))
+        {
+            emit logMessage("Ошибка: не удалось распарсить пресет.", LogCategory::APP, LogLevel::Error);
+            emit finished();
+            return;
+        }
+
+        args << "-y" << "-hide_banner" << "-i" << m_actualInputMkv << "-map" << "0:v:0" << "-c:v" << "copy" << "-an"
+             << "-sn" << "-dn" << "-map_chapters" << "-1";
+        if (m_sourceVideoCodec.contains("hevc", Qt::CaseInsensitive))
+        {
+            args << "-tag:v" << "hvc1";
+        }
+        args << m_tempVideoMp4;
+        stepName = "Видео: копирование потока";
+        m_renderTimer.start();
+        break;
+    }
     case RenderState::AudioPass:
     {
         args = m_currentAudioArgs;
@@ -567,6 +685,14 @@ QList<ChapterMarker> ManualRenderer::prepareChapters()
 void ManualRenderer::cancelOperation()
 {
     emit logMessage("Получена команда на отмену ручного рендера...", LogCategory::APP);
+    if (m_bitrateCalibrator != nullptr)
+    {
+        m_bitrateCalibrator->cancel();
+        m_bitrateCalibrator = nullptr;
+        emit logMessage("Ручной рендер отменен пользователем.", LogCategory::APP);
+        emit finished();
+        return;
+    }
     if (m_processManager != nullptr)
     {
         m_processManager->killProcess();
@@ -602,6 +728,8 @@ void ManualRenderer::onProcessFinished(int exitCode, QProcess::ExitStatus exitSt
         }
         else
         {
+            RenderHelper::recordRenderSpeed(m_preset.name, static_cast<double>(m_sourceDurationS),
+                                            m_renderTimer.elapsed());
             auto* helper = new RenderHelper(m_preset, m_tempVideoMp4, m_processManager, this);
             connect(helper, &RenderHelper::finished, this, &ManualRenderer::onBitrateCheckFinished);
             helper->startCheck();
@@ -610,12 +738,25 @@ void ManualRenderer::onProcessFinished(int exitCode, QProcess::ExitStatus exitSt
 
     case RenderState::VideoPass2:
     {
+        if (m_renderTimer.isValid())
+        {
+            RenderHelper::recordRenderSpeed(m_preset.name, static_cast<double>(m_sourceDurationS),
+                                            m_renderTimer.elapsed());
+        }
         auto* helper = new RenderHelper(m_preset, m_tempVideoMp4, m_processManager, this);
         connect(helper, &RenderHelper::finished, this, &ManualRenderer::onBitrateCheckFinished);
         helper->startCheck();
         break;
     }
 
+    case RenderState::VideoCopy:
+        emit logMessage(RenderHelper::describeFastPathSavings(m_preset.name, static_cast<double>(m_sourceDurationS),
+                                                              m_renderTimer.elapsed()),
+                        LogCategory::APP);
+        m_currentState = RenderState::AudioPass;
+        runStep();
+        break;
+
     case RenderState::AudioPass:
         m_currentState = RenderState::MuxMP4Box;
         runStep();
@@ -664,6 +805,11 @@ void ManualRenderer::onProcessText(const QString& output)
 
 void ManualRenderer::cleanupTempFiles()
 {
+    if (m_preset.isTwoPass() && !m_actualInputMkv.isEmpty())
+    {
+        RenderHelper::removePass1Stats(pass1StatsDir(), pass1StatsFileName(m_preset));
+    }
+
     QString originalMkv = QFileInfo(m_params["inputMkv"].toString()).absoluteFilePath();
     if (!originalMkv.isEmpty() && m_actualInputMkv != originalMkv && QFile::exists(m_actualInputMkv))
     {
@@ -682,6 +828,38 @@ ProcessManager* ManualRenderer::getProcessManager() const
     return m_processManager;
 }
 
+// Файл статистики кладём в рабочую папку процесса: при hardsub она уже выбрана под относительный путь к субтитрам
+QString ManualRenderer::pass1StatsDir() const
+{
+    if (m_params.value("useHardsub").toBool())
+    {
+        const QString anchor = (m_params.value("hardsubMode").toString() == "internal")
+                                   ? m_actualInputMkv
+                                   : m_params.value("externalSubsPath").toString();
+        return QFileInfo(anchor).absolutePath();
+    }
+    return QFileInfo(m_tempVideoMp4).absolutePath();
+}
+
+QString ManualRenderer::pass1StatsFileName(const RenderPreset& preset) const
+{
+    QStringList inputs{m_actualInputMkv};
+    QString filterTag = QStringLiteral("nosub");
+    if (m_params.value("useHardsub").toBool())
+    {
+        if (m_params.value("hardsubMode").toString() == "internal")
+        {
+            filterTag = QString("internal:%1").arg(m_params.value("subtitleTrackIndex").toInt());
+        }
+        else
+        {
+            filterTag = QStringLiteral("external");
+            inputs << m_params.value("externalSubsPath").toString();
+        }
+    }
+    return RenderHelper::pass1StatsFileName(inputs, filterTag, preset.commandPass1);
+}
+
 void ManualRenderer::onBitrateCheckFinished(RerenderDecision decision, const RenderPreset& newPreset)
 {
     if (decision == RerenderDecision::Rerender)
@@ -689,6 +867,13 @@ void ManualRenderer::onBitrateCheckFinished(RerenderDecision decision, const Ren
         emit logMessage("Получено решение о перерендере.", LogCategory::APP);
         m_preset = newPreset;
         m_currentState = RenderState::VideoPass1;
+        if (m_preset.isTwoPass() && RenderHelper::hasPass1Stats(pass1StatsDir(), pass1StatsFileName(m_preset)))
+        {
+            emit logMessage("Статистика первого прохода уже есть, перерендер начинается сразу со второго прохода.",
+                            LogCategory::APP);
+            m_currentState = RenderState::VideoPass2;
+            m_renderTimer.invalidate();
+        }
         runStep();
     }
     else
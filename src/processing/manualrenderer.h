@@ -7,11 +7,13 @@
 #include "renderhelper.h"
 
 #include <QDir>
+#include <QElapsedTimer>
 #include <QObject>
 #include <QProcess>
 #include <QStringList>
 #include <QVariantMap>
 
+class BitrateCalibrator;
 class ProcessManager;
 class ConcatTbRenderer;
 
@@ -20,6 +22,7 @@ enum class RenderState
     Init,
     VideoPass1,
     VideoPass2,
+    VideoCopy, // быстрый путь: рисовать нечего, видео копируется без перекодирования
     AudioPass,
     MuxMP4Box
 };
@@ -62,7 +65,10 @@ private slots:
 
 private:
     void runStep();
+    bool startBitrateCalibration();
     bool parsePreset(const QString& commandTemplate, QStringList& outVideoArgs, QStringList& outAudioArgs);
+    QString pass1StatsDir() const;
+    QString pass1StatsFileName(const RenderPreset& preset) const;
     void applyChaptersIfNeeded();
     void cleanupTempFiles();
     QList<ChapterMarker> prepareChapters();
@@ -70,6 +76,7 @@ private:
     QVariantMap m_params;
     ProcessManager* m_processManager = nullptr;
     ConcatTbRenderer* m_concatRenderer = nullptr;
+    BitrateCalibrator* m_bitrateCalibrator = nullptr;
     RenderPreset m_preset;
 
     RenderState m_currentState = RenderState::Init;
@@ -85,6 +92,8 @@ private:
 
     QStringList m_currentVideoArgs;
     QStringList m_currentAudioArgs;
+    QElapsedTimer m_renderTimer;
+    QString m_sourceVideoCodec;
 };
 
 #endif // MANUALRENDERER_H
@@ -0,0 +1,380 @@
+#include "mkvattachments.h"
+
+#include "fontindex.h"
+
+#include <QFile>
+#include <QHash>
+#include <QJsonObject>
+
+namespace
+{
+constexpr quint32 kIdEbml = 0x1A45DFA3;
+constexpr quint32 kIdSegment = 0x18538067;
+constexpr quint32 kIdSeekHead = 0x114D9B74;
+constexpr quint32 kIdSeek = 0x4DBB;
+constexpr quint32 kIdSeekId = 0x53AB;
+constexpr quint32 kIdSeekPosition = 0x53AC;
+constexpr quint32 kIdCluster = 0x1F43B675;
+constexpr quint32 kIdAttachments = 0x1941A469;
+constexpr quint32 kIdAttachedFile = 0x61A7;
+constexpr quint32 kIdFileName = 0x466E;
+constexpr quint32 kIdFileMimeType = 0x4660;
+constexpr quint32 kIdFileData = 0x465C;
+constexpr quint32 kIdFileUid = 0x46AE;
+
+constexpr qint64 kMaxTextSize = 4096;
+
+struct Element
+{
+    quint32 id = 0;
+    qint64 dataStart = 0;
+    qint64 size = -1; // -1 — размер неизвестен (так пишут сегмент и кластеры при живой записи)
+
+    qint64 end() const
+    {
+        return dataStart + size;
+    }
+};
+
+/// Длина VINT по первому байту: число ведущих нулей плюс один, 0 — недопустимый байт.
+int vintLength(uchar first)
+{
+    for (int i = 0; i < 8; ++i)
+    {
+        if (first & (0x80 >> i))
+        {
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+/// Заголовок элемента по смещению \a pos; элемент с известным размером должен целиком лежать до \a limit.
+bool readElement(QFile& file, qint64 pos, qint64 limit, Element& element)
+{
+    uchar buffer[12];
+    if (pos >= limit || !file.seek(pos))
+    {
+        return false;
+    }
+    const qint64 got = file.read(reinterpret_cast<char*>(buffer), qMin<qint64>(sizeof(buffer), limit - pos));
+    if (got < 2)
+    {
+        return false;
+    }
+    const int idLength = vintLength(buffer[0]);
+    if (idLength == 0 || idLength > 4 || idLength >= got)
+    {
+        return false;
+    }
+    const int sizeLength = vintLength(buffer[idLength]);
+    if (sizeLength == 0 || idLength + sizeLength > got)
+    {
+        return false;
+    }
+
+    // В ID маркер длины остаётся частью значения, в размере — отбрасывается
+    quint32 id = 0;
+    for (int i = 0; i < idLength; ++i)
+    {
+        id = (id << 8) | buffer[i];
+    }
+    const uchar mask = 0xFF >> sizeLength;
+    quint64 size = buffer[idLength] & mask;
+    bool unknownSize = (buffer[idLength] & mask) == mask;
+    for (int i = 1; i < sizeLength; ++i)
+    {
+        size = (size << 8) | buffer[idLength + i];
+        unknownSize = unknownSize && buffer[idLength + i] == 0xFF;
+    }
+
+    element.id = id;
+    element.dataStart = pos + idLength + sizeLength;
+    element.size = unknownSize ? -1 : static_cast<qint64>(size);
+    // Размер за пределами родителя: файл обрезан или это не EBML
+    return unknownSize || (element.dataStart <= limit && size <= quint64(limit - element.dataStart));
+}
+
+QByteArray readPayload(QFile& file, const Element& element, qint64 maxSize)
+{
+    if (element.size < 0 || element.size > maxSize || !file.seek(element.dataStart))
+    {
+        return {};
+    }
+    return file.read(element.size);
+}
+
+quint64 toUInt(const QByteArray& bytes)
+{
+    quint64 value = 0;
+    for (char byte : bytes)
+    {
+        value = (value << 8) | uchar(byte);
+    }
+    return value;
+}
+
+QString toText(QByteArray bytes)
+{
+    // Строки EBML могут быть дополнены нулями до объявленного размера
+    const qsizetype nul = bytes.indexOf('\0');
+    if (nul >= 0)
+    {
+        bytes.truncate(nul);
+    }
+    return QString::fromUtf8(bytes);
+}
+
+/// Позиции элементов верхнего уровня из SeekHead; уже известные не перезаписываются.
+void readSeekHead(QFile& file, const Element& seekHead, qint64 segmentStart, QHash<quint32, qint64>& positions)
+{
+    Element seek;
+    qint64 pos = seekHead.dataStart;
+    while (readElement(file, pos, seekHead.end(), seek) && seek.size >= 0)
+    {
+        pos = seek.end();
+        if (seek.id != kIdSeek)
+        {
+            continue;
+        }
+
+        quint32 id = 0;
+        qint64 position = -1;
+        Element child;
+        qint64 childPos = seek.dataStart;
+        while (readElement(file, childPos, seek.end(), child) && child.size >= 0)
+        {
+            childPos = child.end();
+            if (child.id == kIdSeekId)
+            {
+                id = static_cast<quint32>(toUInt(readPayload(file, child, 4)));
+            }
+            else if (child.id == kIdSeekPosition)
+            {
+                position = static_cast<qint64>(toUInt(readPayload(file, child, 8)));
+            }
+        }
+        if (id != 0 && position >= 0 && !positions.contains(id))
+        {
+            positions.insert(id, segmentStart + position);
+        }
+    }
+}
+
+QList<MkvAttachment> readAttachedFiles(QFile& file, const Element& attachments)
+{
+    QList<MkvAttachment> result;
+    Element attachedFile;
+    qint64 pos = attachments.dataStart;
+    while (readElement(file, pos, attachments.end(), attachedFile) && attachedFile.size >= 0)
+    {
+        pos = attachedFile.end();
+        if (attachedFile.id != kIdAttachedFile)
+        {
+            continue;
+        }
+
+        MkvAttachment attachment;
+        attachment.id = static_cast<int>(result.size()) + 1;
+        Element child;
+        qint64 childPos = attachedFile.dataStart;
+        while (readElement(file, childPos, attachedFile.end(), child) && child.size >= 0)
+        {
+            childPos = child.end();
+            switch (child.id)
+            {
+            case kIdFileName:
+                attachment.fileName = toText(readPayload(file, child, kMaxTextSize));
+                break;
+            case kIdFileMimeType:
+                attachment.mimeType = toText(readPayload(file, child, kMaxTextSize));
+                break;
+            case kIdFileUid:
+                attachment.uid = toUInt(readPayload(file, child, 8));
+                break;
+            case kIdFileData:
+                attachment.dataOffset = child.dataStart;
+                attachment.dataSize = child.size;
+                break;
+            default:
+                break;
+            }
+        }
+        result.append(attachment);
+    }
+    return result;
+}
+} // namespace
+
+namespace MkvAttachments
+{
+QList<MkvAttachment> read(const QString& mkvPath, QString* errorString)
+{
+    const auto fail = [errorString](const QString& reason)
+    {
+        if (errorString != nullptr)
+        {
+            *errorString = reason;
+        }
+        return QList<MkvAttachment>();
+    };
+
+    QFile file(mkvPath);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        return fail(file.errorString());
+    }
+    const qint64 fileSize = file.size();
+    Element header;
+    Element segment;
+    if (!readElement(file, 0, fileSize, header) || header.id != kIdEbml || header.size < 0 ||
+        !readElement(file, header.end(), fileSize, segment) || segment.id != kIdSegment)
+    {
+        return fail(QStringLiteral("нет заголовка EBML или сегмента Matroska"));
+    }
+    const qint64 segmentEnd = segment.size < 0 ? fileSize : segment.end();
+
+    // Обходим верхний уровень только до первого кластера: дальше идут мегабайты видео,
+    // а Attachments, записанный после них, найдётся через SeekHead
+    QHash<quint32, qint64> positions;
+    QList<qint64> visitedSeekHeads;
+    qint64 attachmentsPos = -1;
+    Element element;
+    qint64 pos = segment.dataStart;
+    while (attachmentsPos < 0 && readElement(file, pos, segmentEnd, element) && element.size >= 0 &&
+           element.id != kIdCluster)
+    {
+        if (element.id == kIdAttachments)
+        {
+            attachmentsPos = pos;
+        }
+        else if (element.id == kIdSeekHead)
+        {
+            visitedSeekHeads.append(pos);
+            readSeekHead(file, element, segment.dataStart, positions);
+        }
+        pos = element.end();
+    }
+
+    if (attachmentsPos < 0)
+    {
+        // Второй SeekHead mkvmerge пишет в конец файла, если первый не вместил все ссылки
+        const qint64 extraSeekHead = positions.value(kIdSeekHead, -1);
+        if (!positions.contains(kIdAttachments) && extraSeekHead >= 0 && !visitedSeekHeads.contains(extraSeekHead) &&
+            readElement(file, extraSeekHead, segmentEnd, element) && element.id == kIdSeekHead && element.size >= 0)
+        {
+            readSeekHead(file, element, segment.dataStart, positions);
+        }
+        attachmentsPos = positions.value(kIdAttachments, -1);
+    }
+
+    if (attachmentsPos < 0 || !readElement(file, attachmentsPos, segmentEnd, element) ||
+        element.id != kIdAttachments || element.size < 0)
+    {
+        return fail(QStringLiteral("элемент Attachments не найден"));
+    }
+    return readAttachedFiles(file, element);
+}
+
+QList<MkvAttachment> fontsFromIdentification(const QJsonArray& attachments)
+{
+    QList<MkvAttachment> fonts;
+    for (const QJsonValue& value : attachments)
+    {
+        const QJsonObject attachment = value.toObject();
+        const QString contentType = attachment["content_type"].toString();
+        const QString fileName = attachment["file_name"].toString();
+        // Ищем шрифты по MIME-типу и расширению, чтобы не извлекать картинки и прочее
+        if (!contentType.contains("font", Qt::CaseInsensitive) &&
+            !contentType.contains("octet-stream", Qt::CaseInsensitive))
+        {
+            continue;
+        }
+        if (!fileName.endsWith(".ttf", Qt::CaseInsensitive) && !fileName.endsWith(".otf", Qt::CaseInsensitive) &&
+            !fileName.endsWith(".ttc", Qt::CaseInsensitive))
+        {
+            continue;
+        }
+        MkvAttachment font;
+        font.id = attachment["id"].toInt();
+        font.fileName = fileName;
+        font.mimeType = contentType;
+        font.dataSize = attachment["size"].toInteger();
+        fonts.append(font);
+    }
+    return fonts;
+}
+
+bool locate(QList<MkvAttachment>& fonts, const QList<MkvAttachment>& parsed)
+{
+    for (MkvAttachment& font : fonts)
+    {
+        // Номера у mkvmerge и у read() — порядковые номера AttachedFile в файле
+        if (font.id < 1 || font.id > parsed.size())
+        {
+            return false;
+        }
+        const MkvAttachment& attachment = parsed.at(font.id - 1);
+        if (attachment.dataOffset < 0 || attachment.fileName != font.fileName ||
+            (font.dataSize > 0 && attachment.dataSize != font.dataSize))
+        {
+            return false;
+        }
+        font.uid = attachment.uid;
+        font.dataOffset = attachment.dataOffset;
+        font.dataSize = attachment.dataSize;
+    }
+    return true;
+}
+
+QList<MkvAttachment> selectReferencedFonts(const QString& mkvPath, const QList<MkvAttachment>& fonts,
+                                           const QSet<AssStyleInfo>& styles)
+{
+    QFile file(mkvPath);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        return fonts;
+    }
+
+    // Путь начертания во временном индексе — номер вложения в fonts
+    QList<FontFace> faces;
+    QList<bool> selected(fonts.size(), false);
+    for (int i = 0; i < fonts.size(); ++i)
+    {
+        const MkvAttachment& font = fonts.at(i);
+        QList<FontFace> fontFaces;
+        uchar* mapped = font.dataOffset >= 0 && font.dataSize >= 12 ? file.map(font.dataOffset, font.dataSize)
+                                                                     : nullptr;
+        if (mapped != nullptr)
+        {
+            fontFaces = FontIndex::readFontData(mapped, font.dataSize, QString::number(i));
+            file.unmap(mapped);
+        }
+        if (fontFaces.isEmpty())
+        {
+            selected[i] = true;
+        }
+        faces.append(fontFaces);
+    }
+
+    FontIndex index{QString()};
+    index.setFaces(faces);
+    for (const AssStyleInfo& style : styles)
+    {
+        if (const FontFace* face = index.match(style.fontName, style.bold, style.italic))
+        {
+            selected[face->path.toInt()] = true;
+        }
+    }
+
+    QList<MkvAttachment> result;
+    for (int i = 0; i < fonts.size(); ++i)
+    {
+        if (selected.at(i))
+        {
+            result.append(fonts.at(i));
+        }
+    }
+    return result;
+}
+} // namespace MkvAttachments
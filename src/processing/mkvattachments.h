@@ -0,0 +1,65 @@
+#ifndef MKVATTACHMENTS_H
+#define MKVATTACHMENTS_H
+
+#include "fontfinder.h"
+
+#include <QJsonArray>
+#include <QList>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+
+/// Вложение Matroska: метаданные и положение FileData в файле, без чтения самих данных.
+struct MkvAttachment
+{
+    int id = 0;             // номер вложения, как в mkvmerge -J и mkvextract attachments (с 1)
+    quint64 uid = 0;        // FileUID; известен только после read()
+    QString fileName;
+    QString mimeType;
+    qint64 dataOffset = -1; // начало FileData от начала файла, -1 — неизвестно
+    qint64 dataSize = 0;
+};
+
+/**
+ * @brief Чтение вложений MKV напрямую из контейнера.
+ *
+ * Разбирается только заголовок сегмента: SeekHead (в том числе второй, в конце файла) указывает на
+ * Attachments, так что кластеры с видео не читаются. Шрифты разбираются прямо из отображённых диапазонов
+ * FileData, поэтому решить, какие вложения нужны субтитрам, можно до извлечения.
+ */
+namespace MkvAttachments
+{
+/**
+ * @brief Прочитать элемент Attachments.
+ * @return пустой список, если элемента нет или файл не Matroska; причина — в \a errorString
+ */
+QList<MkvAttachment> read(const QString& mkvPath, QString* errorString = nullptr);
+
+/**
+ * @brief Вложения-шрифты из массива attachments вывода mkvmerge -J.
+ *
+ * FileUID отсюда не берётся: mkvmerge пишет его JSON-числом, а QJsonValue хранит числа больше 2^53
+ * как double с потерей точности. Вложения опознаются по номеру.
+ */
+QList<MkvAttachment> fontsFromIdentification(const QJsonArray& attachments);
+
+/**
+ * @brief Найти \a fonts среди \a parsed (результата read()) по номеру вложения и дописать положение FileData.
+ * @return false, если какого-то вложения нет или имя и размер не совпадают с прочитанными из контейнера
+ */
+bool locate(QList<MkvAttachment>& fonts, const QList<MkvAttachment>& parsed);
+
+/**
+ * @brief Оставить шрифты, которые libass выберет для стилей субтитров.
+ *
+ * Начертания всех \a fonts собираются во временный FontIndex, и для каждого стиля берётся то же
+ * начертание, что выбрал бы libass среди вложений. Вложения, которые не удалось разобрать как sfnt,
+ * остаются в списке: о них ничего не известно, и выбрасывать их небезопасно.
+ * @param fonts вложения с известными dataOffset/dataSize
+ * @return подмножество \a fonts в исходном порядке
+ */
+QList<MkvAttachment> selectReferencedFonts(const QString& mkvPath, const QList<MkvAttachment>& fonts,
+                                           const QSet<AssStyleInfo>& styles);
+} // namespace MkvAttachments
+
+#endif // MKVATTACHMENTS_H
@@ -2,11 +2,70 @@
 
 #include "processmanager.h"
 
+#include <QCryptographicHash>
+#include <QDateTime>
 #include <QDir>
+#include <QFile>
 #include <QFileInfo>
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
+#include <QProcess>
+#include <QRegularExpression>
+#include <QSettings>
+
+namespace
+{
+// Убираем из команды всё, что относится к битрейту и к самим файлам статистики:
+// поправленный в диалоге битрейт не должен менять ключ кэша.
+QString normalizePass1Command(QString command)
+{
+    command.remove(QRegularExpression(R"(-(?:b:v|maxrate|minrate|bufsize)\s+\S+)"));
+    command.remove(QRegularExpression(R"((?:bitrate|vbv-maxrate|vbv-bufsize|stats)=[^:\s"]+:?)"));
+    command.remove(QRegularExpression(R"(-passlogfile\s+\S+)"));
+    return command.simplified();
+}
+
+// codec_name ffprobe для энкодера ffmpeg: hevc_nvenc, libx265 -> hevc; libx264 -> h264; libsvtav1 -> av1
+QString encoderCodecName(const QString& encoder)
+{
+    const QString e = encoder.toLower();
+    if (e.contains("265") || e.contains("hevc"))
+    {
+        return QStringLiteral("hevc");
+    }
+    if (e.contains("264") || e.contains("avc"))
+    {
+        return QStringLiteral("h264");
+    }
+    if (e.contains("av1"))
+    {
+        return QStringLiteral("av1");
+    }
+    return e;
+}
+
+// "Main 10" у ffprobe и "main10" в -profile:v — один профиль
+QString normalizeProfile(const QString& profile)
+{
+    return profile.toLower().remove(' ');
+}
+
+// Бит на компоненту по pix_fmt: yuv420p — 8, yuv420p10le и p010le — 10; у nv12/nv21 цифры не про разрядность
+int pixelFormatBitDepth(const QString& pixFmt)
+{
+    if (pixFmt.isEmpty())
+    {
+        return 0;
+    }
+    if (pixFmt.startsWith("nv"))
+    {
+        return 8;
+    }
+    const QRegularExpressionMatch match = QRegularExpression(R"((\d+)(?:le|be)$)").match(pixFmt);
+    return match.hasMatch() ? match.captured(1).toInt() : 8;
+}
+} // namespace
 
 RenderHelper::RenderHelper(RenderPreset preset, const QString& outputMp4Path, ProcessManager* procManager,
                            QObject* parent)
@@ -109,6 +168,206 @@ void RenderHelper::startCheck()
     }
 }
 
+QString RenderHelper::pass1StatsFileName(const QStringList& inputFiles, const QString& filterTag,
+                                         const QString& pass1Command)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    for (const QString& path : inputFiles)
+    {
+        const QFileInfo info(path);
+        hash.addData(info.absoluteFilePath().toUtf8());
+        hash.addData(QByteArray::number(info.size()));
+        hash.addData(QByteArray::number(info.lastModified().toMSecsSinceEpoch()));
+    }
+    hash.addData(filterTag.toUtf8());
+    hash.addData(normalizePass1Command(pass1Command).toUtf8());
+    return QStringLiteral("pass1_%1.stats").arg(QString::fromLatin1(hash.result().toHex().left(16)));
+}
+
+bool RenderHelper::applyPassStatsFile(QStringList& videoArgs, const QString& statsFileName)
+{
+    for (int i = 0; i + 1 < videoArgs.size(); ++i)
+    {
+        if (videoArgs.at(i) != QLatin1String("-x265-params") || !videoArgs.at(i + 1).contains("pass="))
+        {
+            continue;
+        }
+        // Абсолютный путь с "C:" сломал бы разбор x265-params по ':', поэтому только имя файла
+        QString params = videoArgs.at(i + 1);
+        params.remove(QRegularExpression(R"(:?stats=[^:]*)"));
+        videoArgs[i + 1] = params + QStringLiteral(":stats=") + statsFileName;
+        return true;
+    }
+
+    if (!videoArgs.contains(QLatin1String("-pass")) || videoArgs.isEmpty())
+    {
+        return false;
+    }
+    const qsizetype logIdx = videoArgs.indexOf(QLatin1String("-passlogfile"));
+    if (logIdx >= 0 && logIdx + 1 < videoArgs.size())
+    {
+        videoArgs[logIdx + 1] = statsFileName;
+        return true;
+    }
+    videoArgs.insert(videoArgs.size() - 1, QStringLiteral("-passlogfile"));
+    videoArgs.insert(videoArgs.size() - 1, statsFileName);
+    return true;
+}
+
+bool RenderHelper::hasPass1Stats(const QString& statsDir, const QString& statsFileName)
+{
+    // x265 пишет файл под заданным именем, ffmpeg с -passlogfile добавляет "-0.log"
+    const QDir dir(statsDir);
+    return QFileInfo(dir.filePath(statsFileName)).size() > 0 ||
+           QFileInfo(dir.filePath(statsFileName + "-0.log")).size() > 0;
+}
+
+void RenderHelper::removePass1Stats(const QString& statsDir, const QString& statsFileName)
+{
+    const QDir dir(statsDir);
+    for (const QString& suffix : {QString(), QStringLiteral(".cutree"), QStringLiteral("-0.log"),
+                                  QStringLiteral("-0.log.mbtree"), QStringLiteral(".temp")})
+    {
+        QFile::remove(dir.filePath(statsFileName + suffix));
+    }
+}
+
+bool RenderHelper::isMp4CompatibleVideoCodec(const QString& codec)
+{
+    const QString c = codec.toLower();
+    return c.contains("avc") || c.contains("h264") || c.contains("h.264") || c.contains("hevc") ||
+           c.contains("h265") || c.contains("h.265") || c.contains("av1");
+}
+
+int RenderHelper::mkvTrackBitrateKbps(const QJsonObject& properties, double durationS)
+{
+    // mkvmerge отдаёт значения тегов строками
+    const qint64 bps = properties["tag_bps"].toVariant().toLongLong();
+    if (bps > 0)
+    {
+        return static_cast<int>(bps / 1000);
+    }
+    const qint64 bytes = properties["tag_number_of_bytes"].toVariant().toLongLong();
+    if (bytes > 0 && durationS > 0)
+    {
+        return static_cast<int>(static_cast<double>(bytes) * 8.0 / durationS / 1000.0);
+    }
+    return 0;
+}
+
+bool RenderHelper::sourceBitrateFitsTarget(int sourceBitrateKbps, int targetBitrateKbps)
+{
+    if (targetBitrateKbps <= 0)
+    {
+        return true;
+    }
+    return sourceBitrateKbps > 0 && sourceBitrateKbps <= targetBitrateKbps * 1.15;
+}
+
+QString RenderHelper::mp4FastPathMismatch(const QString& presetCommand, const QJsonObject& sourceStream)
+{
+    const QString sourceCodec = sourceStream["codec_name"].toString();
+    if (sourceCodec.isEmpty())
+    {
+        return QStringLiteral("параметры видео исходника неизвестны");
+    }
+
+    // Без -c:v ffmpeg пишет в MP4 через libx264
+    QString encoder = QStringLiteral("libx264");
+    QString profile;
+    QString pixFmt;
+    const QStringList args = QProcess::splitCommand(presetCommand);
+    for (int i = 0; i + 1 < args.size(); ++i)
+    {
+        const QString& option = args.at(i);
+        const QString& value = args.at(i + 1);
+        if (option == "-vf" || option.startsWith("-filter:v"))
+        {
+            QString rest = value;
+            rest.remove("subtitles=%SIGNS%");
+            if (!rest.remove(',').trimmed().isEmpty())
+            {
+                return QStringLiteral("в пресете есть видеофильтры кроме надписей: %1").arg(value);
+            }
+        }
+        else if (option == "-filter_complex" || option == "-lavfi")
+        {
+            return QStringLiteral("в пресете задан -filter_complex");
+        }
+        else if (option == "-c:v" || option == "-codec:v" || option == "-vcodec" || option == "-c" ||
+                 option == "-codec")
+        {
+            encoder = value;
+        }
+        else if (option == "-profile:v" || option == "-profile")
+        {
+            profile = value;
+        }
+        else if (option == "-pix_fmt" || option == "-pix_fmt:v")
+        {
+            pixFmt = value;
+        }
+    }
+    if (encoder == QLatin1String("copy"))
+    {
+        return {};
+    }
+
+    if (encoderCodecName(encoder) != sourceCodec)
+    {
+        return QStringLiteral("пресет кодирует в %1 (%2), а видео исходника — %3")
+            .arg(encoderCodecName(encoder), encoder, sourceCodec);
+    }
+    const QString sourceProfile = sourceStream["profile"].toString();
+    if (!profile.isEmpty() && normalizeProfile(profile) != normalizeProfile(sourceProfile))
+    {
+        return QStringLiteral("профиль пресета %1, а у исходника — %2").arg(profile, sourceProfile);
+    }
+    // Без -pix_fmt разрядность задаёт профиль: main10/high10 — 10 бит, остальные — 8
+    int presetDepth = pixelFormatBitDepth(pixFmt);
+    if (presetDepth == 0 && !profile.isEmpty())
+    {
+        presetDepth = profile.contains("10") ? 10 : 8;
+    }
+    const int sourceDepth = pixelFormatBitDepth(sourceStream["pix_fmt"].toString());
+    if (presetDepth > 0 && sourceDepth == 0)
+    {
+        return QStringLiteral("разрядность видео исходника неизвестна");
+    }
+    if (presetDepth > 0 && presetDepth != sourceDepth)
+    {
+        return QStringLiteral("пресет выдаёт %1-битное видео, а исходник %2-битный").arg(presetDepth).arg(sourceDepth);
+    }
+    return {};
+}
+
+void RenderHelper::recordRenderSpeed(const QString& presetName, double durationS, qint64 elapsedMs)
+{
+    if (presetName.isEmpty() || durationS <= 0 || elapsedMs <= 0)
+    {
+        return;
+    }
+    QSettings settings("MyCompany", "DubbingTool");
+    settings.setValue("renderStats/" + presetName + "/speed", durationS * 1000.0 / static_cast<double>(elapsedMs));
+}
+
+QString RenderHelper::describeFastPathSavings(const QString& presetName, double durationS, qint64 elapsedMs)
+{
+    QString message = QString("Быстрый путь: рисовать нечего, видео скопировано в MP4 без перекодирования за %1 с.")
+                          .arg(static_cast<double>(elapsedMs) / 1000.0, 0, 'f', 1);
+
+    QSettings settings("MyCompany", "DubbingTool");
+    const double speed = settings.value("renderStats/" + presetName + "/speed", 0.0).toDouble();
+    if (speed > 0 && durationS > 0)
+    {
+        const double savedS = durationS / speed - static_cast<double>(elapsedMs) / 1000.0;
+        message += QString(" По прошлым рендерам пресета '%1' это экономит около %2 мин.")
+                       .arg(presetName)
+                       .arg(qMax(0.0, savedS) / 60.0, 0, 'f', 1);
+    }
+    return message;
+}
+
 void RenderHelper::onDialogFinished(bool accepted, const QString& pass1, const QString& pass2)
 {
     if (accepted)
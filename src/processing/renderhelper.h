@@ -3,6 +3,7 @@
 
 #include "appsettings.h"
 
+#include <QJsonObject>
 #include <QObject>
 
 class ProcessManager;
@@ -23,6 +24,35 @@ public:
 
     void startCheck();
 
+    /// Имя файла статистики первого прохода для (источник, граф фильтров, пресет).
+    /// \a inputFiles — файлы, от которых зависит картинка (исходник, субтитры для фильтра);
+    /// параметры битрейта в \a pass1Command не учитываются, т.к. анализ первого прохода от них не зависит.
+    static QString pass1StatsFileName(const QStringList& inputFiles, const QString& filterTag,
+                                      const QString& pass1Command);
+    /// Прописывает файл статистики в аргументы прохода: x265 (stats= в -x265-params) или -passlogfile для -pass N.
+    /// Имя задаётся относительно рабочей папки процесса. Возвращает false, если пресет не многопроходный.
+    static bool applyPassStatsFile(QStringList& videoArgs, const QString& statsFileName);
+    static bool hasPass1Stats(const QString& statsDir, const QString& statsFileName);
+    static void removePass1Stats(const QString& statsDir, const QString& statsFileName);
+
+    /// Видеопоток можно положить в MP4 без перекодирования (H.264 / HEVC / AV1).
+    /// Принимает и имя кодека mkvmerge ("AVC/H.264/MPEG-4p10"), и CodecID, и расширение ("h265").
+    static bool isMp4CompatibleVideoCodec(const QString& codec);
+    /// Битрейт дорожки по тегам статистики из properties mkvmerge -J: tag_bps, иначе tag_number_of_bytes
+    /// за \a durationS. 0 — тегов нет (их не пишут, например, старые mkvmerge и многие другие муксеры).
+    static int mkvTrackBitrateKbps(const QJsonObject& properties, double durationS);
+    /// Битрейт исходника не мешает скопировать видео без перекодирования: целевой не задан или исходник
+    /// не выше него больше чем на 15%. Неизвестный (0) битрейт при заданной цели — не подходит.
+    static bool sourceBitrateFitsTarget(int sourceBitrateKbps, int targetBitrateKbps);
+    /// Почему копия видеопотока не заменит рендер по \a presetCommand: в пресете есть фильтры кроме надписей,
+    /// или кодек, профиль, разрядность (-c:v, -profile:v, -pix_fmt) не совпадают с \a sourceStream —
+    /// потоком из ffprobe -show_streams (codec_name, profile, pix_fmt). Пустая строка — копировать можно.
+    static QString mp4FastPathMismatch(const QString& presetCommand, const QJsonObject& sourceStream);
+    /// Запоминает скорость полного рендера пресета (секунд видео за секунду), чтобы оценивать экономию быстрого пути.
+    static void recordRenderSpeed(const QString& presetName, double durationS, qint64 elapsedMs);
+    /// Сообщение для лога быстрого пути: время копирования и оценка сэкономленного времени рендера.
+    static QString describeFastPathSavings(const QString& presetName, double durationS, qint64 elapsedMs);
+
 signals:
     void finished(RerenderDecision decision, const RenderPreset& newPreset);
     void logMessage(const QString& message, LogCategory category = LogCategory::APP, LogLevel level = LogLevel::Info);
@@ -0,0 +1,249 @@
+#include "sfnt.h"
+
+namespace Sfnt
+{
+namespace
+{
+using CmapEntry = std::function<void(char32_t, quint16)>;
+
+void readCmapFormat4(const uchar* sub, quint32 available, const CmapEntry& entry)
+{
+    if (available < 14)
+    {
+        return;
+    }
+    const quint32 segCountX2 = readU16(sub + 6);
+    if (quint64(16) + quint64(segCountX2) * 4 > available)
+    {
+        return;
+    }
+    const uchar* endCodes = sub + 14;
+    const uchar* startCodes = endCodes + segCountX2 + 2;
+    const uchar* idDeltas = startCodes + segCountX2;
+    const uchar* idRangeOffsets = idDeltas + segCountX2;
+    for (quint32 i = 0; i < segCountX2; i += 2)
+    {
+        const quint32 start = readU16(startCodes + i);
+        const quint32 end = readU16(endCodes + i);
+        const quint16 delta = readU16(idDeltas + i);
+        const quint16 rangeOffset = readU16(idRangeOffsets + i);
+        if (start > end || start == 0xFFFF)
+        {
+            continue;
+        }
+        for (quint32 c = start; c <= end; ++c)
+        {
+            quint16 glyph = 0;
+            if (rangeOffset == 0)
+            {
+                glyph = static_cast<quint16>(c + delta);
+            }
+            else
+            {
+                // Смещение считается от самого поля idRangeOffset[i]
+                const quint64 pos = quint64(idRangeOffsets + i - sub) + rangeOffset + (c - start) * 2;
+                if (pos + 2 > available)
+                {
+                    break;
+                }
+                glyph = readU16(sub + pos);
+                if (glyph != 0)
+                {
+                    glyph = static_cast<quint16>(glyph + delta);
+                }
+            }
+            if (glyph != 0)
+            {
+                entry(c, glyph);
+            }
+        }
+    }
+}
+
+void readCmapFormat12(const uchar* sub, quint32 available, const CmapEntry& entry)
+{
+    if (available < 16)
+    {
+        return;
+    }
+    const quint32 groups = readU32(sub + 12);
+    if (quint64(16) + quint64(groups) * 12 > available)
+    {
+        return;
+    }
+    for (quint32 i = 0; i < groups; ++i)
+    {
+        const uchar* group = sub + 16 + i * 12;
+        const char32_t first = readU32(group);
+        const char32_t last = qMin<char32_t>(readU32(group + 4), 0x10FFFF);
+        const quint32 startGlyph = readU32(group + 8);
+        for (char32_t c = first; c <= last; ++c)
+        {
+            // Глиф 0 — .notdef, то есть «символа нет»
+            const quint32 glyph = startGlyph + (c - first);
+            if (glyph != 0 && glyph <= 0xFFFF)
+            {
+                entry(c, static_cast<quint16>(glyph));
+            }
+        }
+    }
+}
+
+void readCmapSubtable(const uchar* sub, quint32 available, const CmapEntry& entry)
+{
+    if (available < 6)
+    {
+        return;
+    }
+    switch (readU16(sub))
+    {
+    case 0:
+        for (quint32 c = 0; c < 256 && 6 + c < available; ++c)
+        {
+            if (sub[6 + c] != 0)
+            {
+                entry(c, sub[6 + c]);
+            }
+        }
+        break;
+    case 4:
+        readCmapFormat4(sub, available, entry);
+        break;
+    case 6:
+    {
+        if (available < 10)
+        {
+            break;
+        }
+        const quint32 firstCode = readU16(sub + 6);
+        const quint32 count = readU16(sub + 8);
+        for (quint32 i = 0; i < count && 10 + quint64(i) * 2 + 2 <= available; ++i)
+        {
+            const quint16 glyph = readU16(sub + 10 + i * 2);
+            if (glyph != 0)
+            {
+                entry(firstCode + i, glyph);
+            }
+        }
+        break;
+    }
+    case 12:
+        readCmapFormat12(sub, available, entry);
+        break;
+    default:
+        break;
+    }
+}
+} // namespace
+
+TableRef findTable(const FontView& font, quint32 faceOffset, quint32 tag)
+{
+    if (!font.contains(faceOffset, 12))
+    {
+        return {};
+    }
+    const quint16 numTables = readU16(font.data + faceOffset + 4);
+    if (!font.contains(faceOffset + 12, quint64(numTables) * 16))
+    {
+        return {};
+    }
+    for (quint16 i = 0; i < numTables; ++i)
+    {
+        const uchar* record = font.data + faceOffset + 12 + i * 16;
+        if (readU32(record) == tag)
+        {
+            TableRef table{readU32(record + 8), readU32(record + 12)};
+            return font.contains(table.offset, table.length) ? table : TableRef{};
+        }
+    }
+    return {};
+}
+
+QList<quint32> faceOffsets(const FontView& font)
+{
+    QList<quint32> offsets;
+    if (!font.contains(0, 12))
+    {
+        return offsets;
+    }
+    if (readU32(font.data) == kTagTtcf)
+    {
+        const quint32 numFonts = readU32(font.data + 8);
+        if (font.contains(12, quint64(numFonts) * 4))
+        {
+            for (quint32 i = 0; i < numFonts; ++i)
+            {
+                offsets.append(readU32(font.data + 12 + i * 4));
+            }
+        }
+    }
+    else
+    {
+        offsets.append(0);
+    }
+    return offsets;
+}
+
+bool forEachCmapEntry(const FontView& font, quint32 faceOffset, const std::function<void(char32_t, quint16)>& entry,
+                      bool* isSymbol)
+{
+    const TableRef cmap = findTable(font, faceOffset, kTagCmap);
+    if (cmap.length < 4)
+    {
+        return false;
+    }
+    const uchar* base = font.data + cmap.offset;
+    const quint16 numTables = readU16(base + 2);
+    if (quint64(4) + quint64(numTables) * 8 > cmap.length)
+    {
+        return false;
+    }
+
+    int bestPriority = -1;
+    quint32 bestOffset = 0;
+    for (quint16 i = 0; i < numTables; ++i)
+    {
+        const uchar* record = base + 4 + i * 8;
+        const quint16 platformId = readU16(record);
+        const quint16 encodingId = readU16(record + 2);
+        const quint32 offset = readU32(record + 4);
+        int priority = -1;
+        if (platformId == 3 && encodingId == 10)
+        {
+            priority = 4;
+        }
+        else if (platformId == 0 && (encodingId == 4 || encodingId == 6))
+        {
+            priority = 3;
+        }
+        else if (platformId == 3 && encodingId == 1)
+        {
+            priority = 2;
+        }
+        else if (platformId == 0)
+        {
+            priority = 1;
+        }
+        else if (platformId == 3 && encodingId == 0)
+        {
+            priority = 0;
+        }
+        if (priority > bestPriority && offset < cmap.length)
+        {
+            bestPriority = priority;
+            bestOffset = offset;
+        }
+    }
+    if (bestPriority < 0)
+    {
+        return false;
+    }
+
+    if (isSymbol)
+    {
+        *isSymbol = bestPriority == 0;
+    }
+    readCmapSubtable(base + bestOffset, cmap.length - bestOffset, entry);
+    return true;
+}
+} // namespace Sfnt
@@ -0,0 +1,82 @@
+#ifndef SFNT_H
+#define SFNT_H
+
+#include <QList>
+#include <QtGlobal>
+
+#include <functional>
+
+/// Низкоуровневое чтение контейнера sfnt (TTF/OTF/TTC): общий код индекса шрифтов и сабсеттера.
+namespace Sfnt
+{
+constexpr quint32 makeTag(char a, char b, char c, char d)
+{
+    return (quint32(uchar(a)) << 24) | (quint32(uchar(b)) << 16) | (quint32(uchar(c)) << 8) | quint32(uchar(d));
+}
+
+constexpr quint32 kTagTtcf = makeTag('t', 't', 'c', 'f');
+constexpr quint32 kTagCff = makeTag('C', 'F', 'F', ' ');
+constexpr quint32 kTagCff2 = makeTag('C', 'F', 'F', '2');
+constexpr quint32 kTagCmap = makeTag('c', 'm', 'a', 'p');
+constexpr quint32 kTagDsig = makeTag('D', 'S', 'I', 'G');
+constexpr quint32 kTagFvar = makeTag('f', 'v', 'a', 'r');
+constexpr quint32 kTagGlyf = makeTag('g', 'l', 'y', 'f');
+constexpr quint32 kTagGsub = makeTag('G', 'S', 'U', 'B');
+constexpr quint32 kTagHead = makeTag('h', 'e', 'a', 'd');
+constexpr quint32 kTagLoca = makeTag('l', 'o', 'c', 'a');
+constexpr quint32 kTagMaxp = makeTag('m', 'a', 'x', 'p');
+constexpr quint32 kTagName = makeTag('n', 'a', 'm', 'e');
+constexpr quint32 kTagOs2 = makeTag('O', 'S', '/', '2');
+
+inline quint16 readU16(const uchar* p)
+{
+    return static_cast<quint16>((p[0] << 8) | p[1]);
+}
+
+inline quint32 readU32(const uchar* p)
+{
+    return (quint32(p[0]) << 24) | (quint32(p[1]) << 16) | (quint32(p[2]) << 8) | quint32(p[3]);
+}
+
+struct TableRef
+{
+    quint32 offset = 0;
+    quint32 length = 0;
+
+    bool isValid() const
+    {
+        return length > 0;
+    }
+};
+
+/// Файл шрифта в памяти (обычно отображённый через QFile::map); все чтения проверяются по size.
+struct FontView
+{
+    const uchar* data = nullptr;
+    qint64 size = 0;
+
+    bool contains(quint64 offset, quint64 length) const
+    {
+        return offset <= quint64(size) && length <= quint64(size) - offset;
+    }
+};
+
+/// Таблица начертания, начинающегося с \a faceOffset; пустая, если её нет или она за концом файла.
+TableRef findTable(const FontView& font, quint32 faceOffset, quint32 tag);
+
+/// Смещения начертаний: у .ttc — из заголовка коллекции, у одиночного шрифта — единственное, 0.
+QList<quint32> faceOffsets(const FontView& font);
+
+/**
+ * @brief Обойти лучшую Unicode-подтаблицу cmap (форматы 0, 4, 6, 12).
+ *
+ * Подтаблица выбирается так же, как FreeType выбирает charmap: полная UCS-4, затем BMP, затем Symbol.
+ * \a entry вызывается для каждого символа с ненулевым глифом.
+ * @param isSymbol true, если выбрана символьная подтаблица (3,0) с кодами в U+F000..F0FF
+ * @return false, если подходящей cmap нет
+ */
+bool forEachCmapEntry(const FontView& font, quint32 faceOffset, const std::function<void(char32_t, quint16)>& entry,
+                      bool* isSymbol = nullptr);
+} // namespace Sfnt
+
+#endif // SFNT_H
@@ -0,0 +1,156 @@
+#include "substitutionmatcher.h"
+
+#include <QVarLengthArray>
+
+#include <algorithm>
+
+namespace
+{
+struct Match
+{
+    qsizetype start = 0;
+    qsizetype length = 0;
+    int key = -1;
+};
+} // namespace
+
+SubstitutionMatcher::SubstitutionMatcher(const QMap<QString, QString>& substitutions)
+{
+    for (auto it = substitutions.constBegin(); it != substitutions.constEnd(); ++it)
+    {
+        // Пустой ключ QString::replace вставлял бы замену между всеми символами — такое правило бессмысленно
+        if (it.key().isEmpty())
+        {
+            continue;
+        }
+        m_keys.append(it.key());
+        m_keyBytes.append(it.key().toUtf8());
+        m_replacements.append(it.value().toUtf8());
+    }
+
+    // Сжатие алфавита: таблица переходов строится только по байтам, которые есть в ключах
+    for (const QByteArray& key : std::as_const(m_keyBytes))
+    {
+        for (const char c : key)
+        {
+            quint16& cls = m_byteClass[static_cast<uchar>(c)];
+            if (cls == 0)
+            {
+                cls = static_cast<quint16>(m_classCount++);
+            }
+        }
+    }
+
+    // Бор
+    m_nodes.append(Node());
+    m_delta.fill(-1, m_classCount);
+    for (int k = 0; k < m_keyBytes.size(); ++k)
+    {
+        int node = 0;
+        for (const char c : m_keyBytes.at(k))
+        {
+            const int slot = node * m_classCount + m_byteClass[static_cast<uchar>(c)];
+            if (m_delta.at(slot) < 0)
+            {
+                m_delta[slot] = m_nodes.size();
+                m_nodes.append(Node());
+                m_delta.resize(m_delta.size() + m_classCount, -1);
+            }
+            node = m_delta.at(slot);
+        }
+        m_nodes[node].output = k;
+    }
+
+    // Суффиксные ссылки обходом в ширину; недостающие переходы достраиваются до полного автомата
+    QList<int> queue;
+    queue.reserve(m_nodes.size());
+    for (int cls = 0; cls < m_classCount; ++cls)
+    {
+        int& next = m_delta[cls];
+        if (next < 0)
+        {
+            next = 0;
+        }
+        else
+        {
+            queue.append(next);
+        }
+    }
+    for (qsizetype head = 0; head < queue.size(); ++head)
+    {
+        const int node = queue.at(head);
+        const int fail = m_nodes.at(node).fail;
+        m_nodes[node].dictLink = m_nodes.at(fail).output >= 0 ? fail : m_nodes.at(fail).dictLink;
+        for (int cls = 0; cls < m_classCount; ++cls)
+        {
+            const int slot = node * m_classCount + cls;
+            const int viaFail = m_delta.at(fail * m_classCount + cls);
+            if (m_delta.at(slot) < 0)
+            {
+                m_delta[slot] = viaFail;
+            }
+            else
+            {
+                m_nodes[m_delta.at(slot)].fail = viaFail;
+                queue.append(m_delta.at(slot));
+            }
+        }
+    }
+}
+
+bool SubstitutionMatcher::apply(QByteArrayView text, QByteArray& out, QList<int>* hitsPerKey) const
+{
+    if (m_keys.isEmpty())
+    {
+        return false;
+    }
+
+    QVarLengthArray<Match, 16> matches;
+    int state = 0;
+    for (qsizetype i = 0; i < text.size(); ++i)
+    {
+        state = transition(state, static_cast<uchar>(text.at(i)));
+        int node = m_nodes.at(state).output >= 0 ? state : m_nodes.at(state).dictLink;
+        for (; node >= 0; node = m_nodes.at(node).dictLink)
+        {
+            const int key = m_nodes.at(node).output;
+            const qsizetype length = m_keyBytes.at(key).size();
+            matches.append({i + 1 - length, length, key});
+        }
+    }
+    if (matches.isEmpty())
+    {
+        return false;
+    }
+
+    // Самое левое, при равном начале — самое длинное
+    std::sort(matches.begin(), matches.end(),
+              [](const Match& a, const Match& b)
+              { return a.start != b.start ? a.start < b.start : a.length > b.length; });
+
+    QByteArray result;
+    result.reserve(text.size() + 16);
+    qsizetype pos = 0;
+    for (const Match& match : std::as_const(matches))
+    {
+        if (match.start < pos)
+        {
+            continue;
+        }
+        result.append(text.mid(pos, match.start - pos));
+        result.append(m_replacements.at(match.key));
+        pos = match.start + match.length;
+        if (hitsPerKey)
+        {
+            ++(*hitsPerKey)[match.key];
+        }
+    }
+    result.append(text.mid(pos));
+
+    if (result == text)
+    {
+        return false;
+    }
+    out = result;
+    return true;
+}
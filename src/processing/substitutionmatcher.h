@@ -0,0 +1,62 @@
+#ifndef SUBSTITUTIONMATCHER_H
+#define SUBSTITUTIONMATCHER_H
+
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QList>
+#include <QMap>
+#include <QString>
+
+/**
+ * @brief Автомат Ахо–Корасик для автозамен из ReleaseTemplate::substitutions.
+ *
+ * Строится один раз по словарю замен и работает прямо по UTF-8 байтам поля Text:
+ * один проход по строке находит все вхождения всех ключей, затем слева направо применяются
+ * самые длинные непересекающиеся совпадения. Результат одной замены повторно не сканируется.
+ * UTF-8 самосинхронизируется, поэтому байтовые совпадения всегда выровнены по символам.
+ */
+class SubstitutionMatcher
+{
+public:
+    explicit SubstitutionMatcher(const QMap<QString, QString>& substitutions);
+
+    bool isEmpty() const
+    {
+        return m_keys.isEmpty();
+    }
+    int keyCount() const
+    {
+        return m_keys.size();
+    }
+    const QString& key(int index) const
+    {
+        return m_keys.at(index);
+    }
+
+    /// Применяет замены к \a text. Возвращает false (и не трогает \a out), если совпадений нет.
+    /// \a hitsPerKey (размер keyCount()) накапливает число замен по каждому ключу.
+    bool apply(QByteArrayView text, QByteArray& out, QList<int>* hitsPerKey = nullptr) const;
+
+private:
+    struct Node
+    {
+        int fail = 0;
+        int output = -1;   // самый длинный ключ, оканчивающийся в этом узле
+        int dictLink = -1; // ближайший узел с output по цепочке fail
+    };
+
+    int transition(int node, uchar byte) const
+    {
+        return m_delta[node * m_classCount + m_byteClass[byte]];
+    }
+
+    QList<QString> m_keys;
+    QList<QByteArray> m_keyBytes;
+    QList<QByteArray> m_replacements;
+    QList<Node> m_nodes;
+    QList<int> m_delta; // полная таблица переходов: узел x класс байта
+    quint16 m_byteClass[256] = {}; // 0 — байт не встречается ни в одном ключе
+    int m_classCount = 1;
+};
+
+#endif // SUBSTITUTIONMATCHER_H
@@ -0,0 +1,287 @@
+#include "wavfile.h"
+
+#include <QFile>
+#include <QtEndian>
+
+#include <cstring>
+
+namespace
+{
+constexpr quint16 kFormatPcm = 0x0001;
+constexpr quint16 kFormatFloat = 0x0003;
+constexpr quint16 kFormatExtensible = 0xFFFE;
+constexpr quint32 kUnknownSize = 0xFFFFFFFF; // ffmpeg пишет его в размер data до конца записи
+constexpr qint64 kMaxFormatSize = 1024;
+
+// Sony Wave64: вместо FourCC — GUID, у стандартных чанков первые 4 байта совпадают с FourCC RIFF
+constexpr uchar kWave64Riff[16] = {'r', 'i', 'f', 'f', 0x2E, 0x91, 0xCF, 0x11,
+                                   0xA5, 0xD6, 0x28, 0xDB, 0x04, 0xC1, 0x00, 0x00};
+constexpr uchar kWave64Suffix[12] = {0xF3, 0xAC, 0xD3, 0x11, 0x8C, 0xD1, 0x00, 0xC0, 0x4F, 0x8E, 0xDB, 0x8A};
+constexpr qint64 kWave64HeaderSize = 40;
+
+WavInfo fail(const QString& reason, WavContainer container = WavContainer::None)
+{
+    WavInfo info;
+    info.container = container;
+    info.errorString = reason;
+    return info;
+}
+
+/// Разобрать содержимое чанка fmt; у EXTENSIBLE настоящий формат — первые два байта SubFormat GUID.
+/// @return false, если чанк короче, чем требует его формат; не PCM и не float отмечается в unsupportedFormat
+bool parseFormat(const QByteArray& chunk, WavInfo& info)
+{
+    if (chunk.size() < 16)
+    {
+        return false;
+    }
+    const auto* p = reinterpret_cast<const uchar*>(chunk.constData());
+    quint16 formatTag = qFromLittleEndian<quint16>(p);
+    info.channels = qFromLittleEndian<quint16>(p + 2);
+    info.sampleRate = static_cast<int>(qFromLittleEndian<quint32>(p + 4));
+    info.blockAlign = qFromLittleEndian<quint16>(p + 12);
+    info.bitsPerSample = qFromLittleEndian<quint16>(p + 14);
+    if (formatTag == kFormatExtensible)
+    {
+        if (chunk.size() < 40)
+        {
+            return false;
+        }
+        const quint16 validBits = qFromLittleEndian<quint16>(p + 18);
+        if (validBits > 0)
+        {
+            info.bitsPerSample = validBits;
+        }
+        info.channelMask = qFromLittleEndian<quint32>(p + 20);
+        formatTag = qFromLittleEndian<quint16>(p + 24);
+    }
+    info.isFloat = formatTag == kFormatFloat;
+    info.unsupportedFormat = formatTag != kFormatPcm && formatTag != kFormatFloat;
+    return true;
+}
+
+WavContainer detectContainer(const uchar* data, qint64 size)
+{
+    if (size >= 12 && std::memcmp(data + 8, "WAVE", 4) == 0)
+    {
+        if (std::memcmp(data, "RIFF", 4) == 0)
+        {
+            return WavContainer::Riff;
+        }
+        if (std::memcmp(data, "RF64", 4) == 0 || std::memcmp(data, "BW64", 4) == 0)
+        {
+            return WavContainer::Rf64;
+        }
+    }
+    if (size >= kWave64HeaderSize && std::memcmp(data, kWave64Riff, 16) == 0 &&
+        std::memcmp(data + 24, "wave", 4) == 0 && std::memcmp(data + 28, kWave64Suffix, 12) == 0)
+    {
+        return WavContainer::Wave64;
+    }
+    return WavContainer::None;
+}
+} // namespace
+
+namespace WavFile
+{
+WavInfo readHeader(const QString& path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        return fail(file.errorString());
+    }
+    // Отображение не читает файл целиком: с диска подтягиваются только страницы заголовка
+    const qint64 fileSize = file.size();
+    const uchar* data = fileSize > 0 ? file.map(0, fileSize) : nullptr;
+    if (data == nullptr)
+    {
+        return fail(fileSize > 0 ? file.errorString() : QStringLiteral("пустой файл"));
+    }
+    const WavContainer container = detectContainer(data, fileSize);
+    if (container == WavContainer::None)
+    {
+        return fail(QStringLiteral("не RIFF/RF64/Wave64"));
+    }
+
+    const bool isWave64 = container == WavContainer::Wave64;
+    const qint64 chunkHeaderSize = isWave64 ? 24 : 8;
+    const qint64 alignment = isWave64 ? 8 : 2;
+    WavInfo info;
+    info.container = container;
+    bool hasFormat = false;
+    qint64 ds64DataSize = -1;
+    qint64 pos = isWave64 ? kWave64HeaderSize : 12;
+    while (pos + chunkHeaderSize <= fileSize)
+    {
+        const uchar* chunk = data + pos;
+        QByteArray id;
+        qint64 size = 0;
+        if (isWave64)
+        {
+            // Размер чанка Wave64 включает его заголовок
+            if (std::memcmp(chunk + 4, kWave64Suffix, 12) == 0)
+            {
+                id = QByteArray(reinterpret_cast<const char*>(chunk), 4);
+            }
+            size = qint64(qFromLittleEndian<quint64>(chunk + 16)) - chunkHeaderSize;
+            if (size < 0)
+            {
+                return fail(QStringLiteral("повреждён заголовок чанка"), container);
+            }
+        }
+        else
+        {
+            id = QByteArray(reinterpret_cast<const char*>(chunk), 4);
+            size = qFromLittleEndian<quint32>(chunk + 4);
+        }
+        const qint64 body = pos + chunkHeaderSize;
+
+        if (id == "data")
+        {
+            info.dataOffset = body;
+            info.declaredDataSize = size;
+            if (container == WavContainer::Rf64 && size == kUnknownSize && ds64DataSize >= 0)
+            {
+                info.declaredDataSize = ds64DataSize;
+            }
+            else if (!isWave64 && size == kUnknownSize)
+            {
+                // Размер не дописан: файл ещё пишется или писался в поток, данные — до конца файла
+                info.declaredDataSize = fileSize - body;
+            }
+            info.dataSize = qMin(info.declaredDataSize, fileSize - body);
+            break;
+        }
+        if (body + size > fileSize)
+        {
+            return fail(QStringLiteral("чанк «%1» выходит за конец файла — файл обрезан").arg(QString::fromLatin1(id)),
+                        container);
+        }
+        if (id == "ds64" && container == WavContainer::Rf64 && size >= 24)
+        {
+            ds64DataSize = qint64(qFromLittleEndian<quint64>(chunk + chunkHeaderSize + 8));
+        }
+        else if (id == "fmt ")
+        {
+            const QByteArray format = QByteArray::fromRawData(reinterpret_cast<const char*>(chunk + chunkHeaderSize),
+                                                              qMin(size, kMaxFormatSize));
+            if (size > kMaxFormatSize || !parseFormat(format, info))
+            {
+                return fail(QStringLiteral("некорректный заголовок fmt"), container);
+            }
+            hasFormat = true;
+        }
+        // Чанки RIFF выровнены по чётной границе, Wave64 — по 8 байтам
+        pos = body + size;
+        pos += (alignment - pos % alignment) % alignment;
+    }
+
+    if (!hasFormat || info.dataOffset < 0)
+    {
+        // Обход дошёл до конца файла, не встретив нужных чанков: чаще всего файл оборван на заголовке
+        return fail(QStringLiteral("нет чанка fmt или data — файл обрезан или повреждён"), container);
+    }
+    if (info.unsupportedFormat)
+    {
+        // ADPCM, A-law и прочее сами не декодируем, но размеры чанков уже проверены — обрезку видно и так
+        info.errorString = QStringLiteral("неподдерживаемый формат отсчётов");
+        return info;
+    }
+    const int bytes = info.containerBytes();
+    if (info.channels <= 0 || info.sampleRate <= 0 || info.blockAlign != bytes * info.channels ||
+        (info.isFloat ? bytes != 4 && bytes != 8 : bytes < 1 || bytes > 4))
+    {
+        return fail(QStringLiteral("некорректный заголовок fmt"), container);
+    }
+    info.ok = true;
+    return info;
+}
+
+bool isWav(const QString& path)
+{
+    return readHeader(path).ok;
+}
+
+QString integrityError(const WavInfo& info)
+{
+    if (info.container == WavContainer::None)
+    {
+        return {};
+    }
+    if (!info.ok && !info.unsupportedFormat)
+    {
+        return info.errorString;
+    }
+    if (info.isTruncated() && info.unsupportedFormat)
+    {
+        // Кадр сжатого формата несёт не один отсчёт, поэтому длительность по blockAlign не считаем
+        return QStringLiteral("файл обрезан: в нём %1 байт данных из %2 по заголовку")
+            .arg(info.dataSize)
+            .arg(info.declaredDataSize);
+    }
+    if (info.isTruncated())
+    {
+        const double declaredS = double(info.declaredDataSize / info.blockAlign) / info.sampleRate;
+        return QStringLiteral("файл обрезан: в нём %1 с звука из %2 с по заголовку")
+            .arg(info.durationS(), 0, 'f', 3)
+            .arg(declaredS, 0, 'f', 3);
+    }
+    return {};
+}
+
+void decodeChannel(const uchar* frames, qint64 count, const WavInfo& format, int channel, float* out)
+{
+    const int bytes = format.containerBytes();
+    const int stride = format.blockAlign;
+    const uchar* p = frames + channel * bytes;
+    // Формат проверяется один раз на канал, а не на каждый отсчёт
+    if (format.isFloat && bytes == 4)
+    {
+        for (qint64 i = 0; i < count; ++i, p += stride)
+        {
+            const quint32 bits = qFromLittleEndian<quint32>(p);
+            std::memcpy(&out[i], &bits, sizeof(float));
+        }
+    }
+    else if (format.isFloat)
+    {
+        for (qint64 i = 0; i < count; ++i, p += stride)
+        {
+            const quint64 bits = qFromLittleEndian<quint64>(p);
+            double value;
+            std::memcpy(&value, &bits, sizeof(double));
+            out[i] = static_cast<float>(value);
+        }
+    }
+    else if (bytes == 1)
+    {
+        for (qint64 i = 0; i < count; ++i, p += stride)
+        {
+            out[i] = (int(p[0]) - 128) * (1.0f / 128.0f);
+        }
+    }
+    else if (bytes == 2)
+    {
+        for (qint64 i = 0; i < count; ++i, p += stride)
+        {
+            out[i] = qFromLittleEndian<qint16>(p) * (1.0f / 32768.0f);
+        }
+    }
+    else if (bytes == 3)
+    {
+        for (qint64 i = 0; i < count; ++i, p += stride)
+        {
+            const qint32 value = qint32(quint32(p[0]) << 8 | quint32(p[1]) << 16 | quint32(p[2]) << 24) >> 8;
+            out[i] = value * (1.0f / 8388608.0f);
+        }
+    }
+    else
+    {
+        for (qint64 i = 0; i < count; ++i, p += stride)
+        {
+            out[i] = qFromLittleEndian<qint32>(p) * (1.0f / 2147483648.0f);
+        }
+    }
+}
+} // namespace WavFile
@@ -0,0 +1,88 @@
+#ifndef WAVFILE_H
+#define WAVFILE_H
+
+#include <QString>
+
+/// Контейнер: RIFF ограничен 4 ГБ, RF64/BW64 и Sony Wave64 хранят размеры в 64 битах.
+enum class WavContainer
+{
+    None, // сигнатура не распознана — файл не WAV
+    Riff,
+    Rf64,
+    Wave64
+};
+
+/// Формат и положение PCM-данных WAV-файла.
+struct WavInfo
+{
+    bool ok = false;
+    QString errorString;
+    bool unsupportedFormat = false; // заголовок цел, но отсчёты не PCM/float — ok остаётся false, разбирает ffmpeg
+
+    WavContainer container = WavContainer::None;
+
+    bool isFloat = false;
+    int channels = 0;
+    int sampleRate = 0;
+    int bitsPerSample = 0; // значащие биты
+    int blockAlign = 0;    // байт на кадр (все каналы)
+    quint32 channelMask = 0;
+    qint64 dataOffset = -1; // начало чанка data от начала файла
+    qint64 dataSize = 0;         // сколько данных есть в файле
+    qint64 declaredDataSize = 0; // сколько записано в заголовке
+
+    /// Файл короче, чем обещает заголовок: загрузка или запись оборвалась.
+    bool isTruncated() const
+    {
+        return dataSize < declaredDataSize;
+    }
+
+    /// Байт на отсчёт в файле: у WAVE_FORMAT_EXTENSIBLE 24 значащих бита могут лежать в 32-битном контейнере.
+    int containerBytes() const
+    {
+        return channels > 0 ? blockAlign / channels : 0;
+    }
+
+    qint64 frameCount() const
+    {
+        return blockAlign > 0 ? dataSize / blockAlign : 0;
+    }
+
+    double durationS() const
+    {
+        return sampleRate > 0 ? double(frameCount()) / sampleRate : 0.0;
+    }
+
+    qint64 durationUs() const
+    {
+        return sampleRate > 0 ? frameCount() * 1000000 / sampleRate : 0;
+    }
+};
+
+/// Разбор заголовка RIFF/RF64/Wave64 без запуска ffprobe.
+namespace WavFile
+{
+/**
+ * @brief Прочитать чанки fmt и data из отображённого в память файла.
+ *
+ * Поддерживаются PCM 8/16/24/32 бит и float 32/64 бит, в том числе EXTENSIBLE. Размеры чанков сверяются
+ * с размером файла: служебный чанк за концом файла — ошибка, обрезанный чанк data — isTruncated().
+ */
+WavInfo readHeader(const QString& path);
+
+/// Файл — читаемый WAV (по содержимому, а не по расширению).
+bool isWav(const QString& path);
+
+/**
+ * @brief Почему файл нельзя отдавать в обработку.
+ * Ошибкой считаются только повреждённые или обрезанные файлы: WAV с неподдерживаемым форматом отсчётов
+ * уходит в ffmpeg, как и файл не в WAV.
+ * @return пустая строка, если файл цел или вовсе не WAV (его проверит ffmpeg)
+ */
+QString integrityError(const WavInfo& info);
+
+/// Перевести канал \a channel из \a count кадров, начиная с \a frames, во float в диапазоне [-1, 1).
+void decodeChannel(const uchar* frames, qint64 count, const WavInfo& format, int channel, float* out);
+} // namespace WavFile
+
+#endif // WAVFILE_H
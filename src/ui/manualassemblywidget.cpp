@@ -6,6 +6,7 @@
 
 #include <QColor>
 #include <QFileDialog>
+#include <QHash>
 #include <QListWidgetItem>
 #include <QMessageBox>
 #include <QStyle>
@@ -387,6 +388,12 @@ void ManualAssemblyWidget::onFontFinderFinished(const FontFinderResult& result)
 
     ui->fontsListWidget->clear();
 
+    QHash<QString, QStringList> missingGlyphsByPath;
+    for (const MissingGlyphsInfo& info : result.missingGlyphs)
+    {
+        missingGlyphsByPath[info.path].append(QString("нет %1 символов: %2").arg(info.missingCount).arg(info.sample));
+    }
+
     for (const FoundFontInfo& fontInfo : result.foundFonts)
     {
         QListWidgetItem* item =
@@ -394,6 +401,13 @@ void ManualAssemblyWidget::onFontFinderFinished(const FontFinderResult& result)
         item->setForeground(Qt::darkGreen);
         item->setData(Qt::UserRole, fontInfo.path);
         item->setToolTip(fontInfo.path);
+        const QStringList missingGlyphs = missingGlyphsByPath.value(fontInfo.path);
+        if (!missingGlyphs.isEmpty())
+        {
+            item->setText(QString("%1 - НАЙДЕН, НО БЕЗ ЧАСТИ СИМВОЛОВ -> %2").arg(fontInfo.familyName, fontInfo.path));
+            item->setForeground(QColor(200, 120, 0));
+            item->setToolTip(fontInfo.path + "\n" + missingGlyphs.join("\n"));
+        }
         ui->fontsListWidget->addItem(item);
     }
 
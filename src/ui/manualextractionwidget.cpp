@@ -5,6 +5,7 @@
 
 #include <QDir>
 #include <QDragEnterEvent>
+#include <QFile>
 #include <QFileDialog>
 #include <QJsonArray>
 #include <QJsonDocument>
@@ -366,6 +367,8 @@ void ManualExtractionWidget::onExtractClicked()
                     QString fontsDir = QDir(sourceDir).filePath("attached_fonts");
                     QDir().mkpath(fontsDir);
                     QString outPath = QDir(fontsDir).filePath(fileName);
+                    // Шрифт мог быть размещён ссылкой на общее хранилище: удаляем, чтобы не перезаписать его
+                    QFile::remove(outPath);
 
                     mkvextractAttach << QString("%1:%2").arg(id).arg(outPath);
                     hasWork = true;
@@ -33,6 +33,10 @@ void SettingsDialog::loadSettings()
     ui->qbittorrentPathEdit->setText(settings.qbittorrentPath());
     ui->nugenAmbPathEdit->setText(settings.nugenAmbPath());
     ui->deleteTempFilesCheckBox->setChecked(settings.deleteTempFiles());
+    ui->directSourceTracksCheckBox->setChecked(settings.directSourceTracks());
+    ui->bitrateCalibrationCheckBox->setChecked(settings.bitrateCalibration());
+    ui->subsetFontsCheckBox->setChecked(settings.subsetFonts());
+    ui->applyAudioOffsetCheckBox->setChecked(settings.applyAudioOffset());
     ui->userFileActionComboBox->setCurrentIndex(static_cast<int>(settings.userFileAction()));
     ui->projectDirectoryEdit->setText(settings.projectDirectory());
 
@@ -88,6 +92,10 @@ void SettingsDialog::accept()
     settings.setQbittorrentPath(ui->qbittorrentPathEdit->text());
     settings.setNugenAmbPath(ui->nugenAmbPathEdit->text());
     settings.setDeleteTempFiles(ui->deleteTempFilesCheckBox->isChecked());
+    settings.setDirectSourceTracks(ui->directSourceTracksCheckBox->isChecked());
+    settings.setBitrateCalibration(ui->bitrateCalibrationCheckBox->isChecked());
+    settings.setSubsetFonts(ui->subsetFontsCheckBox->isChecked());
+    settings.setApplyAudioOffset(ui->applyAudioOffsetCheckBox->isChecked());
     settings.setUserFileAction(static_cast<UserFileAction>(ui->userFileActionComboBox->currentIndex()));
     settings.setProjectDirectory(ui->projectDirectoryEdit->text().trimmed());
 
@@ -1,11 +1,10 @@
 #include "styleselectordialog.h"
 
+#include "assdocument.h"
 #include "ui_styleselectordialog.h"
 
-#include <QFile>
 #include <QListWidgetItem>
 #include <QSet>
-#include <QTextStream>
 
 StyleSelectorDialog::StyleSelectorDialog(QWidget* parent) : QDialog(parent), ui(new Ui::StyleSelectorDialog)
 {
@@ -19,8 +18,8 @@ StyleSelectorDialog::~StyleSelectorDialog()
 
 void StyleSelectorDialog::analyzeFile(const QString& filePath)
 {
-    QFile file(filePath);
-    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+    const std::shared_ptr<const AssDocument> doc = AssDocument::load(filePath);
+    if (!doc)
     {
         return;
     }
@@ -28,42 +27,16 @@ void StyleSelectorDialog::analyzeFile(const QString& filePath)
     QSet<QString> foundStyles;
     QSet<QString> foundActors;
 
-    QTextStream in(&file);
-    bool inEvents = false;
-    while (!in.atEnd())
+    for (int i = 0; i < doc->events().size(); ++i)
     {
-        QString line = in.readLine();
-        if (line.startsWith("[Events]"))
-        {
-            inEvents = true;
-            continue;
-        }
-        if (!inEvents)
+        if (doc->events().at(i).comment)
             continue;
-        if (line.startsWith("[Fonts]") || line.startsWith("[Graphics]"))
-            break; // Дальше нет смысла искать
-
-        if (line.startsWith("Style:"))
-        {
-            QStringList parts = line.split(QChar(','), Qt::SkipEmptyParts);
-            if (!parts.isEmpty())
-            {
-                foundStyles.insert(parts[0].split(':').last().trimmed());
-            }
-        }
-        else if (line.startsWith("Dialogue:"))
-        {
-            QStringList parts = line.split(QChar(','), Qt::KeepEmptyParts);
-            if (parts.size() > 4)
-            {
-                QString style = parts[3].trimmed();
-                QString actor = parts[4].trimmed();
-                if (!style.isEmpty())
-                    foundStyles.insert(style);
-                if (!actor.isEmpty())
-                    foundActors.insert(actor);
-            }
-        }
+        const QString style = doc->eventField(i, AssDocument::EventField::Style);
+        const QString actor = doc->eventField(i, AssDocument::EventField::Name);
+        if (!style.isEmpty())
+            foundStyles.insert(style);
+        if (!actor.isEmpty())
+            foundActors.insert(actor);
     }
 
     for (const QString& style : foundStyles)
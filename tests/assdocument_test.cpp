@@ -0,0 +1,80 @@
+/**
+ * @file assdocument_test.cpp
+ * @brief Unit tests for AssDocument: Format-driven fields and in-place serialization
+ */
+
+#include <QtTest/QtTest>
+#include <QByteArray>
+#include <QString>
+
+#include "assdocument.h"
+
+class AssDocumentTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testAssDocument_fieldsFollowFormatLine();
+    void testAssDocument_setEventTextKeepsOtherLines();
+};
+
+/**
+ * @brief Test: event fields are resolved through the [Events] Format line
+ *
+ * Short Format without Name/Margin/Effect columns; commas inside Text must stay in Text
+ */
+void AssDocumentTest::testAssDocument_fieldsFollowFormatLine()
+{
+    const QByteArray data = "\xEF\xBB\xBF[Script Info]\r\n"
+                            "PlayResX: 1280\r\n"
+                            "\r\n"
+                            "[V4+ Styles]\r\n"
+                            "Format: Name, Fontname, Bold, Italic, Alignment\r\n"
+                            "Style: Sign,Arial,-1,0,8\r\n"
+                            "\r\n"
+                            "[Events]\r\n"
+                            "Format: Layer, Start, End, Style, Text\r\n"
+                            "Dialogue: 0,0:00:01.00,0:00:02.50,Sign,Hello, world\r\n"
+                            "Comment: 0,0:00:03.00,0:00:04.00,Sign,note\r\n";
+
+    const AssDocument doc = AssDocument::fromData(data);
+    QCOMPARE(doc.scriptInfoValue("PlayResX"), QString("1280"));
+
+    QCOMPARE(doc.styles().size(), 1);
+    QCOMPARE(doc.styleField(0, AssDocument::StyleField::Fontname), QString("Arial"));
+    QCOMPARE(doc.styleField(0, AssDocument::StyleField::Bold), QString("-1"));
+    QCOMPARE(doc.styleField(0, AssDocument::StyleField::Alignment), QString("8"));
+
+    QCOMPARE(doc.events().size(), 2);
+    QVERIFY(!doc.events().at(0).comment);
+    QVERIFY(doc.events().at(1).comment);
+    QCOMPARE(doc.eventField(0, AssDocument::EventField::Start), QString("0:00:01.00"));
+    QCOMPARE(doc.eventField(0, AssDocument::EventField::Style), QString("Sign"));
+    QCOMPARE(doc.eventField(0, AssDocument::EventField::Text), QString("Hello, world"));
+    QVERIFY(doc.eventField(0, AssDocument::EventField::Name).isEmpty());
+}
+
+/**
+ * @brief Test: edited event text is serialized in place, other lines are byte-identical
+ */
+void AssDocumentTest::testAssDocument_setEventTextKeepsOtherLines()
+{
+    const QByteArray data = "[Events]\n"
+                            "Format: Layer, Start, End, Style, Name, MarginL, MarginR, MarginV, Effect, Text\n"
+                            "Dialogue: 0,0:00:01.00,0:00:02.00,Default,,0,0,0,,{\\i1}Привет{\\i0}\n"
+                            "Dialogue: 0,0:00:03.00,0:00:04.00,Default,,0,0,0,,Пока\n";
+
+    AssDocument doc = AssDocument::fromData(data);
+    QCOMPARE(doc.events().size(), 2);
+    QCOMPARE(doc.eventField(0, AssDocument::EventField::Text), QString("{\\i1}Привет{\\i0}"));
+
+    doc.setEventText(1, "До встречи, друг");
+    QVERIFY(!doc.isLineModified(doc.events().at(0).line));
+    QCOMPARE(doc.lineText(doc.events().at(1).line),
+             QString("Dialogue: 0,0:00:03.00,0:00:04.00,Default,,0,0,0,,До встречи, друг"));
+    QCOMPARE(doc.lineBytes(doc.events().at(0).line),
+             QByteArray("Dialogue: 0,0:00:01.00,0:00:02.00,Default,,0,0,0,,{\\i1}Привет{\\i0}"));
+}
+
+QTEST_MAIN(AssDocumentTest)
+#include "assdocument_test.moc"
@@ -0,0 +1,89 @@
+/**
+ * @file assprocessor_test.cpp
+ * @brief Unit tests for AssProcessor: time spans with visible signs for the render path
+ */
+
+#include <QtTest/QtTest>
+#include <QByteArray>
+#include <QFile>
+#include <QList>
+#include <QString>
+#include <QTemporaryDir>
+
+#include "assprocessor.h"
+
+class AssProcessorTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testAssProcessor_detectsVisibleSignsIntervals();
+    void testAssProcessor_noIntervalsWithoutVisibleSigns();
+};
+
+namespace
+{
+bool writeFile(const QString& path, const QByteArray& data)
+{
+    QFile file(path);
+    return file.open(QIODevice::WriteOnly) && file.write(data) == data.size();
+}
+} // namespace
+
+/**
+ * @brief Test: drawable events are padded by a frame, sorted and merged; tag-only, comment and broken ones are skipped
+ */
+void AssProcessorTest::testAssProcessor_detectsVisibleSignsIntervals()
+{
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    const QString path = tempDir.filePath("signs.ass");
+    QVERIFY(writeFile(path, "[Script Info]\n"
+                            "PlayResX: 1920\n"
+                            "\n"
+                            "[Events]\n"
+                            "Format: Layer, Start, End, Style, Name, MarginL, MarginR, MarginV, Effect, Text\n"
+                            "Dialogue: 0,0:00:10.00,0:00:12.00,Sign,,0,0,0,,Вывеска\n"
+                            "Dialogue: 0,0:00:12.30,0:00:13.00,Sign,,0,0,0,,{\\fad(200,200)}Ещё одна\n"
+                            "Dialogue: 0,0:00:20.00,0:00:21.00,Sign,,0,0,0,,{\\pos(10,10)}\\N{\\an8}\n"
+                            "Comment: 0,0:00:30.00,0:00:31.00,Sign,,0,0,0,,Заметка\n"
+                            "Dialogue: 0,0:00:40.00,0:00:41.00,Sign,,0,0,0,,{\\p1}m 0 0 l 10 0 10 10{\\p0}\n"
+                            "Dialogue: 0,0:00:52.00,0:00:51.00,Sign,,0,0,0,,Наоборот\n"
+                            "Dialogue: 0,0:00:00.02,0:00:01.00,Sign,,0,0,0,,Раньше всех\n"));
+
+    const QList<TbSegment> merged = AssProcessor::detectActiveIntervalsFromFile(path);
+    QCOMPARE(merged.size(), qsizetype(3));
+    QCOMPARE(merged.at(0).startSeconds, 0.0);
+    QCOMPARE(merged.at(0).endSeconds, 1.05);
+    QCOMPARE(merged.at(1).startSeconds, 9.95);
+    QCOMPARE(merged.at(1).endSeconds, 13.05);
+    QCOMPARE(merged.at(2).startSeconds, 39.95);
+    QCOMPARE(merged.at(2).endSeconds, 41.05);
+
+    // Without merging the faded sign after a short gap is a span of its own
+    const QList<TbSegment> separate = AssProcessor::detectActiveIntervalsFromFile(path, 0.0);
+    QCOMPARE(separate.size(), qsizetype(4));
+    QCOMPARE(separate.at(1).endSeconds, 12.05);
+    QCOMPARE(separate.at(2).startSeconds, 12.25);
+}
+
+/**
+ * @brief Test: a signs file that draws nothing, or no file at all, gives no intervals
+ */
+void AssProcessorTest::testAssProcessor_noIntervalsWithoutVisibleSigns()
+{
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    const QString path = tempDir.filePath("empty_signs.ass");
+    QVERIFY(writeFile(path, "[Events]\n"
+                            "Format: Layer, Start, End, Style, Text\n"
+                            "Dialogue: 0,0:00:01.00,0:00:02.00,Sign,{\\an8\\pos(960,80)}\n"
+                            "Dialogue: 0,0:00:03.00,0:00:04.00,Sign,  \\N  \n"
+                            "Comment: 0,0:00:05.00,0:00:06.00,Sign,Только комментарий\n"));
+
+    QVERIFY(AssProcessor::detectActiveIntervalsFromFile(path).isEmpty());
+    QVERIFY(AssProcessor::detectActiveIntervalsFromFile(tempDir.filePath("missing.ass")).isEmpty());
+}
+
+QTEST_MAIN(AssProcessorTest)
+#include "assprocessor_test.moc"
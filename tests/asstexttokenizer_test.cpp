@@ -0,0 +1,214 @@
+/**
+ * @file asstexttokenizer_test.cpp
+ * @brief Unit tests for AssTextTokenizer, the single-pass ASS override tag tokenizer, and the font tag parsing
+ *        built on it, checked and timed against the previous regex implementation
+ */
+
+#include <QtTest/QtTest>
+#include <QRegularExpression>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+
+#include "asstexttokenizer.h"
+#include "fontfinder.h"
+
+class AssTextTokenizerTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testAssTextTokenizer_tokens();
+    void testParseInlineFontTags_matchesRegexImplementation();
+    void benchmarkParseInlineFontTags_regexVsTokenizer_data();
+    void benchmarkParseInlineFontTags_regexVsTokenizer();
+};
+
+namespace
+{
+// Previous QRegularExpression-based parseInlineFontTags, kept as a reference for equivalence and timing
+QSet<AssStyleInfo> regexParseInlineFontTags(const QString& text, const AssStyleInfo& baseStyle)
+{
+    QSet<AssStyleInfo> styles;
+    AssStyleInfo current = baseStyle;
+    QRegularExpression tagBlockRegex(R"(\{([^\}]*)\})");
+
+    auto firstMatch = tagBlockRegex.match(text);
+    bool hasTextBeforeFirstTag = !firstMatch.hasMatch() || firstMatch.capturedStart() > 0;
+    bool initialTagsHaveFontOverride = false;
+    if (!hasTextBeforeFirstTag)
+    {
+        auto it = tagBlockRegex.globalMatch(text);
+        qsizetype expectedPos = 0;
+        while (it.hasNext())
+        {
+            auto match = it.next();
+            if (match.capturedStart() != expectedPos)
+            {
+                break;
+            }
+            if (match.captured(1).contains("\\fn"))
+            {
+                initialTagsHaveFontOverride = true;
+                break;
+            }
+            expectedPos = match.capturedEnd();
+        }
+    }
+    if (!baseStyle.fontName.isEmpty() && (hasTextBeforeFirstTag || !initialTagsHaveFontOverride))
+    {
+        styles.insert(baseStyle);
+    }
+
+    auto it = tagBlockRegex.globalMatch(text);
+    while (it.hasNext())
+    {
+        auto match = it.next();
+        // Text before the first backslash is a comment for libass; the old code treated it as a tag
+        const QString block = match.captured(1);
+        const qsizetype firstTag = block.indexOf('\\');
+        const QStringList tags = firstTag < 0 ? QStringList() : block.mid(firstTag).split('\\', Qt::SkipEmptyParts);
+        bool fontChanged = false;
+        for (const QString& tag : tags)
+        {
+            if (tag.startsWith("fn"))
+            {
+                current.fontName = tag.mid(2).trimmed();
+                if (current.fontName.isEmpty())
+                {
+                    current.fontName = baseStyle.fontName;
+                }
+                fontChanged = true;
+            }
+            else if (tag.startsWith("b") && tag.size() > 1 && tag[1].isDigit())
+            {
+                const int weight = tag.mid(1).toInt();
+                current.bold = tag.mid(1) != "0" && (weight == 1 || weight >= 600);
+                fontChanged = true;
+            }
+            else if (tag.startsWith("i") && tag.size() > 1 && tag[1].isDigit())
+            {
+                current.italic = (tag.mid(1).toInt() != 0);
+                fontChanged = true;
+            }
+            else if (tag.startsWith("r"))
+            {
+                current = baseStyle;
+                fontChanged = true;
+            }
+        }
+        if (fontChanged && !current.fontName.isEmpty())
+        {
+            styles.insert(current);
+        }
+    }
+    return styles;
+}
+
+// Typeset lines: long override blocks, \t animations, \r resets, drawings and broken blocks
+QStringList typesetSamples()
+{
+    return {
+        R"({\an7\pos(412,88)\fnBrush Script\fs60\c&H1A1A1A&\blur0.6\t(0,300,\fscx110\b1)}Вывеска{\b0\i1} магазина)",
+        R"({=0=2}{\fad(120,0)\fnGaramond\b700}Глава{\r}\Nвторая строка{\fn\i0}конец)",
+        R"(Текст до блока{\fnOther}после{\b0}{\i1\fnThird}хвост)",
+        R"({\p1\bord0\shad0}m 0 0 l 100 0 100 100 0 100{\p0})",
+        R"({незакрытый блок \fnX текст)",
+        R"({}{\\}{\b1\\i1}двойные слэши{\fn   Spaced Font   })",
+        R"(Обычная реплика без тегов)",
+    };
+}
+} // namespace
+
+/**
+ * @brief Test: tokenizer yields blocks, tags, text and line breaks; unclosed '{' stays text
+ */
+void AssTextTokenizerTest::testAssTextTokenizer_tokens()
+{
+    const QString text = R"({comment\fnArial\b1}Hi\Nthere{\i1)";
+    AssTextTokenizer tokenizer(text);
+    AssTextToken token;
+
+    QStringList seen;
+    while (tokenizer.next(token))
+    {
+        switch (token.kind)
+        {
+        case AssTextToken::Kind::BlockStart:
+            seen << "{";
+            break;
+        case AssTextToken::Kind::BlockEnd:
+            seen << "}";
+            break;
+        case AssTextToken::Kind::Tag:
+            seen << "tag:" + token.text.toString();
+            break;
+        case AssTextToken::Kind::LineBreak:
+            seen << "br";
+            break;
+        case AssTextToken::Kind::Text:
+            seen << "text:" + token.text.toString();
+            break;
+        }
+    }
+
+    const QStringList expected = {"{", "tag:fnArial", "tag:b1", "}", "text:Hi", "br", "text:there", "text:{\\i1"};
+    QCOMPARE(seen, expected);
+
+    QVERIFY(!AssTextTokenizer::hasVisibleText(R"({\an8\pos(1,2)}\N{\fad(100,0)} )"));
+    QVERIFY(AssTextTokenizer::hasVisibleText(R"({\an8}\hx)"));
+}
+
+/**
+ * @brief Test: tokenizer-based parseInlineFontTags matches the regex implementation on typeset lines
+ */
+void AssTextTokenizerTest::testParseInlineFontTags_matchesRegexImplementation()
+{
+    AssStyleInfo baseStyle;
+    baseStyle.fontName = "Arial";
+
+    for (const QString& sample : typesetSamples())
+    {
+        QCOMPARE(FontFinder::parseInlineFontTags(sample, baseStyle), regexParseInlineFontTags(sample, baseStyle));
+    }
+}
+
+void AssTextTokenizerTest::benchmarkParseInlineFontTags_regexVsTokenizer_data()
+{
+    QTest::addColumn<bool>("tokenizer");
+    QTest::newRow("regex") << false;
+    QTest::newRow("tokenizer") << true;
+}
+
+/**
+ * @brief Benchmark: both parseInlineFontTags implementations over a typeset-heavy synthetic script
+ */
+void AssTextTokenizerTest::benchmarkParseInlineFontTags_regexVsTokenizer()
+{
+    QFETCH(bool, tokenizer);
+    AssStyleInfo baseStyle;
+    baseStyle.fontName = "Arial";
+
+    constexpr int kLines = 20000;
+    const QStringList samples = typesetSamples();
+    QStringList script;
+    script.reserve(kLines);
+    for (int i = 0; i < kLines; ++i)
+    {
+        script.append(samples.at(i % samples.size()));
+    }
+
+    qsizetype total = 0;
+    QBENCHMARK
+    {
+        for (const QString& line : std::as_const(script))
+        {
+            total += tokenizer ? FontFinder::parseInlineFontTags(line, baseStyle).size()
+                               : regexParseInlineFontTags(line, baseStyle).size();
+        }
+    }
+    QVERIFY(total > 0);
+}
+
+QTEST_MAIN(AssTextTokenizerTest)
+#include "asstexttokenizer_test.moc"
@@ -0,0 +1,38 @@
+/**
+ * @file asstime_test.cpp
+ * @brief Unit tests for AssTime parsing and ASS/SRT formatting
+ */
+
+#include <QtTest/QtTest>
+#include <QByteArray>
+
+#include "asstime.h"
+
+class AssTimeTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testAssTime_parseAndFormat();
+};
+
+/**
+ * @brief Test: AssTime accepts centiseconds and milliseconds, rejects garbage, formats ASS and SRT
+ */
+void AssTimeTest::testAssTime_parseAndFormat()
+{
+    QCOMPARE(AssTime::parse(" 0:01:02.34 ").ms, qint64(62340));
+    QCOMPARE(AssTime::parse("1:00:00.5").ms, qint64(3600500));
+    QCOMPARE(AssTime::parse("0:00:10.123").ms, qint64(10123));
+    QCOMPARE(AssTime::parse("0:00:10").ms, qint64(10000));
+    QVERIFY(!AssTime::parse("0:00").isValid());
+    QVERIFY(!AssTime::parse("0:00:1x.00").isValid());
+    QVERIFY(!AssTime::parse("").isValid());
+
+    QCOMPARE(AssTime(62349).toAss(), QByteArray("0:01:02.34"));
+    QCOMPARE(AssTime(62349).toSrt(), QByteArray("00:01:02,349"));
+    QCOMPARE(AssTime(123LL * 3600000).toSrt(), QByteArray("123:00:00,000"));
+}
+
+QTEST_MAIN(AssTimeTest)
+#include "asstime_test.moc"
@@ -0,0 +1,113 @@
+/**
+ * @file audiofingerprint_test.cpp
+ * @brief Unit tests for AudioFingerprint: learning an ending from chapters and finding it in other episodes
+ */
+
+#include <QtTest/QtTest>
+#include <QList>
+#include <QRandomGenerator>
+#include <QString>
+#include <QTemporaryDir>
+#include <QtMath>
+
+#include "audiofingerprint.h"
+
+#include <algorithm>
+#include <cmath>
+
+class AudioFingerprintTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testAudioFingerprint_findsLearnedEnding();
+};
+
+/**
+ * @brief Test: an ending learned from one episode's chapters is found in another episode and restores its chapters
+ */
+void AudioFingerprintTest::testAudioFingerprint_findsLearnedEnding()
+{
+    // Chords of three random tones changing every 100..300 ms, at 8 kHz
+    const int sampleRate = AudioFingerprint::kSampleRate;
+    const auto music = [sampleRate](quint32 seed, int seconds)
+    {
+        QRandomGenerator random(seed);
+        QList<float> samples(qsizetype(seconds) * sampleRate, 0.0f);
+        for (qsizetype i = 0; i < samples.size();)
+        {
+            const int length = random.bounded(800, 2400);
+            const double f1 = random.bounded(300, 2000);
+            const double f2 = random.bounded(300, 2000);
+            const double f3 = random.bounded(300, 2000);
+            for (int k = 0; k < length && i < samples.size(); ++k, ++i)
+            {
+                const double t = double(i) / sampleRate;
+                samples[i] = float(0.2 * (std::sin(2 * M_PI * f1 * t) + std::sin(2 * M_PI * f2 * t) +
+                                          0.5 * std::sin(2 * M_PI * f3 * t)));
+            }
+        }
+        return samples;
+    };
+
+    // Episode A has the 40 s ending at 45 s, episode B has it at 70 s, quieter and with noise
+    const QList<float> ending = music(99, 40);
+    QList<float> episodeA = music(1, 100);
+    std::copy(ending.cbegin(), ending.cend(), episodeA.begin() + 45 * sampleRate);
+    QList<float> episodeB = music(2, 120);
+    QRandomGenerator noise(3);
+    for (qsizetype i = 0; i < episodeB.size(); ++i)
+    {
+        if (i >= 70 * sampleRate && i < 110 * sampleRate)
+        {
+            episodeB[i] = 0.5f * ending.at(i - 70 * sampleRate);
+        }
+        episodeB[i] += 0.02f * float(noise.bounded(2.0) - 1.0);
+    }
+
+    const QList<quint32> hashesA = AudioFingerprint::computeHashes(episodeA.constData(), episodeA.size());
+    const QList<quint32> hashesB = AudioFingerprint::computeHashes(episodeB.constData(), episodeB.size());
+    QVERIFY(qAbs(hashesA.size() - 100 * sampleRate / AudioFingerprint::kHopSamples) < 10);
+
+    const qint64 second = 1000000000LL;
+    QList<ChapterMarker> chapters(3);
+    chapters[0].title = "Episode";
+    chapters[1].startNs = 45 * second;
+    chapters[1].endNs = 85 * second;
+    chapters[1].title = "Ending";
+    chapters[2].startNs = 85 * second;
+    chapters[2].title = "Preview";
+
+    FingerprintIndex learned;
+    QVERIFY(AudioFingerprint::learnChapters(learned, hashesA, chapters, QString()));
+    QCOMPARE(learned.segments.size(), qsizetype(1));
+    QCOMPARE(learned.endingSegment(), 0);
+
+    // The index survives a round trip through disk
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    const QString indexPath = tempDir.filePath("fingerprints/series.bin");
+    QVERIFY(AudioFingerprint::saveIndex(learned, indexPath));
+    const FingerprintIndex index = AudioFingerprint::loadIndex(indexPath);
+    QCOMPARE(index.segments.size(), qsizetype(1));
+    QCOMPARE(index.chapters.size(), qsizetype(3));
+    QCOMPARE(index.segments.at(0).hashes, learned.segments.at(0).hashes);
+
+    const QList<FingerprintMatch> matches = AudioFingerprint::match(index, hashesB);
+    QCOMPARE(matches.size(), qsizetype(1));
+    QVERIFY2(qAbs(matches.at(0).startS - 70.0) < 0.05, qPrintable(QString::number(matches.at(0).startS)));
+    QVERIFY(matches.at(0).score > 0.8);
+
+    const QList<ChapterMarker> restored = AudioFingerprint::buildChapters(index, matches, 120.0);
+    QCOMPARE(restored.size(), qsizetype(3));
+    QCOMPARE(restored.at(1).title, QString("Ending"));
+    QVERIFY(qAbs(restored.at(1).startNs - 70 * second) < second / 20);
+    QVERIFY(qAbs(restored.at(2).startNs - 110 * second) < second / 20);
+
+    // An episode without this ending gives no match
+    const QList<quint32> other = AudioFingerprint::computeHashes(music(4, 120).constData(), 120 * sampleRate);
+    QVERIFY(AudioFingerprint::match(index, other).isEmpty());
+}
+
+QTEST_MAIN(AudioFingerprintTest)
+#include "audiofingerprint_test.moc"
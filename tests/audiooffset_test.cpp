@@ -0,0 +1,61 @@
+/**
+ * @file audiooffset_test.cpp
+ * @brief Unit tests for AudioOffset, the dub-to-source offset search by onset cross-correlation
+ */
+
+#include <QtTest/QtTest>
+#include <QList>
+#include <QRandomGenerator>
+
+#include "audiooffset.h"
+
+class AudioOffsetTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testAudioOffset_findsShiftedOnsets();
+};
+
+/**
+ * @brief Test: cross-correlation of onset envelopes finds a 137 ms delay of a quieter, noisier copy
+ */
+void AudioOffsetTest::testAudioOffset_findsShiftedOnsets()
+{
+    // Noise bursts of random length and level separated by random gaps, 64 s at 8 kHz
+    const int sampleRate = 8000;
+    QRandomGenerator random(1);
+    QList<float> source(sampleRate * 64, 0.0f);
+    for (qsizetype i = 0; i < source.size();)
+    {
+        const int burst = random.bounded(200, 2200);
+        const float level = 0.1f + float(random.bounded(1.0));
+        for (int k = 0; k < burst && i < source.size(); ++k, ++i)
+        {
+            source[i] = level * float(random.bounded(2.0) - 1.0);
+        }
+        i += random.bounded(100, 3100);
+    }
+
+    // The reference covers 2..62 s; the candidate covers 0..64 s and lags by 137 ms
+    const int delayMs = 137;
+    const QList<float> reference = source.mid(2 * sampleRate, 60 * sampleRate);
+    QList<float> candidate(source.size(), 0.0f);
+    for (qsizetype t = delayMs * sampleRate / 1000; t < candidate.size(); ++t)
+    {
+        candidate[t] = 0.5f * source.at(t - delayMs * sampleRate / 1000) + 0.05f * float(random.bounded(2.0) - 1.0);
+    }
+
+    const QList<float> referenceEnvelope =
+        AudioOffset::onsetEnvelope(reference.constData(), reference.size(), sampleRate);
+    const QList<float> candidateEnvelope =
+        AudioOffset::onsetEnvelope(candidate.constData(), candidate.size(), sampleRate);
+    QCOMPARE(referenceEnvelope.size(), qsizetype(60 * AudioOffset::kEnvelopeRate));
+
+    const AudioOffsetWindow window = AudioOffset::correlate(referenceEnvelope, candidateEnvelope, 2000);
+    QCOMPARE(window.offsetMs, delayMs);
+    QVERIFY(window.score > 0.3);
+}
+
+QTEST_MAIN(AudioOffsetTest)
+#include "audiooffset_test.moc"
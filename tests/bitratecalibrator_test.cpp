@@ -0,0 +1,90 @@
+/**
+ * @file bitratecalibrator_test.cpp
+ * @brief Unit tests for BitrateCalibrator: rate option scaling and the bitrate curve fit
+ */
+
+#include <QtTest/QtTest>
+#include <QString>
+#include <QStringList>
+
+#include <cmath>
+
+#include "bitratecalibrator.h"
+
+class BitrateCalibratorTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testBitrateCalibrator_scalesAllRateOptions();
+    void testBitrateCalibrator_fitsExponentAndFactor();
+    void testBitrateCalibrator_isApplicableToSinglePassVbr();
+};
+
+/**
+ * @brief Test: -b:v, -minrate, -maxrate and -bufsize are scaled together, audio and other numbers are left alone
+ */
+void BitrateCalibratorTest::testBitrateCalibrator_scalesAllRateOptions()
+{
+    const QString nvenc = "ffmpeg -i \"%INPUT%\" -c:v hevc_nvenc -rc vbr -b:v 4M -minrate 4M -maxrate 8M "
+                          "-bufsize 16M -rc-lookahead 32 -multipass 2 -c:a aac -b:a 256k \"%OUTPUT%\"";
+    QCOMPARE(BitrateCalibrator::scaleRateOptions(nvenc, 0.8),
+             QString("ffmpeg -i \"%INPUT%\" -c:v hevc_nvenc -rc vbr -b:v 3200k -minrate 3200k -maxrate 6400k "
+                     "-bufsize 12800k -rc-lookahead 32 -multipass 2 -c:a aac -b:a 256k \"%OUTPUT%\""));
+
+    // QSV keeps -minrate just under -b:v; after scaling it must still be under it
+    const QString qsv = "-c:v hevc_qsv -b:v 4150k -minrate 4100k -maxrate 8000k -bufsize 8000k -g 48";
+    QCOMPARE(BitrateCalibrator::scaleRateOptions(qsv, 1.2),
+             QString("-c:v hevc_qsv -b:v 4980k -minrate 4920k -maxrate 9600k -bufsize 9600k -g 48"));
+
+    const QStringList args{"-c:v", "hevc_nvenc", "-b:v", "4M", "-minrate", "4M", "-maxrate", "8M",
+                           "-b:a", "256k", "out.mp4"};
+    QCOMPARE(BitrateCalibrator::scaleRateArgs(args, 0.7),
+             (QStringList{"-c:v", "hevc_nvenc", "-b:v", "2800k", "-minrate", "2800k", "-maxrate", "5600k", "-b:a",
+                          "256k", "out.mp4"}));
+}
+
+/**
+ * @brief Test: the power-law exponent is recovered from two samples and clamped, the factor hits the target
+ */
+void BitrateCalibratorTest::testBitrateCalibrator_fitsExponentAndFactor()
+{
+    // bitrate = a * setting^0.8 sampled at the preset -b:v and at 0.7 of it
+    QCOMPARE(BitrateCalibrator::fitExponent(5000.0, 5000.0 * std::pow(0.7, 0.8), 0.7), 0.8);
+    QCOMPARE(BitrateCalibrator::fitExponent(5000.0, 5000.0 * std::pow(0.7, 3.0), 0.7), 1.5);
+    QCOMPARE(BitrateCalibrator::fitExponent(5000.0, 5000.0, 0.7), 0.3);
+    QCOMPARE(BitrateCalibrator::fitExponent(0.0, 3000.0, 0.7), 1.0);
+
+    QCOMPARE(BitrateCalibrator::correctionFactor(4000.0, 5000.0, 1.0), 0.8);
+    QCOMPARE(BitrateCalibrator::correctionFactor(4000.0, 5000.0, 0.5), 0.64);
+    QCOMPARE(BitrateCalibrator::correctionFactor(4000.0, 1000.0, 1.0), 2.0);
+    QCOMPARE(BitrateCalibrator::correctionFactor(4000.0, 20000.0, 1.0), 0.5);
+    QCOMPARE(BitrateCalibrator::correctionFactor(4000.0, 0.0, 1.0), 1.0);
+}
+
+/**
+ * @brief Test: only single-pass presets with a target and an explicit -b:v on long enough video are calibrated
+ */
+void BitrateCalibratorTest::testBitrateCalibrator_isApplicableToSinglePassVbr()
+{
+    RenderPreset preset;
+    preset.commandPass1 = "ffmpeg -i \"%INPUT%\" -c:v hevc_nvenc -b:v 4M -maxrate 8M \"%OUTPUT%\"";
+    preset.targetBitrateKbps = 4000;
+    QVERIFY(BitrateCalibrator::isApplicable(preset, 1440.0));
+    QVERIFY(!BitrateCalibrator::isApplicable(preset, 60.0));
+
+    RenderPreset noTarget = preset;
+    noTarget.targetBitrateKbps = 0;
+    QVERIFY(!BitrateCalibrator::isApplicable(noTarget, 1440.0));
+
+    RenderPreset constantQuality = preset;
+    constantQuality.commandPass1 = "ffmpeg -i \"%INPUT%\" -c:v hevc_nvenc -cq 20 \"%OUTPUT%\"";
+    QVERIFY(!BitrateCalibrator::isApplicable(constantQuality, 1440.0));
+
+    RenderPreset twoPass = preset;
+    twoPass.commandPass2 = preset.commandPass1;
+    QVERIFY(!BitrateCalibrator::isApplicable(twoPass, 1440.0));
+}
+
+QTEST_MAIN(BitrateCalibratorTest)
+#include "bitratecalibrator_test.moc"
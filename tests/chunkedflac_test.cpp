@@ -0,0 +1,313 @@
+/**
+ * @file chunkedflac_test.cpp
+ * @brief Unit tests for ChunkedFlac, stitching FLAC chunks encoded in parallel into one stream
+ */
+
+#include <QtTest/QtTest>
+#include <QByteArray>
+#include <QDataStream>
+#include <QFile>
+#include <QList>
+#include <QPair>
+#include <QProcess>
+#include <QStandardPaths>
+#include <QString>
+#include <QStringList>
+#include <QTemporaryDir>
+#include <QtEndian>
+
+#include <cmath>
+
+#include "chunkedflac.h"
+
+class ChunkedFlacTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testChunkedFlac_stitchesChunksIntoOneStream();
+    void testChunkedFlac_acceptsPerFrameStereoDecorrelation();
+    void testChunkedFlac_encodeMatchesReferenceEncode_data();
+    void testChunkedFlac_encodeMatchesReferenceEncode();
+};
+
+namespace
+{
+quint8 crc8(const QByteArray& bytes)
+{
+    quint8 crc = 0;
+    for (char byte : bytes)
+    {
+        crc ^= quint8(byte);
+        for (int bit = 0; bit < 8; ++bit)
+        {
+            crc = quint8((crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1);
+        }
+    }
+    return crc;
+}
+
+quint16 crc16(const QByteArray& bytes)
+{
+    quint16 crc = 0;
+    for (char byte : bytes)
+    {
+        crc ^= quint16(quint8(byte) << 8);
+        for (int bit = 0; bit < 8; ++bit)
+        {
+            crc = quint16((crc & 0x8000) ? (crc << 1) ^ 0x8005 : crc << 1);
+        }
+    }
+    return crc;
+}
+
+/// Two CONSTANT subframes of \a value; the side channel of codes 8..10 is zero and one bit wider.
+QByteArray stereoSubframes(int channelCode, int value)
+{
+    const bool sideFirst = channelCode == 9;
+    const bool hasSide = channelCode >= 8;
+    QList<QPair<int, int>> subframes; // value, bits
+    for (int channel = 0; channel < 2; ++channel)
+    {
+        const bool side = hasSide && (channel == 0) == sideFirst;
+        subframes.append({side ? 0 : value, side ? 17 : 16});
+    }
+    QByteArray out;
+    quint64 accumulator = 0;
+    int bits = 0;
+    const auto put = [&](quint64 field, int width)
+    {
+        accumulator = accumulator << width | (field & ((quint64(1) << width) - 1));
+        for (bits += width; bits >= 8; bits -= 8)
+        {
+            out.append(char(accumulator >> (bits - 8)));
+        }
+    };
+    for (const auto& [subframeValue, width] : subframes)
+    {
+        put(0, 8); // zero pad bit, SUBFRAME_CONSTANT, no wasted bits
+        put(quint64(subframeValue), width);
+    }
+    if (bits > 0)
+    {
+        put(0, 8 - bits);
+    }
+    return out;
+}
+
+/**
+ * 48 kHz, 16 bit stereo chunk; every frame holds CONSTANT subframes with the frame's own value.
+ * Frame n uses channel assignment channelCodes[n % size], as ffmpeg picks one per frame.
+ */
+QByteArray makeFlacChunk(int fullFrames, int lastFrameSamples, int firstValue, const QList<int>& channelCodes = {1})
+{
+    QByteArray flac("fLaC");
+    const qint64 samples = qint64(fullFrames) * ChunkedFlac::kBlockSize + lastFrameSamples;
+    flac.append(char(0x80)).append(char(0)).append(char(0)).append(char(34));
+    flac.append(QByteArray::fromHex("10001000000000000000"));
+    const quint64 packed = quint64(48000) << 44 | quint64(1) << 41 | quint64(15) << 36 | quint64(samples);
+    for (int shift = 56; shift >= 0; shift -= 8)
+    {
+        flac.append(char(packed >> shift));
+    }
+    flac.append(QByteArray(16, '\0'));
+    for (int number = 0; number < fullFrames + (lastFrameSamples > 0 ? 1 : 0); ++number)
+    {
+        const bool partial = number == fullFrames;
+        const int channelCode = channelCodes.at(number % channelCodes.size());
+        QByteArray frame = QByteArray::fromHex(partial ? "fff87a" : "fff8ca");
+        frame.append(char(channelCode << 4 | 0x08)); // 16 bit
+        if (number < 0x80)
+        {
+            frame.append(char(number));
+        }
+        else
+        {
+            frame.append(char(0xC0 | number >> 6)).append(char(0x80 | (number & 0x3F)));
+        }
+        if (partial)
+        {
+            frame.append(char((lastFrameSamples - 1) >> 8)).append(char((lastFrameSamples - 1) & 0xFF));
+        }
+        frame.append(char(crc8(frame)));
+        frame.append(stereoSubframes(channelCode, firstValue + number));
+        const quint16 crc = crc16(frame);
+        flac.append(frame).append(char(crc >> 8)).append(char(crc & 0xFF));
+    }
+    return flac;
+}
+
+bool writeFile(const QString& path, const QByteArray& data)
+{
+    QFile file(path);
+    return file.open(QIODevice::WriteOnly) && file.write(data) == data.size();
+}
+
+/// 16 bit stereo WAV with pseudo-random samples: every misplaced sample changes the MD5
+QByteArray makeNoiseWav(int sampleRate, int frames)
+{
+    QByteArray pcm(qsizetype(frames) * 4, Qt::Uninitialized);
+    auto* out = reinterpret_cast<qint16*>(pcm.data());
+    quint32 state = 12345;
+    for (int i = 0; i < frames * 2; ++i)
+    {
+        state = state * 1664525u + 1013904223u;
+        out[i] = qToLittleEndian(static_cast<qint16>(state >> 18)); // 14 bit, about -6 dBFS
+    }
+
+    QByteArray wav;
+    QDataStream stream(&wav, QIODevice::WriteOnly);
+    stream.setByteOrder(QDataStream::LittleEndian);
+    stream.writeRawData("RIFF", 4);
+    stream << quint32(36 + pcm.size());
+    stream.writeRawData("WAVEfmt ", 8);
+    stream << quint32(16) << quint16(1) << quint16(2) << quint32(sampleRate) << quint32(sampleRate * 4)
+           << quint16(4) << quint16(16);
+    stream.writeRawData("data", 4);
+    stream << quint32(pcm.size());
+    return wav + pcm;
+}
+
+/// MD5 of the audio decoded by ffmpeg, empty on failure
+QByteArray decodedMd5(const QString& ffmpegPath, const QString& path)
+{
+    QProcess ffmpeg;
+    ffmpeg.start(ffmpegPath, {"-v", "error", "-nostdin", "-i", path, "-c:a", "pcm_s16le", "-f", "md5", "-"});
+    if (!ffmpeg.waitForFinished(60000) || ffmpeg.exitCode() != 0)
+    {
+        return {};
+    }
+    const QByteArray output = ffmpeg.readAllStandardOutput().trimmed();
+    return output.startsWith("MD5=") ? output.mid(4) : QByteArray();
+}
+
+/// MD5 from STREAMINFO, which always follows the "fLaC" marker and the block header
+QByteArray streamInfoMd5(const QString& path)
+{
+    QFile file(path);
+    return file.open(QIODevice::ReadOnly) ? file.read(42).mid(26, 16) : QByteArray();
+}
+} // namespace
+
+/**
+ * @brief Test: FLAC chunks are stitched into one stream with renumbered frames, fresh CRCs, STREAMINFO and SEEKTABLE
+ */
+void ChunkedFlacTest::testChunkedFlac_stitchesChunksIntoOneStream()
+{
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    // Frame numbers of the first chunk already take two bytes, the second chunk's ones grow from one to two
+    const QStringList chunks{tempDir.filePath("0.flac"), tempDir.filePath("1.flac")};
+    QVERIFY(writeFile(chunks.at(0), makeFlacChunk(130, 0, 0)));
+    QVERIFY(writeFile(chunks.at(1), makeFlacChunk(5, 1000, 130)));
+
+    const QByteArray md5 = QByteArray::fromHex("00112233445566778899aabbccddeeff");
+    const QString stitchedPath = tempDir.filePath("out/stitched.flac");
+    const ChunkedFlacResult result = ChunkedFlac::stitch(chunks, stitchedPath, md5);
+    QVERIFY2(result.ok, qPrintable(result.errorString));
+    QCOMPARE(result.chunks, 2);
+    const qint64 totalSamples = 135 * ChunkedFlac::kBlockSize + 1000;
+    QCOMPARE(result.totalSamples, totalSamples);
+    QCOMPARE(result.seekPoints, 2);
+    QVERIFY(result.hasMd5);
+
+    QFile stitched(stitchedPath);
+    QVERIFY(stitched.open(QIODevice::ReadOnly));
+    const QByteArray bytes = stitched.readAll();
+    QCOMPARE(bytes.mid(8, 4), QByteArray::fromHex("10001000"));
+    QCOMPARE(bytes.mid(26, 16), md5);
+    QCOMPARE(quint8(bytes.at(42)) & 0x7F, 3); // SEEKTABLE right after STREAMINFO
+
+    // The result parses back as a single chunk: sequential frame numbers and valid CRCs throughout
+    const ChunkedFlacResult reparsed = ChunkedFlac::stitch({stitchedPath}, tempDir.filePath("again.flac"), md5);
+    QVERIFY2(reparsed.ok, qPrintable(reparsed.errorString));
+    QCOMPARE(reparsed.totalSamples, totalSamples);
+
+    // A damaged chunk is rejected instead of being glued in
+    QFile damaged(chunks.at(1));
+    QVERIFY(damaged.open(QIODevice::ReadWrite));
+    damaged.seek(damaged.size() - 4);
+    damaged.write("\x55", 1);
+    damaged.close();
+    QVERIFY(!ChunkedFlac::stitch(chunks, tempDir.filePath("broken.flac")).ok);
+}
+
+/**
+ * @brief Test: frames switching between independent, left/side, right/side and mid/side stereo are one stream
+ */
+void ChunkedFlacTest::testChunkedFlac_acceptsPerFrameStereoDecorrelation()
+{
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    const QList<int> channelCodes{1, 8, 9, 10, 10, 1};
+    const QStringList chunks{tempDir.filePath("0.flac"), tempDir.filePath("1.flac")};
+    QVERIFY(writeFile(chunks.at(0), makeFlacChunk(12, 0, 0, channelCodes)));
+    QVERIFY(writeFile(chunks.at(1), makeFlacChunk(7, 300, 12, {10, 9, 8, 1})));
+
+    const ChunkedFlacResult result = ChunkedFlac::stitch(chunks, tempDir.filePath("stitched.flac"));
+    QVERIFY2(result.ok, qPrintable(result.errorString));
+    QCOMPARE(result.totalSamples, qint64(19) * ChunkedFlac::kBlockSize + 300);
+
+    // Renumbered frames keep their channel assignment and still chain as one stream
+    const ChunkedFlacResult reparsed =
+        ChunkedFlac::stitch({tempDir.filePath("stitched.flac")}, tempDir.filePath("again.flac"));
+    QVERIFY2(reparsed.ok, qPrintable(reparsed.errorString));
+    QCOMPARE(reparsed.totalSamples, result.totalSamples);
+}
+
+void ChunkedFlacTest::testChunkedFlac_encodeMatchesReferenceEncode_data()
+{
+    QTest::addColumn<int>("offsetMs");
+    QTest::newRow("no offset") << 0;
+    QTest::newRow("cut start") << 250;
+    QTest::newRow("leading silence") << -120;
+}
+
+/**
+ * @brief Test: encode() in parallel chunks gives the same audio and STREAMINFO MD5 as one ffmpeg encode
+ *
+ * Every chunk after the first is seeked into, so the chunk boundaries must be taken from the file start
+ */
+void ChunkedFlacTest::testChunkedFlac_encodeMatchesReferenceEncode()
+{
+    const QString ffmpegPath = QStandardPaths::findExecutable("ffmpeg");
+    if (ffmpegPath.isEmpty())
+    {
+        QSKIP("ffmpeg not found in PATH");
+    }
+    QFETCH(int, offsetMs);
+
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    const int sampleRate = 48000;
+    const int frames = sampleRate * 20 + 777;
+    const QString wavPath = tempDir.filePath("dub.wav");
+    QVERIFY(writeFile(wavPath, makeNoiseWav(sampleRate, frames)));
+
+    const QString stitchedPath = tempDir.filePath("chunked.flac");
+    const ChunkedFlacResult result = ChunkedFlac::encode(ffmpegPath, wavPath, 4, offsetMs, 0.0, stitchedPath);
+    QVERIFY2(result.ok, qPrintable(result.errorString));
+    QCOMPARE(result.chunks, 4);
+    const qint64 shift = std::llround(offsetMs * double(sampleRate) / 1000.0);
+    QCOMPARE(result.totalSamples, frames - shift);
+    QVERIFY(result.hasMd5);
+
+    // The same shift as the single-process path applies it
+    const QString shiftFilter = shift > 0   ? QString("atrim=start_sample=%1,asetpts=PTS-STARTPTS").arg(shift)
+                                : shift < 0 ? QString("adelay=%1S:all=1").arg(-shift)
+                                            : QString("anull");
+    const QString referencePath = tempDir.filePath("reference.flac");
+    QProcess reference;
+    reference.start(ffmpegPath, {"-v", "error", "-nostdin", "-i", wavPath, "-af", shiftFilter, "-c:a", "flac",
+                                 referencePath});
+    QVERIFY(reference.waitForFinished(60000));
+    QCOMPARE(reference.exitCode(), 0);
+
+    const QByteArray referenceMd5 = decodedMd5(ffmpegPath, referencePath);
+    QVERIFY(!referenceMd5.isEmpty());
+    QCOMPARE(decodedMd5(ffmpegPath, stitchedPath), referenceMd5);
+    QCOMPARE(streamInfoMd5(stitchedPath), streamInfoMd5(referencePath));
+}
+
+QTEST_MAIN(ChunkedFlacTest)
+#include "chunkedflac_test.moc"
@@ -0,0 +1,97 @@
+/**
+ * @file filestager_test.cpp
+ * @brief Unit tests for FileStager: placing user files by rename, reflink, hardlink or copy
+ */
+
+#include <QtTest/QtTest>
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+#include <QTemporaryDir>
+
+#include "filestager.h"
+
+class FileStagerTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testFileStager_stagesByMode();
+    void testFileStager_reportsMissingSource();
+};
+
+namespace
+{
+bool writeFile(const QString& path, const QByteArray& data)
+{
+    QFile file(path);
+    return file.open(QIODevice::WriteOnly) && file.write(data) == data.size();
+}
+
+QByteArray readFile(const QString& path)
+{
+    QFile file(path);
+    return file.open(QIODevice::ReadOnly) ? file.readAll() : QByteArray();
+}
+} // namespace
+
+/**
+ * @brief Test: Move renames, Copy gives an independent file, ReadOnlyCopy keeps the source; the target is replaced
+ */
+void FileStagerTest::testFileStager_stagesByMode()
+{
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    const QByteArray data(3 * 1024 * 1024 + 17, '\x3C');
+    const QString source = tempDir.filePath("source.wav");
+    QVERIFY(writeFile(source, data));
+
+    // Copy: whatever the strategy, writing to the copy must not touch the source
+    const QString copy = tempDir.filePath("copy.wav");
+    QVERIFY(writeFile(copy, "stale target"));
+    const StageResult copied = FileStager::stageFile(source, copy, StageMode::Copy);
+    QVERIFY2(copied.ok, qPrintable(copied.errorString));
+    QVERIFY(copied.strategy == StageStrategy::Reflink || copied.strategy == StageStrategy::Copy);
+    QCOMPARE(copied.bytes, qint64(data.size()));
+    QCOMPARE(readFile(copy), data);
+    QVERIFY(writeFile(copy, "changed"));
+    QCOMPARE(readFile(source), data);
+
+    // ReadOnlyCopy may share the data, but never takes the source away
+    const QString shared = tempDir.filePath("shared.wav");
+    const StageResult linked = FileStager::stageFile(source, shared, StageMode::ReadOnlyCopy);
+    QVERIFY2(linked.ok, qPrintable(linked.errorString));
+    QVERIFY(linked.strategy != StageStrategy::Rename);
+    QCOMPARE(readFile(shared), data);
+    QVERIFY(QFile::exists(source));
+
+    // Move within one directory is a rename
+    const QString moved = tempDir.filePath("moved.wav");
+    const StageResult renamed = FileStager::stageFile(source, moved, StageMode::Move);
+    QVERIFY2(renamed.ok, qPrintable(renamed.errorString));
+    QVERIFY(renamed.strategy == StageStrategy::Rename);
+    QVERIFY(!QFile::exists(source));
+    QCOMPARE(readFile(moved), data);
+    QVERIFY(FileStager::describe(renamed).startsWith("rename, 3.0 МиБ за "));
+}
+
+/**
+ * @brief Test: a missing source fails without creating or removing the target
+ */
+void FileStagerTest::testFileStager_reportsMissingSource()
+{
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    const QString target = tempDir.filePath("target.wav");
+    QVERIFY(writeFile(target, "keep"));
+
+    const StageResult result = FileStager::stageFile(tempDir.filePath("missing.wav"), target, StageMode::Copy);
+    QVERIFY(!result.ok);
+    QVERIFY(result.strategy == StageStrategy::None);
+    QVERIFY(!result.errorString.isEmpty());
+    QCOMPARE(readFile(target), QByteArray("keep"));
+    QCOMPARE(FileStager::strategyName(result.strategy), QString("none"));
+}
+
+QTEST_MAIN(FileStagerTest)
+#include "filestager_test.moc"
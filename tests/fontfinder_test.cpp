@@ -12,6 +12,7 @@
 #include <QFile>
 #include <QSet>
 #include <QString>
+#include <QThread>
 
 #include "fontfinder.h"
 
@@ -41,6 +42,10 @@ private slots:
     void testParseAssFile_italicStyleMissing();
     void testParseAssFile_multipleInlineFonts();
     void testParseAssFile_inlineFnOverride();
+    void testFindFontsInSubs_asyncDeduplicatedResult();
+
+    // collectGlyphUsage tests
+    void testCollectGlyphUsage_perStyleCodepoints();
 
     // findSystemFont tests (Windows-only, uses DirectWrite API)
     void testFindSystemFont_standardWindowsFonts();
@@ -511,6 +516,82 @@ void FontFinderTest::testParseAssFile_inlineFnOverride()
     }
 }
 
+/**
+ * @brief Test: findFontsInSubs() returns immediately and delivers one deduplicated result in the caller thread
+ */
+void FontFinderTest::testFindFontsInSubs_asyncDeduplicatedResult()
+{
+    const QStringList files = {testDataPath("inline_fn_override.ass"), testDataPath("multiple_inline_fonts.ass"),
+                               testDataPath("consecutive_tag_blocks.ass")};
+    for (const QString& file : files)
+    {
+        if (!QFile::exists(file))
+        {
+            QSKIP("Test file not found - run cmake to copy test data");
+        }
+    }
+
+    FontFinder finder;
+    bool delivered = false;
+    bool deliveredInCallerThread = false;
+    FontFinderResult result;
+    connect(&finder, &FontFinder::finished, this,
+            [&](const FontFinderResult& r)
+            {
+                delivered = true;
+                deliveredInCallerThread = QThread::currentThread() == thread();
+                result = r;
+            });
+
+    finder.findFontsInSubs(files);
+    QVERIFY(!delivered);
+    QTRY_VERIFY_WITH_TIMEOUT(delivered, 60000);
+    QVERIFY(deliveredInCallerThread);
+
+    // Belepotan RUS is a release font, not a system one
+    QVERIFY(result.notFoundFontNames.contains("Belepotan RUS", Qt::CaseInsensitive));
+
+    QSet<QString> paths;
+    QSet<QString> foundFamilies;
+    for (const FoundFontInfo& found : result.foundFonts)
+    {
+        QVERIFY2(!paths.contains(found.path), qPrintable("Duplicate path: " + found.path));
+        paths.insert(found.path);
+        foundFamilies.insert(found.familyName.toCaseFolded());
+    }
+    QSet<QString> missingFamilies;
+    for (const QString& name : result.notFoundFontNames)
+    {
+        QVERIFY2(!missingFamilies.contains(name.toCaseFolded()), qPrintable("Duplicate missing font: " + name));
+        QVERIFY2(!foundFamilies.contains(name.toCaseFolded()), qPrintable("Found and missing at once: " + name));
+        missingFamilies.insert(name.toCaseFolded());
+    }
+}
+
+// ============================================================================
+// collectGlyphUsage tests
+// ============================================================================
+
+/**
+ * @brief Test: codepoints are attributed to the style active at each text run
+ */
+void FontFinderTest::testCollectGlyphUsage_perStyleCodepoints()
+{
+    AssStyleInfo base;
+    base.fontName = "Arial";
+
+    GlyphUsage usage;
+    FontFinder::collectGlyphUsage("Да\\hнет{\\fnComic\\b1}Ж\\Nё{\\r}Q {\\p1}m 0 0 l 10 10{\\p0}Z\u200B", base, usage);
+
+    AssStyleInfo comicBold;
+    comicBold.fontName = "Comic";
+    comicBold.bold = true;
+
+    QCOMPARE(usage.size(), 2);
+    QCOMPARE(usage.value(base), (QSet<char32_t>{U'Д', U'а', U'н', U'е', U'т', U'Q', U'Z'}));
+    QCOMPARE(usage.value(comicBold), (QSet<char32_t>{U'Ж', U'ё'}));
+}
+
 // ============================================================================
 // findSystemFont tests (Windows-only, uses DirectWrite API)
 // ============================================================================
@@ -0,0 +1,118 @@
+/**
+ * @file fontindex_test.cpp
+ * @brief Unit tests for FontIndex: sfnt parsing, libass-like face matching and the on-disk cache
+ */
+
+#include <QtTest/QtTest>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QString>
+#include <QTemporaryDir>
+
+#include "fontindex.h"
+#include "testfonts.h"
+
+class FontIndexTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testFontIndex_matchesLikeLibassAndReusesCache();
+    void testFontIndex_glyphCoverageFromCmap();
+};
+
+/**
+ * @brief Test: sfnt tables are parsed, faces are picked like libass, unchanged files come from the cache
+ */
+void FontIndexTest::testFontIndex_matchesLikeLibassAndReusesCache()
+{
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    const QString fontDir = tempDir.filePath("fonts");
+    QVERIFY(QDir().mkpath(fontDir));
+
+    auto writeFile = [&fontDir](const QString& name, const QByteArray& data)
+    {
+        QFile file(QDir(fontDir).filePath(name));
+        return file.open(QIODevice::WriteOnly) && file.write(data) == data.size();
+    };
+    // File names deliberately say nothing about the family
+    QVERIFY(writeFile("a.ttf", TestFonts::makeSfntFont("Test Sans", "Test Sans", 400, false)));
+    QVERIFY(writeFile("b.TTF", TestFonts::makeSfntFont("Test Sans", "Test Sans Bold", 700, false)));
+    QVERIFY(writeFile("c.otf", TestFonts::makeSfntFont("Test Sans", "Test Sans Italic", 400, true)));
+    QVERIFY(writeFile("broken.ttf", QByteArray("not a font at all")));
+
+    const QString cachePath = tempDir.filePath("cache/font_index.bin");
+    FontIndex index(cachePath);
+    FontIndex::ScanStats stats = index.scanDirectories({fontDir});
+    QCOMPARE(stats.files, 4);
+    QCOMPARE(stats.parsed, 3);
+    QCOMPARE(stats.failed, 1);
+    QCOMPARE(index.faceCount(), 3);
+
+    auto matchedFile = [&index](const QString& family, bool bold, bool italic)
+    {
+        const FontFace* face = index.match(family, bold, italic);
+        return face == nullptr ? QString() : QFileInfo(face->path).fileName();
+    };
+    QCOMPARE(matchedFile("Test Sans", false, false), QString("a.ttf"));
+    QCOMPARE(matchedFile("test sans", true, false), QString("b.TTF"));
+    QCOMPARE(matchedFile("@TEST SANS", false, true), QString("c.otf"));
+    // Weight difference (300) outweighs slant difference (100), as in libass
+    QCOMPARE(matchedFile("Test Sans", true, true), QString("b.TTF"));
+    QCOMPARE(matchedFile("Test Sans Bold", false, false), QString("b.TTF"));
+    QVERIFY(matchedFile("Missing Family", false, false).isEmpty());
+
+    QVERIFY(index.save());
+    QVERIFY(QFileInfo::exists(cachePath));
+
+    FontIndex reloaded(cachePath);
+    stats = reloaded.scanDirectories({fontDir});
+    QCOMPARE(stats.files, 4);
+    QCOMPARE(stats.reused, 4);
+    QCOMPARE(stats.parsed, 0);
+    QCOMPARE(reloaded.faceCount(), 3);
+    QVERIFY(reloaded.match("Test Sans", true, false) != nullptr);
+}
+
+/**
+ * @brief Test: cmap coverage is read into bitsets and persisted with the index
+ */
+void FontIndexTest::testFontIndex_glyphCoverageFromCmap()
+{
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    const QString fontDir = tempDir.filePath("fonts");
+    QVERIFY(QDir().mkpath(fontDir));
+    const QString fontPath = QDir(fontDir).filePath("latin.ttf");
+    {
+        QFile file(fontPath);
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write(TestFonts::makeSfntFont("Latin Only", "Latin Only", 400, false, "ABCabc Ё"));
+    }
+
+    const QString cachePath = tempDir.filePath("font_index.bin");
+    FontIndex index(cachePath);
+    index.scanDirectories({fontDir});
+    GlyphCoverage coverage = index.coverage(fontPath, 0);
+    QVERIFY(!coverage.isEmpty());
+    QVERIFY(coverage.contains(U'A'));
+    QVERIFY(coverage.contains(U'c'));
+    QVERIFY(coverage.contains(U'Ё'));
+    QVERIFY(!coverage.contains(U'D'));
+    QVERIFY(!coverage.contains(U'ж'));
+    QVERIFY(!coverage.contains(0x1F600));
+    QVERIFY(index.save());
+
+    // The file is gone, so the second coverage can only come from the cache
+    FontIndex reloaded(cachePath);
+    reloaded.scanDirectories({fontDir});
+    QVERIFY(QFile::remove(fontPath));
+    coverage = reloaded.coverage(fontPath, 0);
+    QVERIFY(coverage.contains(U'Ё'));
+    QVERIFY(!coverage.contains(U'ж'));
+}
+
+QTEST_MAIN(FontIndexTest)
+#include "fontindex_test.moc"
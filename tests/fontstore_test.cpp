@@ -0,0 +1,129 @@
+/**
+ * @file fontstore_test.cpp
+ * @brief Unit tests for FontStore, the content-addressed font store shared by episodes
+ */
+
+#include <QtTest/QtTest>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QString>
+#include <QTemporaryDir>
+
+#include "fontindex.h"
+#include "fontstore.h"
+#include "testfonts.h"
+
+class FontStoreTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testFontStore_sharesFontsAcrossEpisodes();
+    void testFontStore_prunesFontsUnusedByEpisodes();
+};
+
+/**
+ * @brief Test: the same font is stored once and parsed once for every episode that links to it
+ */
+void FontStoreTest::testFontStore_sharesFontsAcrossEpisodes()
+{
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    const QString storeDir = tempDir.filePath("store");
+    const QString episode1 = tempDir.filePath("ep01/attached_fonts");
+    const QString episode2 = tempDir.filePath("ep02/attached_fonts");
+    QVERIFY(QDir().mkpath(episode1));
+    QVERIFY(QDir().mkpath(episode2));
+
+    const QByteArray font = TestFonts::makeSfntFont("Shared Sans", "Shared Sans", 400, false);
+    const auto* data = reinterpret_cast<const uchar*>(font.constData());
+    const StoredFont first = FontStore::placeData(data, font.size(), episode1 + "/shared.TTF", storeDir);
+    QVERIFY2(first.ok, qPrintable(first.errorString));
+    QVERIFY(!first.reused);
+    QVERIFY(first.storePath.endsWith(first.hash + ".ttf"));
+    const StoredFont second = FontStore::placeData(data, font.size(), episode2 + "/shared.ttf", storeDir);
+    QVERIFY2(second.ok, qPrintable(second.errorString));
+    QVERIFY(second.reused);
+    QCOMPARE(second.storePath, first.storePath);
+    QCOMPARE(QFileInfo(episode2 + "/shared.ttf").size(), qint64(font.size()));
+
+    // A plain copy extracted by mkvextract is replaced by a link to the stored file
+    const QString extracted = episode2 + "/copy.ttf";
+    {
+        QFile file(extracted);
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write(font);
+    }
+    const StoredFont adopted = FontStore::adoptFile(extracted, storeDir);
+    QVERIFY2(adopted.ok, qPrintable(adopted.errorString));
+    QVERIFY(adopted.reused);
+    QCOMPARE(adopted.hash, first.hash);
+    QVERIFY(QFileInfo::exists(extracted));
+
+    QVERIFY(FontStore::writeManifest(episode1, {{"shared.TTF", first.hash}}));
+    QVERIFY(FontStore::writeManifest(episode2, {{"shared.ttf", second.hash}}));
+    QVERIFY(FontStore::writeManifest(episode2, {{"copy.ttf", adopted.hash}}));
+    QCOMPARE(FontIndex::readContentManifest(episode2).size(), 2);
+    QCOMPARE(FontIndex::readContentManifest(episode2).value("shared.ttf"), first.hash);
+
+    FontIndex index(tempDir.filePath("index.bin"));
+    FontIndex::ScanStats stats = index.scanDirectories({episode1});
+    QCOMPARE(stats.parsed, 1);
+    stats = index.scanDirectories({episode2, episode1});
+    QCOMPARE(stats.parsed, 0);
+    QCOMPARE(stats.shared, 2);
+    QCOMPARE(stats.reused, 1);
+    const FontFace* face = index.match("Shared Sans", false, false);
+    QVERIFY(face != nullptr);
+    QCOMPARE(QFileInfo(face->path).absolutePath(), QFileInfo(episode2).absoluteFilePath());
+}
+
+/**
+ * @brief Test: store content unused for longer than the limit is removed, episode links and fresh content stay
+ */
+void FontStoreTest::testFontStore_prunesFontsUnusedByEpisodes()
+{
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    const QString storeDir = tempDir.filePath("store");
+    const QString episode = tempDir.filePath("ep01/attached_fonts");
+    QVERIFY(QDir().mkpath(episode));
+
+    const QByteArray oldFont = TestFonts::makeSfntFont("Old Sans", "Old Sans", 400, false);
+    const QByteArray newFont = TestFonts::makeSfntFont("New Sans", "New Sans", 400, false);
+    const StoredFont old = FontStore::placeData(reinterpret_cast<const uchar*>(oldFont.constData()), oldFont.size(),
+                                                episode + "/old.ttf", storeDir);
+    const StoredFont fresh = FontStore::placeData(reinterpret_cast<const uchar*>(newFont.constData()),
+                                                  newFont.size(), episode + "/new.ttf", storeDir);
+    QVERIFY(old.ok && fresh.ok);
+
+    // Content without a journal entry was stored before the journal existed and is kept
+    QCOMPARE(FontStore::pruneStore({fresh.storePath}, FontStore::kStoreMaxUnusedDays, storeDir), 0);
+    QVERIFY(QFile::exists(old.storePath));
+
+    // Last used by an episode long ago
+    const QString journalPath = QDir(storeDir).filePath(FontStore::usageJournalName());
+    const qint64 longAgo =
+        QDateTime::currentDateTime().addDays(-FontStore::kStoreMaxUnusedDays - 1).toSecsSinceEpoch();
+    {
+        QFile journal(journalPath);
+        QVERIFY(journal.open(QIODevice::WriteOnly));
+        const QString relative = QDir(storeDir).relativeFilePath(old.storePath);
+        journal.write(QStringLiteral("%1  %2\n").arg(longAgo).arg(relative).toUtf8());
+    }
+    QCOMPARE(FontStore::pruneStore({fresh.storePath}, FontStore::kStoreMaxUnusedDays, storeDir), 1);
+    QVERIFY(!QFile::exists(old.storePath));
+    QVERIFY(QFile::exists(fresh.storePath));
+    QCOMPARE(QFileInfo(episode + "/old.ttf").size(), qint64(oldFont.size()));
+
+    QFile journal(journalPath);
+    QVERIFY(journal.open(QIODevice::ReadOnly));
+    const QByteArray entries = journal.readAll();
+    QVERIFY(entries.contains(fresh.hash.toLatin1()));
+    QVERIFY(!entries.contains(old.hash.toLatin1()));
+}
+
+QTEST_MAIN(FontStoreTest)
+#include "fontstore_test.moc"
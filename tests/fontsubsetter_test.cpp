@@ -0,0 +1,150 @@
+/**
+ * @file fontsubsetter_test.cpp
+ * @brief Unit tests for FontSubsetter: glyph subsetting, the subset cache and font renaming in ASS
+ */
+
+#include <QtTest/QtTest>
+#include <QDateTime>
+#include <QFile>
+#include <QString>
+#include <QTemporaryDir>
+
+#include "assdocument.h"
+#include "fontindex.h"
+#include "fontsubsetter.h"
+#include "sfnt.h"
+#include "testfonts.h"
+
+class FontSubsetterTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testFontSubsetter_stripsUnusedGlyphsAndRenames();
+    void testFontSubsetter_renamesFontsInAss();
+    void testFontSubsetter_prunesUnusedCacheEntries();
+};
+
+/**
+ * @brief Test: unused outlines are dropped, glyph ids and cmap stay, the family is renamed
+ */
+void FontSubsetterTest::testFontSubsetter_stripsUnusedGlyphsAndRenames()
+{
+    // Glyphs: 0 .notdef, 1 'A', 2 'B', 3 'C', 4 'а', 5 'б', 6 'в'
+    const QByteArray font = TestFonts::makeSfntFont("Sub Sans", "Sub Sans Bold", 700, false, "ABCабв");
+    QString error;
+    const QByteArray subset = FontSubsetter::subsetFontData(font, {U'A', U'б'}, "DTTEST0001", &error);
+    QVERIFY2(!subset.isEmpty(), qPrintable(error));
+
+    const Sfnt::FontView view{reinterpret_cast<const uchar*>(subset.constData()), subset.size()};
+    QCOMPARE(Sfnt::findTable(view, 0, Sfnt::kTagGlyf).length, 3u * 12);
+    const Sfnt::TableRef loca = Sfnt::findTable(view, 0, Sfnt::kTagLoca);
+    QCOMPARE(loca.length, 8u * 2);
+    auto glyphLength = [&view, &loca](int glyph)
+    {
+        const uchar* p = view.data + loca.offset + glyph * 2;
+        return (Sfnt::readU16(p + 2) - Sfnt::readU16(p)) * 2;
+    };
+    QCOMPARE(glyphLength(0), 12);
+    QCOMPARE(glyphLength(1), 12);
+    QCOMPARE(glyphLength(2), 0);
+    QCOMPARE(glyphLength(4), 0);
+    QCOMPARE(glyphLength(5), 12);
+
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    const QString path = tempDir.filePath("subset.ttf");
+    {
+        QFile file(path);
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write(subset);
+    }
+    const QList<FontFace> faces = FontIndex::readFontFile(path);
+    QCOMPARE(faces.size(), 1);
+    QCOMPARE(faces.first().families, QStringList{"DTTEST0001"});
+    QVERIFY(faces.first().fullNames.contains("DTTEST0001 Regular"));
+    QCOMPARE(faces.first().weight, 700);
+    QVERIFY(FontIndex::readCoverage(path).first().contains(U'б'));
+
+    // Second request with the same characters is served from the cache
+    const QString sourcePath = tempDir.filePath("source.ttf");
+    {
+        QFile file(sourcePath);
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write(font);
+    }
+    const QString cacheDir = tempDir.filePath("subsets");
+    const FontSubsetResult first = FontSubsetter::subsetFont(sourcePath, {U'A'}, "DTTEST0002", cacheDir);
+    QVERIFY2(first.ok, qPrintable(first.errorString));
+    QVERIFY(!first.fromCache);
+    QCOMPARE(first.originalBytes, qint64(font.size()));
+    const FontSubsetResult second = FontSubsetter::subsetFont(sourcePath, {U'A'}, "DTTEST0002", cacheDir);
+    QVERIFY(second.fromCache);
+    QCOMPARE(second.path, first.path);
+}
+
+/**
+ * @brief Test: style Fontname and \fn tags are renamed, other fonts and '@' are kept
+ */
+void FontSubsetterTest::testFontSubsetter_renamesFontsInAss()
+{
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    const QString source = tempDir.filePath("in.ass");
+    {
+        QFile file(source);
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write("[V4+ Styles]\n"
+                   "Format: Name, Fontname, Fontsize, PrimaryColour, Bold, Italic\n"
+                   "Style: Default,Sub Sans,48,&H00FFFFFF,0,0\n"
+                   "Style: Other,Arial,48,&H00FFFFFF,-1,0\n"
+                   "\n[Events]\n"
+                   "Format: Layer, Start, End, Style, Name, MarginL, MarginR, MarginV, Effect, Text\n"
+                   "Dialogue: 0,0:00:00.00,0:00:01.00,Other,,0,0,0,,{\\fn@sub sans\\b1}Верт{\\fnArial}икаль\n");
+    }
+
+    const QString dest = tempDir.filePath("out.ass");
+    QVERIFY(FontSubsetter::renameFontsInAss(source, dest, {{FontIndex::lookupKey("Sub Sans"), "DT0000ABCD"}}));
+    const AssDocument doc = AssDocument::fromFile(dest);
+    QVERIFY(doc.isValid());
+    QCOMPARE(doc.styleField(0, AssDocument::StyleField::Fontname), QString("DT0000ABCD"));
+    QCOMPARE(doc.styleField(0, AssDocument::StyleField::Bold), QString("0"));
+    QCOMPARE(doc.styleField(1, AssDocument::StyleField::Fontname), QString("Arial"));
+    QCOMPARE(doc.eventField(0, AssDocument::EventField::Text), QString("{\\fn@DT0000ABCD\\b1}Верт{\\fnArial}икаль"));
+}
+
+/**
+ * @brief Test: cache entries unused for longer than the limit are removed, a cache hit keeps its entry
+ */
+void FontSubsetterTest::testFontSubsetter_prunesUnusedCacheEntries()
+{
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    const QString sourcePath = tempDir.filePath("source.ttf");
+    {
+        QFile file(sourcePath);
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write(TestFonts::makeSfntFont("Prune Sans", "Prune Sans", 400, false, "ABC"));
+    }
+    const QString cacheDir = tempDir.filePath("subsets");
+    const FontSubsetResult kept = FontSubsetter::subsetFont(sourcePath, {U'A'}, "DTTEST0003", cacheDir);
+    const FontSubsetResult stale = FontSubsetter::subsetFont(sourcePath, {U'B'}, "DTTEST0004", cacheDir);
+    QVERIFY(kept.ok && stale.ok);
+
+    const QDateTime longAgo = QDateTime::currentDateTime().addDays(-FontSubsetter::kCacheMaxUnusedDays - 1);
+    for (const QString& path : {kept.path, stale.path})
+    {
+        QFile file(path);
+        QVERIFY(file.open(QIODevice::ReadWrite));
+        QVERIFY(file.setFileTime(longAgo, QFileDevice::FileModificationTime));
+    }
+    QVERIFY(FontSubsetter::subsetFont(sourcePath, {U'A'}, "DTTEST0003", cacheDir).fromCache);
+
+    QCOMPARE(FontSubsetter::pruneCache(cacheDir), 1);
+    QVERIFY(QFile::exists(kept.path));
+    QVERIFY(!QFile::exists(stale.path));
+    QCOMPARE(FontSubsetter::pruneCache(cacheDir), 0);
+}
+
+QTEST_MAIN(FontSubsetterTest)
+#include "fontsubsetter_test.moc"
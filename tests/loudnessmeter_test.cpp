@@ -0,0 +1,91 @@
+/**
+ * @file loudnessmeter_test.cpp
+ * @brief Unit tests for LoudnessMeter, the in-process EBU R128 meter
+ */
+
+#include <QtTest/QtTest>
+#include <QByteArray>
+#include <QDataStream>
+#include <QFile>
+#include <QString>
+#include <QTemporaryDir>
+#include <QtEndian>
+#include <QtMath>
+
+#include "loudnessmeter.h"
+#include "wavfile.h"
+
+#include <cmath>
+
+class LoudnessMeterTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testLoudnessMeter_measuresReferenceSine();
+};
+
+/**
+ * @brief Test: a -20 dBFS 997 Hz stereo sine reads -20 LUFS, and the gain to -23 LUFS respects the true-peak ceiling
+ */
+void LoudnessMeterTest::testLoudnessMeter_measuresReferenceSine()
+{
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+
+    // 35 s spans two 30 s chunks, so the warm-up at the chunk boundary is exercised too
+    const int sampleRate = 48000;
+    const int frames = sampleRate * 35;
+    const double amplitude = std::pow(10.0, -20.0 / 20.0);
+    QByteArray pcm(frames * 4, Qt::Uninitialized);
+    auto* out = reinterpret_cast<qint16*>(pcm.data());
+    for (int i = 0; i < frames; ++i)
+    {
+        const auto sample = static_cast<qint16>(std::lround(32767.0 * amplitude *
+                                                            std::sin(2.0 * M_PI * 997.0 * i / sampleRate)));
+        out[2 * i] = qToLittleEndian(sample);
+        out[2 * i + 1] = qToLittleEndian(sample);
+    }
+
+    QByteArray wav;
+    QDataStream stream(&wav, QIODevice::WriteOnly);
+    stream.setByteOrder(QDataStream::LittleEndian);
+    stream.writeRawData("RIFF", 4);
+    stream << quint32(36 + pcm.size());
+    stream.writeRawData("WAVEfmt ", 8);
+    stream << quint32(16) << quint16(1) << quint16(2) << quint32(sampleRate) << quint32(sampleRate * 4)
+           << quint16(4) << quint16(16);
+    stream.writeRawData("data", 4);
+    stream << quint32(pcm.size());
+    wav.append(pcm);
+
+    const QString path = tempDir.filePath("dub.wav");
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write(wav);
+    file.close();
+
+    const WavInfo info = WavFile::readHeader(path);
+    QVERIFY2(info.ok, qPrintable(info.errorString));
+    QCOMPARE(info.channels, 2);
+    QCOMPARE(info.frameCount(), qint64(frames));
+
+    const LoudnessResult result = LoudnessMeter::analyzeFile(path);
+    QVERIFY2(result.ok, qPrintable(result.errorString));
+    QVERIFY(qAbs(result.integratedLufs + 20.0) < 0.1);
+    QVERIFY(result.loudnessRangeLu < 0.1);
+    QVERIFY(qAbs(result.truePeakDbtp + 20.0) < 0.1);
+    QCOMPARE(result.clippedSamples, qint64(0));
+    QVERIFY(qAbs(LoudnessMeter::recommendedGainDb(result) + 3.0) < 0.1);
+
+    // Quiet but peaky material is raised only up to the true-peak ceiling
+    LoudnessResult peaky;
+    peaky.ok = true;
+    peaky.integratedLufs = -30.0;
+    peaky.truePeakDbtp = -3.0;
+    QCOMPARE(LoudnessMeter::recommendedGainDb(peaky), 2.0);
+    QCOMPARE(LoudnessMeter::recommendedGainDb(LoudnessResult()), 0.0);
+}
+
+QTEST_MAIN(LoudnessMeterTest)
+#include "loudnessmeter_test.moc"
@@ -0,0 +1,178 @@
+/**
+ * @file mkvattachments_test.cpp
+ * @brief Unit tests for MkvAttachments: reading the attachment table and picking referenced fonts
+ */
+
+#include <QtTest/QtTest>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QList>
+#include <QPair>
+#include <QString>
+#include <QStringList>
+#include <QTemporaryDir>
+
+#include "mkvattachments.h"
+#include "testfonts.h"
+
+class MkvAttachmentsTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testMkvAttachments_selectsReferencedFonts();
+    void testMkvAttachments_locatesMkvmergeFontsWithLargeUids();
+};
+
+namespace
+{
+using AttachedFiles = QList<QPair<QString, QByteArray>>;
+
+// Matroska file with a SeekHead pointing past a cluster to Attachments with \a files and FileUIDs \a uids
+QByteArray makeMkv(const AttachedFiles& files, const QList<quint64>& uids)
+{
+    // EBML element with an 8-byte size field
+    auto element = [](quint32 id, const QByteArray& payload)
+    {
+        QByteArray out;
+        for (int shift = 24; shift >= 0; shift -= 8)
+        {
+            if ((id >> shift) != 0)
+            {
+                out.append(char((id >> shift) & 0xFF));
+            }
+        }
+        out.append(char(0x01));
+        for (int shift = 48; shift >= 0; shift -= 8)
+        {
+            out.append(char((quint64(payload.size()) >> shift) & 0xFF));
+        }
+        return out + payload;
+    };
+    auto uint64 = [](quint64 value)
+    {
+        QByteArray out;
+        for (int shift = 56; shift >= 0; shift -= 8)
+        {
+            out.append(char((value >> shift) & 0xFF));
+        }
+        return out;
+    };
+
+    QByteArray attachments;
+    for (int i = 0; i < files.size(); ++i)
+    {
+        attachments += element(0x61A7, element(0x466E, files.at(i).first.toUtf8()) +
+                                            element(0x4660, "font/ttf") + element(0x465C, files.at(i).second) +
+                                            element(0x46AE, uint64(uids.at(i))));
+    }
+    attachments = element(0x1941A469, attachments);
+    const QByteArray cluster = element(0x1F43B675, QByteArray(4096, '\x55'));
+    // SeekPosition is relative to the segment data and points past the cluster
+    auto seekHead = [&](quint64 position)
+    {
+        const QByteArray seek = element(0x53AB, "\x19\x41\xA4\x69") + element(0x53AC, uint64(position));
+        return element(0x114D9B74, element(0x4DBB, seek));
+    };
+    const QByteArray head = seekHead(seekHead(0).size() + cluster.size());
+    return element(0x1A45DFA3, element(0x4282, "matroska")) + element(0x18538067, head + cluster + attachments);
+}
+
+bool writeFile(const QString& path, const QByteArray& data)
+{
+    QFile file(path);
+    return file.open(QIODevice::WriteOnly) && file.write(data) == data.size();
+}
+} // namespace
+
+/**
+ * @brief Test: attachments are found through SeekHead past a cluster, only referenced fonts are selected
+ */
+void MkvAttachmentsTest::testMkvAttachments_selectsReferencedFonts()
+{
+    const AttachedFiles files = {
+        {"used.ttf", TestFonts::makeSfntFont("Used Sans", "Used Sans", 400, false)},
+        {"used-bold.ttf", TestFonts::makeSfntFont("Used Sans", "Used Sans Bold", 700, false)},
+        {"unused.ttf", TestFonts::makeSfntFont("Unused Serif", "Unused Serif", 400, false)},
+        {"broken.ttf", QByteArray("not a font at all")},
+    };
+    const QByteArray mkv = makeMkv(files, {1000, 1001, 1002, 1003});
+
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    const QString path = tempDir.filePath("episode.mkv");
+    QVERIFY(writeFile(path, mkv));
+
+    QString error;
+    const QList<MkvAttachment> parsed = MkvAttachments::read(path, &error);
+    QVERIFY2(parsed.size() == files.size(), qPrintable(error));
+    for (int i = 0; i < files.size(); ++i)
+    {
+        QCOMPARE(parsed.at(i).id, i + 1);
+        QCOMPARE(parsed.at(i).uid, quint64(1000 + i));
+        QCOMPARE(parsed.at(i).fileName, files.at(i).first);
+        QCOMPARE(mkv.mid(parsed.at(i).dataOffset, parsed.at(i).dataSize), files.at(i).second);
+    }
+
+    // Bold face is not used, unknown data is kept because nothing is known about it
+    const QList<MkvAttachment> selected =
+        MkvAttachments::selectReferencedFonts(path, parsed, {AssStyleInfo{"used sans", false, false}});
+    QStringList selectedNames;
+    for (const MkvAttachment& attachment : selected)
+    {
+        selectedNames.append(attachment.fileName);
+    }
+    QCOMPARE(selectedNames, (QStringList{"used.ttf", "broken.ttf"}));
+
+    QVERIFY(MkvAttachments::read(tempDir.filePath("missing.mkv")).isEmpty());
+}
+
+/**
+ * @brief Test: fonts from mkvmerge -J are located by attachment number, FileUIDs above 2^53 do not matter
+ */
+void MkvAttachmentsTest::testMkvAttachments_locatesMkvmergeFontsWithLargeUids()
+{
+    const QByteArray font = TestFonts::makeSfntFont("Used Sans", "Used Sans", 400, false);
+    const AttachedFiles files = {{"cover.jpg", QByteArray(100, '\xFF')}, {"used.ttf", font}, {"other.otf", font}};
+    // Random 64-bit FileUIDs, as mkvmerge writes them; as a double they round to other values
+    const QList<quint64> uids = {Q_UINT64_C(9007199254740993), Q_UINT64_C(13835058055282163713),
+                                 Q_UINT64_C(18446744073709551557)};
+
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    const QString path = tempDir.filePath("episode.mkv");
+    QVERIFY(writeFile(path, makeMkv(files, uids)));
+
+    const QString json = QString(R"([
+        {"id":1,"file_name":"cover.jpg","content_type":"image/jpeg","size":100,"properties":{"uid":%1}},
+        {"id":2,"file_name":"used.ttf","content_type":"font/ttf","size":%4,"properties":{"uid":%2}},
+        {"id":3,"file_name":"other.otf","content_type":"application/octet-stream","size":%4,
+         "properties":{"uid":%3}}])")
+                             .arg(uids.at(0))
+                             .arg(uids.at(1))
+                             .arg(uids.at(2))
+                             .arg(font.size());
+    const QJsonArray identification = QJsonDocument::fromJson(json.toUtf8()).array();
+    QList<MkvAttachment> fonts = MkvAttachments::fontsFromIdentification(identification);
+    QCOMPARE(fonts.size(), qsizetype(2));
+    QCOMPARE(fonts.at(0).id, 2);
+    QCOMPARE(fonts.at(1).fileName, QString("other.otf"));
+
+    QString error;
+    const QList<MkvAttachment> parsed = MkvAttachments::read(path, &error);
+    QVERIFY2(parsed.size() == files.size(), qPrintable(error));
+    QVERIFY(MkvAttachments::locate(fonts, parsed));
+    QCOMPARE(fonts.at(0).uid, uids.at(1));
+    QCOMPARE(fonts.at(1).uid, uids.at(2));
+    QCOMPARE(fonts.at(0).dataOffset, parsed.at(1).dataOffset);
+    QCOMPARE(fonts.at(1).dataSize, qint64(font.size()));
+
+    // Another file under the same number is not taken for the font
+    QList<MkvAttachment> renamed = MkvAttachments::fontsFromIdentification(identification);
+    renamed[0].fileName = "cover.ttf";
+    QVERIFY(!MkvAttachments::locate(renamed, parsed));
+}
+
+QTEST_MAIN(MkvAttachmentsTest)
+#include "mkvattachments_test.moc"
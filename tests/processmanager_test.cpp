@@ -0,0 +1,71 @@
+/**
+ * @file processmanager_test.cpp
+ * @brief Unit tests for ProcessManager: read counters of finished asynchronous processes
+ */
+
+#include <QtTest/QtTest>
+#include <QDir>
+#include <QFile>
+#include <QSignalSpy>
+#include <QString>
+#include <QStringList>
+#include <QTemporaryDir>
+
+#include "processmanager.h"
+
+class ProcessManagerTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testProcessManager_reportsBytesReadByFinishedProcess();
+};
+
+/**
+ * @brief Test: bytes read by a finished process are taken from the OS counters before the process is reaped
+ */
+void ProcessManagerTest::testProcessManager_reportsBytesReadByFinishedProcess()
+{
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    const QString path = tempDir.filePath("source.bin");
+    const qint64 size = 4 * 1024 * 1024;
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    QCOMPARE(file.write(QByteArray(size, '\x5A')), size);
+    file.close();
+
+#if defined(Q_OS_WIN)
+    const QString program = "cmd";
+    const auto arguments = [](const QString& input)
+    {
+        return QStringList{"/c", "type", QDir::toNativeSeparators(input)};
+    };
+#elif defined(Q_OS_LINUX)
+    const QString program = "cat";
+    const auto arguments = [](const QString& input)
+    {
+        return QStringList{input};
+    };
+#else
+    QSKIP("read counters are only available on Windows and Linux");
+#endif
+
+    ProcessManager manager;
+    QSignalSpy finished(&manager, &ProcessManager::processFinished);
+    manager.startProcess(program, arguments(path));
+    QVERIFY(finished.wait(30000));
+    QCOMPARE(finished.first().at(0).toInt(), 0);
+
+    // Linux keeps the last sample taken while the process was writing, so a tail of the file may be missing
+    const qint64 bytesRead = manager.lastProcessBytesRead();
+    QVERIFY2(bytesRead >= size / 2, qPrintable(QString::number(bytesRead)));
+
+    // The counter belongs to the last process only
+    manager.startProcess(program, arguments(tempDir.filePath("missing.bin")));
+    QVERIFY(finished.wait(30000));
+    QVERIFY(manager.lastProcessBytesRead() < size / 2);
+}
+
+QTEST_MAIN(ProcessManagerTest)
+#include "processmanager_test.moc"
@@ -0,0 +1,183 @@
+/**
+ * @file renderhelper_test.cpp
+ * @brief Unit tests for RenderHelper: first-pass statistics for rerender and the MP4 stream-copy fast path
+ */
+
+#include <QtTest/QtTest>
+#include <QByteArray>
+#include <QDir>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QString>
+#include <QStringList>
+#include <QTemporaryDir>
+
+#include "renderhelper.h"
+
+class RenderHelperTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testRenderHelper_pass1StatsFileNameIgnoresBitrate();
+    void testRenderHelper_appliesPassStatsFile();
+    void testRenderHelper_findsAndRemovesPass1Stats();
+    void testRenderHelper_mp4FastPathEligibility();
+    void testRenderHelper_mp4FastPathFollowsPreset();
+};
+
+namespace
+{
+bool writeFile(const QString& path, const QByteArray& data)
+{
+    QFile file(path);
+    return file.open(QIODevice::WriteOnly) && file.write(data) == data.size();
+}
+} // namespace
+
+/**
+ * @brief Test: the stats key follows the source, the filter and the encoder options, but not the bitrate
+ */
+void RenderHelperTest::testRenderHelper_pass1StatsFileNameIgnoresBitrate()
+{
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    const QString source = tempDir.filePath("episode.mkv");
+    QVERIFY(writeFile(source, QByteArray(1000, '\x01')));
+    const QStringList inputs{source};
+
+    const QString command = "ffmpeg -i \"%INPUT%\" -c:v libx265 -b:v 4000k -maxrate 8000k -bufsize 16000k "
+                            "-preset medium -x265-params pass=1:vbv-maxrate=8000:stats=old.stats -an -f mp4 NUL";
+    const QString name = RenderHelper::pass1StatsFileName(inputs, "hardsub", command);
+    QVERIFY(name.startsWith("pass1_"));
+    QVERIFY(name.endsWith(".stats"));
+
+    // The dialog only changes bitrate options, the first pass analysis stays valid
+    QString retuned = command;
+    retuned.replace("4000k", "5200k").replace("vbv-maxrate=8000", "vbv-maxrate=10400").replace("old", "new");
+    QCOMPARE(RenderHelper::pass1StatsFileName(inputs, "hardsub", retuned), name);
+
+    QVERIFY(RenderHelper::pass1StatsFileName(inputs, "nosub", command) != name);
+    QString slower = command;
+    slower.replace("-preset medium", "-preset slow");
+    QVERIFY(RenderHelper::pass1StatsFileName(inputs, "hardsub", slower) != name);
+
+    // A different source under the same path is a different key
+    QVERIFY(writeFile(source, QByteArray(2000, '\x01')));
+    QVERIFY(RenderHelper::pass1StatsFileName(inputs, "hardsub", command) != name);
+}
+
+/**
+ * @brief Test: x265 gets stats= inside -x265-params, -pass encoders get -passlogfile before the output
+ */
+void RenderHelperTest::testRenderHelper_appliesPassStatsFile()
+{
+    QStringList x265{"-c:v", "libx265", "-x265-params", "pass=2:stats=old.stats:aq-mode=3", "out.mp4"};
+    QVERIFY(RenderHelper::applyPassStatsFile(x265, "pass1_abc.stats"));
+    QCOMPARE(x265.at(3), QString("pass=2:aq-mode=3:stats=pass1_abc.stats"));
+    QCOMPARE(x265.size(), qsizetype(5));
+
+    QStringList x264{"-c:v", "libx264", "-pass", "1", "-f", "mp4", "NUL"};
+    QVERIFY(RenderHelper::applyPassStatsFile(x264, "pass1_abc.stats"));
+    QCOMPARE(x264, (QStringList{"-c:v", "libx264", "-pass", "1", "-f", "mp4", "-passlogfile", "pass1_abc.stats",
+                                "NUL"}));
+    // The option is replaced, not added twice
+    QVERIFY(RenderHelper::applyPassStatsFile(x264, "pass1_def.stats"));
+    QCOMPARE(x264.count("-passlogfile"), qsizetype(1));
+    QVERIFY(x264.contains("pass1_def.stats"));
+
+    QStringList singlePass{"-c:v", "hevc_nvenc", "-b:v", "4M", "out.mp4"};
+    const QStringList unchanged = singlePass;
+    QVERIFY(!RenderHelper::applyPassStatsFile(singlePass, "pass1_abc.stats"));
+    QCOMPARE(singlePass, unchanged);
+}
+
+/**
+ * @brief Test: stats are found under both x265 and ffmpeg -passlogfile names and removed with their side files
+ */
+void RenderHelperTest::testRenderHelper_findsAndRemovesPass1Stats()
+{
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    const QDir dir(tempDir.path());
+    QVERIFY(!RenderHelper::hasPass1Stats(dir.path(), "pass1_abc.stats"));
+
+    // An empty file is what an interrupted first pass leaves behind
+    QVERIFY(writeFile(dir.filePath("pass1_abc.stats"), QByteArray()));
+    QVERIFY(!RenderHelper::hasPass1Stats(dir.path(), "pass1_abc.stats"));
+
+    QVERIFY(writeFile(dir.filePath("pass1_abc.stats-0.log"), "#options: 1"));
+    QVERIFY(writeFile(dir.filePath("pass1_abc.stats-0.log.mbtree"), "tree"));
+    QVERIFY(writeFile(dir.filePath("pass1_abc.stats.cutree"), "tree"));
+    QVERIFY(RenderHelper::hasPass1Stats(dir.path(), "pass1_abc.stats"));
+
+    RenderHelper::removePass1Stats(dir.path(), "pass1_abc.stats");
+    QVERIFY(!RenderHelper::hasPass1Stats(dir.path(), "pass1_abc.stats"));
+    QVERIFY(dir.entryList(QDir::Files).isEmpty());
+}
+
+/**
+ * @brief Test: video is copied only for MP4 codecs and a source bitrate known to be close to the target
+ */
+void RenderHelperTest::testRenderHelper_mp4FastPathEligibility()
+{
+    QVERIFY(RenderHelper::isMp4CompatibleVideoCodec("V_MPEGH/ISO/HEVC"));
+    QVERIFY(RenderHelper::isMp4CompatibleVideoCodec("AVC/H.264/MPEG-4p10"));
+    QVERIFY(RenderHelper::isMp4CompatibleVideoCodec("h265"));
+    QVERIFY(!RenderHelper::isMp4CompatibleVideoCodec("V_MPEG2"));
+
+    // mkvmerge -J writes statistics tags as strings
+    const QJsonObject tagged = QJsonDocument::fromJson(R"({"codec_id":"V_MPEGH/ISO/HEVC","tag_bps":"4515263",
+        "tag_number_of_bytes":"1"})").object();
+    QCOMPARE(RenderHelper::mkvTrackBitrateKbps(tagged, 1420.0), 4515);
+    const QJsonObject bytesOnly = QJsonDocument::fromJson(R"({"tag_number_of_bytes":"750000000"})").object();
+    QCOMPARE(RenderHelper::mkvTrackBitrateKbps(bytesOnly, 1500.0), 4000);
+    QCOMPARE(RenderHelper::mkvTrackBitrateKbps(bytesOnly, 0.0), 0);
+    QCOMPARE(RenderHelper::mkvTrackBitrateKbps(QJsonObject{{"codec_id", "V_MPEG4/ISO/AVC"}}, 1500.0), 0);
+
+    QVERIFY(RenderHelper::sourceBitrateFitsTarget(4500, 4000));
+    QVERIFY(!RenderHelper::sourceBitrateFitsTarget(4700, 4000));
+    // Without statistics the source may be far above the target, so it is re-encoded
+    QVERIFY(!RenderHelper::sourceBitrateFitsTarget(0, 4000));
+    QVERIFY(RenderHelper::sourceBitrateFitsTarget(0, 0));
+    QVERIFY(RenderHelper::sourceBitrateFitsTarget(20000, 0));
+}
+
+/**
+ * @brief Test: video is copied only when the preset adds no filters and encodes to the source codec, profile and depth
+ */
+void RenderHelperTest::testRenderHelper_mp4FastPathFollowsPreset()
+{
+    const QJsonObject main8 = QJsonDocument::fromJson(R"({"codec_name":"hevc","profile":"Main","pix_fmt":"yuv420p"})")
+                                  .object();
+    const QJsonObject main10 =
+        QJsonDocument::fromJson(R"({"codec_name":"hevc","profile":"Main 10","pix_fmt":"yuv420p10le"})").object();
+
+    const QString nvenc = "ffmpeg -y -i \"%INPUT%\" -vf \"subtitles=%SIGNS%\" -c:v hevc_nvenc -profile:v main "
+                          "-b:v 4M -c:a aac \"%OUTPUT%\"";
+    QVERIFY(RenderHelper::mp4FastPathMismatch(nvenc, main8).isEmpty());
+    // main preset without -pix_fmt gives 8-bit video, a Main 10 source would lose its depth
+    QVERIFY(!RenderHelper::mp4FastPathMismatch(nvenc, main10).isEmpty());
+
+    QString main10Preset = nvenc;
+    main10Preset.replace("-profile:v main", "-profile:v main10 -pix_fmt p010le");
+    QVERIFY(RenderHelper::mp4FastPathMismatch(main10Preset, main10).isEmpty());
+
+    QString scaled = nvenc;
+    scaled.replace("subtitles=%SIGNS%", "subtitles=%SIGNS%,scale=1280:-2");
+    QVERIFY(RenderHelper::mp4FastPathMismatch(scaled, main8).contains("scale=1280:-2"));
+
+    const QString x264 = "ffmpeg -i \"%INPUT%\" -vf \"subtitles=%SIGNS%\" -c:v libx264 -crf 18 \"%OUTPUT%\"";
+    QVERIFY(!RenderHelper::mp4FastPathMismatch(x264, main8).isEmpty());
+    const QJsonObject high = QJsonDocument::fromJson(R"({"codec_name":"h264","profile":"High","pix_fmt":"yuv420p"})")
+                                 .object();
+    QVERIFY(RenderHelper::mp4FastPathMismatch(x264, high).isEmpty());
+    QVERIFY(RenderHelper::mp4FastPathMismatch("ffmpeg -i \"%INPUT%\" -c copy \"%OUTPUT%\"", high).isEmpty());
+
+    // Without ffprobe data nothing is known about the source
+    QVERIFY(!RenderHelper::mp4FastPathMismatch(nvenc, QJsonObject()).isEmpty());
+}
+
+QTEST_MAIN(RenderHelperTest)
+#include "renderhelper_test.moc"
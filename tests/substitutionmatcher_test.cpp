@@ -0,0 +1,54 @@
+/**
+ * @file substitutionmatcher_test.cpp
+ * @brief Unit tests for SubstitutionMatcher (Aho-Corasick template substitutions)
+ */
+
+#include <QtTest/QtTest>
+#include <QByteArray>
+#include <QList>
+#include <QMap>
+#include <QString>
+
+#include "substitutionmatcher.h"
+
+class SubstitutionMatcherTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testSubstitutionMatcher_leftmostLongest();
+};
+
+/**
+ * @brief Test: one pass, leftmost-longest, replaced text is not rescanned
+ */
+void SubstitutionMatcherTest::testSubstitutionMatcher_leftmostLongest()
+{
+    QMap<QString, QString> substitutions;
+    substitutions.insert("Ёж", "Ёжик");
+    substitutions.insert("Ёжик", "Колючий");
+    substitutions.insert("ик", "ИК");
+    substitutions.insert("сан", "-сан");
+    const SubstitutionMatcher matcher(substitutions);
+
+    QList<int> hits(matcher.keyCount(), 0);
+    QByteArray out;
+    QVERIFY(matcher.apply(QString("Ёжик и Ёж, Танака сан").toUtf8(), out, &hits));
+    QCOMPARE(QString::fromUtf8(out), QString("Колючий и Ёжик, Танака -сан"));
+
+    QVERIFY(!matcher.apply(QString("{\\i1}ничего{\\i0}").toUtf8(), out, &hits));
+
+    int total = 0;
+    for (int k = 0; k < matcher.keyCount(); ++k)
+    {
+        total += hits.at(k);
+        if (matcher.key(k) == "ик")
+        {
+            QCOMPARE(hits.at(k), 0);
+        }
+    }
+    QCOMPARE(total, 3);
+}
+
+QTEST_MAIN(SubstitutionMatcherTest)
+#include "substitutionmatcher_test.moc"
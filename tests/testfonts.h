@@ -0,0 +1,154 @@
+/**
+ * @file testfonts.h
+ * @brief Synthetic font files shared by the font module tests
+ */
+
+#ifndef TESTFONTS_H
+#define TESTFONTS_H
+
+#include <QByteArray>
+#include <QChar>
+#include <QList>
+#include <QPair>
+#include <QString>
+
+#include <algorithm>
+
+namespace TestFonts
+{
+// Minimal sfnt with only the tables FontIndex reads: name (Windows UTF-16BE), OS/2, head and cmap (format 4),
+// plus maxp/loca/glyf with a 12-byte empty outline per glyph for FontSubsetter
+inline QByteArray makeSfntFont(const QString& family, const QString& fullName, int weight, bool italic,
+                               const QString& coveredChars = QString())
+{
+    auto u16 = [](QByteArray& out, int value)
+    {
+        out.append(static_cast<char>((value >> 8) & 0xFF));
+        out.append(static_cast<char>(value & 0xFF));
+    };
+    auto u32 = [&u16](QByteArray& out, quint32 value)
+    {
+        u16(out, static_cast<int>(value >> 16));
+        u16(out, static_cast<int>(value & 0xFFFF));
+    };
+
+    const QList<QPair<int, QString>> names = {{1, family}, {2, italic ? "Italic" : "Regular"}, {4, fullName}};
+    QByteArray strings;
+    QByteArray name;
+    u16(name, 0);
+    u16(name, static_cast<int>(names.size()));
+    u16(name, 6 + static_cast<int>(names.size()) * 12);
+    for (const auto& [nameId, value] : names)
+    {
+        u16(name, 3);      // Windows
+        u16(name, 1);      // Unicode BMP
+        u16(name, 0x0409); // en-US
+        u16(name, nameId);
+        u16(name, static_cast<int>(value.size()) * 2);
+        u16(name, static_cast<int>(strings.size()));
+        for (QChar c : value)
+        {
+            u16(strings, c.unicode());
+        }
+    }
+    name.append(strings);
+
+    QByteArray os2(78, '\0');
+    os2[4] = static_cast<char>(weight >> 8);
+    os2[5] = static_cast<char>(weight & 0xFF);
+    os2[7] = 5; // usWidthClass: normal
+    os2[63] = italic ? 1 : 0;
+
+    QByteArray head(54, '\0');
+    head[45] = static_cast<char>((weight >= 700 ? 1 : 0) | (italic ? 2 : 0));
+
+    // One segment per character mapped to glyphs 1..n, plus the mandatory 0xFFFF segment
+    QList<char16_t> codes;
+    for (QChar c : coveredChars)
+    {
+        codes.append(c.unicode());
+    }
+    std::sort(codes.begin(), codes.end());
+    codes.erase(std::unique(codes.begin(), codes.end()), codes.end());
+    const int segCount = static_cast<int>(codes.size()) + 1;
+    QByteArray subtable;
+    u16(subtable, 4);
+    u16(subtable, 16 + segCount * 8);
+    u16(subtable, 0);
+    u16(subtable, segCount * 2);
+    u16(subtable, 0);
+    u16(subtable, 0);
+    u16(subtable, 0);
+    for (char16_t code : codes)
+    {
+        u16(subtable, code); // endCode
+    }
+    u16(subtable, 0xFFFF);
+    u16(subtable, 0); // reservedPad
+    for (char16_t code : codes)
+    {
+        u16(subtable, code); // startCode
+    }
+    u16(subtable, 0xFFFF);
+    for (int i = 0; i < codes.size(); ++i)
+    {
+        u16(subtable, (i + 1 - codes.at(i)) & 0xFFFF); // idDelta
+    }
+    u16(subtable, 1);
+    for (int i = 0; i < segCount; ++i)
+    {
+        u16(subtable, 0); // idRangeOffset
+    }
+    QByteArray cmap;
+    u16(cmap, 0);
+    u16(cmap, 1);
+    u16(cmap, 3); // Windows
+    u16(cmap, 1); // Unicode BMP
+    u32(cmap, 12);
+    cmap.append(subtable);
+
+    // Glyph 0 is .notdef, glyphs 1..n follow the sorted characters; loca is in the short format (head zeroed)
+    const int numGlyphs = static_cast<int>(codes.size()) + 1;
+    QByteArray maxp;
+    u32(maxp, 0x00005000);
+    u16(maxp, numGlyphs);
+    QByteArray loca;
+    QByteArray glyf;
+    for (int i = 0; i <= numGlyphs; ++i)
+    {
+        u16(loca, static_cast<int>(glyf.size()) / 2);
+        if (i < numGlyphs)
+        {
+            glyf.append(QByteArray(12, '\0'));
+        }
+    }
+
+    const QList<QPair<QByteArray, QByteArray>> tables = {{"OS/2", os2}, {"cmap", cmap}, {"glyf", glyf},
+                                                         {"head", head}, {"loca", loca}, {"maxp", maxp},
+                                                         {"name", name}};
+    QByteArray font;
+    u32(font, 0x00010000);
+    u16(font, static_cast<int>(tables.size()));
+    u16(font, 0);
+    u16(font, 0);
+    u16(font, 0);
+    quint32 offset = 12 + static_cast<quint32>(tables.size()) * 16;
+    for (const auto& [tag, data] : tables)
+    {
+        font.append(tag);
+        u32(font, 0);
+        u32(font, offset);
+        u32(font, static_cast<quint32>(data.size()));
+        offset += static_cast<quint32>((data.size() + 3) & ~3);
+    }
+    for (const auto& table : tables)
+    {
+        QByteArray data = table.second;
+        data.append(QByteArray((4 - data.size() % 4) % 4, '\0'));
+        font.append(data);
+    }
+    return font;
+}
+} // namespace TestFonts
+
+#endif // TESTFONTS_H
@@ -0,0 +1,134 @@
+/**
+ * @file torrentmonitor_test.cpp
+ * @brief Unit tests for TorrentMonitor against a local stand-in for the qBittorrent Web UI
+ */
+
+#include <QtTest/QtTest>
+#include <QHash>
+#include <QList>
+#include <QNetworkCookie>
+#include <QSignalSpy>
+#include <QString>
+#include <QStringList>
+#include <QTcpServer>
+#include <QTcpSocket>
+
+#include "torrentmonitor.h"
+
+class TorrentMonitorTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testTorrentMonitor_mergesSyncDeltasForAllWatched();
+    void testTorrentMonitor_adaptsPollIntervalToSpeedAndEta();
+};
+
+/**
+ * @brief Test: one sync/maindata request serves every watched torrent, rid deltas are merged into full states
+ */
+void TorrentMonitorTest::testTorrentMonitor_mergesSyncDeltasForAllWatched()
+{
+    // A local stand-in for the qBittorrent Web UI: answers each request with the next canned body
+    QTcpServer server;
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+    QList<QByteArray> bodies{
+        R"({"rid":1,"full_update":true,"torrents":{
+            "aaaa":{"progress":0.5,"dlspeed":1000000,"eta":100,"size":200000000,
+                    "state":"downloading","save_path":"/dl"},
+            "bbbb":{"progress":0.1,"dlspeed":0,"eta":8640000,"size":100000000,"state":"stalledDL"},
+            "cccc":{"progress":0.7,"state":"downloading"}}})",
+        R"({"rid":2,"torrents":{"aaaa":{"progress":1.0,"dlspeed":0}},"torrents_removed":["bbbb"]})"};
+    QStringList requests;
+    connect(&server, &QTcpServer::newConnection, this,
+            [&]()
+            {
+                QTcpSocket* socket = server.nextPendingConnection();
+                connect(socket, &QTcpSocket::readyRead, socket,
+                        [&, socket]()
+                        {
+                            const QByteArray request = socket->peek(socket->bytesAvailable());
+                            if (!request.contains("\r\n\r\n"))
+                            {
+                                return;
+                            }
+                            socket->readAll();
+                            requests.append(QString::fromLatin1(request));
+                            const QByteArray body = bodies.isEmpty() ? QByteArray() : bodies.takeFirst();
+                            socket->write("HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nConnection: close\r\n");
+                            socket->write("Content-Length: " + QByteArray::number(body.size()) + "\r\n\r\n" + body);
+                            socket->disconnectFromHost();
+                        });
+            });
+
+    TorrentMonitor monitor;
+    QSignalSpy updates(&monitor, &TorrentMonitor::torrentUpdated);
+    const QString webUiUrl = QString("http://127.0.0.1:%1").arg(server.serverPort());
+    const QList<QNetworkCookie> cookies{QNetworkCookie("SID", "test")};
+    monitor.watch(webUiUrl, cookies, "AAAA");
+    monitor.watch(webUiUrl, cookies, "bbbb");
+
+    // Both episodes are served by the first full update; the unwatched torrent is not reported
+    QTRY_COMPARE(updates.size(), 2);
+    QCOMPARE(requests.size(), 1);
+    QVERIFY(requests.at(0).startsWith("GET /api/v2/sync/maindata?rid=0 "));
+    QVERIFY(requests.at(0).contains("SID=test"));
+    QHash<QString, TorrentState> states;
+    for (const QList<QVariant>& arguments : std::as_const(updates))
+    {
+        const TorrentState state = arguments.at(0).value<TorrentState>();
+        states.insert(state.hash, state);
+    }
+    QCOMPARE(states.keys().size(), qsizetype(2));
+    QCOMPARE(states.value("aaaa").progress, 0.5);
+    QCOMPARE(states.value("bbbb").state, QString("stalledDL"));
+
+    // The delta only carries changed fields, the rest come from the first answer
+    updates.clear();
+    monitor.poll();
+    QTRY_COMPARE(updates.size(), 1);
+    QVERIFY(requests.at(1).startsWith("GET /api/v2/sync/maindata?rid=1 "));
+    const TorrentState finished = updates.at(0).at(0).value<TorrentState>();
+    QCOMPARE(finished.hash, QString("aaaa"));
+    QVERIFY(finished.isFinished());
+    QCOMPARE(finished.state, QString("downloading"));
+    QCOMPARE(finished.savePath, QString("/dl"));
+    QCOMPARE(finished.sizeBytes, qint64(200000000));
+
+    monitor.unwatch("aaaa");
+    monitor.unwatch("bbbb");
+}
+
+/**
+ * @brief Test: the poll interval follows the torrent closest to changing its visible progress
+ */
+void TorrentMonitorTest::testTorrentMonitor_adaptsPollIntervalToSpeedAndEta()
+{
+    const auto downloading = [](qint64 speed, qint64 etaS, qint64 size)
+    {
+        TorrentState state;
+        state.progress = 0.5;
+        state.downloadSpeed = speed;
+        state.etaS = etaS;
+        state.sizeBytes = size;
+        return state;
+    };
+
+    QCOMPARE(TorrentMonitor::pollIntervalMs({}), TorrentMonitor::kMaxIntervalMs);
+    // Stalled and finished torrents do not need frequent polls
+    QCOMPARE(TorrentMonitor::pollIntervalMs({downloading(0, 8640000, 1000000000)}), TorrentMonitor::kMaxIntervalMs);
+    TorrentState done = downloading(1000000, 0, 1000000);
+    done.progress = 1.0;
+    QCOMPARE(TorrentMonitor::pollIntervalMs({done}), TorrentMonitor::kMaxIntervalMs);
+    // 1% of 100 MB at 1 MB/s changes every second; a tenth of a 30 s ETA is 3 s
+    QCOMPARE(TorrentMonitor::pollIntervalMs({downloading(1000000, 100, 100000000)}), 1000);
+    QCOMPARE(TorrentMonitor::pollIntervalMs({downloading(1000000, 30, 0)}), 3000);
+    // Almost done: as often as allowed; several torrents share the shortest interval
+    QCOMPARE(TorrentMonitor::pollIntervalMs({downloading(1000000, 2, 0)}), TorrentMonitor::kMinIntervalMs);
+    QCOMPARE(TorrentMonitor::pollIntervalMs(
+                 {downloading(0, 8640000, 1000000000), downloading(1000000, 100, 100000000)}),
+             1000);
+}
+
+QTEST_MAIN(TorrentMonitorTest)
+#include "torrentmonitor_test.moc"
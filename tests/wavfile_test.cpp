@@ -0,0 +1,172 @@
+/**
+ * @file wavfile_test.cpp
+ * @brief Unit tests for WavFile: RIFF, RF64 and Wave64 headers and truncation checks
+ */
+
+#include <QtTest/QtTest>
+#include <QByteArray>
+#include <QDataStream>
+#include <QFile>
+#include <QString>
+#include <QTemporaryDir>
+
+#include "wavfile.h"
+
+class WavFileTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testWavFile_readsRf64AndWave64AndCatchesTruncation();
+    void testWavFile_unsupportedFormatIsNotDamage();
+};
+
+/**
+ * @brief Test: RF64 and Wave64 headers give the same format and duration as RIFF, truncated files are reported
+ */
+void WavFileTest::testWavFile_readsRf64AndWave64AndCatchesTruncation()
+{
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    const auto writeFile = [&](const QString& name, const QByteArray& bytes)
+    {
+        const QString path = tempDir.filePath(name);
+        QFile file(path);
+        if (file.open(QIODevice::WriteOnly))
+        {
+            file.write(bytes);
+        }
+        return path;
+    };
+
+    // 2.5 s of 48 kHz 24-bit stereo silence
+    const qint64 frames = 120000;
+    const QByteArray pcm(frames * 6, '\0');
+    const auto format = [](QDataStream& stream)
+    {
+        stream << quint16(1) << quint16(2) << quint32(48000) << quint32(48000 * 6) << quint16(6) << quint16(24);
+    };
+
+    QByteArray rf64;
+    QDataStream rf64Stream(&rf64, QIODevice::WriteOnly);
+    rf64Stream.setByteOrder(QDataStream::LittleEndian);
+    rf64Stream.writeRawData("RF64", 4);
+    rf64Stream << quint32(0xFFFFFFFF);
+    rf64Stream.writeRawData("WAVEds64", 8);
+    rf64Stream << quint32(28) << quint64(0) << quint64(pcm.size()) << quint64(frames) << quint32(0);
+    rf64Stream.writeRawData("fmt ", 4);
+    rf64Stream << quint32(16);
+    format(rf64Stream);
+    rf64Stream.writeRawData("data", 4);
+    rf64Stream << quint32(0xFFFFFFFF);
+    rf64.append(pcm);
+
+    const QByteArray guidSuffix = QByteArray::fromHex("f3acd3118cd100c04f8edb8a");
+    QByteArray wave64;
+    QDataStream wave64Stream(&wave64, QIODevice::WriteOnly);
+    wave64Stream.setByteOrder(QDataStream::LittleEndian);
+    wave64Stream.writeRawData("riff", 4);
+    wave64Stream.writeRawData(QByteArray::fromHex("2e91cf11a5d628db04c10000").constData(), 12);
+    wave64Stream << quint64(40 + 24 + 16 + 24 + pcm.size());
+    wave64Stream.writeRawData("wave", 4);
+    wave64Stream.writeRawData(guidSuffix.constData(), 12);
+    wave64Stream.writeRawData("fmt ", 4);
+    wave64Stream.writeRawData(guidSuffix.constData(), 12);
+    wave64Stream << quint64(24 + 16);
+    format(wave64Stream);
+    wave64Stream.writeRawData("data", 4);
+    wave64Stream.writeRawData(guidSuffix.constData(), 12);
+    wave64Stream << quint64(24 + pcm.size());
+    wave64.append(pcm);
+
+    for (const QString& path : {writeFile("dub.rf64.wav", rf64), writeFile("dub.w64", wave64)})
+    {
+        const WavInfo info = WavFile::readHeader(path);
+        QVERIFY2(info.ok, qPrintable(info.errorString));
+        QCOMPARE(info.bitsPerSample, 24);
+        QCOMPARE(info.frameCount(), frames);
+        QCOMPARE(info.durationUs(), qint64(2500000));
+        QVERIFY(WavFile::integrityError(info).isEmpty());
+    }
+    QCOMPARE(WavFile::readHeader(tempDir.filePath("dub.w64")).container, WavContainer::Wave64);
+
+    // An interrupted upload: the header promises more data than the file holds
+    const WavInfo truncated = WavFile::readHeader(writeFile("truncated.wav", rf64.left(rf64.size() - 6000)));
+    QVERIFY(truncated.ok);
+    QVERIFY(truncated.isTruncated());
+    QCOMPARE(truncated.frameCount(), frames - 1000);
+    QVERIFY(!WavFile::integrityError(truncated).isEmpty());
+
+    // Cut inside the header, and a file that is not WAV at all
+    QVERIFY(!WavFile::integrityError(WavFile::readHeader(writeFile("header.wav", rf64.left(50)))).isEmpty());
+    const WavInfo flac = WavFile::readHeader(writeFile("dub.flac", QByteArray("fLaC").append(64, '\0')));
+    QCOMPARE(flac.container, WavContainer::None);
+    QVERIFY(WavFile::integrityError(flac).isEmpty());
+}
+
+/**
+ * @brief Test: intact WAV files with ADPCM or EXTENSIBLE A-law samples go to ffmpeg, truncation is still reported
+ */
+void WavFileTest::testWavFile_unsupportedFormatIsNotDamage()
+{
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    const auto writeWav = [&](const QString& name, const QByteArray& format, qint64 dataSize, qint64 written)
+    {
+        QByteArray bytes;
+        QDataStream stream(&bytes, QIODevice::WriteOnly);
+        stream.setByteOrder(QDataStream::LittleEndian);
+        stream.writeRawData("RIFF", 4);
+        stream << quint32(4 + 8 + format.size() + 8 + dataSize);
+        stream.writeRawData("WAVEfmt ", 8);
+        stream << quint32(format.size());
+        stream.writeRawData(format.constData(), format.size());
+        stream.writeRawData("data", 4);
+        stream << quint32(dataSize);
+        bytes.append(QByteArray(written, '\x11'));
+        const QString path = tempDir.filePath(name);
+        QFile file(path);
+        if (file.open(QIODevice::WriteOnly))
+        {
+            file.write(bytes);
+        }
+        return path;
+    };
+
+    // IMA ADPCM: 2048-byte blocks, 4 bits per sample, cbSize and samples per block after the base fields
+    QByteArray adpcm;
+    QDataStream adpcmStream(&adpcm, QIODevice::WriteOnly);
+    adpcmStream.setByteOrder(QDataStream::LittleEndian);
+    adpcmStream << quint16(0x11) << quint16(2) << quint32(48000) << quint32(48000 * 2) << quint16(2048)
+                << quint16(4) << quint16(2) << quint16(2041);
+
+    // EXTENSIBLE whose SubFormat is A-law
+    QByteArray alaw;
+    QDataStream alawStream(&alaw, QIODevice::WriteOnly);
+    alawStream.setByteOrder(QDataStream::LittleEndian);
+    alawStream << quint16(0xFFFE) << quint16(2) << quint32(48000) << quint32(48000 * 2) << quint16(2) << quint16(8)
+               << quint16(22) << quint16(8) << quint32(3) << quint16(0x0006);
+    alawStream.writeRawData(QByteArray::fromHex("000000001000800000aa00389b71").constData(), 14);
+
+    for (const QString& path : {writeWav("adpcm.wav", adpcm, 8192, 8192), writeWav("alaw.wav", alaw, 9600, 9600)})
+    {
+        const WavInfo info = WavFile::readHeader(path);
+        QVERIFY(!info.ok);
+        QVERIFY(info.unsupportedFormat);
+        QVERIFY(!WavFile::isWav(path));
+        QVERIFY2(WavFile::integrityError(info).isEmpty(), qPrintable(WavFile::integrityError(info)));
+    }
+
+    const WavInfo truncated = WavFile::readHeader(writeWav("adpcm_cut.wav", adpcm, 8192, 5000));
+    QVERIFY(truncated.unsupportedFormat);
+    QVERIFY(truncated.isTruncated());
+    QVERIFY(!WavFile::integrityError(truncated).isEmpty());
+
+    // A fmt chunk too short for its own format is damage, not an unknown format
+    const WavInfo broken = WavFile::readHeader(writeWav("broken.wav", alaw.left(24), 9600, 9600));
+    QVERIFY(!broken.unsupportedFormat);
+    QVERIFY(!WavFile::integrityError(broken).isEmpty());
+}
+
+QTEST_MAIN(WavFileTest)
+#include "wavfile_test.moc"